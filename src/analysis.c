@@ -0,0 +1,634 @@
+/*******************************************************************************
+** analysis.c (gamut clipping & perceptual spacing analysis)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "analysis.h"
+#include "palette.h"
+
+/* the yiq to rgb conversion is repeated here with the same float  */
+/* operations as generate_palette_base_row(), so the clip counts   */
+/* match the generated texture exactly. the colors are then taken  */
+/* to cie lab (srgb, d65 white point). each row of shades is done  */
+/* 4 at a time with sse2 (or with the equivalent scalar code).     */
+
+/* the cube root for cie lab is computed by newton's method, */
+/* starting from a guess made by dividing the exponent by 3  */
+#define ANALYSIS_CBRT_MAGIC       709921077
+#define ANALYSIS_CBRT_ITERATIONS  3
+
+#define ANALYSIS_LAB_EPSILON  0.008856451679f   /* (6/29)^3 */
+#define ANALYSIS_LAB_KAPPA    903.2962962963f   /* (29/3)^3 */
+
+float S_analysis_linear_table[256];
+
+/*******************************************************************************
+** generate_analysis_tables()
+*******************************************************************************/
+short int generate_analysis_tables()
+{
+  int   k;
+  float c;
+
+  /* srgb to linear */
+  for (k = 0; k < 256; k++)
+  {
+    c = k / 255.0f;
+
+    if (c <= 0.04045f)
+      S_analysis_linear_table[k] = c / 12.92f;
+    else
+      S_analysis_linear_table[k] = (float) pow((c + 0.055f) / 1.055f, 2.4f);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_analysis_rgb()
+*******************************************************************************/
+short int convert_analysis_rgb(analysis_row* row, int num_shades)
+{
+  int k;
+
+#ifdef __SSE2__
+  __m128  y;
+  __m128  i;
+  __m128  q;
+  __m128  v;
+  __m128  scale;
+  __m128  half;
+
+  scale = _mm_set1_ps(255.0f);
+  half = _mm_set1_ps(0.5f);
+
+  for (k = 0; k < num_shades; k += 4)
+  {
+    y = _mm_loadu_ps(&row->y[k]);
+    i = _mm_loadu_ps(&row->i[k]);
+    q = _mm_loadu_ps(&row->q[k]);
+
+    v = _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(i, _mm_set1_ps(0.956f))), _mm_mul_ps(q, _mm_set1_ps(0.619f)));
+    v = _mm_mul_ps(v, scale);
+    _mm_storeu_ps(&row->rgb[0][k], v);
+    _mm_storeu_si128((__m128i*) &row->rounded[0][k], _mm_cvttps_epi32(_mm_add_ps(v, half)));
+
+    v = _mm_sub_ps(_mm_sub_ps(y, _mm_mul_ps(i, _mm_set1_ps(0.272f))), _mm_mul_ps(q, _mm_set1_ps(0.647f)));
+    v = _mm_mul_ps(v, scale);
+    _mm_storeu_ps(&row->rgb[1][k], v);
+    _mm_storeu_si128((__m128i*) &row->rounded[1][k], _mm_cvttps_epi32(_mm_add_ps(v, half)));
+
+    v = _mm_add_ps(_mm_sub_ps(y, _mm_mul_ps(i, _mm_set1_ps(1.106f))), _mm_mul_ps(q, _mm_set1_ps(1.703f)));
+    v = _mm_mul_ps(v, scale);
+    _mm_storeu_ps(&row->rgb[2][k], v);
+    _mm_storeu_si128((__m128i*) &row->rounded[2][k], _mm_cvttps_epi32(_mm_add_ps(v, half)));
+  }
+#else
+  for (k = 0; k < num_shades; k++)
+  {
+    row->rgb[0][k] = (row->y[k] + (row->i[k] * 0.956f) + (row->q[k] * 0.619f)) * 255;
+    row->rgb[1][k] = (row->y[k] - (row->i[k] * 0.272f) - (row->q[k] * 0.647f)) * 255;
+    row->rgb[2][k] = (row->y[k] - (row->i[k] * 1.106f) + (row->q[k] * 1.703f)) * 255;
+
+    row->rounded[0][k] = (int) (row->rgb[0][k] + 0.5f);
+    row->rounded[1][k] = (int) (row->rgb[1][k] + 0.5f);
+    row->rounded[2][k] = (int) (row->rgb[2][k] + 0.5f);
+  }
+#endif
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_analysis_lab()
+*******************************************************************************/
+short int convert_analysis_lab(analysis_row* row, int num_shades)
+{
+  int k;
+  int n;
+  int m;
+
+#ifdef __SSE2__
+  __m128  r;
+  __m128  g;
+  __m128  b;
+  __m128  t[3];
+  __m128  f[3];
+  __m128  guess;
+  __m128  linear;
+  __m128  third;
+  __m128  mask;
+
+  third = _mm_set1_ps(1.0f / 3.0f);
+
+  for (k = 0; k < num_shades; k += 4)
+  {
+    /* the linear values were stored in place of the rgb values */
+    r = _mm_loadu_ps(&row->rgb[0][k]);
+    g = _mm_loadu_ps(&row->rgb[1][k]);
+    b = _mm_loadu_ps(&row->rgb[2][k]);
+
+    /* linear rgb to xyz (normalized by the white point) */
+    t[0] = _mm_add_ps(_mm_add_ps( _mm_mul_ps(r, _mm_set1_ps(0.4124564f / 0.95047f)),
+                                  _mm_mul_ps(g, _mm_set1_ps(0.3575761f / 0.95047f))),
+                                  _mm_mul_ps(b, _mm_set1_ps(0.1804375f / 0.95047f)));
+    t[1] = _mm_add_ps(_mm_add_ps( _mm_mul_ps(r, _mm_set1_ps(0.2126729f)),
+                                  _mm_mul_ps(g, _mm_set1_ps(0.7151522f))),
+                                  _mm_mul_ps(b, _mm_set1_ps(0.0721750f)));
+    t[2] = _mm_add_ps(_mm_add_ps( _mm_mul_ps(r, _mm_set1_ps(0.0193339f / 1.08883f)),
+                                  _mm_mul_ps(g, _mm_set1_ps(0.1191920f / 1.08883f))),
+                                  _mm_mul_ps(b, _mm_set1_ps(0.9503041f / 1.08883f)));
+
+    for (n = 0; n < 3; n++)
+    {
+      /* cube root */
+      guess = _mm_cvtepi32_ps(_mm_castps_si128(t[n]));
+      f[n] = _mm_castsi128_ps(_mm_add_epi32(_mm_cvttps_epi32(_mm_mul_ps(guess, third)),
+                                            _mm_set1_epi32(ANALYSIS_CBRT_MAGIC)));
+
+      for (m = 0; m < ANALYSIS_CBRT_ITERATIONS; m++)
+        f[n] = _mm_mul_ps(_mm_add_ps(_mm_add_ps(f[n], f[n]), _mm_div_ps(t[n], _mm_mul_ps(f[n], f[n]))), third);
+
+      /* linear segment near black */
+      linear = _mm_div_ps(_mm_add_ps(_mm_mul_ps(t[n], _mm_set1_ps(ANALYSIS_LAB_KAPPA)), _mm_set1_ps(16.0f)),
+                          _mm_set1_ps(116.0f));
+
+      mask = _mm_cmpgt_ps(t[n], _mm_set1_ps(ANALYSIS_LAB_EPSILON));
+      f[n] = _mm_or_ps(_mm_and_ps(mask, f[n]), _mm_andnot_ps(mask, linear));
+    }
+
+    _mm_storeu_ps(&row->lab[0][k], _mm_sub_ps(_mm_mul_ps(f[1], _mm_set1_ps(116.0f)), _mm_set1_ps(16.0f)));
+    _mm_storeu_ps(&row->lab[1][k], _mm_mul_ps(_mm_sub_ps(f[0], f[1]), _mm_set1_ps(500.0f)));
+    _mm_storeu_ps(&row->lab[2][k], _mm_mul_ps(_mm_sub_ps(f[1], f[2]), _mm_set1_ps(200.0f)));
+  }
+#else
+  float r;
+  float g;
+  float b;
+  float t[3];
+  float f[3];
+  int   bits;
+
+  for (k = 0; k < num_shades; k++)
+  {
+    r = row->rgb[0][k];
+    g = row->rgb[1][k];
+    b = row->rgb[2][k];
+
+    t[0] = (r * (0.4124564f / 0.95047f)) + (g * (0.3575761f / 0.95047f)) + (b * (0.1804375f / 0.95047f));
+    t[1] = (r * 0.2126729f) + (g * 0.7151522f) + (b * 0.0721750f);
+    t[2] = (r * (0.0193339f / 1.08883f)) + (g * (0.1191920f / 1.08883f)) + (b * (0.9503041f / 1.08883f));
+
+    for (n = 0; n < 3; n++)
+    {
+      if (t[n] > ANALYSIS_LAB_EPSILON)
+      {
+        memcpy(&bits, &t[n], sizeof(float));
+        bits = (int) (((float) bits) * (1.0f / 3.0f)) + ANALYSIS_CBRT_MAGIC;
+        memcpy(&f[n], &bits, sizeof(float));
+
+        for (m = 0; m < ANALYSIS_CBRT_ITERATIONS; m++)
+          f[n] = (f[n] + f[n] + (t[n] / (f[n] * f[n]))) * (1.0f / 3.0f);
+      }
+      else
+        f[n] = ((t[n] * ANALYSIS_LAB_KAPPA) + 16.0f) / 116.0f;
+    }
+
+    row->lab[0][k] = (f[1] * 116.0f) - 16.0f;
+    row->lab[1][k] = (f[0] - f[1]) * 500.0f;
+    row->lab[2][k] = (f[1] - f[2]) * 200.0f;
+  }
+#endif
+
+  return 0;
+}
+
+/*******************************************************************************
+** compute_analysis_delta_e()
+*******************************************************************************/
+short int compute_analysis_delta_e( float* delta_e,
+                                    float* l1, float* a1, float* b1,
+                                    float* l2, float* a2, float* b2,
+                                    int num_values)
+{
+  int k;
+
+#ifdef __SSE2__
+  __m128  dl;
+  __m128  da;
+  __m128  db;
+
+  for (k = 0; k + 4 <= num_values; k += 4)
+  {
+    dl = _mm_sub_ps(_mm_loadu_ps(&l1[k]), _mm_loadu_ps(&l2[k]));
+    da = _mm_sub_ps(_mm_loadu_ps(&a1[k]), _mm_loadu_ps(&a2[k]));
+    db = _mm_sub_ps(_mm_loadu_ps(&b1[k]), _mm_loadu_ps(&b2[k]));
+
+    _mm_storeu_ps(&delta_e[k],
+                  _mm_sqrt_ps(_mm_add_ps( _mm_add_ps(_mm_mul_ps(dl, dl), _mm_mul_ps(da, da)),
+                                          _mm_mul_ps(db, db))));
+  }
+#else
+  k = 0;
+#endif
+
+  for (; k < num_values; k++)
+  {
+    delta_e[k] = (float) sqrt( ((l1[k] - l2[k]) * (l1[k] - l2[k])) +
+                               ((a1[k] - a2[k]) * (a1[k] - a2[k])) +
+                               ((b1[k] - b2[k]) * (b1[k] - b2[k])));
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_analysis_row()
+*******************************************************************************/
+short int generate_analysis_row(palette_params* pp, palette_analysis* pa,
+                                analysis_row* row, int n)
+{
+  int   num_shades;
+  int   padded_shades;
+
+  float angle;
+  double c;
+  double s;
+
+  float magnitude;
+
+  int   k;
+  int   m;
+  int   v;
+
+  num_shades = pp->num_shades;
+  padded_shades = (num_shades + 3) & ~3;
+
+  /* compute color in yiq (as in the generator) */
+  if (n > 0)
+  {
+    angle = ((TWO_PI * (n - 1)) / pp->num_hues) + pp->phi;
+
+    c = cos(angle);
+    s = sin(angle);
+  }
+  else
+  {
+    c = 0.0;
+    s = 0.0;
+  }
+
+  for (k = 0; k < padded_shades; k++)
+  {
+    if (k < num_shades)
+    {
+      row->y[k] = pp->luma_table[k];
+      row->i[k] = pp->saturation_table[k] * c;
+      row->q[k] = pp->saturation_table[k] * s;
+    }
+    else
+    {
+      row->y[k] = 0.0f;
+      row->i[k] = 0.0f;
+      row->q[k] = 0.0f;
+    }
+  }
+
+  convert_analysis_rgb(row, padded_shades);
+
+  /* count clipped channels, and replace the */
+  /* rgb values with the linear clamped ones */
+  for (m = 0; m < 3; m++)
+  {
+    for (k = 0; k < padded_shades; k++)
+    {
+      v = row->rounded[m][k];
+
+      if ((v < 0) || (v > 255))
+      {
+        if (v < 0)
+        {
+          magnitude = -row->rgb[m][k];
+          v = 0;
+        }
+        else
+        {
+          magnitude = row->rgb[m][k] - 255.0f;
+          v = 255;
+        }
+
+        if (k < num_shades)
+        {
+          pa->gradient_clip_counts[n] += 1;
+          pa->gradient_clip_magnitudes[n] += magnitude;
+
+          pa->shade_clip_counts[k] += 1;
+          pa->shade_clip_magnitudes[k] += magnitude;
+
+          pa->clip_count += 1;
+          pa->clip_magnitude += magnitude;
+
+          if (magnitude > pa->max_clip_magnitude)
+            pa->max_clip_magnitude = magnitude;
+        }
+      }
+
+      row->rgb[m][k] = S_analysis_linear_table[v];
+    }
+  }
+
+  convert_analysis_lab(row, padded_shades);
+
+  return 0;
+}
+
+/*******************************************************************************
+** accumulate_analysis_hue_delta_e()
+*******************************************************************************/
+short int accumulate_analysis_hue_delta_e(palette_analysis* pa, float* delta_e)
+{
+  int k;
+
+  for (k = 0; k < pa->num_shades; k++)
+  {
+    if ((pa->shade_min_delta_e[k] < 0.0f) || (delta_e[k] < pa->shade_min_delta_e[k]))
+      pa->shade_min_delta_e[k] = delta_e[k];
+
+    if (delta_e[k] > pa->shade_max_delta_e[k])
+      pa->shade_max_delta_e[k] = delta_e[k];
+
+    pa->shade_mean_delta_e[k] += delta_e[k];
+
+    if ((pa->min_hue_delta_e < 0.0f) || (delta_e[k] < pa->min_hue_delta_e))
+      pa->min_hue_delta_e = delta_e[k];
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** analyze_palette_rows()
+*******************************************************************************/
+short int analyze_palette_rows(palette_params* pp, palette_analysis* pa, analysis_row* rows)
+{
+  analysis_row* current;
+  analysis_row* previous;
+
+  float delta_e[ANALYSIS_MAX_SHADES];
+
+  int   num_gradients;
+  int   num_shades;
+
+  int   num_hue_pairs;
+
+  int   n;
+  int   k;
+
+  if ((pp == NULL) || (pa == NULL))
+    return 1;
+
+  if ((pp->luma_table == NULL) || (pp->saturation_table == NULL))
+    return 1;
+
+  num_gradients = pp->num_hues + 1;
+  num_shades = pp->num_shades;
+
+  if ((pp->num_hues < 1) || (num_gradients > ANALYSIS_MAX_GRADIENTS) ||
+      (num_shades < 1) || (num_shades > ANALYSIS_MAX_SHADES))
+  {
+    return 1;
+  }
+
+  if (rows == NULL)
+    return 1;
+
+  memset(pa, 0, sizeof(palette_analysis));
+
+  pa->num_gradients = num_gradients;
+  pa->num_shades = num_shades;
+
+  pa->min_shade_delta_e = -1.0f;
+  pa->min_hue_delta_e = -1.0f;
+
+  for (k = 0; k < num_shades; k++)
+    pa->shade_min_delta_e[k] = -1.0f;
+
+  num_hue_pairs = (pp->num_hues > 2) ? pp->num_hues : pp->num_hues - 1;
+
+  previous = NULL;
+
+  for (n = 0; n < num_gradients; n++)
+  {
+    current = &rows[(n == 1) ? 0 : 1 + (n % 2)];
+
+    generate_analysis_row(pp, pa, current, n);
+
+    /* adjacent shades */
+    pa->gradient_min_delta_e[n] = -1.0f;
+
+    if (num_shades > 1)
+    {
+      compute_analysis_delta_e( delta_e,
+                                &current->lab[0][0], &current->lab[1][0], &current->lab[2][0],
+                                &current->lab[0][1], &current->lab[1][1], &current->lab[2][1],
+                                num_shades - 1);
+
+      for (k = 0; k < num_shades - 1; k++)
+      {
+        if ((pa->gradient_min_delta_e[n] < 0.0f) || (delta_e[k] < pa->gradient_min_delta_e[n]))
+          pa->gradient_min_delta_e[n] = delta_e[k];
+
+        if (delta_e[k] > pa->gradient_max_delta_e[n])
+          pa->gradient_max_delta_e[n] = delta_e[k];
+
+        pa->gradient_mean_delta_e[n] += delta_e[k];
+      }
+
+      pa->mean_shade_delta_e += pa->gradient_mean_delta_e[n];
+      pa->gradient_mean_delta_e[n] /= num_shades - 1;
+
+      if ((pa->min_shade_delta_e < 0.0f) || (pa->gradient_min_delta_e[n] < pa->min_shade_delta_e))
+        pa->min_shade_delta_e = pa->gradient_min_delta_e[n];
+    }
+
+    /* adjacent hues */
+    if (n >= 2)
+    {
+      compute_analysis_delta_e( delta_e,
+                                previous->lab[0], previous->lab[1], previous->lab[2],
+                                current->lab[0], current->lab[1], current->lab[2],
+                                num_shades);
+
+      accumulate_analysis_hue_delta_e(pa, delta_e);
+    }
+
+    /* the last hue wraps around to the first */
+    if ((n == num_gradients - 1) && (pp->num_hues > 2))
+    {
+      compute_analysis_delta_e( delta_e,
+                                rows[0].lab[0], rows[0].lab[1], rows[0].lab[2],
+                                current->lab[0], current->lab[1], current->lab[2],
+                                num_shades);
+
+      accumulate_analysis_hue_delta_e(pa, delta_e);
+    }
+
+    previous = current;
+  }
+
+  /* means */
+  if (num_shades > 1)
+    pa->mean_shade_delta_e /= num_gradients * (num_shades - 1);
+
+  if (num_hue_pairs > 0)
+  {
+    for (k = 0; k < num_shades; k++)
+    {
+      pa->mean_hue_delta_e += pa->shade_mean_delta_e[k];
+      pa->shade_mean_delta_e[k] /= num_hue_pairs;
+    }
+
+    pa->mean_hue_delta_e /= num_hue_pairs * num_shades;
+  }
+
+  /* minimums are 0 where there was nothing to compare */
+  if (pa->min_shade_delta_e < 0.0f)
+    pa->min_shade_delta_e = 0.0f;
+
+  if (pa->min_hue_delta_e < 0.0f)
+    pa->min_hue_delta_e = 0.0f;
+
+  for (n = 0; n < num_gradients; n++)
+  {
+    if (pa->gradient_min_delta_e[n] < 0.0f)
+      pa->gradient_min_delta_e[n] = 0.0f;
+  }
+
+  for (k = 0; k < num_shades; k++)
+  {
+    if (pa->shade_min_delta_e[k] < 0.0f)
+      pa->shade_min_delta_e[k] = 0.0f;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** analyze_palette()
+*******************************************************************************/
+short int analyze_palette(palette_params* pp, palette_analysis* pa)
+{
+  analysis_row* rows;
+
+  short int status;
+
+  /* the first hue is kept so the last hue can be compared with it */
+  rows = malloc(sizeof(analysis_row) * ANALYSIS_NUM_ROWS);
+
+  if (rows == NULL)
+    return 1;
+
+  status = analyze_palette_rows(pp, pa, rows);
+
+  free(rows);
+
+  return status;
+}
+
+/*******************************************************************************
+** analyze_palette_source()
+*******************************************************************************/
+short int analyze_palette_source(int source, palette_analysis* pa)
+{
+  palette_params  params;
+
+  int   table_length;
+
+  if (pa == NULL)
+    return 1;
+
+  /* the approx nes palettes have 12 hues of 4 shades, */
+  /* with the hues rotated by 15 degrees in mode 1     */
+  if ((source == SOURCE_APPROX_NES) || (source == SOURCE_APPROX_NES_ROTATED))
+  {
+    params.num_hues = 12;
+    params.num_shades = 4;
+
+    if (source == SOURCE_APPROX_NES_ROTATED)
+      params.phi = (15 * TWO_PI) / 360.0f;
+    else
+      params.phi = 0.0f;
+  }
+  else if (set_palette_params_for_source(&params, source))
+    return 1;
+
+  if (get_source_voltage_tables(source, &params.luma_table, &params.saturation_table, &table_length))
+    return 1;
+
+  return analyze_palette(&params, pa);
+}
+
+/*******************************************************************************
+** write_palette_analysis()
+*******************************************************************************/
+short int write_palette_analysis(FILE* fp_out, palette_analysis* pa, char* name)
+{
+  int n;
+  int k;
+
+  if ((fp_out == NULL) || (pa == NULL))
+    return 1;
+
+  /* summary */
+  fprintf(fp_out, "palette %s: %d hues, %d shades\n",
+          (name != NULL) ? name : "", pa->num_gradients - 1, pa->num_shades);
+
+  fprintf(fp_out, "clipped channels: %d (total %.2f, max %.2f)\n",
+          pa->clip_count, pa->clip_magnitude, pa->max_clip_magnitude);
+
+  fprintf(fp_out, "delta e between shades: min %.2f, mean %.2f\n",
+          pa->min_shade_delta_e, pa->mean_shade_delta_e);
+
+  fprintf(fp_out, "delta e between hues: min %.2f, mean %.2f\n",
+          pa->min_hue_delta_e, pa->mean_hue_delta_e);
+
+  /* per hue (delta e between adjacent shades) */
+  fprintf(fp_out, "\nhue,clipped,clip_total,min_shade_delta_e,mean_shade_delta_e,max_shade_delta_e\n");
+
+  for (n = 0; n < pa->num_gradients; n++)
+  {
+    if (n == 0)
+      fprintf(fp_out, "grey");
+    else
+      fprintf(fp_out, "%d", n);
+
+    fprintf(fp_out, ",%d,%.2f,%.2f,%.2f,%.2f\n",
+            pa->gradient_clip_counts[n], pa->gradient_clip_magnitudes[n],
+            pa->gradient_min_delta_e[n], pa->gradient_mean_delta_e[n],
+            pa->gradient_max_delta_e[n]);
+  }
+
+  /* per shade (delta e between adjacent hues) */
+  fprintf(fp_out, "\nshade,clipped,clip_total,min_hue_delta_e,mean_hue_delta_e,max_hue_delta_e\n");
+
+  for (k = 0; k < pa->num_shades; k++)
+  {
+    fprintf(fp_out, "%d,%d,%.2f,%.2f,%.2f,%.2f\n",
+            k, pa->shade_clip_counts[k], pa->shade_clip_magnitudes[k],
+            pa->shade_min_delta_e[k], pa->shade_mean_delta_e[k],
+            pa->shade_max_delta_e[k]);
+  }
+
+  if (ferror(fp_out))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+** analysis.h (gamut clipping & perceptual spacing analysis)
+*******************************************************************************/
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdio.h>
+
+#include "palette.h"
+
+/* the hues & shades fill one row, and there are at least size / 32 */
+/* shades, so there are never more than 32 gradients (incl. grey)   */
+#define ANALYSIS_MAX_GRADIENTS  32
+#define ANALYSIS_MAX_SHADES     256
+
+/* one row of shades, in structure of arrays form */
+typedef struct analysis_row
+{
+  float y[ANALYSIS_MAX_SHADES];
+  float i[ANALYSIS_MAX_SHADES];
+  float q[ANALYSIS_MAX_SHADES];
+
+  float rgb[3][ANALYSIS_MAX_SHADES];
+  int   rounded[3][ANALYSIS_MAX_SHADES];
+
+  float lab[3][ANALYSIS_MAX_SHADES];
+} analysis_row;
+
+/* the rows used by the analysis (the first hue, and the */
+/* previous & current gradients)                         */
+#define ANALYSIS_NUM_ROWS 3
+
+/* every color in a composite texture is a copy of one of the colors */
+/* in the palette 0 base row (or black / white), so the analysis is  */
+/* done on the base row: gradient 0 is grey, and 1 to n are the hues */
+typedef struct palette_analysis
+{
+  int   num_gradients;
+  int   num_shades;
+
+  /* clipped channels, and the amount out of range (in 0-255 units) */
+  int   gradient_clip_counts[ANALYSIS_MAX_GRADIENTS];
+  float gradient_clip_magnitudes[ANALYSIS_MAX_GRADIENTS];
+
+  int   shade_clip_counts[ANALYSIS_MAX_SHADES];
+  float shade_clip_magnitudes[ANALYSIS_MAX_SHADES];
+
+  /* cie76 delta e between adjacent shades of each gradient */
+  float gradient_min_delta_e[ANALYSIS_MAX_GRADIENTS];
+  float gradient_mean_delta_e[ANALYSIS_MAX_GRADIENTS];
+  float gradient_max_delta_e[ANALYSIS_MAX_GRADIENTS];
+
+  /* cie76 delta e between adjacent hues (wrapping around) at each shade */
+  float shade_min_delta_e[ANALYSIS_MAX_SHADES];
+  float shade_mean_delta_e[ANALYSIS_MAX_SHADES];
+  float shade_max_delta_e[ANALYSIS_MAX_SHADES];
+
+  /* totals */
+  int   clip_count;
+  float clip_magnitude;
+  float max_clip_magnitude;
+
+  float min_shade_delta_e;
+  float mean_shade_delta_e;
+  float min_hue_delta_e;
+  float mean_hue_delta_e;
+} palette_analysis;
+
+/* function declarations */
+short int generate_analysis_tables();
+
+short int analyze_palette_rows(palette_params* pp, palette_analysis* pa, analysis_row* rows);
+short int analyze_palette(palette_params* pp, palette_analysis* pa);
+short int analyze_palette_source(int source, palette_analysis* pa);
+
+short int write_palette_analysis(FILE* fp_out, palette_analysis* pa, char* name);
+
+#endif
@@ -0,0 +1,387 @@
+/*******************************************************************************
+** atlas.c (texture atlas of all sources)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+#include "palette.h"
+#include "pool.h"
+#include "tga.h"
+
+/* the atlas contains every source in its own region. the regions    */
+/* are placed with a skyline (bottom left) packer, largest first,    */
+/* into the smallest power of two atlas that fits them (the width is */
+/* doubled first). the composite sources are generated in parallel,  */
+/* directly into their regions (with the atlas width as the row      */
+/* stride). the approx & ntsc nes sources are generated on their own */
+/* and copied in, with transparent colors written as magenta (as in  */
+/* the tga output).                                                  */
+/*                                                                   */
+/* the uv file has one line per region, with its pixel rectangle and */
+/* the matching texture coordinates of its outer edges (the origin   */
+/* is the top left corner, as in the tga file):                      */
+/*                                                                   */
+/*   name,x,y,width,height,u0,v0,u1,v1                               */
+
+atlas_region  G_atlas_regions[NUM_SOURCES];
+
+int G_atlas_width;
+int G_atlas_height;
+
+unsigned char*  G_atlas_data;
+
+/*******************************************************************************
+** try_atlas_packing()
+*******************************************************************************/
+short int try_atlas_packing(int width, int height, int* order)
+{
+  int*  skyline;
+
+  atlas_region* region;
+
+  int   best_x;
+  int   best_y;
+  int   y;
+
+  int   m;
+  int   n;
+  int   k;
+
+  /* height of the filled area in each column */
+  skyline = malloc(sizeof(int) * width);
+
+  if (skyline == NULL)
+    return 1;
+
+  for (n = 0; n < width; n++)
+    skyline[n] = 0;
+
+  for (k = 0; k < NUM_SOURCES; k++)
+  {
+    region = &G_atlas_regions[order[k]];
+
+    best_x = -1;
+    best_y = 0;
+
+    /* the candidates are the starts of the skyline segments */
+    for (n = 0; n + region->width <= width; n++)
+    {
+      if ((n > 0) && (skyline[n] == skyline[n - 1]))
+        continue;
+
+      y = 0;
+
+      for (m = n; m < n + region->width; m++)
+      {
+        if (skyline[m] > y)
+          y = skyline[m];
+      }
+
+      if (y + region->height > height)
+        continue;
+
+      if ((best_x < 0) || (y < best_y))
+      {
+        best_x = n;
+        best_y = y;
+      }
+    }
+
+    if (best_x < 0)
+    {
+      free(skyline);
+      return 1;
+    }
+
+    region->x = best_x;
+    region->y = best_y;
+
+    for (n = best_x; n < best_x + region->width; n++)
+      skyline[n] = best_y + region->height;
+  }
+
+  free(skyline);
+
+  return 0;
+}
+
+/*******************************************************************************
+** pack_atlas_regions()
+*******************************************************************************/
+short int pack_atlas_regions()
+{
+  int   order[NUM_SOURCES];
+
+  int   n;
+  int   k;
+  int   tmp;
+
+  /* set region sizes */
+  for (k = 0; k < NUM_SOURCES; k++)
+  {
+    G_atlas_regions[k].source = k;
+
+    G_atlas_regions[k].x = 0;
+    G_atlas_regions[k].y = 0;
+    G_atlas_regions[k].width = get_source_palette_size(k);
+    G_atlas_regions[k].height = get_source_palette_size(k);
+
+    G_atlas_regions[k].status = 0;
+
+    order[k] = k;
+  }
+
+  /* sort by size (largest first, in source order otherwise) */
+  for (k = 1; k < NUM_SOURCES; k++)
+  {
+    for (n = k; n > 0; n--)
+    {
+      if (G_atlas_regions[order[n]].height <= G_atlas_regions[order[n - 1]].height)
+        break;
+
+      tmp = order[n];
+      order[n] = order[n - 1];
+      order[n - 1] = tmp;
+    }
+  }
+
+  /* find the smallest atlas that fits */
+  G_atlas_width = G_atlas_regions[order[0]].width;
+  G_atlas_height = G_atlas_regions[order[0]].height;
+
+  while (try_atlas_packing(G_atlas_width, G_atlas_height, order))
+  {
+    if (G_atlas_width == G_atlas_height)
+      G_atlas_width *= 2;
+    else
+      G_atlas_height *= 2;
+
+    if (G_atlas_width > ATLAS_MAX_SIZE)
+    {
+      fprintf(stderr, "Unable to pack atlas: The regions do not fit.\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** copy_atlas_nes_region()
+*******************************************************************************/
+short int copy_atlas_nes_region(atlas_region* region)
+{
+  unsigned char*  row;
+
+  int   saved_source;
+  int   saved_size;
+
+  int   m;
+  int   n;
+
+  int   index;
+  int   bytes_per_pixel;
+
+  saved_source = G_source;
+  saved_size = G_palette_size;
+
+  G_source = region->source;
+
+  if (generate_palette())
+  {
+    clear_palette();
+
+    G_source = saved_source;
+    G_palette_size = saved_size;
+
+    return 1;
+  }
+
+  bytes_per_pixel = get_palette_bytes_per_pixel();
+
+  /* copy rows (transparent colors are written as magenta) */
+  for (m = 0; m < region->height; m++)
+  {
+    row = &G_atlas_data[3 * ((region->y + m) * G_atlas_width + region->x)];
+
+    for (n = 0; n < region->width; n++)
+    {
+      index = m * G_palette_size + n;
+
+      if ((bytes_per_pixel == 4) && (G_palette_data[4 * index + 3] == 0))
+      {
+        row[3 * n + 0] = 255;
+        row[3 * n + 1] = 0;
+        row[3 * n + 2] = 255;
+      }
+      else
+      {
+        row[3 * n + 0] = G_palette_data[bytes_per_pixel * index + 0];
+        row[3 * n + 1] = G_palette_data[bytes_per_pixel * index + 1];
+        row[3 * n + 2] = G_palette_data[bytes_per_pixel * index + 2];
+      }
+    }
+  }
+
+  clear_palette();
+
+  G_source = saved_source;
+  G_palette_size = saved_size;
+
+  return 0;
+}
+
+/*******************************************************************************
+** atlas_task()
+*******************************************************************************/
+void atlas_task(int worker, long index, void* arg)
+{
+  atlas_region*   region;
+  palette_params  params;
+
+  int   table_length;
+
+  (void) worker;
+  (void) arg;
+
+  region = &G_atlas_regions[index];
+
+  /* the approx & ntsc nes regions are copied in beforehand */
+  if (!is_source_composite(region->source))
+    return;
+
+  if (set_palette_params_for_source(&params, region->source))
+  {
+    region->status = 1;
+    return;
+  }
+
+  if (get_source_voltage_tables(region->source,
+                                &params.luma_table, &params.saturation_table,
+                                &table_length))
+  {
+    region->status = 1;
+    return;
+  }
+
+  params.channel_order = PALETTE_CHANNEL_ORDER_RGB;
+  params.base_row = NULL;
+  params.row_stride = G_atlas_width;
+
+  if (derive_palette_params(&params))
+  {
+    region->status = 1;
+    return;
+  }
+
+  /* generate palette into its region */
+  region->status = generate_palette_composite_data(
+                    &params, &G_atlas_data[3 * (region->y * G_atlas_width + region->x)]);
+}
+
+/*******************************************************************************
+** generate_atlas()
+*******************************************************************************/
+short int generate_atlas(int num_threads)
+{
+  int       k;
+
+  short int status;
+
+  if (pack_atlas_regions())
+    return 1;
+
+  /* the unused area is black */
+  G_atlas_data = calloc(3 * G_atlas_width * G_atlas_height, sizeof(unsigned char));
+
+  if (G_atlas_data == NULL)
+    return 1;
+
+  /* the approx & ntsc nes generators use the global palette data */
+  for (k = 0; k < NUM_SOURCES; k++)
+  {
+    if (!is_source_composite(G_atlas_regions[k].source))
+      G_atlas_regions[k].status = copy_atlas_nes_region(&G_atlas_regions[k]);
+  }
+
+  free_palette_arena();
+
+  /* generate the composite regions across the worker threads */
+  run_pool_tasks(num_threads, NUM_SOURCES, atlas_task, NULL);
+
+  /* report failures */
+  status = 0;
+
+  for (k = 0; k < NUM_SOURCES; k++)
+  {
+    if (G_atlas_regions[k].status)
+    {
+      fprintf(stderr, "Error generating atlas region %s.\n",
+              get_source_name(G_atlas_regions[k].source));
+      status = 1;
+    }
+  }
+
+  return status;
+}
+
+/*******************************************************************************
+** write_atlas_tga()
+*******************************************************************************/
+short int write_atlas_tga(FILE* fp_out)
+{
+  if (G_atlas_data == NULL)
+    return 1;
+
+  return write_tga_image(fp_out, G_atlas_data, G_atlas_width, G_atlas_height, 3);
+}
+
+/*******************************************************************************
+** write_atlas_uv_file()
+*******************************************************************************/
+short int write_atlas_uv_file(FILE* fp_out)
+{
+  atlas_region* region;
+
+  int k;
+
+  if (fp_out == NULL)
+    return 1;
+
+  fprintf(fp_out, "name,x,y,width,height,u0,v0,u1,v1\n");
+
+  for (k = 0; k < NUM_SOURCES; k++)
+  {
+    region = &G_atlas_regions[k];
+
+    fprintf(fp_out, "%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f\n",
+            get_source_name(region->source),
+            region->x, region->y, region->width, region->height,
+            (double) region->x / G_atlas_width,
+            (double) region->y / G_atlas_height,
+            (double) (region->x + region->width) / G_atlas_width,
+            (double) (region->y + region->height) / G_atlas_height);
+  }
+
+  if (ferror(fp_out))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_atlas()
+*******************************************************************************/
+short int clear_atlas()
+{
+  if (G_atlas_data != NULL)
+  {
+    free(G_atlas_data);
+    G_atlas_data = NULL;
+  }
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+/*******************************************************************************
+** atlas.h (texture atlas of all sources)
+*******************************************************************************/
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stdio.h>
+
+#include "palette.h"
+
+/* largest atlas (in either direction) */
+#define ATLAS_MAX_SIZE 8192
+
+typedef struct atlas_region
+{
+  int   source;
+
+  int   x;
+  int   y;
+  int   width;
+  int   height;
+
+  short int status;
+} atlas_region;
+
+extern atlas_region G_atlas_regions[NUM_SOURCES];
+
+extern int  G_atlas_width;
+extern int  G_atlas_height;
+
+extern unsigned char* G_atlas_data;
+
+/* function declarations */
+short int pack_atlas_regions();
+short int generate_atlas(int num_threads);
+
+short int write_atlas_tga(FILE* fp_out);
+short int write_atlas_uv_file(FILE* fp_out);
+
+short int clear_atlas();
+
+#endif
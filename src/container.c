@@ -0,0 +1,815 @@
+/*******************************************************************************
+** container.c (ktx2 & dds texture containers)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "container.h"
+#include "linear.h"
+#include "packed.h"
+#include "palette.h"
+
+/* the containers hold the texture in a format that can be uploaded */
+/* as is (rows are tightly packed, with the top row first). the mip */
+/* levels are sampled directly from the full size texture (nearest) */
+/* so that each palette keeps its own rows: a palette is never mixed */
+/* with its neighbours, and its base (unlit) level is always kept.  */
+/* every level is converted one row at a time while it is written,  */
+/* so the file is written in a single pass with no seeking. the    */
+/* float formats are linear light, converted from the yiq values   */
+/* (see linear.c).                                                 */
+
+/* vulkan formats & khronos data format descriptor values */
+#define CONTAINER_VK_FORMAT_R4G4B4A4_UNORM_PACK16 2
+#define CONTAINER_VK_FORMAT_R5G6B5_UNORM_PACK16   4
+#define CONTAINER_VK_FORMAT_R5G5B5A1_UNORM_PACK16 6
+#define CONTAINER_VK_FORMAT_R8G8B8A8_UNORM        37
+#define CONTAINER_VK_FORMAT_B8G8R8A8_UNORM        44
+#define CONTAINER_VK_FORMAT_R16G16B16A16_SFLOAT   97
+#define CONTAINER_VK_FORMAT_R32G32B32A32_SFLOAT   109
+
+#define CONTAINER_DF_MODEL_RGBSDA     1
+#define CONTAINER_DF_PRIMARIES_BT709  1
+#define CONTAINER_DF_TRANSFER_LINEAR  1
+
+#define CONTAINER_DF_CHANNEL_R  0
+#define CONTAINER_DF_CHANNEL_G  1
+#define CONTAINER_DF_CHANNEL_B  2
+#define CONTAINER_DF_CHANNEL_A  15
+
+#define CONTAINER_DF_SAMPLE_SIGNED  0x40
+#define CONTAINER_DF_SAMPLE_FLOAT   0x80
+
+/* sample lower & upper for float channels (-1.0f & 1.0f) */
+#define CONTAINER_DF_FLOAT_LOWER  0xBF800000UL
+#define CONTAINER_DF_FLOAT_UPPER  0x3F800000UL
+
+/* dds header flags */
+#define CONTAINER_DDSD_CAPS         0x00000001
+#define CONTAINER_DDSD_HEIGHT       0x00000002
+#define CONTAINER_DDSD_WIDTH        0x00000004
+#define CONTAINER_DDSD_PITCH        0x00000008
+#define CONTAINER_DDSD_PIXELFORMAT  0x00001000
+#define CONTAINER_DDSD_MIPMAPCOUNT  0x00020000
+
+#define CONTAINER_DDPF_ALPHAPIXELS  0x00000001
+#define CONTAINER_DDPF_FOURCC       0x00000004
+#define CONTAINER_DDPF_RGB          0x00000040
+
+#define CONTAINER_DDSCAPS_COMPLEX   0x00000008
+#define CONTAINER_DDSCAPS_TEXTURE   0x00001000
+#define CONTAINER_DDSCAPS_MIPMAP    0x00400000
+
+/* d3d9 float formats (used as the fourcc) */
+#define CONTAINER_D3DFMT_A16B16G16R16F  113
+#define CONTAINER_D3DFMT_A32B32G32R32F  116
+
+int G_container_pixel_format;
+int G_container_mip_flag;
+
+unsigned char S_ktx2_identifier[12] =
+  { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+/*******************************************************************************
+** get_container_pixel_format()
+*******************************************************************************/
+int get_container_pixel_format(char* name)
+{
+  if (name == NULL)
+    return -1;
+
+  if (!strcmp("rgba8", name))
+    return CONTAINER_PIXEL_FORMAT_RGBA8;
+  else if (!strcmp("bgra8", name))
+    return CONTAINER_PIXEL_FORMAT_BGRA8;
+  else if (!strcmp("rgb565", name))
+    return CONTAINER_PIXEL_FORMAT_RGB565;
+  else if (!strcmp("rgba5551", name))
+    return CONTAINER_PIXEL_FORMAT_RGBA5551;
+  else if (!strcmp("rgba4444", name))
+    return CONTAINER_PIXEL_FORMAT_RGBA4444;
+  else if (!strcmp("rgba16f", name))
+    return CONTAINER_PIXEL_FORMAT_RGBA16F;
+  else if (!strcmp("rgba32f", name))
+    return CONTAINER_PIXEL_FORMAT_RGBA32F;
+  else
+    return -1;
+}
+
+/*******************************************************************************
+** get_container_packed_format()
+*******************************************************************************/
+int get_container_packed_format()
+{
+  if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGB565)
+    return PACKED_FORMAT_RGB565;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA5551)
+    return PACKED_FORMAT_RGBA5551;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA4444)
+    return PACKED_FORMAT_RGBA4444;
+  else
+    return -1;
+}
+
+/*******************************************************************************
+** get_container_linear_format()
+*******************************************************************************/
+int get_container_linear_format()
+{
+  if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA16F)
+    return LINEAR_FORMAT_F16;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA32F)
+    return LINEAR_FORMAT_F32;
+  else
+    return -1;
+}
+
+/*******************************************************************************
+** get_container_bytes_per_pixel()
+*******************************************************************************/
+int get_container_bytes_per_pixel()
+{
+  if (get_container_packed_format() >= 0)
+    return 2;
+  else if (get_container_linear_format() == LINEAR_FORMAT_F16)
+    return 8;
+  else if (get_container_linear_format() == LINEAR_FORMAT_F32)
+    return 16;
+  else
+    return 4;
+}
+
+/*******************************************************************************
+** get_container_type_size()
+*******************************************************************************/
+int get_container_type_size()
+{
+  /* the size of the data type (for byte swapping) */
+  if (get_container_packed_format() >= 0)
+    return 2;
+  else if (get_container_linear_format() == LINEAR_FORMAT_F16)
+    return 2;
+  else if (get_container_linear_format() == LINEAR_FORMAT_F32)
+    return 4;
+  else
+    return 1;
+}
+
+/*******************************************************************************
+** get_container_num_levels()
+*******************************************************************************/
+int get_container_num_levels()
+{
+  int num_levels;
+  int size;
+
+  if (!G_container_mip_flag)
+    return 1;
+
+  num_levels = 1;
+
+  for (size = G_palette_size; size > 1; size >>= 1)
+    num_levels += 1;
+
+  return num_levels;
+}
+
+/*******************************************************************************
+** get_container_level_size()
+*******************************************************************************/
+int get_container_level_size(int level)
+{
+  int size;
+
+  size = G_palette_size >> level;
+
+  if (size < 1)
+    size = 1;
+
+  return size;
+}
+
+/*******************************************************************************
+** get_container_level_bytes()
+*******************************************************************************/
+long get_container_level_bytes(int level)
+{
+  long size;
+
+  size = get_container_level_size(level);
+
+  return size * size * get_container_bytes_per_pixel();
+}
+
+/*******************************************************************************
+** get_container_source_row()
+*******************************************************************************/
+int get_container_source_row(int height, int y)
+{
+  int num_bands;
+  int levels_per_band;
+  int base_level;
+
+  int band;
+  int first_row;
+  int num_rows;
+  int half_rows;
+
+  int j;
+  int level;
+
+  if (height >= G_palette_size)
+    return y;
+
+  num_bands = get_palette_num_bands();
+  levels_per_band = G_palette_size / num_bands;
+  base_level = levels_per_band / 2;
+
+  /* find the palette this row belongs to (when there are */
+  /* fewer rows than palettes, some palettes are skipped) */
+  band = (y * num_bands) / height;
+
+  first_row = (band * height + num_bands - 1) / num_bands;
+  num_rows = ((band + 1) * height + num_bands - 1) / num_bands - first_row;
+  half_rows = num_rows / 2;
+
+  /* spread the rows out evenly around the base level */
+  j = y - first_row;
+
+  if (j < half_rows)
+    level = base_level - ((half_rows - j) * levels_per_band) / num_rows;
+  else
+    level = base_level + ((j - half_rows) * levels_per_band) / num_rows;
+
+  if (level < 0)
+    level = 0;
+  else if (level >= levels_per_band)
+    level = levels_per_band - 1;
+
+  return band * levels_per_band + level;
+}
+
+/*******************************************************************************
+** rotate_container_alpha()
+*******************************************************************************/
+short int rotate_container_alpha(unsigned char* buffer, int num_pixels)
+{
+  unsigned int  value;
+  int           x;
+
+  /* move the alpha bit (or nibble) from the bottom to the top, */
+  /* for the a1r5g5b5 & a4r4g4b4 layouts of the dds files       */
+  for (x = 0; x < num_pixels; x++)
+  {
+    value = buffer[2 * x + 0] | (buffer[2 * x + 1] << 8);
+
+    if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA5551)
+      value = (value >> 1) | ((value & 0x01) << 15);
+    else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA4444)
+      value = (value >> 4) | ((value & 0x0F) << 12);
+
+    buffer[2 * x + 0] = value & 0xFF;
+    buffer[2 * x + 1] = (value >> 8) & 0xFF;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_container_row()
+*******************************************************************************/
+short int convert_container_row(unsigned char* buffer, unsigned char* rgba,
+                                int level, int y, int alpha_first)
+{
+  int   size;
+  int   source_row;
+  int   source_bytes_per_pixel;
+
+  unsigned char*  source;
+
+  int   x;
+  int   swap;
+
+  size = get_container_level_size(level);
+  source_row = get_container_source_row(size, y);
+  source_bytes_per_pixel = get_palette_bytes_per_pixel();
+
+  /* the float formats are converted from the linear palette */
+  if (get_container_linear_format() >= 0)
+    return convert_linear_row(buffer, (float*) rgba, source_row, size, get_container_linear_format());
+
+  source = &G_palette_data[(long) source_bytes_per_pixel * source_row * G_palette_size];
+
+  /* gather the nearest pixels (the full size level is copied as is) */
+  if (size == G_palette_size)
+    expand_packed_source_row(rgba, source, size);
+  else
+  {
+    for (x = 0; x < size; x++)
+      expand_packed_source_row(&rgba[4 * x], &source[(long) source_bytes_per_pixel * (((long) x * G_palette_size) / size)], 1);
+  }
+
+  /* convert to the output format */
+  if (get_container_packed_format() >= 0)
+  {
+    if (pack_pixels(buffer, rgba, size, get_container_packed_format()))
+      return 1;
+
+    if (alpha_first)
+      rotate_container_alpha(buffer, size);
+
+    return 0;
+  }
+
+  memcpy(buffer, rgba, 4 * size);
+
+  if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_BGRA8)
+  {
+    for (x = 0; x < size; x++)
+    {
+      swap = buffer[4 * x + 0];
+      buffer[4 * x + 0] = buffer[4 * x + 2];
+      buffer[4 * x + 2] = swap;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_container_level()
+*******************************************************************************/
+short int write_container_level(FILE* fp_out, unsigned char* buffer, int level, int alpha_first)
+{
+  int size;
+  int y;
+
+  size = get_container_level_size(level);
+
+  /* the rgba row is stored after the output row */
+  for (y = 0; y < size; y++)
+  {
+    if (convert_container_row(buffer, &buffer[CONTAINER_MAX_BYTES_PER_PIXEL * G_palette_size], level, y, alpha_first))
+      return 1;
+
+    if (fwrite(buffer, get_container_bytes_per_pixel(), size, fp_out) < (size_t) size)
+      return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_container_u16()
+*******************************************************************************/
+short int set_container_u16(unsigned char* data, unsigned long value)
+{
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_container_u32()
+*******************************************************************************/
+short int set_container_u32(unsigned char* data, unsigned long value)
+{
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = (value >> 16) & 0xFF;
+  data[3] = (value >> 24) & 0xFF;
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_container_u64()
+*******************************************************************************/
+short int set_container_u64(unsigned char* data, unsigned long value)
+{
+  /* the files are far smaller than 4 gb, so the upper half is 0 */
+  set_container_u32(&data[0], value);
+  set_container_u32(&data[4], 0);
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_ktx2_sample()
+*******************************************************************************/
+short int set_ktx2_sample(unsigned char* sample, int channel,
+                          int bit_offset, int bit_length)
+{
+  set_container_u16(&sample[0], bit_offset);
+  sample[2] = bit_length - 1;
+  sample[3] = channel;
+
+  /* sample position */
+  sample[4] = 0;
+  sample[5] = 0;
+  sample[6] = 0;
+  sample[7] = 0;
+
+  /* sample lower & upper (unsigned normalized) */
+  set_container_u32(&sample[8], 0);
+  set_container_u32(&sample[12], (1UL << bit_length) - 1);
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_ktx2_float_sample()
+*******************************************************************************/
+short int set_ktx2_float_sample(unsigned char* sample, int channel,
+                                int bit_offset, int bit_length)
+{
+  set_ktx2_sample(sample, channel, bit_offset, bit_length);
+
+  sample[3] = channel | CONTAINER_DF_SAMPLE_SIGNED | CONTAINER_DF_SAMPLE_FLOAT;
+
+  set_container_u32(&sample[8], CONTAINER_DF_FLOAT_LOWER);
+  set_container_u32(&sample[12], CONTAINER_DF_FLOAT_UPPER);
+
+  return 0;
+}
+
+/*******************************************************************************
+** fill_ktx2_dfd()
+*******************************************************************************/
+int fill_ktx2_dfd(unsigned char* dfd)
+{
+  int num_samples;
+  int size;
+
+  if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGB565)
+    num_samples = 3;
+  else
+    num_samples = 4;
+
+  size = 4 + 24 + 16 * num_samples;
+
+  memset(dfd, 0, size);
+
+  /* total size, then the basic descriptor block header */
+  set_container_u32(&dfd[0], size);
+  set_container_u32(&dfd[4], 0);
+  set_container_u16(&dfd[8], 2);
+  set_container_u16(&dfd[10], 24 + 16 * num_samples);
+
+  dfd[12] = CONTAINER_DF_MODEL_RGBSDA;
+  dfd[13] = CONTAINER_DF_PRIMARIES_BT709;
+  dfd[14] = CONTAINER_DF_TRANSFER_LINEAR;
+  dfd[15] = 0;
+
+  /* texel block dimensions are all 1 (stored as 0) */
+  /* bytes per plane (only plane 0 is used)         */
+  dfd[20] = get_container_bytes_per_pixel();
+
+  /* samples, in order of bit offset */
+  if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGB565)
+  {
+    set_ktx2_sample(&dfd[28 + 0],  CONTAINER_DF_CHANNEL_B, 0, 5);
+    set_ktx2_sample(&dfd[28 + 16], CONTAINER_DF_CHANNEL_G, 5, 6);
+    set_ktx2_sample(&dfd[28 + 32], CONTAINER_DF_CHANNEL_R, 11, 5);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA5551)
+  {
+    set_ktx2_sample(&dfd[28 + 0],  CONTAINER_DF_CHANNEL_A, 0, 1);
+    set_ktx2_sample(&dfd[28 + 16], CONTAINER_DF_CHANNEL_B, 1, 5);
+    set_ktx2_sample(&dfd[28 + 32], CONTAINER_DF_CHANNEL_G, 6, 5);
+    set_ktx2_sample(&dfd[28 + 48], CONTAINER_DF_CHANNEL_R, 11, 5);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA4444)
+  {
+    set_ktx2_sample(&dfd[28 + 0],  CONTAINER_DF_CHANNEL_A, 0, 4);
+    set_ktx2_sample(&dfd[28 + 16], CONTAINER_DF_CHANNEL_B, 4, 4);
+    set_ktx2_sample(&dfd[28 + 32], CONTAINER_DF_CHANNEL_G, 8, 4);
+    set_ktx2_sample(&dfd[28 + 48], CONTAINER_DF_CHANNEL_R, 12, 4);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA16F)
+  {
+    set_ktx2_float_sample(&dfd[28 + 0],  CONTAINER_DF_CHANNEL_R, 0, 16);
+    set_ktx2_float_sample(&dfd[28 + 16], CONTAINER_DF_CHANNEL_G, 16, 16);
+    set_ktx2_float_sample(&dfd[28 + 32], CONTAINER_DF_CHANNEL_B, 32, 16);
+    set_ktx2_float_sample(&dfd[28 + 48], CONTAINER_DF_CHANNEL_A, 48, 16);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA32F)
+  {
+    set_ktx2_float_sample(&dfd[28 + 0],  CONTAINER_DF_CHANNEL_R, 0, 32);
+    set_ktx2_float_sample(&dfd[28 + 16], CONTAINER_DF_CHANNEL_G, 32, 32);
+    set_ktx2_float_sample(&dfd[28 + 32], CONTAINER_DF_CHANNEL_B, 64, 32);
+    set_ktx2_float_sample(&dfd[28 + 48], CONTAINER_DF_CHANNEL_A, 96, 32);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_BGRA8)
+  {
+    set_ktx2_sample(&dfd[28 + 0],  CONTAINER_DF_CHANNEL_B, 0, 8);
+    set_ktx2_sample(&dfd[28 + 16], CONTAINER_DF_CHANNEL_G, 8, 8);
+    set_ktx2_sample(&dfd[28 + 32], CONTAINER_DF_CHANNEL_R, 16, 8);
+    set_ktx2_sample(&dfd[28 + 48], CONTAINER_DF_CHANNEL_A, 24, 8);
+  }
+  else
+  {
+    set_ktx2_sample(&dfd[28 + 0],  CONTAINER_DF_CHANNEL_R, 0, 8);
+    set_ktx2_sample(&dfd[28 + 16], CONTAINER_DF_CHANNEL_G, 8, 8);
+    set_ktx2_sample(&dfd[28 + 32], CONTAINER_DF_CHANNEL_B, 16, 8);
+    set_ktx2_sample(&dfd[28 + 48], CONTAINER_DF_CHANNEL_A, 24, 8);
+  }
+
+  return size;
+}
+
+/*******************************************************************************
+** add_ktx2_key_value()
+*******************************************************************************/
+int add_ktx2_key_value(unsigned char* kvd, char* key, char* value)
+{
+  int length;
+  int size;
+
+  /* the key & value are both null terminated, and */
+  /* each entry is padded to a multiple of 4 bytes */
+  length = strlen(key) + 1 + strlen(value) + 1;
+  size = (4 + length + 3) & ~3;
+
+  memset(kvd, 0, size);
+
+  set_container_u32(&kvd[0], length);
+  strcpy((char*) &kvd[4], key);
+  strcpy((char*) &kvd[4 + strlen(key) + 1], value);
+
+  return size;
+}
+
+/*******************************************************************************
+** write_ktx2_file()
+*******************************************************************************/
+short int write_ktx2_file(FILE* fp_out)
+{
+  unsigned char header[ CONTAINER_KTX2_HEADER_SIZE +
+                        CONTAINER_KTX2_LEVEL_INDEX_SIZE * CONTAINER_MAX_LEVELS +
+                        CONTAINER_KTX2_MAX_DFD_SIZE +
+                        CONTAINER_KTX2_MAX_KVD_SIZE];
+
+  unsigned char   padding[CONTAINER_MAX_BYTES_PER_PIXEL];
+  unsigned char*  buffer;
+
+  int   vk_format;
+  int   num_levels;
+  int   alignment;
+
+  long  dfd_offset;
+  long  dfd_length;
+  long  kvd_offset;
+  long  kvd_length;
+
+  long  offsets[CONTAINER_MAX_LEVELS];
+  long  offset;
+  long  header_length;
+
+  int   level;
+
+  if ((fp_out == NULL) || (G_palette_data == NULL))
+    return 1;
+
+  if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGB565)
+    vk_format = CONTAINER_VK_FORMAT_R5G6B5_UNORM_PACK16;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA5551)
+    vk_format = CONTAINER_VK_FORMAT_R5G5B5A1_UNORM_PACK16;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA4444)
+    vk_format = CONTAINER_VK_FORMAT_R4G4B4A4_UNORM_PACK16;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA16F)
+    vk_format = CONTAINER_VK_FORMAT_R16G16B16A16_SFLOAT;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA32F)
+    vk_format = CONTAINER_VK_FORMAT_R32G32B32A32_SFLOAT;
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_BGRA8)
+    vk_format = CONTAINER_VK_FORMAT_B8G8R8A8_UNORM;
+  else
+    vk_format = CONTAINER_VK_FORMAT_R8G8B8A8_UNORM;
+
+  num_levels = get_container_num_levels();
+
+  memset(header, 0, sizeof(header));
+  memset(padding, 0, sizeof(padding));
+
+  /* data format descriptor & key / value data (after the level index) */
+  dfd_offset = CONTAINER_KTX2_HEADER_SIZE + CONTAINER_KTX2_LEVEL_INDEX_SIZE * num_levels;
+  dfd_length = fill_ktx2_dfd(&header[dfd_offset]);
+
+  kvd_offset = dfd_offset + dfd_length;
+  kvd_length = add_ktx2_key_value(&header[kvd_offset], "KTXorientation", "rd");
+  kvd_length += add_ktx2_key_value(&header[kvd_offset + kvd_length], "KTXwriter", "texture");
+
+  header_length = kvd_offset + kvd_length;
+
+  /* the levels are stored from smallest to largest, and each one  */
+  /* starts on a multiple of lcm(texel size, 4) bytes (the texel   */
+  /* sizes are powers of 2, so this is the larger of the two)      */
+  alignment = get_container_bytes_per_pixel();
+
+  if (alignment < 4)
+    alignment = 4;
+
+  offset = header_length;
+
+  for (level = num_levels - 1; level >= 0; level--)
+  {
+    offset = (offset + alignment - 1) & ~((long) alignment - 1);
+    offsets[level] = offset;
+    offset += get_container_level_bytes(level);
+  }
+
+  /* identifier & header */
+  memcpy(&header[0], S_ktx2_identifier, 12);
+
+  set_container_u32(&header[12], vk_format);
+  set_container_u32(&header[16], get_container_type_size());
+  set_container_u32(&header[20], G_palette_size);
+  set_container_u32(&header[24], G_palette_size);
+  set_container_u32(&header[28], 0);
+  set_container_u32(&header[32], 0);
+  set_container_u32(&header[36], 1);
+  set_container_u32(&header[40], num_levels);
+  set_container_u32(&header[44], 0);
+
+  /* index */
+  set_container_u32(&header[48], dfd_offset);
+  set_container_u32(&header[52], dfd_length);
+  set_container_u32(&header[56], kvd_offset);
+  set_container_u32(&header[60], kvd_length);
+  set_container_u64(&header[64], 0);
+  set_container_u64(&header[72], 0);
+
+  /* level index (largest level first) */
+  for (level = 0; level < num_levels; level++)
+  {
+    set_container_u64(&header[80 + 24 * level + 0], offsets[level]);
+    set_container_u64(&header[80 + 24 * level + 8], get_container_level_bytes(level));
+    set_container_u64(&header[80 + 24 * level + 16], get_container_level_bytes(level));
+  }
+
+  if (fwrite(header, 1, header_length, fp_out) < (size_t) header_length)
+    return 1;
+
+  /* write levels */
+  buffer = malloc(sizeof(unsigned char) * 2 * CONTAINER_MAX_BYTES_PER_PIXEL * G_palette_size);
+
+  if (buffer == NULL)
+    return 1;
+
+  offset = header_length;
+
+  for (level = num_levels - 1; level >= 0; level--)
+  {
+    if ((offsets[level] > offset) &&
+        (fwrite(padding, 1, offsets[level] - offset, fp_out) < (size_t) (offsets[level] - offset)))
+    {
+      free(buffer);
+      return 1;
+    }
+
+    if (write_container_level(fp_out, buffer, level, 0))
+    {
+      free(buffer);
+      return 1;
+    }
+
+    offset = offsets[level] + get_container_level_bytes(level);
+  }
+
+  free(buffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_dds_file()
+*******************************************************************************/
+short int write_dds_file(FILE* fp_out)
+{
+  unsigned char   header[CONTAINER_DDS_HEADER_SIZE];
+  unsigned char*  buffer;
+
+  unsigned long   flags;
+  unsigned long   caps;
+
+  int   num_levels;
+  int   level;
+
+  if ((fp_out == NULL) || (G_palette_data == NULL))
+    return 1;
+
+  num_levels = get_container_num_levels();
+
+  memset(header, 0, sizeof(header));
+
+  flags = CONTAINER_DDSD_CAPS | CONTAINER_DDSD_HEIGHT | CONTAINER_DDSD_WIDTH |
+          CONTAINER_DDSD_PITCH | CONTAINER_DDSD_PIXELFORMAT;
+  caps = CONTAINER_DDSCAPS_TEXTURE;
+
+  if (num_levels > 1)
+  {
+    flags |= CONTAINER_DDSD_MIPMAPCOUNT;
+    caps |= CONTAINER_DDSCAPS_COMPLEX | CONTAINER_DDSCAPS_MIPMAP;
+  }
+
+  /* magic, then the header (size, flags, height, width, pitch, depth, mip count) */
+  memcpy(&header[0], "DDS ", 4);
+
+  set_container_u32(&header[4], 124);
+  set_container_u32(&header[8], flags);
+  set_container_u32(&header[12], G_palette_size);
+  set_container_u32(&header[16], G_palette_size);
+  set_container_u32(&header[20], G_palette_size * get_container_bytes_per_pixel());
+  set_container_u32(&header[24], 0);
+  set_container_u32(&header[28], num_levels);
+
+  /* pixel format (size, flags, fourcc, bit count, channel masks). */
+  /* the 16 bit formats with alpha are stored as a1r5g5b5 & a4r4g4b4 */
+  /* (dxgi b5g5r5a1 & b4g4r4a4), as no loader reads the alpha bits   */
+  /* at the bottom                                                   */
+  set_container_u32(&header[76], 32);
+
+  if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGB565)
+  {
+    set_container_u32(&header[80], CONTAINER_DDPF_RGB);
+    set_container_u32(&header[88], 16);
+    set_container_u32(&header[92], 0xF800);
+    set_container_u32(&header[96], 0x07E0);
+    set_container_u32(&header[100], 0x001F);
+    set_container_u32(&header[104], 0);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA5551)
+  {
+    set_container_u32(&header[80], CONTAINER_DDPF_RGB | CONTAINER_DDPF_ALPHAPIXELS);
+    set_container_u32(&header[88], 16);
+    set_container_u32(&header[92], 0x7C00);
+    set_container_u32(&header[96], 0x03E0);
+    set_container_u32(&header[100], 0x001F);
+    set_container_u32(&header[104], 0x8000);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA4444)
+  {
+    set_container_u32(&header[80], CONTAINER_DDPF_RGB | CONTAINER_DDPF_ALPHAPIXELS);
+    set_container_u32(&header[88], 16);
+    set_container_u32(&header[92], 0x0F00);
+    set_container_u32(&header[96], 0x00F0);
+    set_container_u32(&header[100], 0x000F);
+    set_container_u32(&header[104], 0xF000);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA16F)
+  {
+    set_container_u32(&header[80], CONTAINER_DDPF_FOURCC);
+    set_container_u32(&header[84], CONTAINER_D3DFMT_A16B16G16R16F);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_RGBA32F)
+  {
+    set_container_u32(&header[80], CONTAINER_DDPF_FOURCC);
+    set_container_u32(&header[84], CONTAINER_D3DFMT_A32B32G32R32F);
+  }
+  else if (G_container_pixel_format == CONTAINER_PIXEL_FORMAT_BGRA8)
+  {
+    set_container_u32(&header[80], CONTAINER_DDPF_RGB | CONTAINER_DDPF_ALPHAPIXELS);
+    set_container_u32(&header[88], 32);
+    set_container_u32(&header[92], 0x00FF0000);
+    set_container_u32(&header[96], 0x0000FF00);
+    set_container_u32(&header[100], 0x000000FF);
+    set_container_u32(&header[104], 0xFF000000);
+  }
+  else
+  {
+    set_container_u32(&header[80], CONTAINER_DDPF_RGB | CONTAINER_DDPF_ALPHAPIXELS);
+    set_container_u32(&header[88], 32);
+    set_container_u32(&header[92], 0x000000FF);
+    set_container_u32(&header[96], 0x0000FF00);
+    set_container_u32(&header[100], 0x00FF0000);
+    set_container_u32(&header[104], 0xFF000000);
+  }
+
+  /* caps */
+  set_container_u32(&header[108], caps);
+
+  if (fwrite(header, 1, CONTAINER_DDS_HEADER_SIZE, fp_out) < CONTAINER_DDS_HEADER_SIZE)
+    return 1;
+
+  /* write levels (largest first) */
+  buffer = malloc(sizeof(unsigned char) * 2 * CONTAINER_MAX_BYTES_PER_PIXEL * G_palette_size);
+
+  if (buffer == NULL)
+    return 1;
+
+  for (level = 0; level < num_levels; level++)
+  {
+    if (write_container_level(fp_out, buffer, level, 1))
+    {
+      free(buffer);
+      return 1;
+    }
+  }
+
+  free(buffer);
+
+  return 0;
+}
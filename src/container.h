@@ -0,0 +1,47 @@
+/*******************************************************************************
+** container.h (ktx2 & dds texture containers)
+*******************************************************************************/
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <stdio.h>
+
+enum
+{
+  CONTAINER_PIXEL_FORMAT_RGBA8 = 0,
+  CONTAINER_PIXEL_FORMAT_BGRA8,
+  CONTAINER_PIXEL_FORMAT_RGB565,
+  CONTAINER_PIXEL_FORMAT_RGBA5551,
+  CONTAINER_PIXEL_FORMAT_RGBA4444,
+  CONTAINER_PIXEL_FORMAT_RGBA16F,
+  CONTAINER_PIXEL_FORMAT_RGBA32F,
+  CONTAINER_NUM_PIXEL_FORMATS
+};
+
+/* the rgba32f pixels are the largest */
+#define CONTAINER_MAX_BYTES_PER_PIXEL 16
+
+/* enough mip levels for the largest texture (8192 down to 1) */
+#define CONTAINER_MAX_LEVELS  14
+
+#define CONTAINER_KTX2_HEADER_SIZE      80
+#define CONTAINER_KTX2_LEVEL_INDEX_SIZE 24
+#define CONTAINER_KTX2_MAX_DFD_SIZE     92
+#define CONTAINER_KTX2_MAX_KVD_SIZE     64
+
+#define CONTAINER_DDS_HEADER_SIZE 128
+
+extern int  G_container_pixel_format;
+extern int  G_container_mip_flag;
+
+/* function declarations */
+int       get_container_pixel_format(char* name);
+int       get_container_packed_format();
+int       get_container_linear_format();
+int       get_container_num_levels();
+
+short int write_ktx2_file(FILE* fp_out);
+short int write_dds_file(FILE* fp_out);
+
+#endif
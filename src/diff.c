@@ -0,0 +1,381 @@
+/*******************************************************************************
+** diff.c (region-level texture diff)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "diff.h"
+#include "ntsc.h"
+#include "palette.h"
+#include "reader.h"
+
+/* two textures are compared one row at a time. most rows are equal,  */
+/* so each row is first checked with a vectorized compare that stops  */
+/* at the first difference. only a differing row is split into its    */
+/* gradients, which are compared the same way, and each differing     */
+/* gradient is scanned to find its range of shades.                   */
+/*                                                                    */
+/* each region is reported as one line:                               */
+/*                                                                    */
+/*   palette,level,gradient,first_shade,last_shade,texels,max_delta   */
+/*                                                                    */
+/* where max_delta is the largest difference in any channel.          */
+
+/* the approx nes rows start with transparent, black, 4 greys & white */
+#define DIFF_APPROX_NES_NUM_GREYS 7
+#define DIFF_APPROX_NES_NUM_HUES  12
+
+/*******************************************************************************
+** find_diff_offset()
+*******************************************************************************/
+long find_diff_offset(unsigned char* a, unsigned char* b, long num_bytes)
+{
+  long  k;
+
+#ifdef __SSE2__
+  __m128i eq;
+  int     mask;
+
+  k = 0;
+
+  /* 64 bytes at a time (one mask test per block) */
+  for (; k + 64 <= num_bytes; k += 64)
+  {
+    eq = _mm_and_si128(
+          _mm_and_si128(
+            _mm_cmpeq_epi8( _mm_loadu_si128((__m128i*) &a[k + 0]),
+                            _mm_loadu_si128((__m128i*) &b[k + 0])),
+            _mm_cmpeq_epi8( _mm_loadu_si128((__m128i*) &a[k + 16]),
+                            _mm_loadu_si128((__m128i*) &b[k + 16]))),
+          _mm_and_si128(
+            _mm_cmpeq_epi8( _mm_loadu_si128((__m128i*) &a[k + 32]),
+                            _mm_loadu_si128((__m128i*) &b[k + 32])),
+            _mm_cmpeq_epi8( _mm_loadu_si128((__m128i*) &a[k + 48]),
+                            _mm_loadu_si128((__m128i*) &b[k + 48]))));
+
+    if (_mm_movemask_epi8(eq) != 0xFFFF)
+      break;
+  }
+
+  /* 16 bytes at a time (this also finds the difference in a block) */
+  for (; k + 16 <= num_bytes; k += 16)
+  {
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*) &a[k]),
+                                            _mm_loadu_si128((__m128i*) &b[k])));
+
+    if (mask != 0xFFFF)
+    {
+      mask = ~mask;
+
+      while (!(mask & 1))
+      {
+        mask >>= 1;
+        k += 1;
+      }
+
+      return k;
+    }
+  }
+#else
+  k = 0;
+#endif
+
+  for (; k < num_bytes; k++)
+  {
+    if (a[k] != b[k])
+      return k;
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+** setup_diff_layout()
+*******************************************************************************/
+short int setup_diff_layout(diff_layout* dl, int source, int width, int height)
+{
+  palette_params  params;
+
+  int   num_shades;
+  int   n;
+
+  if (dl == NULL)
+    return 1;
+
+  dl->gradient_starts = NULL;
+  dl->grey_flag = 1;
+
+  /* approx nes: 8 palettes, each row has the greys and 12 hues of 4 */
+  if ((source == SOURCE_APPROX_NES) || (source == SOURCE_APPROX_NES_ROTATED))
+  {
+    dl->num_palettes = PALETTE_APPROX_NES_NUM_BANDS;
+    dl->num_gradients = 1 + DIFF_APPROX_NES_NUM_HUES;
+
+    if (width < PALETTE_APPROX_NES_NUM_COLORS)
+      return 1;
+  }
+  /* ntsc nes: 8 emphasis palettes, each row has 4 lumas of 16 hues */
+  else if (source == SOURCE_NTSC_NES)
+  {
+    dl->num_palettes = NTSC_NUM_EMPHASIS;
+    dl->num_gradients = NTSC_NUM_LUMAS;
+    dl->grey_flag = 0;
+
+    if (width < NTSC_NUM_COLORS)
+      return 1;
+  }
+  /* composite: 16 palettes, each row has the grey & hue gradients */
+  else if (!set_palette_params_for_source(&params, source))
+  {
+    dl->num_palettes = PALETTE_NUM_INDICES;
+    dl->num_gradients = params.num_hues + 1;
+
+    if (dl->num_gradients * params.num_shades > width)
+      return 1;
+  }
+  else
+    return 1;
+
+  if (height % dl->num_palettes != 0)
+    return 1;
+
+  dl->levels_per_palette = height / dl->num_palettes;
+
+  /* the last entry is the padding (after the gradients) */
+  dl->gradient_starts = malloc(sizeof(int) * (dl->num_gradients + 2));
+
+  if (dl->gradient_starts == NULL)
+    return 1;
+
+  for (n = 0; n <= dl->num_gradients; n++)
+  {
+    if ((source == SOURCE_APPROX_NES) || (source == SOURCE_APPROX_NES_ROTATED))
+    {
+      num_shades = PALETTE_APPROX_NES_NUM_COLORS - DIFF_APPROX_NES_NUM_GREYS;
+      num_shades /= DIFF_APPROX_NES_NUM_HUES;
+
+      if (n == 0)
+        dl->gradient_starts[n] = 0;
+      else
+        dl->gradient_starts[n] = DIFF_APPROX_NES_NUM_GREYS + (n - 1) * num_shades;
+    }
+    else if (source == SOURCE_NTSC_NES)
+      dl->gradient_starts[n] = n * NTSC_NUM_HUES;
+    else
+      dl->gradient_starts[n] = n * params.num_shades;
+  }
+
+  dl->gradient_starts[dl->num_gradients + 1] = width;
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_diff_layout()
+*******************************************************************************/
+short int clear_diff_layout(diff_layout* dl)
+{
+  if (dl == NULL)
+    return 1;
+
+  if (dl->gradient_starts != NULL)
+  {
+    free(dl->gradient_starts);
+    dl->gradient_starts = NULL;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_diff_regions()
+*******************************************************************************/
+short int write_diff_regions( FILE* fp_out, diff_layout* dl,
+                              tga_image* a, tga_image* b, diff_totals* dt)
+{
+  unsigned char*  row_a;
+  unsigned char*  row_b;
+
+  long  offset;
+  long  gradient_offset;
+
+  int   start;
+  int   end;
+  int   first;
+  int   last;
+
+  int   count;
+  int   delta;
+  int   max_delta;
+
+  int   m;
+  int   n;
+  int   g;
+  int   k;
+
+  if ((fp_out == NULL) || (dl == NULL) || (a == NULL) || (b == NULL) || (dt == NULL))
+    return 1;
+
+  dt->num_texels = 0;
+  dt->num_regions = 0;
+  dt->num_rows = 0;
+
+  fprintf(fp_out, "palette,level,gradient,first_shade,last_shade,texels,max_delta\n");
+
+  for (m = 0; m < a->height; m++)
+  {
+    row_a = get_tga_image_row(a, m);
+    row_b = get_tga_image_row(b, m);
+
+    offset = find_diff_offset(row_a, row_b, 3 * (long) a->width);
+
+    if (offset < 0)
+      continue;
+
+    dt->num_rows += 1;
+
+    /* find the gradient with the first difference */
+    g = 0;
+
+    while (dl->gradient_starts[g + 1] <= offset / 3)
+      g++;
+
+    /* compare the remaining gradients (and the padding) */
+    for (; g <= dl->num_gradients; g++)
+    {
+      start = dl->gradient_starts[g];
+      end = dl->gradient_starts[g + 1];
+
+      if (start < offset / 3)
+        start = offset / 3;
+
+      if (start >= end)
+        continue;
+
+      gradient_offset = find_diff_offset( &row_a[3 * start], &row_b[3 * start],
+                                          3 * (long) (end - start));
+
+      if (gradient_offset < 0)
+        continue;
+
+      /* scan the rest of the gradient */
+      first = start + gradient_offset / 3;
+      last = first;
+      count = 0;
+      max_delta = 0;
+
+      for (n = first; n < end; n++)
+      {
+        delta = 0;
+
+        for (k = 0; k < 3; k++)
+        {
+          if (abs(row_a[3 * n + k] - row_b[3 * n + k]) > delta)
+            delta = abs(row_a[3 * n + k] - row_b[3 * n + k]);
+        }
+
+        if (delta > 0)
+        {
+          last = n;
+          count += 1;
+
+          if (delta > max_delta)
+            max_delta = delta;
+        }
+      }
+
+      fprintf(fp_out, "%d,%d,", m / dl->levels_per_palette, m % dl->levels_per_palette);
+
+      if ((g == 0) && (dl->grey_flag))
+        fprintf(fp_out, "grey");
+      else if (g == dl->num_gradients)
+        fprintf(fp_out, "padding");
+      else
+        fprintf(fp_out, "%d", g);
+
+      fprintf(fp_out, ",%d,%d,%d,%d\n",
+              first - dl->gradient_starts[g], last - dl->gradient_starts[g],
+              count, max_delta);
+
+      dt->num_texels += count;
+      dt->num_regions += 1;
+    }
+  }
+
+  if (ferror(fp_out))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** diff_tga_files()
+*******************************************************************************/
+short int diff_tga_files(FILE* fp_out, int source, char* filename_a, char* filename_b)
+{
+  tga_image   a;
+  tga_image   b;
+
+  diff_layout dl;
+  diff_totals dt;
+
+  short int   status;
+
+  if (fp_out == NULL)
+    return 1;
+
+  if (read_tga_image(filename_a, &a))
+    return 1;
+
+  if (read_tga_image(filename_b, &b))
+  {
+    clear_tga_image(&a);
+    return 1;
+  }
+
+  if ((a.width != b.width) || (a.height != b.height))
+  {
+    fprintf(stderr, "Texture diff failed: The sizes differ (%dx%d and %dx%d).\n",
+            a.width, a.height, b.width, b.height);
+    clear_tga_image(&a);
+    clear_tga_image(&b);
+    return 1;
+  }
+
+  if (setup_diff_layout(&dl, source, a.width, a.height))
+  {
+    fprintf(stderr, "Texture diff failed: The textures do not match the %s layout.\n",
+            get_source_name(source));
+    clear_diff_layout(&dl);
+    clear_tga_image(&a);
+    clear_tga_image(&b);
+    return 1;
+  }
+
+  fprintf(fp_out, "diff %s %s: %dx%d, %s layout (%d palettes of %d levels)\n\n",
+          filename_a, filename_b, a.width, a.height, get_source_name(source),
+          dl.num_palettes, dl.levels_per_palette);
+
+  status = write_diff_regions(fp_out, &dl, &a, &b, &dt);
+
+  if (!status)
+  {
+    fprintf(fp_out, "\ndiffering texels: %ld (%ld regions in %ld rows)\n",
+            dt.num_texels, dt.num_regions, dt.num_rows);
+  }
+
+  clear_diff_layout(&dl);
+  clear_tga_image(&a);
+  clear_tga_image(&b);
+
+  if (ferror(fp_out))
+    return 1;
+
+  return status;
+}
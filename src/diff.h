@@ -0,0 +1,45 @@
+/*******************************************************************************
+** diff.h (region-level texture diff)
+*******************************************************************************/
+
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdio.h>
+
+#include "reader.h"
+
+/* the texture layout, used to name the differing regions. each row */
+/* is one lighting level of a palette, and is split into gradients  */
+/* of shades (the rest of the row is padding). the first gradient   */
+/* is grey, except for the ntsc nes source, where each palette is   */
+/* an emphasis setting and each gradient is a luma of 16 hues.      */
+typedef struct diff_layout
+{
+  int   num_palettes;
+  int   levels_per_palette;
+
+  int   num_gradients;
+  int*  gradient_starts;
+
+  int   grey_flag;
+} diff_layout;
+
+typedef struct diff_totals
+{
+  long  num_texels;
+  long  num_regions;
+  long  num_rows;
+} diff_totals;
+
+/* function declarations */
+long      find_diff_offset(unsigned char* a, unsigned char* b, long num_bytes);
+
+short int setup_diff_layout(diff_layout* dl, int source, int width, int height);
+short int clear_diff_layout(diff_layout* dl);
+
+short int write_diff_regions( FILE* fp_out, diff_layout* dl,
+                              tga_image* a, tga_image* b, diff_totals* dt);
+short int diff_tga_files(FILE* fp_out, int source, char* filename_a, char* filename_b);
+
+#endif
@@ -0,0 +1,677 @@
+/*******************************************************************************
+** encode.c (per-tile palette assignment)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "encode.h"
+#include "palette.h"
+#include "pool.h"
+#include "query.h"
+#include "reader.h"
+#include "tga.h"
+
+/* an rgb image is encoded as color indices, plus one texture row     */
+/* (palette & lighting level) per tile. every row of every used       */
+/* palette is tried for each tile, and the one with the lowest error  */
+/* is kept (the first one, in palette & level order, if there is a    */
+/* tie). each texel gets the index of the nearest color in its row.   */
+/*                                                                    */
+/* the rows are generated once with the row queries, and stored as    */
+/* separate red, green & blue float arrays (so that 4 colors can be   */
+/* compared at a time), along with the bounding box of their gradient */
+/* colors (the black past the gradients is a separate candidate, so   */
+/* that it does not stretch every box down to black). the search      */
+/* starts from the worker's previous row, a row is skipped if the     */
+/* distance from the tile's colors to its box (or to black) already   */
+/* exceeds the best error so far, and the error sum stops as soon as  */
+/* it does.                                                           */
+/* ties are broken by the row, so the result does not depend on the   */
+/* order of the tiles. the distances are exact in floating point, so  */
+/* the sse2 & scalar searches pick the same colors.                   */
+
+palette_params  S_encode_params;
+
+int     S_encode_num_rows;
+int     S_encode_row_length;
+
+float*  S_encode_row_colors;
+float*  S_encode_row_bounds;
+int     S_encode_black_flag;
+
+unsigned char*  S_encode_color_map;
+
+tga_image       S_encode_image;
+int             S_encode_image_flag;
+
+int   S_encode_tile_size;
+int   S_encode_tiles_across;
+int   S_encode_tiles_down;
+
+encode_tile*    S_encode_tiles;
+unsigned short* S_encode_indices;
+
+/* the row chosen for the last tile, and the */
+/* rows searched & skipped (per worker)       */
+int   S_encode_last_rows[POOL_MAX_THREADS];
+long  S_encode_num_searched[POOL_MAX_THREADS];
+long  S_encode_num_pruned[POOL_MAX_THREADS];
+
+/*******************************************************************************
+** setup_encode_rows()
+*******************************************************************************/
+short int setup_encode_rows(int source, int num_levels)
+{
+  unsigned char*  row;
+  float*          colors;
+  float*          bounds;
+
+  int   table_length;
+  int   num_gradient_colors;
+
+  int   n;
+  int   m;
+  int   k;
+
+  clear_encode();
+
+  /* the same parameters as the row queries */
+  if (set_palette_params_for_source(&S_encode_params, source))
+  {
+    fprintf(stderr, "Tile encoding is only available for the composite sources.\n");
+    return 1;
+  }
+
+  if (get_source_voltage_tables(source, &S_encode_params.luma_table,
+                                &S_encode_params.saturation_table, &table_length))
+  {
+    return 1;
+  }
+
+  S_encode_params.channel_order = PALETTE_CHANNEL_ORDER_RGB;
+  S_encode_params.base_row = NULL;
+  S_encode_params.num_levels = num_levels;
+
+  if (derive_palette_params(&S_encode_params))
+    return 1;
+
+  if (setup_palette_query(&S_encode_params))
+    return 1;
+
+  /* every row is black past its gradients (if they do not fill it) */
+  num_gradient_colors = (S_encode_params.num_hues + 1) * S_encode_params.num_shades;
+  S_encode_black_flag = (num_gradient_colors < S_encode_params.palette_size);
+
+  /* allocate the row tables (padded to a multiple of the lanes) */
+  S_encode_num_rows = PALETTE_NUM_INDICES * S_encode_params.levels_per_palette;
+  S_encode_row_length = (S_encode_params.palette_size + ENCODE_NUM_LANES - 1) &
+                        ~(ENCODE_NUM_LANES - 1);
+
+  S_encode_row_colors = (float*) allocate_aligned_buffer(
+                          sizeof(float) * 3 * (long) S_encode_num_rows * S_encode_row_length);
+  S_encode_row_bounds = malloc(sizeof(float) * 6 * S_encode_num_rows);
+  S_encode_color_map = malloc(sizeof(unsigned char) * 3 * S_encode_params.palette_size);
+
+  if ((S_encode_row_colors == NULL) || (S_encode_row_bounds == NULL) ||
+      (S_encode_color_map == NULL))
+  {
+    fprintf(stderr, "Unable to allocate encoder rows.\n");
+    clear_palette_query();
+    clear_encode();
+    return 1;
+  }
+
+  for (n = 0; n < S_encode_num_rows; n++)
+  {
+    row = get_palette_query_row(n / S_encode_params.levels_per_palette,
+                                n % S_encode_params.levels_per_palette);
+
+    if (row == NULL)
+    {
+      clear_palette_query();
+      clear_encode();
+      return 1;
+    }
+
+    colors = &S_encode_row_colors[3 * (long) n * S_encode_row_length];
+    bounds = &S_encode_row_bounds[6 * n];
+
+    for (k = 0; k < 3; k++)
+    {
+      bounds[k] = 255.0f;
+      bounds[3 + k] = 0.0f;
+    }
+
+    for (m = 0; m < S_encode_params.palette_size; m++)
+    {
+      for (k = 0; k < 3; k++)
+        colors[k * S_encode_row_length + m] = row[3 * m + k];
+    }
+
+    for (m = 0; m < num_gradient_colors; m++)
+    {
+      for (k = 0; k < 3; k++)
+      {
+        if (row[3 * m + k] < bounds[k])
+          bounds[k] = row[3 * m + k];
+        if (row[3 * m + k] > bounds[3 + k])
+          bounds[3 + k] = row[3 * m + k];
+      }
+    }
+
+    /* the padding is far away from every color */
+    for (m = S_encode_params.palette_size; m < S_encode_row_length; m++)
+    {
+      for (k = 0; k < 3; k++)
+        colors[k * S_encode_row_length + m] = ENCODE_PADDING_VALUE;
+    }
+  }
+
+  /* the index image's color map is palette 0 at the base level (bgr) */
+  row = get_palette_query_row(PALETTE_INDEX_STANDARD, S_encode_params.base_level);
+
+  for (m = 0; m < S_encode_params.palette_size; m++)
+  {
+    S_encode_color_map[3 * m + 0] = row[3 * m + 2];
+    S_encode_color_map[3 * m + 1] = row[3 * m + 1];
+    S_encode_color_map[3 * m + 2] = row[3 * m + 0];
+  }
+
+  clear_palette_query();
+
+  return 0;
+}
+
+/*******************************************************************************
+** find_encode_nearest_color()
+*******************************************************************************/
+long find_encode_nearest_color(float* colors, int row_length, float* rgb, int* index)
+{
+  float*  reds;
+  float*  greens;
+  float*  blues;
+
+  float best;
+  int   best_index;
+
+  int   k;
+
+#ifdef __SSE2__
+  __m128  red;
+  __m128  green;
+  __m128  blue;
+
+  __m128  d;
+  __m128  dr;
+  __m128  dg;
+  __m128  db;
+  __m128  mask;
+
+  __m128  lane_best;
+  __m128  lane_index;
+  __m128  lane_best_index;
+  __m128  step;
+
+  float   lane_values[ENCODE_NUM_LANES];
+  float   lane_indices[ENCODE_NUM_LANES];
+#else
+  float   dr;
+  float   dg;
+  float   db;
+  float   d;
+#endif
+
+  /* the red, green & blue planes are each row_length long */
+  reds = colors;
+  greens = &colors[row_length];
+  blues = &colors[2 * row_length];
+
+#ifdef __SSE2__
+  red = _mm_set1_ps(rgb[0]);
+  green = _mm_set1_ps(rgb[1]);
+  blue = _mm_set1_ps(rgb[2]);
+
+  lane_best = _mm_set1_ps(1.0e9f);
+  lane_best_index = _mm_setzero_ps();
+  lane_index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  step = _mm_set1_ps((float) ENCODE_NUM_LANES);
+
+  /* each lane keeps its first nearest color */
+  for (k = 0; k < row_length; k += ENCODE_NUM_LANES)
+  {
+    dr = _mm_sub_ps(_mm_load_ps(&reds[k]), red);
+    dg = _mm_sub_ps(_mm_load_ps(&greens[k]), green);
+    db = _mm_sub_ps(_mm_load_ps(&blues[k]), blue);
+
+    d = _mm_add_ps( _mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                    _mm_mul_ps(db, db));
+
+    mask = _mm_cmplt_ps(d, lane_best);
+
+    lane_best = _mm_min_ps(d, lane_best);
+    lane_best_index = _mm_or_ps(_mm_and_ps(mask, lane_index),
+                                _mm_andnot_ps(mask, lane_best_index));
+
+    lane_index = _mm_add_ps(lane_index, step);
+  }
+
+  _mm_storeu_ps(lane_values, lane_best);
+  _mm_storeu_ps(lane_indices, lane_best_index);
+
+  best = lane_values[0];
+  best_index = (int) lane_indices[0];
+
+  for (k = 1; k < ENCODE_NUM_LANES; k++)
+  {
+    if ((lane_values[k] < best) ||
+        ((lane_values[k] == best) && ((int) lane_indices[k] < best_index)))
+    {
+      best = lane_values[k];
+      best_index = (int) lane_indices[k];
+    }
+  }
+#else
+  best = 1.0e9f;
+  best_index = 0;
+
+  for (k = 0; k < row_length; k++)
+  {
+    dr = reds[k] - rgb[0];
+    dg = greens[k] - rgb[1];
+    db = blues[k] - rgb[2];
+
+    d = (dr * dr) + (dg * dg) + (db * db);
+
+    if (d < best)
+    {
+      best = d;
+      best_index = k;
+    }
+  }
+#endif
+
+  if (index != NULL)
+    *index = best_index;
+
+  return (long) best;
+}
+
+/*******************************************************************************
+** get_encode_row_bound()
+*******************************************************************************/
+long get_encode_row_bound(float* bounds, float* tile_colors, int* counts, int num_colors)
+{
+  long  bound;
+  float d;
+  float d_black;
+  float gap;
+
+  int   n;
+  int   k;
+
+  /* each color is at least as far from its nearest row color */
+  /* as it is from the row's bounding box, or from black       */
+  bound = 0;
+
+  for (n = 0; n < num_colors; n++)
+  {
+    d = 0.0f;
+    d_black = 0.0f;
+
+    for (k = 0; k < 3; k++)
+    {
+      if (tile_colors[3 * n + k] < bounds[k])
+        gap = bounds[k] - tile_colors[3 * n + k];
+      else if (tile_colors[3 * n + k] > bounds[3 + k])
+        gap = tile_colors[3 * n + k] - bounds[3 + k];
+      else
+        gap = 0.0f;
+
+      d += gap * gap;
+      d_black += tile_colors[3 * n + k] * tile_colors[3 * n + k];
+    }
+
+    if (S_encode_black_flag && (d_black < d))
+      d = d_black;
+
+    bound += counts[n] * (long) d;
+  }
+
+  return bound;
+}
+
+/*******************************************************************************
+** get_encode_row_error()
+*******************************************************************************/
+long get_encode_row_error(int row, float* tile_colors, int* counts, int num_colors,
+                          long limit)
+{
+  long  error;
+
+  int   k;
+
+  /* the sum stops once it is over the limit */
+  error = 0;
+
+  for (k = 0; (k < num_colors) && (error <= limit); k++)
+  {
+    error += counts[k] * find_encode_nearest_color(
+                          &S_encode_row_colors[3 * (long) row * S_encode_row_length],
+                          S_encode_row_length, &tile_colors[3 * k], NULL);
+  }
+
+  return error;
+}
+
+/*******************************************************************************
+** encode_tile_task()
+*******************************************************************************/
+void encode_tile_task(int worker, long index, void* arg)
+{
+  encode_tile*  tile;
+
+  unsigned char*  src;
+
+  float tile_colors[3 * ENCODE_MAX_TILE_TEXELS];
+  int   counts[ENCODE_MAX_TILE_TEXELS];
+  int   color_indices[ENCODE_MAX_TILE_TEXELS];
+  int   texel_colors[ENCODE_MAX_TILE_TEXELS];
+  int   num_colors;
+
+  int   x;
+  int   y;
+  int   width;
+  int   height;
+
+  int   n;
+  int   m;
+  int   k;
+
+  int   row;
+  int   best_row;
+  long  best_error;
+  long  error;
+  long  bound;
+
+  (void) arg;
+
+  tile = &S_encode_tiles[index];
+
+  x = (int) (index % S_encode_tiles_across) * S_encode_tile_size;
+  y = (int) (index / S_encode_tiles_across) * S_encode_tile_size;
+
+  width = S_encode_image.width - x;
+  height = S_encode_image.height - y;
+
+  if (width > S_encode_tile_size)
+    width = S_encode_tile_size;
+  if (height > S_encode_tile_size)
+    height = S_encode_tile_size;
+
+  /* find the distinct colors of the tile (the image is bgr) */
+  num_colors = 0;
+
+  for (n = 0; n < height; n++)
+  {
+    src = get_tga_image_row(&S_encode_image, y + n) + 3 * x;
+
+    for (m = 0; m < width; m++)
+    {
+      for (k = 0; k < num_colors; k++)
+      {
+        if ((tile_colors[3 * k + 0] == src[3 * m + 2]) &&
+            (tile_colors[3 * k + 1] == src[3 * m + 1]) &&
+            (tile_colors[3 * k + 2] == src[3 * m + 0]))
+        {
+          break;
+        }
+      }
+
+      if (k == num_colors)
+      {
+        tile_colors[3 * k + 0] = src[3 * m + 2];
+        tile_colors[3 * k + 1] = src[3 * m + 1];
+        tile_colors[3 * k + 2] = src[3 * m + 0];
+        counts[k] = 0;
+        num_colors += 1;
+      }
+
+      counts[k] += 1;
+      texel_colors[n * width + m] = k;
+    }
+  }
+
+  /* start with the row of this worker's previous tile (neighbouring */
+  /* tiles tend to match), and then try each row of each used palette */
+  best_row = S_encode_last_rows[worker];
+  best_error = get_encode_row_error(best_row, tile_colors, counts, num_colors, LONG_MAX);
+
+  S_encode_num_searched[worker] += 1;
+
+  for (row = 0; row < S_encode_num_rows; row++)
+  {
+    if ((row == S_encode_last_rows[worker]) ||
+        (!is_palette_used(&S_encode_params, row / S_encode_params.levels_per_palette)))
+    {
+      continue;
+    }
+
+    bound = get_encode_row_bound(&S_encode_row_bounds[6 * row], tile_colors, counts, num_colors);
+
+    if ((bound > best_error) || ((bound == best_error) && (row > best_row)))
+    {
+      S_encode_num_pruned[worker] += 1;
+      continue;
+    }
+
+    S_encode_num_searched[worker] += 1;
+
+    error = get_encode_row_error(row, tile_colors, counts, num_colors, best_error);
+
+    if ((error < best_error) || ((error == best_error) && (row < best_row)))
+    {
+      best_row = row;
+      best_error = error;
+    }
+  }
+
+  S_encode_last_rows[worker] = best_row;
+
+  tile->palette = best_row / S_encode_params.levels_per_palette;
+  tile->level = best_row % S_encode_params.levels_per_palette;
+  tile->error = best_error;
+
+  /* write the indices of the chosen row's colors */
+  for (k = 0; k < num_colors; k++)
+  {
+    find_encode_nearest_color(&S_encode_row_colors[3 * (long) best_row * S_encode_row_length],
+                              S_encode_row_length, &tile_colors[3 * k], &color_indices[k]);
+  }
+
+  for (n = 0; n < height; n++)
+  {
+    for (m = 0; m < width; m++)
+    {
+      S_encode_indices[(long) (y + n) * S_encode_image.width + x + m] =
+        (unsigned short) color_indices[texel_colors[n * width + m]];
+    }
+  }
+}
+
+/*******************************************************************************
+** encode_tga_file()
+*******************************************************************************/
+short int encode_tga_file(char* filename, int tile_size, int num_threads)
+{
+  struct timespec start;
+  struct timespec end;
+
+  long  num_tiles;
+  long  num_searched;
+  long  num_pruned;
+  long  total_error;
+
+  long  n;
+
+  if (S_encode_row_colors == NULL)
+    return 1;
+
+  if ((tile_size != ENCODE_MIN_TILE_SIZE) && (tile_size != ENCODE_MAX_TILE_SIZE))
+    return 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (read_tga_image(filename, &S_encode_image))
+    return 1;
+
+  S_encode_image_flag = 1;
+
+  S_encode_tile_size = tile_size;
+  S_encode_tiles_across = (S_encode_image.width + tile_size - 1) / tile_size;
+  S_encode_tiles_down = (S_encode_image.height + tile_size - 1) / tile_size;
+
+  num_tiles = (long) S_encode_tiles_across * S_encode_tiles_down;
+
+  S_encode_tiles = malloc(sizeof(encode_tile) * num_tiles);
+  S_encode_indices = malloc(sizeof(unsigned short) *
+                            (long) S_encode_image.width * S_encode_image.height);
+
+  if ((S_encode_tiles == NULL) || (S_encode_indices == NULL))
+  {
+    fprintf(stderr, "Unable to allocate encoder tiles.\n");
+    return 1;
+  }
+
+  for (n = 0; n < POOL_MAX_THREADS; n++)
+  {
+    S_encode_last_rows[n] = S_encode_params.base_level;
+    S_encode_num_searched[n] = 0;
+    S_encode_num_pruned[n] = 0;
+  }
+
+  if (run_pool_tasks(num_threads, num_tiles, encode_tile_task, NULL))
+    return 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  /* summary */
+  num_searched = 0;
+  num_pruned = 0;
+
+  for (n = 0; n < POOL_MAX_THREADS; n++)
+  {
+    num_searched += S_encode_num_searched[n];
+    num_pruned += S_encode_num_pruned[n];
+  }
+
+  total_error = 0;
+
+  for (n = 0; n < num_tiles; n++)
+    total_error += S_encode_tiles[n].error;
+
+  printf("encoded %ld tiles of %dx%d in %.2f ms (%ld rows searched, %ld pruned), error %ld\n",
+         num_tiles, tile_size, tile_size,
+         (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0,
+         num_searched, num_pruned, total_error);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_encode_indices()
+*******************************************************************************/
+short int write_encode_indices(FILE* fp_out)
+{
+  if (S_encode_indices == NULL)
+    return 1;
+
+  return write_tga_image_indexed( fp_out, S_encode_indices,
+                                  S_encode_image.width, S_encode_image.height,
+                                  S_encode_color_map, S_encode_params.palette_size);
+}
+
+/*******************************************************************************
+** write_encode_tile_map()
+*******************************************************************************/
+short int write_encode_tile_map(FILE* fp_out)
+{
+  encode_tile*  tile;
+
+  int   n;
+  int   m;
+
+  if ((fp_out == NULL) || (S_encode_tiles == NULL))
+    return 1;
+
+  /* one line per tile, the row is the texture v coordinate */
+  fprintf(fp_out, "tile_x,tile_y,palette,level,row,error\n");
+
+  for (n = 0; n < S_encode_tiles_down; n++)
+  {
+    for (m = 0; m < S_encode_tiles_across; m++)
+    {
+      tile = &S_encode_tiles[(long) n * S_encode_tiles_across + m];
+
+      fprintf(fp_out, "%d,%d,%d,%d,%d,%ld\n", m, n, tile->palette, tile->level,
+              tile->palette * S_encode_params.levels_per_palette + tile->level,
+              tile->error);
+    }
+  }
+
+  if (ferror(fp_out))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_encode()
+*******************************************************************************/
+short int clear_encode()
+{
+  if (S_encode_row_colors != NULL)
+  {
+    free(S_encode_row_colors);
+    S_encode_row_colors = NULL;
+  }
+
+  if (S_encode_row_bounds != NULL)
+  {
+    free(S_encode_row_bounds);
+    S_encode_row_bounds = NULL;
+  }
+
+  if (S_encode_color_map != NULL)
+  {
+    free(S_encode_color_map);
+    S_encode_color_map = NULL;
+  }
+
+  if (S_encode_tiles != NULL)
+  {
+    free(S_encode_tiles);
+    S_encode_tiles = NULL;
+  }
+
+  if (S_encode_indices != NULL)
+  {
+    free(S_encode_indices);
+    S_encode_indices = NULL;
+  }
+
+  if (S_encode_image_flag)
+  {
+    clear_tga_image(&S_encode_image);
+    S_encode_image_flag = 0;
+  }
+
+  return 0;
+}
@@ -0,0 +1,42 @@
+/*******************************************************************************
+** encode.h (per-tile palette assignment)
+*******************************************************************************/
+
+#ifndef ENCODE_H
+#define ENCODE_H
+
+#include <stdio.h>
+
+/* tiles are 8x8 or 16x16 (the tiles on the right & bottom */
+/* edges are cut off if the image size is not a multiple)  */
+#define ENCODE_MIN_TILE_SIZE  8
+#define ENCODE_MAX_TILE_SIZE  16
+#define ENCODE_MAX_TILE_TEXELS  (ENCODE_MAX_TILE_SIZE * ENCODE_MAX_TILE_SIZE)
+
+/* the row colors are compared 4 at a time (the rows are stored as */
+/* red, green & blue planes, padded with colors far from any other) */
+#define ENCODE_NUM_LANES  4
+#define ENCODE_PADDING_VALUE  4096.0f
+
+/* the chosen row of each tile, and its error (the sum of the */
+/* squared rgb distances of the texels to their colors)       */
+typedef struct encode_tile
+{
+  int   palette;
+  int   level;
+
+  long  error;
+} encode_tile;
+
+/* function declarations */
+long      find_encode_nearest_color(float* colors, int row_length, float* rgb, int* index);
+
+short int setup_encode_rows(int source, int num_levels);
+short int encode_tga_file(char* filename, int tile_size, int num_threads);
+
+short int write_encode_indices(FILE* fp_out);
+short int write_encode_tile_map(FILE* fp_out);
+
+short int clear_encode();
+
+#endif
@@ -0,0 +1,426 @@
+/*******************************************************************************
+** linear.c (linear light floating point outputs)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "linear.h"
+#include "palette.h"
+
+/* every color in a composite texture is a copy of one of the base   */
+/* row colors (or black / white), so the texture is generated once   */
+/* more from a base row of color indices (24 bit, plus 1 so that 0   */
+/* stays black and 0xFFFFFF white). each texel is then looked up in   */
+/* a table of the base row colors, computed in float directly from   */
+/* the yiq values (clipped to 0-1, then converted from srgb to       */
+/* linear light). the approx nes sources have no such base row, so   */
+/* their 8 bit values are converted (transparent texels get alpha 0). */
+/*                                                                   */
+/* the float to half conversion rounds to nearest even, and handles  */
+/* subnormals, infinity and nan. the sse2 kernel converts 8 values   */
+/* at a time, with the same results as the scalar version.           */
+
+/* half conversion constants (as float bit patterns) */
+#define LINEAR_HALF_MAX           ((127 + 16) << 23)
+#define LINEAR_HALF_MIN_NORMAL    ((127 - 14) << 23)
+#define LINEAR_HALF_SUBNORM_MAGIC (((127 - 15) + (23 - 10) + 1) << 23)
+#define LINEAR_HALF_NORMAL_BIAS   (0xFFF - ((127 - 15) << 23))
+#define LINEAR_FLOAT_INFINITY     (255 << 23)
+
+float*          S_linear_table;
+int             S_linear_num_colors;
+
+unsigned char*  S_linear_indices;
+
+float           S_linear_srgb_table[256];
+
+/*******************************************************************************
+** convert_srgb_to_linear()
+*******************************************************************************/
+float convert_srgb_to_linear(float value)
+{
+  /* hard clipping, as in the 8 bit output */
+  if (value <= 0.0f)
+    return 0.0f;
+  else if (value >= 1.0f)
+    return 1.0f;
+  else if (value <= 0.04045f)
+    return value / 12.92f;
+  else
+    return (float) pow((value + 0.055) / 1.055, 2.4);
+}
+
+/*******************************************************************************
+** setup_linear_palette()
+*******************************************************************************/
+short int setup_linear_palette()
+{
+  palette_params  params;
+  unsigned char*  encoded_row;
+
+  float rgb[3];
+
+  int   num_gradients;
+  int   num_shades;
+
+  int   n;
+  int   k;
+
+  int   index;
+  long  value;
+
+  clear_linear_palette();
+
+  if (G_palette_data == NULL)
+    return 1;
+
+  /* approx & ntsc nes: converted from the 8 bit values */
+  if (!is_source_composite(G_source))
+  {
+    for (k = 0; k < 256; k++)
+      S_linear_srgb_table[k] = convert_srgb_to_linear(k / 255.0f);
+
+    return 0;
+  }
+
+  params = G_palette_params;
+
+  num_gradients = params.num_hues + 1;
+  num_shades = params.num_shades;
+
+  S_linear_num_colors = num_gradients * num_shades;
+
+  /* black, the base row colors, then white */
+  S_linear_table = malloc(sizeof(float) * 4 * (S_linear_num_colors + 2));
+  S_linear_indices = malloc(sizeof(unsigned char) * 3 * G_palette_size * get_palette_height(&params));
+  encoded_row = malloc(sizeof(unsigned char) * 3 * S_linear_num_colors);
+
+  if ((S_linear_table == NULL) || (S_linear_indices == NULL) || (encoded_row == NULL))
+  {
+    if (encoded_row != NULL)
+      free(encoded_row);
+
+    clear_linear_palette();
+    return 1;
+  }
+
+  for (k = 0; k < 4; k++)
+  {
+    S_linear_table[k] = (k == 3) ? 1.0f : 0.0f;
+    S_linear_table[4 * (S_linear_num_colors + 1) + k] = 1.0f;
+  }
+
+  for (n = 0; n < num_gradients; n++)
+  {
+    for (k = 0; k < num_shades; k++)
+    {
+      index = n * num_shades + k;
+
+      compute_palette_base_color(&params, n, k, rgb);
+
+      S_linear_table[4 * (index + 1) + 0] = convert_srgb_to_linear(rgb[0]);
+      S_linear_table[4 * (index + 1) + 1] = convert_srgb_to_linear(rgb[1]);
+      S_linear_table[4 * (index + 1) + 2] = convert_srgb_to_linear(rgb[2]);
+      S_linear_table[4 * (index + 1) + 3] = 1.0f;
+
+      value = index + 1;
+
+      encoded_row[3 * index + 0] = value & 0xFF;
+      encoded_row[3 * index + 1] = (value >> 8) & 0xFF;
+      encoded_row[3 * index + 2] = (value >> 16) & 0xFF;
+    }
+  }
+
+  /* generate the index texture */
+  params.base_row = encoded_row;
+  params.row_stride = 0;
+
+  if (generate_palette_composite_data(&params, S_linear_indices))
+  {
+    free(encoded_row);
+    clear_linear_palette();
+    return 1;
+  }
+
+  free(encoded_row);
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_half_float()
+*******************************************************************************/
+unsigned int convert_half_float(float value)
+{
+  unsigned int  bits;
+  unsigned int  sign;
+  unsigned int  half;
+
+  float magic;
+
+  memcpy(&bits, &value, 4);
+
+  sign = bits & 0x80000000U;
+  bits ^= sign;
+
+  /* infinity or nan */
+  if (bits >= LINEAR_HALF_MAX)
+    half = (bits > LINEAR_FLOAT_INFINITY) ? 0x7E00 : 0x7C00;
+  /* subnormal or zero (the addition does the rounding) */
+  else if (bits < LINEAR_HALF_MIN_NORMAL)
+  {
+    memcpy(&value, &bits, 4);
+
+    bits = LINEAR_HALF_SUBNORM_MAGIC;
+    memcpy(&magic, &bits, 4);
+
+    value += magic;
+
+    memcpy(&bits, &value, 4);
+    half = bits - LINEAR_HALF_SUBNORM_MAGIC;
+  }
+  /* normal (rebias the exponent, and round to nearest even) */
+  else
+  {
+    bits += LINEAR_HALF_NORMAL_BIAS + ((bits >> 13) & 1);
+    half = bits >> 13;
+  }
+
+  return half | (sign >> 16);
+}
+
+#ifdef __SSE2__
+/*******************************************************************************
+** convert_half_floats_4()
+*******************************************************************************/
+__m128i convert_half_floats_4(__m128 values)
+{
+  __m128  sign;
+  __m128  abs_values;
+  __m128i abs_bits;
+
+  __m128i is_regular;
+  __m128i is_subnormal;
+  __m128i special;
+
+  __m128i subnormal;
+  __m128i normal;
+  __m128i odd;
+
+  __m128i result;
+
+  sign = _mm_and_ps(values, _mm_castsi128_ps(_mm_set1_epi32((int) 0x80000000U)));
+  abs_values = _mm_xor_ps(values, sign);
+  abs_bits = _mm_castps_si128(abs_values);
+
+  /* infinity or nan */
+  is_regular = _mm_cmpgt_epi32(_mm_set1_epi32(LINEAR_HALF_MAX), abs_bits);
+  special = _mm_or_si128( _mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(abs_values, abs_values)),
+                                        _mm_set1_epi32(0x200)),
+                          _mm_set1_epi32(0x7C00));
+
+  /* subnormal or zero */
+  is_subnormal = _mm_cmpgt_epi32(_mm_set1_epi32(LINEAR_HALF_MIN_NORMAL), abs_bits);
+  subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(abs_values,
+                                                        _mm_castsi128_ps(_mm_set1_epi32(LINEAR_HALF_SUBNORM_MAGIC)))),
+                            _mm_set1_epi32(LINEAR_HALF_SUBNORM_MAGIC));
+
+  /* normal (odd is -1 when the half mantissa is odd) */
+  odd = _mm_srai_epi32(_mm_slli_epi32(abs_bits, 31 - 13), 31);
+  normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs_bits, _mm_set1_epi32(LINEAR_HALF_NORMAL_BIAS)), odd), 13);
+
+  /* combine */
+  result = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+  result = _mm_or_si128(_mm_and_si128(is_regular, result), _mm_andnot_si128(is_regular, special));
+
+  /* the sign is shifted arithmetically, so the packing keeps the bits */
+  return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+#endif
+
+/*******************************************************************************
+** convert_half_floats()
+*******************************************************************************/
+short int convert_half_floats(unsigned char* half, float* values, int num_values)
+{
+  int k;
+
+  unsigned int  value;
+
+  if ((half == NULL) || (values == NULL))
+    return 1;
+
+  k = 0;
+
+#ifdef __SSE2__
+  for (; k + 8 <= num_values; k += 8)
+  {
+    _mm_storeu_si128( (__m128i*) &half[2 * k],
+                      _mm_packs_epi32(convert_half_floats_4(_mm_loadu_ps(&values[k])),
+                                      convert_half_floats_4(_mm_loadu_ps(&values[k + 4]))));
+  }
+#endif
+
+  for (; k < num_values; k++)
+  {
+    value = convert_half_float(values[k]);
+
+    half[2 * k + 0] = value & 0xFF;
+    half[2 * k + 1] = (value >> 8) & 0xFF;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_linear_row()
+*******************************************************************************/
+short int convert_linear_row( unsigned char* buffer, float* rgba,
+                              int source_row, int size, int format)
+{
+  unsigned char*  texel;
+
+  unsigned int    bits;
+
+  long  source_index;
+  long  value;
+
+  int   bytes_per_pixel;
+
+  int   x;
+  int   k;
+
+  if ((buffer == NULL) || (rgba == NULL) || (G_palette_data == NULL))
+    return 1;
+
+  if ((format < 0) || (format >= LINEAR_NUM_FORMATS))
+    return 1;
+
+  /* the composite sources need the index texture */
+  if ((S_linear_indices == NULL) && (is_source_composite(G_source)))
+    return 1;
+
+  bytes_per_pixel = get_palette_bytes_per_pixel();
+
+  /* gather the nearest texels */
+  for (x = 0; x < size; x++)
+  {
+    source_index = (long) source_row * G_palette_size + ((long) x * G_palette_size) / size;
+
+    if (S_linear_indices != NULL)
+    {
+      texel = &S_linear_indices[3 * source_index];
+      value = texel[0] | (texel[1] << 8) | ((long) texel[2] << 16);
+
+      if (value > S_linear_num_colors)
+        value = S_linear_num_colors + 1;
+
+      memcpy(&rgba[4 * x], &S_linear_table[4 * value], 4 * sizeof(float));
+    }
+    else
+    {
+      texel = &G_palette_data[bytes_per_pixel * source_index];
+
+      rgba[4 * x + 0] = S_linear_srgb_table[texel[0]];
+      rgba[4 * x + 1] = S_linear_srgb_table[texel[1]];
+      rgba[4 * x + 2] = S_linear_srgb_table[texel[2]];
+
+      if (bytes_per_pixel == 4)
+        rgba[4 * x + 3] = texel[3] / 255.0f;
+      else
+        rgba[4 * x + 3] = 1.0f;
+    }
+  }
+
+  /* convert to the output format */
+  if (format == LINEAR_FORMAT_F16)
+    return convert_half_floats(buffer, rgba, 4 * size);
+
+  for (k = 0; k < 4 * size; k++)
+  {
+    memcpy(&bits, &rgba[k], 4);
+
+    buffer[4 * k + 0] = bits & 0xFF;
+    buffer[4 * k + 1] = (bits >> 8) & 0xFF;
+    buffer[4 * k + 2] = (bits >> 16) & 0xFF;
+    buffer[4 * k + 3] = (bits >> 24) & 0xFF;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_linear_file()
+*******************************************************************************/
+short int write_linear_file(FILE* fp_out, int format)
+{
+  unsigned char*  buffer;
+  float*          rgba;
+
+  int   bytes_per_pixel;
+  int   m;
+
+  if ((fp_out == NULL) || (G_palette_data == NULL))
+    return 1;
+
+  bytes_per_pixel = (format == LINEAR_FORMAT_F16) ? 8 : 16;
+
+  buffer = malloc(sizeof(unsigned char) * bytes_per_pixel * G_palette_size);
+  rgba = malloc(sizeof(float) * 4 * G_palette_size);
+
+  if ((buffer == NULL) || (rgba == NULL))
+  {
+    if (buffer != NULL)
+      free(buffer);
+    if (rgba != NULL)
+      free(rgba);
+
+    return 1;
+  }
+
+  /* rows are written top first */
+  for (m = 0; m < G_palette_size; m++)
+  {
+    if ((convert_linear_row(buffer, rgba, m, G_palette_size, format)) ||
+        (fwrite(buffer, bytes_per_pixel, G_palette_size, fp_out) < (size_t) G_palette_size))
+    {
+      free(buffer);
+      free(rgba);
+      return 1;
+    }
+  }
+
+  free(buffer);
+  free(rgba);
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_linear_palette()
+*******************************************************************************/
+short int clear_linear_palette()
+{
+  if (S_linear_table != NULL)
+  {
+    free(S_linear_table);
+    S_linear_table = NULL;
+  }
+
+  if (S_linear_indices != NULL)
+  {
+    free(S_linear_indices);
+    S_linear_indices = NULL;
+  }
+
+  S_linear_num_colors = 0;
+
+  return 0;
+}
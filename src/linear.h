@@ -0,0 +1,30 @@
+/*******************************************************************************
+** linear.h (linear light floating point outputs)
+*******************************************************************************/
+
+#ifndef LINEAR_H
+#define LINEAR_H
+
+#include <stdio.h>
+
+/* the pixels are rgba, with little endian 16 bit (half) */
+/* or 32 bit floats per channel, in linear light         */
+enum
+{
+  LINEAR_FORMAT_F16 = 0,
+  LINEAR_FORMAT_F32,
+  LINEAR_NUM_FORMATS
+};
+
+/* function declarations */
+short int setup_linear_palette();
+
+short int convert_half_floats(unsigned char* half, float* values, int num_values);
+short int convert_linear_row( unsigned char* buffer, float* rgba,
+                              int source_row, int size, int format);
+
+short int write_linear_file(FILE* fp_out, int format);
+
+short int clear_linear_palette();
+
+#endif
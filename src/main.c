@@ -9,1304 +9,1248 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 
-#define PI      3.14159265358979323846f
-#define TWO_PI  6.28318530717958647693f
-
-enum
-{
-  PALETTE_INDEX_STANDARD = 0, 
-  PALETTE_INDEX_ROTATE_60, 
-  PALETTE_INDEX_ROTATE_120, 
-  PALETTE_INDEX_ROTATE_180, 
-  PALETTE_INDEX_ROTATE_240, 
-  PALETTE_INDEX_ROTATE_300, 
-  PALETTE_INDEX_GREYSCALE, 
-  PALETTE_INDEX_ALTERNATE_ROTATE_60, 
-  PALETTE_INDEX_ALTERNATE_ROTATE_120, 
-  PALETTE_INDEX_ALTERNATE_ROTATE_180, 
-  PALETTE_INDEX_ALTERNATE_ROTATE_240, 
-  PALETTE_INDEX_ALTERNATE_ROTATE_300, 
-  PALETTE_INDEX_ALTERNATE_GREYSCALE, 
-  PALETTE_INDEX_TINT_RED, 
-  PALETTE_INDEX_TINT_BLUE, 
-  PALETTE_INDEX_TINT_GREEN, 
-  PALETTE_NUM_INDICES
-};
-
-enum
-{
-  PALETTE_MODE_STANDARD = 0, 
-  PALETTE_MODE_ROTATED, 
-  PALETTE_MODE_DOUBLED, 
-  PALETTE_NUM_MODES
-};
-
-enum
-{
-  /* 64 color palettes */
-  SOURCE_APPROX_NES = 0,
-  SOURCE_APPROX_NES_ROTATED,
-  /* 256 color palettes */
-  SOURCE_COMPOSITE_08,
-  SOURCE_COMPOSITE_16,
-  SOURCE_COMPOSITE_16_ROTATED,
-  /* 1024 color palettes */
-  SOURCE_COMPOSITE_32
-};
-
-#if 0
-/* the standard table step is 1 / (n + 2),  */
-/* where n is the number of colors per hue  */
-#define COMPOSITE_08_TABLE_STEP 0.1f                /* 1/10 */
-#define COMPOSITE_16_TABLE_STEP 0.055555555555556f  /* 1/18 */
-#define COMPOSITE_32_TABLE_STEP 0.029411764705882f  /* 1/34 */
-#endif
-
-/* the size of the table step is 1 / (n + 2), */
-/* where n is the number of colors per hue    */
-#define PALETTE_256_COLOR_TABLE_STEP  0.055555555555556f  /* 1/18 (n = 16) */
-#define PALETTE_1024_COLOR_TABLE_STEP 0.029411764705882f  /* 1/34 (n = 32) */
-
-/* the luma is the average of the low and high voltages */
-/* for the 1st half of each table, the low value is 0   */
-/* for the 2nd half of each table, the high value is 1  */
-/* the saturation is half of the peak-to-peak voltage   */
-
-/* for the nes tables, the numbers were obtained    */
-/* from information on the nesdev wiki              */
-/* (see the "NTSC video" and "PPU palettes" pages)  */
-float S_nes_p_p[4] = {0.399f,   0.684f, 0.692f, 0.285f};
-float S_nes_lum[4] = {0.1995f,  0.342f, 0.654f, 0.8575f};
-float S_nes_sat[4] = {0.1995f,  0.342f, 0.346f, 0.1425f};
-
-/* note that if we used the "composite 04" table, */
-/* with the table step being 1/(4+2) = 1/6, we    */
-/* would obtain an approximation of these values! */
-float S_approx_nes_p_p[4] = {0.4f, 0.7f,  0.7f,   0.3f};
-float S_approx_nes_lum[4] = {0.2f, 0.35f, 0.65f,  0.85f};
-float S_approx_nes_sat[4] = {0.2f, 0.35f, 0.35f,  0.15f};
-
-float S_composite_08_lum[8];
-float S_composite_08_sat[8];
-
-float S_composite_16_lum[16];
-float S_composite_16_sat[16];
-
-float S_composite_32_lum[32];
-float S_composite_32_sat[32];
-
-int   G_source;
-int   G_palette_size;
-
-unsigned char*  G_palette_data;
-
-float*  S_luma_table;
-float*  S_saturation_table;
-int     S_table_length;
+#include "analysis.h"
+#include "atlas.h"
+#include "container.h"
+#include "diff.h"
+#include "encode.h"
+#include "mapped.h"
+#include "ntsc.h"
+#include "output.h"
+#include "palette.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "publish.h"
+#include "query.h"
+#include "recipe.h"
+#include "remap.h"
+#include "spec.h"
+#include "sweep.h"
+#include "tga.h"
+#include "trim.h"
+#include "ubo.h"
+#include "watch.h"
 
 /*******************************************************************************
-** generate_voltage_tables()
+** main()
 *******************************************************************************/
-short int generate_voltage_tables()
+int main(int argc, char *argv[])
 {
-  int k;
-
-  /* composite 08 tables */
-  for (k = 0; k < 4; k++)
-  {
-    /* the table should include steps 1, 3, 6, and 8 */
-    if (k < 2)
-      S_composite_08_lum[k] = (2 * k + 1) * PALETTE_256_COLOR_TABLE_STEP;
-    else
-      S_composite_08_lum[k] = (2 * k + 2) * PALETTE_256_COLOR_TABLE_STEP;
-
-    S_composite_08_lum[7 - k] = 1.0f - S_composite_08_lum[k];
+  int   i;
 
-    S_composite_08_sat[k] = S_composite_08_lum[k];
-    S_composite_08_sat[7 - k] = S_composite_08_sat[k];
-  }
+  char  output_tga_filename[64];
 
-  /* composite 16 tables */
-  for (k = 0; k < 8; k++)
-  {
-    S_composite_16_lum[k] = (k + 1) * PALETTE_256_COLOR_TABLE_STEP;
-    S_composite_16_lum[15 - k] = 1.0f - S_composite_16_lum[k];
+  char* output_filename;
+  int   output_fd;
+  char* endptr;
+  long  value;
+
+  int   mapped_flag;
+  int   analyze_flag;
+  int   watch_flag;
+
+  int   num_modes;
+  int   output_flag;
+
+  int   tile_flag;
+  int   container_flag;
+  int   ubo_output_flag;
+  int   container_output_flag;
+
+  int   row_palette;
+  int   row_level;
+  int   num_levels;
+  char  row_filename[96];
+  int   format;
+
+  char* spec_filename;
+  char* sweep_filename;
+  char* atlas_uv_filename;
+  char* diff_filename_a;
+  char* diff_filename_b;
+  char* encode_filename;
+  char* encode_indices_filename;
+  char* encode_tile_map_filename;
+  int   tile_size;
+  char* remap_input;
+  char* remap_output_dir;
+  int   remap_mode;
+  char* publish_name;
+  char* unpublish_name;
+  char* published_name;
+  char* trim_list_filename;
+  char* trim_texture_filename;
+  char* trim_tables_filename;
+  char* recipe_filename;
+  char* expand_filename;
+  char  expand_tga_filename[64];
+  int   num_threads;
 
-    S_composite_16_sat[k] = S_composite_16_lum[k];
-    S_composite_16_sat[15 - k] = S_composite_16_sat[k];
-  }
+  FILE* fp_out;
 
-  /* composite 32 tables */
-  for (k = 0; k < 16; k++)
-  {
-    S_composite_32_lum[k] = (k + 1) * PALETTE_1024_COLOR_TABLE_STEP;
-    S_composite_32_lum[31 - k] = 1.0f - S_composite_32_lum[k];
+  recipe            rc;
+  unsigned char*    expand_data;
 
-    S_composite_32_sat[k] = S_composite_32_lum[k];
-    S_composite_32_sat[31 - k] = S_composite_32_sat[k];
-  }
+  palette_analysis  analysis;
 
-  return 0;
-}
+  /* initialization */
+  G_palette_data = NULL;
 
-/*******************************************************************************
-** set_voltage_table_pointers()
-*******************************************************************************/
-short int set_voltage_table_pointers()
-{
-  if ((G_source == SOURCE_APPROX_NES) || 
-      (G_source == SOURCE_APPROX_NES_ROTATED))
-  {
-    S_luma_table = S_approx_nes_lum;
-    S_saturation_table = S_approx_nes_sat;
-    S_table_length = 4;
-  }
-  else if (G_source == SOURCE_COMPOSITE_08)
-  {
-    S_luma_table = S_composite_08_lum;
-    S_saturation_table = S_composite_08_sat;
-    S_table_length = 8;
-  }
-  else if ( (G_source == SOURCE_COMPOSITE_16) || 
-            (G_source == SOURCE_COMPOSITE_16_ROTATED))
-  {
-    S_luma_table = S_composite_16_lum;
-    S_saturation_table = S_composite_16_sat;
-    S_table_length = 16;
-  }
-  else if (G_source == SOURCE_COMPOSITE_32)
-  {
-    S_luma_table = S_composite_32_lum;
-    S_saturation_table = S_composite_32_sat;
-    S_table_length = 32;
-  }
-  else
-  {
-    printf("Cannot set voltage table pointers; invalid source specified.\n");
-    return 1;
-  }
+  G_source = SOURCE_APPROX_NES;
+  G_palette_size = 64;
+  G_palette_channel_order = PALETTE_CHANNEL_ORDER_RGB;
 
-  return 0;
-}
+  output_tga_filename[0] = '\0';
 
-/*******************************************************************************
-** generate_palette_approx_nes()
-*******************************************************************************/
-short int generate_palette_approx_nes(int mode)
-{
-  int   phi;
+  output_filename = NULL;
+  output_fd = -1;
+
+  mapped_flag = 0;
+  analyze_flag = 0;
+  watch_flag = 0;
+
+  tile_flag = 0;
+  container_flag = 0;
+
+  row_palette = -1;
+  row_level = -1;
+  num_levels = 0;
+
+  G_num_output_files = 0;
+
+  G_container_pixel_format = CONTAINER_PIXEL_FORMAT_RGBA8;
+  G_container_mip_flag = 0;
+
+  spec_filename = NULL;
+  sweep_filename = NULL;
+  atlas_uv_filename = NULL;
+  diff_filename_a = NULL;
+  diff_filename_b = NULL;
+  encode_filename = NULL;
+  encode_indices_filename = NULL;
+  encode_tile_map_filename = NULL;
+  tile_size = ENCODE_MIN_TILE_SIZE;
+  remap_input = NULL;
+  remap_output_dir = NULL;
+  remap_mode = REMAP_MODE_NEAREST;
+  publish_name = NULL;
+  unpublish_name = NULL;
+  published_name = NULL;
+  trim_list_filename = NULL;
+  trim_texture_filename = NULL;
+  trim_tables_filename = NULL;
+  recipe_filename = NULL;
+  expand_filename = NULL;
+  num_threads = 0;
+
+  G_ubo_selection = NULL;
 
-  int   m;
-  int   n;
-  int   k;
+  /* generate voltage tables */
+  generate_voltage_tables();
+  generate_analysis_tables();
+  generate_ntsc_tables();
 
-  float y;
-  float i;
-  float q;
+  /* read command line arguments */
+  i = 1;
 
-  int   r;
-  int   g;
-  int   b;
+  while (i < argc)
+  {
+    /* source */
+    if (!strcmp(argv[i], "-s"))
+    {
+      i++;
 
-  unsigned char gradients[13][4][3];
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected source name. Exiting...\n");
+        return 0;
+      }
 
-  /* generate greys */
-  for (n = 0; n < 4; n++)
-  {
-    gradients[0][n][0] = (int) ((S_approx_nes_lum[n] * 255) + 0.5f);
-    gradients[0][n][1] = (int) ((S_approx_nes_lum[n] * 255) + 0.5f);
-    gradients[0][n][2] = (int) ((S_approx_nes_lum[n] * 255) + 0.5f);
-  }
+      G_source = get_palette_source_from_name(argv[i]);
 
-  /* determine phi    */
-  /* mode 0: standard */
-  /* mode 1: rotated  */
-  if (mode == 0)
-    phi = 0;
-  else if (mode == 1)
-    phi = 15;
-  else
-    phi = 0;
+      if (G_source < 0)
+      {
+        fprintf(stderr, "Unknown source %s. Exiting...\n", argv[i]);
+        return 0;
+      }
 
-  /* generate each hue */
-  for (m = 0; m < 12; m++)
-  {
-    for (n = 0; n < 4; n++)
-    {
-      /* compute yiq values */
-      y = S_approx_nes_lum[n];
-      i = S_approx_nes_sat[n] * cos(TWO_PI * ((m * 30) + phi) / 360.0f);
-      q = S_approx_nes_sat[n] * sin(TWO_PI * ((m * 30) + phi) / 360.0f);
-
-      /* convert to rgb */
-      r = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
-      g = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
-      b = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
-
-      /* bound rgb values */
-      if (r < 0)
-        r = 0;
-      else if (r > 255)
-        r = 255;
-
-      if (g < 0)
-        g = 0;
-      else if (g > 255)
-        g = 255;
-
-      if (b < 0)
-        b = 0;
-      else if (b > 255)
-        b = 255;
-
-      gradients[m + 1][n][0] = r;
-      gradients[m + 1][n][1] = g;
-      gradients[m + 1][n][2] = b;
+      i++;
     }
-  }
+    /* output filename ("-" for standard output) */
+    else if (!strcmp(argv[i], "-o"))
+    {
+      i++;
 
-  /* allocate palette data */
-  /*G_palette_data = malloc(sizeof(GLubyte) * 4 * G_palette_size * G_palette_size);*/
-  G_palette_data = malloc(sizeof(unsigned char) * 4 * G_palette_size * G_palette_size);
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected output filename. Exiting...\n");
+        return 0;
+      }
 
-  /* initialize palette data */
-  for (n = 0; n < G_palette_size * G_palette_size; n++)
-  {
-    G_palette_data[4 * n + 0] = 0;
-    G_palette_data[4 * n + 1] = 0;
-    G_palette_data[4 * n + 2] = 0;
-    G_palette_data[4 * n + 3] = 0;
-  }
+      output_filename = argv[i];
 
-  /* generate palette 0 */
+      i++;
+    }
+    /* output file descriptor (inherited from the parent process) */
+    else if (!strcmp(argv[i], "-fd"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected file descriptor. Exiting...\n");
+        return 0;
+      }
 
-  /* transparency color */
-  G_palette_data[4 * (4 * 64 + 0) + 0] = 0;
-  G_palette_data[4 * (4 * 64 + 0) + 1] = 0;
-  G_palette_data[4 * (4 * 64 + 0) + 2] = 0;
-  G_palette_data[4 * (4 * 64 + 0) + 3] = 0;
+      value = strtol(argv[i], &endptr, 10);
 
-  /* black */
-  G_palette_data[4 * (4 * 64 + 1) + 0] = 0;
-  G_palette_data[4 * (4 * 64 + 1) + 1] = 0;
-  G_palette_data[4 * (4 * 64 + 1) + 2] = 0;
-  G_palette_data[4 * (4 * 64 + 1) + 3] = 255;
+      if ((endptr == argv[i]) || (*endptr != '\0') || (value < 0) || (value > 65535))
+      {
+        fprintf(stderr, "Invalid file descriptor %s. Exiting...\n", argv[i]);
+        return 0;
+      }
 
-  /* greys */
-  for (n = 0; n < 4; n++)
-  {
-    G_palette_data[4 * (4 * 64 + n + 2) + 0] = gradients[0][n][0];
-    G_palette_data[4 * (4 * 64 + n + 2) + 1] = gradients[0][n][1];
-    G_palette_data[4 * (4 * 64 + n + 2) + 2] = gradients[0][n][2];
-    G_palette_data[4 * (4 * 64 + n + 2) + 3] = 255;
-  }
+      output_fd = (int) value;
 
-  /* white */
-  G_palette_data[4 * (4 * 64 + 6) + 0] = 255;
-  G_palette_data[4 * (4 * 64 + 6) + 1] = 255;
-  G_palette_data[4 * (4 * 64 + 6) + 2] = 255;
-  G_palette_data[4 * (4 * 64 + 6) + 3] = 255;
+      i++;
+    }
+    /* memory-mapped output (regular files only) */
+    else if (!strcmp(argv[i], "-mmap"))
+    {
+      mapped_flag = 1;
 
-  /* hues */
-  for (m = 0; m < 12; m++)
-  {
-    for (n = 0; n < 4; n++)
+      i++;
+    }
+    /* clipping & delta e report (instead of the texture) */
+    else if (!strcmp(argv[i], "-analyze"))
     {
-      G_palette_data[4 * (4 * 64 + 7 + 4 * m + n) + 0] = gradients[m + 1][n][0];
-      G_palette_data[4 * (4 * 64 + 7 + 4 * m + n) + 1] = gradients[m + 1][n][1];
-      G_palette_data[4 * (4 * 64 + 7 + 4 * m + n) + 2] = gradients[m + 1][n][2];
-      G_palette_data[4 * (4 * 64 + 7 + 4 * m + n) + 3] = 255;
+      analyze_flag = 1;
+
+      i++;
     }
-  }
+    /* region diff of two tga files (in the layout of the source) */
+    else if (!strcmp(argv[i], "-diff"))
+    {
+      i++;
 
-  /* generate lighting levels for palette 0 */
-  for (k = 0; k < 8; k++)
-  {
-    if (k == 4)
-      continue;
+      if (i + 1 >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected two tga filenames. Exiting...\n");
+        return 0;
+      }
 
-    /* copy transparency color */
-    memcpy(&G_palette_data[4 * (k * 64 + 0)], &G_palette_data[4 * (4 * 64 + 0)], 4);
+      diff_filename_a = argv[i];
+      diff_filename_b = argv[i + 1];
 
-    /* shadows */
-    if (k < 4)
+      i += 2;
+    }
+    /* per-tile palette encoding (input, index image & tile map files) */
+    else if (!strcmp(argv[i], "-encode"))
     {
-      /* greys */
-      for (m = 0; m < 4 - k + 1; m++)
-        memcpy(&G_palette_data[4 * (k * 64 + m + 1)], &G_palette_data[4 * (4 * 64 + 1)], 4);
-
-      memcpy(&G_palette_data[4 * (k * 64 + 4 - k + 2)], &G_palette_data[4 * (4 * 64 + 2)], 4 * (k + 1));
+      i++;
 
-      /* hues */
-      for (m = 0; m < 12; m++)
+      if (i + 2 >= argc)
       {
-        for (n = 0; n < 4 - k; n++)
-          memcpy(&G_palette_data[4 * (k * 64 + 4 * m + 7 + n)], &G_palette_data[4 * (4 * 64 + 1)], 4);
-
-        if (k != 0)
-          memcpy(&G_palette_data[4 * (k * 64 + 4 * m + 7 + 4 - k)], &G_palette_data[4 * (4 * 64 + 4 * m + 7)], 4 * k);
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected input, index and tile map filenames. Exiting...\n");
+        return 0;
       }
+
+      encode_filename = argv[i];
+      encode_indices_filename = argv[i + 1];
+      encode_tile_map_filename = argv[i + 2];
+
+      i += 3;
     }
-    /* highlights */
-    else if (k > 4)
+    /* tile size (for -encode) */
+    else if (!strcmp(argv[i], "-tile"))
     {
-      /* greys */
-      for (m = 0; m < k - 4 + 1; m++)
-        memcpy(&G_palette_data[4 * (k * 64 + (6 - m))], &G_palette_data[4 * (4 * 64 + 6)], 4);
+      i++;
+
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected tile size. Exiting...\n");
+        return 0;
+      }
 
-      memcpy(&G_palette_data[4 * (k * 64 + 1)], &G_palette_data[4 * (4 * 64 + (k - 4) + 1)], 4 * ((8 - k) + 1));
+      value = strtol(argv[i], &endptr, 10);
 
-      /* hues */
-      for (m = 0; m < 12; m++)
+      if ((endptr == argv[i]) || (*endptr != '\0') ||
+          ((value != ENCODE_MIN_TILE_SIZE) && (value != ENCODE_MAX_TILE_SIZE)))
       {
-        for (n = 0; n < k - 4; n++)
-          memcpy(&G_palette_data[4 * (k * 64 + 4 * m + 7 + (3 - n))], &G_palette_data[4 * (4 * 64 + 6)], 4);
+        fprintf(stderr, "Invalid tile size %s. Exiting...\n", argv[i]);
+        return 0;
+      }
+
+      tile_size = (int) value;
+      tile_flag = 1;
+
+      i++;
+    }
+    /* batch remap (a directory or list of tga files, and the output directory) */
+    else if (!strcmp(argv[i], "-remap"))
+    {
+      i++;
 
-        memcpy(&G_palette_data[4 * (k * 64 + 4 * m + 7)], &G_palette_data[4 * (4 * 64 + 4 * m + 7 + (k - 4))], 4 * (8 - k));
+      if (i + 1 >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected input and output directory. Exiting...\n");
+        return 0;
       }
+
+      remap_input = argv[i];
+      remap_output_dir = argv[i + 1];
+
+      i += 2;
     }
-  }
+    /* exact color matches only (for -remap) */
+    else if (!strcmp(argv[i], "-exact"))
+    {
+      remap_mode = REMAP_MODE_EXACT;
 
-  /* generate palettes 1 - 5 (shift by 2 each time) */
-  for (m = 1; m < 6; m++)
-  {
-    for (n = 0; n < 8; n++)
+      i++;
+    }
+    /* publish the texture in shared memory (as a new generation) */
+    else if (!strcmp(argv[i], "-publish"))
     {
-      /* transparency & greys */
-      memcpy(&G_palette_data[4 * ((8 * m + n) * 64 + 0)], &G_palette_data[4 * ((8 * (m - 1) + n) * 64 + 0)], 4 * 7);
+      i++;
 
-      /* shifted back colors */
-      memcpy(&G_palette_data[4 * ((8 * m + n) * 64 + 7)], &G_palette_data[4 * ((8 * (m - 1) + n) * 64 + 15)], 4 * 4 * 10);
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected shared memory name. Exiting...\n");
+        return 0;
+      }
 
-      /* cycled around colors */
-      memcpy(&G_palette_data[4 * ((8 * m + n) * 64 + 47)], &G_palette_data[4 * ((8 * (m - 1) + n) * 64 + 7)], 4 * 4 * 2);
-    }
-  }
+      publish_name = argv[i];
 
-  /* generate palette 6 (greyscale) */
-  for (m = 0; m < 8; m++)
-  {
-    memcpy(&G_palette_data[4 * ((48 + m) * 64 + 0)], &G_palette_data[4 * (m * 64 + 0)], 4 * 7);
+      i++;
+    }
+    /* remove a published texture */
+    else if (!strcmp(argv[i], "-unpublish"))
+    {
+      i++;
 
-    for (n = 0; n < 12; n++)
-      memcpy(&G_palette_data[4 * ((48 + m) * 64 + 4 * n + 7)], &G_palette_data[4 * (m * 64 + 2)], 4 * 4);
-  }
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected shared memory name. Exiting...\n");
+        return 0;
+      }
 
-  /* generate palette 7 (inverted greyscale) */
-  for (m = 0; m < 8; m++)
-  {
-    memcpy(&G_palette_data[4 * ((56 + m) * 64 + 0)], &G_palette_data[4 * (m * 64 + 0)], 4);
+      unpublish_name = argv[i];
 
-    for (n = 1; n < 7; n++)
+      i++;
+    }
+    /* describe a published texture (to -o / -fd, or standard output) */
+    else if (!strcmp(argv[i], "-published"))
     {
-      G_palette_data[4 * ((56 + m) * 64 + n) + 0] = G_palette_data[4 * (m * 64 + (7 - n)) + 0];
-      G_palette_data[4 * ((56 + m) * 64 + n) + 1] = G_palette_data[4 * (m * 64 + (7 - n)) + 1];
-      G_palette_data[4 * ((56 + m) * 64 + n) + 2] = G_palette_data[4 * (m * 64 + (7 - n)) + 2];
-      G_palette_data[4 * ((56 + m) * 64 + n) + 3] = G_palette_data[4 * (m * 64 + (7 - n)) + 3];
+      i++;
+
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected shared memory name. Exiting...\n");
+        return 0;
+      }
+
+      published_name = argv[i];
+
+      i++;
     }
+    /* trim the texture to the texels used by the listed assets */
+    /* (asset list, trimmed texture & remap table files)        */
+    else if (!strcmp(argv[i], "-trim"))
+    {
+      i++;
 
-    for (n = 0; n < 12; n++)
-      memcpy(&G_palette_data[4 * ((56 + m) * 64 + 4 * n + 7)], &G_palette_data[4 * ((56 + m) * 64 + 2)], 4 * 4);
-  }
+      if (i + 2 >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected asset list, texture and table filenames. Exiting...\n");
+        return 0;
+      }
 
-  return 0;
-}
+      trim_list_filename = argv[i];
+      trim_texture_filename = argv[i + 1];
+      trim_tables_filename = argv[i + 2];
 
-/*******************************************************************************
-** generate_palette_256_color()
-*******************************************************************************/
-short int generate_palette_256_color(int mode)
-{
-  #define PALETTE_SIZE 256
+      i += 3;
+    }
+    /* recipe file (the copies & fills that build the composite texture) */
+    else if (!strcmp(argv[i], "-recipe"))
+    {
+      i++;
 
-  #define PALETTE_LEVELS_PER_PALETTE  (PALETTE_SIZE / PALETTE_NUM_INDICES)
-  #define PALETTE_BASE_LEVEL          (PALETTE_LEVELS_PER_PALETTE / 2)
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected recipe filename. Exiting...\n");
+        return 0;
+      }
+
+      recipe_filename = argv[i];
+
+      i++;
+    }
+    /* expand a recipe file (the texture goes to -o / -fd) */
+    else if (!strcmp(argv[i], "-expand"))
+    {
+      i++;
 
-  int   num_hues;
-  int   num_gradients;
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected recipe filename. Exiting...\n");
+        return 0;
+      }
 
-  int   num_shades;
-  int   shade_step;
+      expand_filename = argv[i];
 
-  int   num_rotations;
-  int   rotation_step;
+      i++;
+    }
+    /* rows of the uniform buffer outputs (palette[:level[-level]], ...) */
+    else if (!strcmp(argv[i], "-ubo"))
+    {
+      i++;
 
-  int   num_tints;
-  int   tint_step;
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected uniform buffer rows. Exiting...\n");
+        return 0;
+      }
 
-  float phi;
+      G_ubo_selection = argv[i];
 
-  int   tint_start_hue;
+      i++;
+    }
+    /* single row (palette index & lighting level), generated on its own */
+    else if (!strcmp(argv[i], "-row"))
+    {
+      i++;
 
-  int   fixed_hues_left;
-  int   fixed_hues_right;
+      if (i + 1 >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected palette index and level. Exiting...\n");
+        return 0;
+      }
 
-  int   m;
-  int   n;
-  int   k;
+      value = strtol(argv[i], &endptr, 10);
 
-  int   p;
+      if ((endptr == argv[i]) || (*endptr != '\0') || (value < 0) || (value >= PALETTE_NUM_INDICES))
+      {
+        fprintf(stderr, "Invalid palette index %s. Exiting...\n", argv[i]);
+        return 0;
+      }
 
-  float y;
-  float i;
-  float q;
+      row_palette = (int) value;
 
-  int   r;
-  int   g;
-  int   b;
+      value = strtol(argv[i + 1], &endptr, 10);
 
-  int   index;
+      if ((endptr == argv[i + 1]) || (*endptr != '\0') || (value < 0) || (value > 65535))
+      {
+        fprintf(stderr, "Invalid level %s. Exiting...\n", argv[i + 1]);
+        return 0;
+      }
 
-  int   source_base_index;
-  int   dest_base_index;
+      row_level = (int) value;
 
-  /* initialize variables based on mode */
-  if (mode == PALETTE_MODE_STANDARD)
-  {
-    num_hues = 12;
-    num_shades = 16;
+      i += 2;
+    }
+    /* lighting levels per palette (for -row & -encode) */
+    else if (!strcmp(argv[i], "-levels"))
+    {
+      i++;
 
-    num_rotations = 6;
-    num_tints = 3;
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected number of levels. Exiting...\n");
+        return 0;
+      }
 
-    phi = 0.0f;
-    tint_start_hue = 2;
+      value = strtol(argv[i], &endptr, 10);
 
-    fixed_hues_left = 1;
-    fixed_hues_right = 1;
-  }
-  else if (mode == PALETTE_MODE_ROTATED)
-  {
-    num_hues = 12;
-    num_shades = 16;
+      if ((endptr == argv[i]) || (*endptr != '\0') ||
+          (value < PALETTE_MIN_LEVELS) || (value > PALETTE_MAX_LEVELS) || (value % 2 != 0))
+      {
+        fprintf(stderr, "Invalid number of levels %s. Exiting...\n", argv[i]);
+        return 0;
+      }
 
-    num_rotations = 6;
-    num_tints = 3;
+      num_levels = (int) value;
 
-    phi = PI / 12.0f; /* 15 degrees */
-    tint_start_hue = 1;
+      i++;
+    }
+    /* additional output (format and filename) */
+    else if (!strcmp(argv[i], "-f"))
+    {
+      i++;
 
-    fixed_hues_left = 1;
-    fixed_hues_right = 1;
-  }
-  else if (mode == PALETTE_MODE_DOUBLED)
-  {
-    num_hues = 24;
-    num_shades = 8;
+      if (i + 1 >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected output format and filename. Exiting...\n");
+        return 0;
+      }
 
-    num_rotations = 6;
-    num_tints = 3;
+      format = get_output_format(argv[i]);
 
-    phi = 0.0f;
-    tint_start_hue = 2;
+      if (format < 0)
+      {
+        fprintf(stderr, "Unknown output format %s. Exiting...\n", argv[i]);
+        return 0;
+      }
 
-    fixed_hues_left = 1;
-    fixed_hues_right = 2;
-  }
-  else
-  {
-    num_hues = 12;
-    num_shades = 16;
+      if (add_output_file(format, argv[i + 1], -1))
+        return 0;
 
-    num_rotations = 6;
-    num_tints = 3;
+      i += 2;
+    }
+    /* pixel format for the ktx2 & dds outputs */
+    else if (!strcmp(argv[i], "-pf"))
+    {
+      i++;
 
-    phi = 0.0f;
-    tint_start_hue = 2;
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected pixel format. Exiting...\n");
+        return 0;
+      }
 
-    fixed_hues_left = 1;
-    fixed_hues_right = 1;
-  }
+      G_container_pixel_format = get_container_pixel_format(argv[i]);
 
-  /* initialize derived variables */
-  num_gradients = num_hues + 1;
+      if (G_container_pixel_format < 0)
+      {
+        fprintf(stderr, "Unknown pixel format %s. Exiting...\n", argv[i]);
+        return 0;
+      }
 
-  shade_step = num_shades / PALETTE_BASE_LEVEL;
-  rotation_step = num_hues / num_rotations;
-  tint_step = num_hues / num_tints;
+      container_flag = 1;
 
-  /* allocate palette data */
-  /*G_palette_data = malloc(sizeof(GLubyte) * 3 * PALETTE_SIZE * PALETTE_SIZE);*/
-  G_palette_data = malloc(sizeof(unsigned char) * 3 * PALETTE_SIZE * PALETTE_SIZE);
+      i++;
+    }
+    /* mip chain for the ktx2 & dds outputs */
+    else if (!strcmp(argv[i], "-mips"))
+    {
+      G_container_mip_flag = 1;
+      container_flag = 1;
 
-  /* initialize palette data */
-  for (k = 0; k < PALETTE_SIZE * PALETTE_SIZE; k++)
-  {
-    G_palette_data[3 * k + 0] = 0;
-    G_palette_data[3 * k + 1] = 0;
-    G_palette_data[3 * k + 2] = 0;
-  }
+      i++;
+    }
+    /* keep regenerating the spec file's palettes when it changes */
+    else if (!strcmp(argv[i], "-watch"))
+    {
+      watch_flag = 1;
 
-  /* initialize palette 0 */
-  for (m = PALETTE_BASE_LEVEL; m < PALETTE_LEVELS_PER_PALETTE; m++)
-  {
-    for (n = 0; n < num_gradients; n++)
+      i++;
+    }
+    /* spec file (generates all of the palettes defined in it) */
+    else if (!strcmp(argv[i], "-spec"))
     {
-      for (k = 0; k < num_shades; k++)
-      {
-        index = m * PALETTE_SIZE + n * num_shades + k;
+      i++;
 
-        G_palette_data[3 * index + 0] = 255;
-        G_palette_data[3 * index + 1] = 255;
-        G_palette_data[3 * index + 2] = 255;
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected spec filename. Exiting...\n");
+        return 0;
       }
+
+      spec_filename = argv[i];
+
+      i++;
     }
-  }
+    /* sweep file (generates every combination of the listed parameters) */
+    else if (!strcmp(argv[i], "-sweep"))
+    {
+      i++;
 
-  /* generate palette 0 */
-  for (n = 0; n < num_gradients; n++)
-  {
-    for (k = 0; k < num_shades; k++)
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected sweep filename. Exiting...\n");
+        return 0;
+      }
+
+      sweep_filename = argv[i];
+
+      i++;
+    }
+    /* atlas of all sources (the texture goes to -o / -fd) */
+    else if (!strcmp(argv[i], "-atlas"))
     {
-      index = PALETTE_BASE_LEVEL * PALETTE_SIZE + n * num_shades + k;
+      i++;
+
+      if (i >= argc)
+      {
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected uv filename. Exiting...\n");
+        return 0;
+      }
+
+      atlas_uv_filename = argv[i];
 
-      /* compute color in yiq */
-      y = S_luma_table[k];
+      i++;
+    }
+    /* number of worker threads */
+    else if (!strcmp(argv[i], "-j"))
+    {
+      i++;
 
-      if (n == 0)
+      if (i >= argc)
       {
-        i = 0.0f;
-        q = 0.0f;
+        fprintf(stderr, "Insufficient number of arguments. ");
+        fprintf(stderr, "Expected number of threads. Exiting...\n");
+        return 0;
       }
-      else
+
+      value = strtol(argv[i], &endptr, 10);
+
+      if ((endptr == argv[i]) || (*endptr != '\0') || (value < 1) || (value > POOL_MAX_THREADS))
       {
-        i = S_saturation_table[k] * cos(((TWO_PI * (n - 1)) / num_hues) + phi);
-        q = S_saturation_table[k] * sin(((TWO_PI * (n - 1)) / num_hues) + phi);
+        fprintf(stderr, "Invalid number of threads %s. Exiting...\n", argv[i]);
+        return 0;
       }
 
-      /* convert from yiq to rgb */
-      r = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
-      g = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
-      b = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
-
-      /* hard clipping at the bottom */
-      if (r < 0)
-        r = 0;
-      if (g < 0)
-        g = 0;
-      if (b < 0)
-        b = 0;
-
-      /* hard clipping at the top */
-      if (r > 255)
-        r = 255;
-      if (g > 255)
-        g = 255;
-      if (b > 255)
-        b = 255;
-
-      /* insert this color into the palette */
-      G_palette_data[3 * index + 0] = r;
-      G_palette_data[3 * index + 1] = g;
-      G_palette_data[3 * index + 2] = b;
+      num_threads = (int) value;
+
+      i++;
+    }
+    else
+    {
+      fprintf(stderr, "Unknown command line argument %s. Exiting...\n", argv[i]);
+      return 0;
     }
   }
 
-  /* shadows for palette 0 */
-  for (m = 1; m < PALETTE_BASE_LEVEL; m++)
+  /* only one mode can be given, and the output options must be */
+  /* used by that mode (rather than silently ignored)            */
+  num_modes = ((watch_flag) || (spec_filename != NULL)) +
+              (unpublish_name != NULL) + (published_name != NULL) +
+              (publish_name != NULL) + (recipe_filename != NULL) +
+              (expand_filename != NULL) + (sweep_filename != NULL) +
+              (analyze_flag != 0) + (diff_filename_a != NULL) +
+              (remap_input != NULL) + (trim_list_filename != NULL) +
+              ((row_palette >= 0) && (remap_input == NULL)) +
+              (encode_filename != NULL) + (atlas_uv_filename != NULL);
+
+  output_flag = (output_filename != NULL) || (output_fd >= 0);
+
+  if (num_modes > 1)
+  {
+    fprintf(stderr, "Only one of -spec / -watch, -publish, -unpublish, -published, -recipe, -expand, ");
+    fprintf(stderr, "-sweep, -analyze, -diff, -remap, -trim, -row, -encode & -atlas can be given. Exiting...\n");
+    return 0;
+  }
+
+  if ((num_modes > 0) && (G_num_output_files > 0))
   {
-    source_base_index = PALETTE_BASE_LEVEL * PALETTE_SIZE;
-    dest_base_index = m * PALETTE_SIZE;
+    fprintf(stderr, "Additional outputs (-f) can only be written with the texture. Exiting...\n");
+    return 0;
+  }
 
-    for (n = 0; n < num_gradients; n++)
-    {
-      memcpy( &G_palette_data[3 * (dest_base_index + num_shades * n + (PALETTE_BASE_LEVEL - m) * shade_step)], 
-              &G_palette_data[3 * (source_base_index + num_shades * n)], 
-              3 * m * shade_step);
-    }
+  if ((num_modes > 0) && (mapped_flag))
+  {
+    fprintf(stderr, "Memory-mapped output (-mmap) can only be used for the texture. Exiting...\n");
+    return 0;
   }
 
-  /* highlights for palette 0 */
-  for (m = PALETTE_BASE_LEVEL + 1; m < PALETTE_LEVELS_PER_PALETTE; m++)
+  /* these modes write their own files */
+  if ( (output_flag) &&
+       ((watch_flag) || (spec_filename != NULL) || (unpublish_name != NULL) ||
+        (publish_name != NULL) || (recipe_filename != NULL) || (remap_input != NULL) ||
+        (trim_list_filename != NULL) || (encode_filename != NULL)))
   {
-    source_base_index = PALETTE_BASE_LEVEL * PALETTE_SIZE;
-    dest_base_index = m * PALETTE_SIZE;
+    fprintf(stderr, "The output (-o / -fd) is not used by this mode. Exiting...\n");
+    return 0;
+  }
+
+  /* the options of a mode or output need that mode or output */
+  ubo_output_flag = 0;
+  container_output_flag = 0;
 
-    for (n = 0; n < num_gradients; n++)
+  for (i = 0; i < G_num_output_files; i++)
+  {
+    if ((G_output_files[i].format == OUTPUT_FORMAT_UBO)     ||
+        (G_output_files[i].format == OUTPUT_FORMAT_UBO_F32) ||
+        (G_output_files[i].format == OUTPUT_FORMAT_UBO_HEADER))
     {
-      memcpy( &G_palette_data[3 * (dest_base_index + num_shades * n)], 
-              &G_palette_data[3 * (source_base_index + num_shades * n + (m - PALETTE_BASE_LEVEL) * shade_step)], 
-              3 * (PALETTE_LEVELS_PER_PALETTE - m) * shade_step);
+      ubo_output_flag = 1;
+    }
+    else if ( (G_output_files[i].format == OUTPUT_FORMAT_KTX2) ||
+              (G_output_files[i].format == OUTPUT_FORMAT_DDS))
+    {
+      container_output_flag = 1;
     }
   }
 
-  /* palettes 1-5: rotations */
-  for (p = 1; p < num_rotations; p++)
+  if ((tile_flag) && (encode_filename == NULL))
   {
-    for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
-    {
-      source_base_index = m * PALETTE_SIZE;
-      dest_base_index = (((PALETTE_INDEX_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+    fprintf(stderr, "The tile size (-tile) is only valid with -encode. Exiting...\n");
+    return 0;
+  }
 
-      /* greys */
-      memcpy( &G_palette_data[3 * dest_base_index], 
-              &G_palette_data[3 * source_base_index], 
-              3 * num_shades);
+  if ((remap_mode == REMAP_MODE_EXACT) && (remap_input == NULL))
+  {
+    fprintf(stderr, "Exact matching (-exact) is only valid with -remap. Exiting...\n");
+    return 0;
+  }
 
-      /* rotated hues */
-      memcpy( &G_palette_data[3 * (dest_base_index + 1 * num_shades)], 
-              &G_palette_data[3 * (source_base_index + (1 + p * rotation_step) * num_shades)], 
-              3 * (num_rotations - p) * rotation_step * num_shades);
+  if ((G_ubo_selection != NULL) && (!ubo_output_flag))
+  {
+    fprintf(stderr, "The uniform buffer rows (-ubo) are only valid with a ubo, ubo_f32 or ubo_header output (-f). Exiting...\n");
+    return 0;
+  }
 
-      memcpy( &G_palette_data[3 * (dest_base_index + (1 + (num_rotations - p) * rotation_step) * num_shades)], 
-              &G_palette_data[3 * (source_base_index + num_shades)], 
-              3 * p * rotation_step * num_shades);
-    }
+  if ((container_flag) && (!container_output_flag))
+  {
+    fprintf(stderr, "The pixel format (-pf) and mips (-mips) are only valid with a ktx2 or dds output (-f). Exiting...\n");
+    return 0;
   }
 
-  /* palette 6: greyscale */
-  for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
+  /* watch mode (only the changed palettes are regenerated) */
+  if (watch_flag)
   {
-    for (n = 0; n < num_gradients; n++)
+    if (spec_filename == NULL)
     {
-      source_base_index = m * PALETTE_SIZE;
-      dest_base_index = ((PALETTE_INDEX_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-
-      memcpy( &G_palette_data[3 * (dest_base_index + (n * num_shades))], 
-              &G_palette_data[3 * (source_base_index + (0 * num_shades))], 
-              3 * num_shades);
+      fprintf(stderr, "Watch mode requires a spec file. Exiting...\n");
+      return 0;
     }
+
+    if (num_threads == 0)
+      num_threads = get_default_num_threads();
+
+    if (run_spec_watch(spec_filename, num_threads))
+      fprintf(stderr, "Error watching spec file.\n");
+
+    return 0;
   }
 
-  /* palettes 7-11: alternate rotations (preserving flesh tones) */
-  for (p = 1; p < num_rotations; p++)
+  /* remove the shared memory segments of a published texture */
+  if (unpublish_name != NULL)
   {
-    for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
-    {
-      /* copy non-rotated hues from palette 0 */
-      source_base_index = m * PALETTE_SIZE;
-      dest_base_index = (((PALETTE_INDEX_ALTERNATE_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+    if (unpublish_texture(unpublish_name))
+      fprintf(stderr, "Error removing published texture.\n");
+
+    return 0;
+  }
 
-      /* copying grey and the fixed hues on the left side */
-      memcpy( &G_palette_data[3 * dest_base_index], 
-              &G_palette_data[3 * source_base_index], 
-              3 * num_shades * (1 + fixed_hues_left));
+  /* describe a published texture */
+  if (published_name != NULL)
+  {
+    if ((output_filename != NULL) && (output_fd >= 0))
+    {
+      fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
+      return 0;
+    }
 
-      /* copying the fixed hues on the right side */
-      memcpy( &G_palette_data[3 * (dest_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-              &G_palette_data[3 * (source_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-              3 * num_shades * fixed_hues_right);
+    if ((output_filename == NULL) && (output_fd < 0))
+      output_filename = "-";
 
-      /* copy rotated hues from the original rotated palette */
-      source_base_index = (((PALETTE_INDEX_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-      dest_base_index = (((PALETTE_INDEX_ALTERNATE_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+    fp_out = open_output_stream(output_filename, output_fd);
 
-      memcpy( &G_palette_data[3 * (dest_base_index + (1 + fixed_hues_left) * num_shades)], 
-              &G_palette_data[3 * (source_base_index + (1 + fixed_hues_left) * num_shades)], 
-              3 * num_shades * (num_hues - fixed_hues_left - fixed_hues_right));
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open output stream. Exiting...\n");
+      return 0;
     }
+
+    if (write_published_info(fp_out, published_name))
+      fprintf(stderr, "Error reading published texture.\n");
+
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing output stream.\n");
+
+    return 0;
   }
 
-  /* palette 12: alternate greyscale (preserving flesh tones) */
-  for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
+  /* generate the texture into shared memory (replacing the */
+  /* previous generation, if it was published before)       */
+  if (publish_name != NULL)
   {
-    /* copy non-rotated hues from palette 0 */
-    source_base_index = m * PALETTE_SIZE;
-    dest_base_index = ((PALETTE_INDEX_ALTERNATE_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-
-    /* copying grey and the fixed hues on the left side */
-    memcpy( &G_palette_data[3 * dest_base_index], 
-            &G_palette_data[3 * source_base_index], 
-            3 * num_shades * (1 + fixed_hues_left));
-
-    /* copying the fixed hues on the right side */
-    memcpy( &G_palette_data[3 * (dest_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-            &G_palette_data[3 * (source_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-            3 * num_shades * fixed_hues_right);
-
-    /* copy greyscale hues from the original greyscale palette */
-    source_base_index = ((PALETTE_INDEX_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-    dest_base_index = ((PALETTE_INDEX_ALTERNATE_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-
-    memcpy( &G_palette_data[3 * (dest_base_index + (1 + fixed_hues_left) * num_shades)], 
-            &G_palette_data[3 * (source_base_index + (1 + fixed_hues_left) * num_shades)], 
-            3 * num_shades * (num_hues - fixed_hues_left - fixed_hues_right));
+    if (publish_texture(publish_name))
+      fprintf(stderr, "Error publishing texture.\n");
+
+    clear_palette();
+    free_palette_arena();
+
+    return 0;
   }
 
-  /* palettes 13-15: tints */
-  for (p = 0; p < num_tints; p++)
+  /* write the recipe of the source's texture */
+  if (recipe_filename != NULL)
   {
-    for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
+    if (build_recipe(&rc, G_source))
     {
-      for (n = 0; n < num_gradients; n++)
-      {
-        source_base_index = m * PALETTE_SIZE;
-        dest_base_index = (((PALETTE_INDEX_TINT_RED + p) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+      fprintf(stderr, "Error building recipe. Exiting...\n");
+      return 0;
+    }
 
-        memcpy( &G_palette_data[3 * (dest_base_index + n * num_shades)], 
-                &G_palette_data[3 * (source_base_index + (tint_start_hue + p * tint_step) * num_shades)], 
-                3 * num_shades);
-      }
+    fp_out = open_output_stream(recipe_filename, -1);
+
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open recipe file. Exiting...\n");
+      clear_recipe(&rc);
+      return 0;
     }
+
+    if (write_recipe_file(fp_out, &rc))
+      fprintf(stderr, "Error writing recipe file.\n");
+
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing recipe file.\n");
+
+    clear_recipe(&rc);
+
+    return 0;
   }
 
-  #undef PALETTE_SIZE
+  /* expand a recipe, and write the texture */
+  if (expand_filename != NULL)
+  {
+    if ((output_filename != NULL) && (output_fd >= 0))
+    {
+      fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
+      return 0;
+    }
+
+    if (read_recipe_file(expand_filename, &rc))
+      return 0;
 
-  #undef PALETTE_LEVELS_PER_PALETTE
-  #undef PALETTE_BASE_LEVEL
+    expand_data = allocate_aligned_buffer(3 * (long) rc.palette_size * rc.palette_size);
 
-  return 0;
-}
+    if (expand_data == NULL)
+    {
+      fprintf(stderr, "Unable to allocate texture. Exiting...\n");
+      clear_recipe(&rc);
+      return 0;
+    }
 
-/*******************************************************************************
-** generate_palette_1024_color()
-*******************************************************************************/
-short int generate_palette_1024_color()
-{
-  #define PALETTE_SIZE 1024
+    expand_recipe(&rc, expand_data);
 
-  #define PALETTE_LEVELS_PER_PALETTE  (PALETTE_SIZE / PALETTE_NUM_INDICES)
-  #define PALETTE_BASE_LEVEL          (PALETTE_LEVELS_PER_PALETTE / 2)
+    G_source = rc.source;
 
-  int   num_hues;
-  int   num_gradients;
+    if ((output_filename == NULL) && (output_fd < 0))
+    {
+      sprintf(expand_tga_filename, "%s.tga", get_palette_source_name());
+      output_filename = expand_tga_filename;
+    }
 
-  int   num_shades;
-  int   shade_step;
+    fp_out = open_output_stream(output_filename, output_fd);
 
-  int   num_rotations;
-  int   rotation_step;
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open output stream. Exiting...\n");
+      free(expand_data);
+      clear_recipe(&rc);
+      return 0;
+    }
 
-  int   num_tints;
-  int   tint_step;
+    if (write_tga_image(fp_out, expand_data, rc.palette_size, rc.palette_size, 3))
+      fprintf(stderr, "Error writing texture.\n");
 
-  float phi;
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing output stream.\n");
 
-  int   tint_start_hue;
+    free(expand_data);
+    clear_recipe(&rc);
 
-  int   fixed_hues_left;
-  int   fixed_hues_right;
+    return 0;
+  }
 
-  int   m;
-  int   n;
-  int   k;
+  /* generate the palettes from the spec file */
+  if (spec_filename != NULL)
+  {
+    if (load_palette_specs(spec_filename))
+    {
+      fprintf(stderr, "Error loading spec file. Exiting...\n");
+      return 0;
+    }
 
-  int   p;
+    if (num_threads == 0)
+      num_threads = get_default_num_threads();
 
-  float y;
-  float i;
-  float q;
+    run_palette_specs(num_threads);
+    clear_palette_specs();
 
-  int   r;
-  int   g;
-  int   b;
+    return 0;
+  }
 
-  int   index;
+  /* run the parameter sweep (the summary goes to -o / -fd) */
+  if (sweep_filename != NULL)
+  {
+    if ((output_filename != NULL) && (output_fd >= 0))
+    {
+      fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
+      return 0;
+    }
 
-  int   source_base_index;
-  int   dest_base_index;
+    if (load_sweep(sweep_filename))
+    {
+      fprintf(stderr, "Error loading sweep file. Exiting...\n");
+      return 0;
+    }
 
-  /* initialize variables */
-  num_hues = 24;
-  num_shades = 32;
+    if (num_threads == 0)
+      num_threads = get_default_num_threads();
 
-  num_rotations = 6;
-  num_tints = 3;
+    if ((output_filename == NULL) && (output_fd < 0))
+      output_filename = "-";
 
-  phi = 0.0f;
-  tint_start_hue = 2;
+    fp_out = open_output_stream(output_filename, output_fd);
 
-  fixed_hues_left = 1;
-  fixed_hues_right = 2;
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open output stream. Exiting...\n");
+      clear_sweep();
+      return 0;
+    }
 
-  /* initialize derived variables */
-  num_gradients = num_hues + 1;
+    if (run_sweep(fp_out, num_threads))
+      fprintf(stderr, "Error running sweep.\n");
 
-  shade_step = num_shades / PALETTE_BASE_LEVEL;
-  rotation_step = num_hues / num_rotations;
-  tint_step = num_hues / num_tints;
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing output stream.\n");
 
-  /* allocate palette data */
-  /*G_palette_data = malloc(sizeof(GLubyte) * 3 * PALETTE_SIZE * PALETTE_SIZE);*/
-  G_palette_data = malloc(sizeof(unsigned char) * 3 * PALETTE_SIZE * PALETTE_SIZE);
+    clear_sweep();
 
-  /* initialize palette data */
-  for (k = 0; k < PALETTE_SIZE * PALETTE_SIZE; k++)
-  {
-    G_palette_data[3 * k + 0] = 0;
-    G_palette_data[3 * k + 1] = 0;
-    G_palette_data[3 * k + 2] = 0;
+    return 0;
   }
 
-  /* initialize palette 0 */
-  for (m = PALETTE_BASE_LEVEL; m < PALETTE_LEVELS_PER_PALETTE; m++)
+  /* write the analysis report (to -o / -fd, or standard output) */
+  if (analyze_flag)
   {
-    for (n = 0; n < num_gradients; n++)
+    if ((output_filename != NULL) && (output_fd >= 0))
     {
-      for (k = 0; k < num_shades; k++)
-      {
-        index = m * PALETTE_SIZE + n * num_shades + k;
-
-        G_palette_data[3 * index + 0] = 255;
-        G_palette_data[3 * index + 1] = 255;
-        G_palette_data[3 * index + 2] = 255;
-      }
+      fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
+      return 0;
     }
-  }
 
-  /* generate palette 0 */
-  for (n = 0; n < num_gradients; n++)
-  {
-    for (k = 0; k < num_shades; k++)
+    if (analyze_palette_source(G_source, &analysis))
     {
-      index = PALETTE_BASE_LEVEL * PALETTE_SIZE + n * num_shades + k;
+      fprintf(stderr, "Error analyzing palette. Exiting...\n");
+      return 0;
+    }
 
-      /* compute color in yiq */
-      y = S_luma_table[k];
+    if ((output_filename == NULL) && (output_fd < 0))
+      output_filename = "-";
 
-      if (n == 0)
-      {
-        i = 0.0f;
-        q = 0.0f;
-      }
-      else
-      {
-        i = S_saturation_table[k] * cos(((TWO_PI * (n - 1)) / num_hues) + phi);
-        q = S_saturation_table[k] * sin(((TWO_PI * (n - 1)) / num_hues) + phi);
-      }
+    fp_out = open_output_stream(output_filename, output_fd);
 
-      /* convert from yiq to rgb */
-      r = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
-      g = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
-      b = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
-
-      /* hard clipping at the bottom */
-      if (r < 0)
-        r = 0;
-      if (g < 0)
-        g = 0;
-      if (b < 0)
-        b = 0;
-
-      /* hard clipping at the top */
-      if (r > 255)
-        r = 255;
-      if (g > 255)
-        g = 255;
-      if (b > 255)
-        b = 255;
-
-      /* insert this color into the palette */
-      G_palette_data[3 * index + 0] = r;
-      G_palette_data[3 * index + 1] = g;
-      G_palette_data[3 * index + 2] = b;
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open output stream. Exiting...\n");
+      return 0;
     }
+
+    if (write_palette_analysis(fp_out, &analysis, get_palette_source_name()))
+      fprintf(stderr, "Error writing analysis.\n");
+
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing output stream.\n");
+
+    return 0;
   }
 
-  /* shadows for palette 0 */
-  for (m = 1; m < PALETTE_BASE_LEVEL; m++)
+  /* write the diff report (to -o / -fd, or standard output) */
+  if (diff_filename_a != NULL)
   {
-    source_base_index = PALETTE_BASE_LEVEL * PALETTE_SIZE;
-    dest_base_index = m * PALETTE_SIZE;
+    if ((output_filename != NULL) && (output_fd >= 0))
+    {
+      fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
+      return 0;
+    }
+
+    if ((output_filename == NULL) && (output_fd < 0))
+      output_filename = "-";
 
-    for (n = 0; n < num_gradients; n++)
+    fp_out = open_output_stream(output_filename, output_fd);
+
+    if (fp_out == NULL)
     {
-      memcpy( &G_palette_data[3 * (dest_base_index + num_shades * n + (PALETTE_BASE_LEVEL - m) * shade_step)], 
-              &G_palette_data[3 * (source_base_index + num_shades * n)], 
-              3 * m * shade_step);
+      fprintf(stderr, "Unable to open output stream. Exiting...\n");
+      return 0;
     }
+
+    if (diff_tga_files(fp_out, G_source, diff_filename_a, diff_filename_b))
+      fprintf(stderr, "Error comparing textures.\n");
+
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing output stream.\n");
+
+    return 0;
   }
 
-  /* highlights for palette 0 */
-  for (m = PALETTE_BASE_LEVEL + 1; m < PALETTE_LEVELS_PER_PALETTE; m++)
+  /* remap the images onto one row of the texture (-row, or */
+  /* palette 0 at the middle level), each to its own file    */
+  if (remap_input != NULL)
   {
-    source_base_index = PALETTE_BASE_LEVEL * PALETTE_SIZE;
-    dest_base_index = m * PALETTE_SIZE;
+    if (num_levels != 0)
+    {
+      fprintf(stderr, "The number of levels cannot be set for -remap. Exiting...\n");
+      return 0;
+    }
 
-    for (n = 0; n < num_gradients; n++)
+    if (setup_remap_palette(row_palette, row_level, remap_mode))
     {
-      memcpy( &G_palette_data[3 * (dest_base_index + num_shades * n)], 
-              &G_palette_data[3 * (source_base_index + num_shades * n + (m - PALETTE_BASE_LEVEL) * shade_step)], 
-              3 * (PALETTE_LEVELS_PER_PALETTE - m) * shade_step);
+      fprintf(stderr, "Error setting up remap palette. Exiting...\n");
+      clear_remap();
+      clear_palette();
+      free_palette_arena();
+      return 0;
     }
-  }
 
-  /* palettes 1-5: rotations */
-  for (p = 1; p < num_rotations; p++)
-  {
-    for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
+    if (add_remap_inputs(remap_input, remap_output_dir))
     {
-      source_base_index = m * PALETTE_SIZE;
-      dest_base_index = (((PALETTE_INDEX_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+      fprintf(stderr, "Error adding remap inputs. Exiting...\n");
+      clear_remap();
+      clear_palette();
+      free_palette_arena();
+      return 0;
+    }
 
-      /* greys */
-      memcpy( &G_palette_data[3 * dest_base_index], 
-              &G_palette_data[3 * source_base_index], 
-              3 * num_shades);
+    if (num_threads == 0)
+      num_threads = get_default_num_threads();
 
-      /* rotated hues */
-      memcpy( &G_palette_data[3 * (dest_base_index + 1 * num_shades)], 
-              &G_palette_data[3 * (source_base_index + (1 + p * rotation_step) * num_shades)], 
-              3 * (num_rotations - p) * rotation_step * num_shades);
+    if (run_remap(num_threads))
+      fprintf(stderr, "Error remapping images.\n");
 
-      memcpy( &G_palette_data[3 * (dest_base_index + (1 + (num_rotations - p) * rotation_step) * num_shades)], 
-              &G_palette_data[3 * (source_base_index + num_shades)], 
-              3 * p * rotation_step * num_shades);
-    }
+    clear_remap();
+    clear_palette();
+    free_palette_arena();
+
+    return 0;
   }
 
-  /* palette 6: greyscale */
-  for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
+  /* trim the texture (the trimmed texture & remap tables go to their own files) */
+  if (trim_list_filename != NULL)
   {
-    for (n = 0; n < num_gradients; n++)
+    if (num_levels != 0)
     {
-      source_base_index = m * PALETTE_SIZE;
-      dest_base_index = ((PALETTE_INDEX_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-
-      memcpy( &G_palette_data[3 * (dest_base_index + (n * num_shades))], 
-              &G_palette_data[3 * (source_base_index + (0 * num_shades))], 
-              3 * num_shades);
+      fprintf(stderr, "The number of levels cannot be set for -trim. Exiting...\n");
+      return 0;
     }
-  }
 
-  /* palettes 7-11: alternate rotations (preserving flesh tones) */
-  for (p = 1; p < num_rotations; p++)
-  {
-    for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
+    if (load_trim_assets(trim_list_filename))
     {
-      /* copy non-rotated hues from palette 0 */
-      source_base_index = m * PALETTE_SIZE;
-      dest_base_index = (((PALETTE_INDEX_ALTERNATE_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+      fprintf(stderr, "Error loading asset list. Exiting...\n");
+      return 0;
+    }
+
+    if (num_threads == 0)
+      num_threads = get_default_num_threads();
 
-      /* copying grey and the fixed hues on the left side */
-      memcpy( &G_palette_data[3 * dest_base_index], 
-              &G_palette_data[3 * source_base_index], 
-              3 * num_shades * (1 + fixed_hues_left));
+    if (run_trim(num_threads))
+    {
+      fprintf(stderr, "Error trimming texture. Exiting...\n");
+      clear_trim();
+      clear_palette();
+      free_palette_arena();
+      return 0;
+    }
 
-      /* copying the fixed hues on the right side */
-      memcpy( &G_palette_data[3 * (dest_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-              &G_palette_data[3 * (source_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-              3 * num_shades * fixed_hues_right);
+    fp_out = open_output_stream(trim_texture_filename, -1);
 
-      /* copy rotated hues from the original rotated palette */
-      source_base_index = (((PALETTE_INDEX_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-      dest_base_index = (((PALETTE_INDEX_ALTERNATE_ROTATE_60 + p - 1) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+    if (fp_out == NULL)
+      fprintf(stderr, "Unable to open trimmed texture file.\n");
+    else
+    {
+      if (write_trim_texture(fp_out))
+        fprintf(stderr, "Error writing trimmed texture.\n");
 
-      memcpy( &G_palette_data[3 * (dest_base_index + (1 + fixed_hues_left) * num_shades)], 
-              &G_palette_data[3 * (source_base_index + (1 + fixed_hues_left) * num_shades)], 
-              3 * num_shades * (num_hues - fixed_hues_left - fixed_hues_right));
+      if (close_output_stream(fp_out))
+        fprintf(stderr, "Error closing trimmed texture file.\n");
     }
-  }
 
-  /* palette 12: alternate greyscale (preserving flesh tones) */
-  for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
-  {
-    /* copy non-rotated hues from palette 0 */
-    source_base_index = m * PALETTE_SIZE;
-    dest_base_index = ((PALETTE_INDEX_ALTERNATE_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-
-    /* copying grey and the fixed hues on the left side */
-    memcpy( &G_palette_data[3 * dest_base_index], 
-            &G_palette_data[3 * source_base_index], 
-            3 * num_shades * (1 + fixed_hues_left));
-
-    /* copying the fixed hues on the right side */
-    memcpy( &G_palette_data[3 * (dest_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-            &G_palette_data[3 * (source_base_index + (1 + num_hues - fixed_hues_right) * num_shades)], 
-            3 * num_shades * fixed_hues_right);
-
-    /* copy greyscale hues from the original greyscale palette */
-    source_base_index = ((PALETTE_INDEX_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-    dest_base_index = ((PALETTE_INDEX_ALTERNATE_GREYSCALE * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
-
-    memcpy( &G_palette_data[3 * (dest_base_index + (1 + fixed_hues_left) * num_shades)], 
-            &G_palette_data[3 * (source_base_index + (1 + fixed_hues_left) * num_shades)], 
-            3 * num_shades * (num_hues - fixed_hues_left - fixed_hues_right));
-  }
+    fp_out = open_output_stream(trim_tables_filename, -1);
 
-  /* palettes 13-15: tints */
-  for (p = 0; p < num_tints; p++)
-  {
-    for (m = 0; m < PALETTE_LEVELS_PER_PALETTE; m++)
+    if (fp_out == NULL)
+      fprintf(stderr, "Unable to open remap table file.\n");
+    else
     {
-      for (n = 0; n < num_gradients; n++)
-      {
-        source_base_index = m * PALETTE_SIZE;
-        dest_base_index = (((PALETTE_INDEX_TINT_RED + p) * PALETTE_LEVELS_PER_PALETTE) + m) * PALETTE_SIZE;
+      if (write_trim_tables(fp_out))
+        fprintf(stderr, "Error writing remap table file.\n");
 
-        memcpy( &G_palette_data[3 * (dest_base_index + n * num_shades)], 
-                &G_palette_data[3 * (source_base_index + (tint_start_hue + p * tint_step) * num_shades)], 
-                3 * num_shades);
-      }
+      if (close_output_stream(fp_out))
+        fprintf(stderr, "Error closing remap table file.\n");
     }
-  }
-
-  #undef PALETTE_SIZE
 
-  #undef PALETTE_LEVELS_PER_PALETTE
-  #undef PALETTE_BASE_LEVEL
+    clear_trim();
+    clear_palette();
+    free_palette_arena();
 
-  return 0;
-}
+    return 0;
+  }
 
-/*******************************************************************************
-** write_tga_file()
-*******************************************************************************/
-short int write_tga_file(char* filename)
-{
-  FILE* fp_out;
+  /* write a single row (as a tga file with a height of 1) */
+  if (row_palette >= 0)
+  {
+    if ((output_filename != NULL) && (output_fd >= 0))
+    {
+      fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
+      return 0;
+    }
 
-  int   m;
-  int   n;
+    if (setup_palette_query_source(G_source, num_levels))
+    {
+      fprintf(stderr, "Error setting up row query. Exiting...\n");
+      return 0;
+    }
 
-  unsigned char image_id_field_length;
-  unsigned char color_map_type;
-  unsigned char image_type;
-  unsigned char image_descriptor;
+    if ((output_filename == NULL) && (output_fd < 0))
+    {
+      sprintf(row_filename, "%s_row_%d_%d.tga", get_palette_source_name(), row_palette, row_level);
+      output_filename = row_filename;
+    }
 
-  unsigned char color_map_specification[5];
+    fp_out = open_output_stream(output_filename, output_fd);
 
-  short int     x_origin;
-  short int     y_origin;
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open output stream. Exiting...\n");
+      clear_palette_query();
+      return 0;
+    }
 
-  short int     image_size;
+    if (write_palette_query_row(fp_out, row_palette, row_level))
+      fprintf(stderr, "Error writing row (the level may be out of range).\n");
 
-  unsigned char pixel_bpp;
-  short int     pixel_num_bytes;
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing output stream.\n");
 
-  unsigned char output_buffer[3];
+    clear_palette_query();
 
-  /* make sure filename is valid */
-  if (filename == NULL)
-  {
-    printf("Write TGA file failed: No filename specified.\n");
-    return 1;
+    return 0;
   }
 
-  /* initialize parameters */
-  image_id_field_length = 0;
-  color_map_type = 0;
-  image_type = 2;
-  image_descriptor = 0x20;
-
-  color_map_specification[0] = 0;
-  color_map_specification[1] = 0;
-  color_map_specification[2] = 0;
-  color_map_specification[3] = 0;
-  color_map_specification[4] = 0;
-
-  x_origin = 0;
-  y_origin = 0;
-
-  if (G_palette_size == 64)
-    image_size = 64;
-  else if (G_palette_size == 256)
-    image_size = 256;
-  else if (G_palette_size == 1024)
-    image_size = 1024;
-  else
+  /* encode the image (the index image & tile map go to their own files) */
+  if (encode_filename != NULL)
   {
-    printf("Write TGA file failed: Unknown source specified.\n");
-    return 1;
-  }
-
-  pixel_bpp = 24;
-  pixel_num_bytes = 3;
+    if (setup_encode_rows(G_source, num_levels))
+    {
+      fprintf(stderr, "Error setting up encoder. Exiting...\n");
+      return 0;
+    }
 
-  output_buffer[0] = 0;
-  output_buffer[1] = 0;
-  output_buffer[2] = 0;
+    if (num_threads == 0)
+      num_threads = get_default_num_threads();
 
-  /* open file */
-  fp_out = fopen(filename, "wb");
+    if (encode_tga_file(encode_filename, tile_size, num_threads))
+    {
+      fprintf(stderr, "Error encoding %s. Exiting...\n", encode_filename);
+      clear_encode();
+      return 0;
+    }
 
-  /* if file did not open, return error */
-  if (fp_out == NULL)
-  {
-    printf("Write TGA file failed: Unable to open output file.\n");
-    return 1;
-  }
+    fp_out = open_output_stream(encode_indices_filename, -1);
 
-  /* write image id field length */
-  if (fwrite(&image_id_field_length, 1, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open index file. Exiting...\n");
+      clear_encode();
+      return 0;
+    }
 
-  /* write colormap type */
-  if (fwrite(&color_map_type, 1, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    if (write_encode_indices(fp_out))
+      fprintf(stderr, "Error writing index file.\n");
 
-  /* write image type */
-  if (fwrite(&image_type, 1, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing index file.\n");
 
-  /* write colormap specification */
-  if (fwrite(color_map_specification, 1, 5, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    fp_out = open_output_stream(encode_tile_map_filename, -1);
 
-  /* write x origin */
-  if (fwrite(&x_origin, 2, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open tile map file. Exiting...\n");
+      clear_encode();
+      return 0;
+    }
 
-  /* write y origin */
-  if (fwrite(&y_origin, 2, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    if (write_encode_tile_map(fp_out))
+      fprintf(stderr, "Error writing tile map file.\n");
 
-  /* write image width */
-  if (fwrite(&image_size, 2, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing tile map file.\n");
 
-  /* write image height */
-  if (fwrite(&image_size, 2, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+    clear_encode();
 
-  /* write pixel bpp */
-  if (fwrite(&pixel_bpp, 1, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
+    return 0;
   }
 
-  /* write image descriptor */
-  if (fwrite(&image_descriptor, 1, 1, fp_out) < 1)
+  /* the full textures are square (use a spec file for other level counts) */
+  if (num_levels != 0)
   {
-    fclose(fp_out);
-    return 1;
+    fprintf(stderr, "The number of levels can only be set for -row & -encode. Exiting...\n");
+    return 0;
   }
 
-  /* write palette data */
-  if ((G_source == SOURCE_APPROX_NES) || 
-      (G_source == SOURCE_APPROX_NES_ROTATED))
-  {
-    for (n = 0; n < G_palette_size; n++)
-    {
-      for (m = 0; m < G_palette_size; m++)
-      {
-        /* if this is a transparency color, just write out magenta */
-        if (G_palette_data[4 * ((n * G_palette_size) + m) + 3] == 0)
-        {
-          output_buffer[2] = 255;
-          output_buffer[1] = 0;
-          output_buffer[0] = 255;
-        }
-        /* otherwise, write out this color */
-        else
-        {
-          output_buffer[2] = G_palette_data[4 * ((n * G_palette_size) + m) + 0];
-          output_buffer[1] = G_palette_data[4 * ((n * G_palette_size) + m) + 1];
-          output_buffer[0] = G_palette_data[4 * ((n * G_palette_size) + m) + 2];
-        }
-
-        if (fwrite(output_buffer, 1, 3, fp_out) < 1)
-        {
-          fclose(fp_out);
-          return 1;
-        }
-      }
-    }
-  }
-  else
+  /* generate the atlas, and write it with its uv file */
+  if (atlas_uv_filename != NULL)
   {
-    for (n = 0; n < G_palette_size; n++)
+    if ((output_filename != NULL) && (output_fd >= 0))
     {
-      for (m = 0; m < G_palette_size; m++)
-      {
-        output_buffer[2] = G_palette_data[3 * ((n * G_palette_size) + m) + 0];
-        output_buffer[1] = G_palette_data[3 * ((n * G_palette_size) + m) + 1];
-        output_buffer[0] = G_palette_data[3 * ((n * G_palette_size) + m) + 2];
-
-        if (fwrite(output_buffer, 1, 3, fp_out) < 1)
-        {
-          fclose(fp_out);
-          return 1;
-        }
-      }
+      fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
+      return 0;
     }
-  }
 
-  /* close file */
-  fclose(fp_out);
-
-  return 0;
-}
+    if (num_threads == 0)
+      num_threads = get_default_num_threads();
 
-/*******************************************************************************
-** main()
-*******************************************************************************/
-int main(int argc, char *argv[])
-{
-  int   i;
+    if (generate_atlas(num_threads))
+    {
+      fprintf(stderr, "Error generating atlas. Exiting...\n");
+      clear_atlas();
+      return 0;
+    }
 
-  char  output_tga_filename[64];
+    if ((output_filename == NULL) && (output_fd < 0))
+      output_filename = "atlas.tga";
 
-  /* initialization */
-  G_palette_data = NULL;
+    fp_out = open_output_stream(output_filename, output_fd);
 
-  G_source = SOURCE_APPROX_NES;
-  G_palette_size = 64;
+    if (fp_out == NULL)
+    {
+      fprintf(stderr, "Unable to open output stream. Exiting...\n");
+      clear_atlas();
+      return 0;
+    }
 
-  output_tga_filename[0] = '\0';
+    if (write_atlas_tga(fp_out))
+      fprintf(stderr, "Error writing atlas.\n");
 
-  /* generate voltage tables */
-  generate_voltage_tables();
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing output stream.\n");
 
-  /* read command line arguments */
-  i = 1;
+    fp_out = open_output_stream(atlas_uv_filename, -1);
 
-  while (i < argc)
-  {
-    /* source */
-    if (!strcmp(argv[i], "-s"))
+    if (fp_out == NULL)
     {
-      i++;
+      fprintf(stderr, "Unable to open uv file. Exiting...\n");
+      clear_atlas();
+      return 0;
+    }
 
-      if (i >= argc)
-      {
-        printf("Insufficient number of arguments. ");
-        printf("Expected source name. Exiting...\n");
-        return 0;
-      }
+    if (write_atlas_uv_file(fp_out))
+      fprintf(stderr, "Error writing uv file.\n");
 
-      if (!strcmp("approx_nes", argv[i]))
-        G_source = SOURCE_APPROX_NES;
-      else if (!strcmp("approx_nes_rotated", argv[i]))
-        G_source = SOURCE_APPROX_NES_ROTATED;
-      else if (!strcmp("composite_08", argv[i]))
-        G_source = SOURCE_COMPOSITE_08;
-      else if (!strcmp("composite_16", argv[i]))
-        G_source = SOURCE_COMPOSITE_16;
-      else if (!strcmp("composite_16_rotated", argv[i]))
-        G_source = SOURCE_COMPOSITE_16_ROTATED;
-      else if (!strcmp("composite_32", argv[i]))
-        G_source = SOURCE_COMPOSITE_32;
-      else
-      {
-        printf("Unknown source %s. Exiting...\n", argv[i]);
-        return 0;
-      }
+    if (close_output_stream(fp_out))
+      fprintf(stderr, "Error closing uv file.\n");
 
-      i++;
-    }
-    else
-    {
-      printf("Unknown command line argument %s. Exiting...\n", argv[i]);
-      return 0;
-    }
+    clear_atlas();
+
+    return 0;
   }
 
   /* set output filename */
@@ -1314,6 +1258,8 @@ int main(int argc, char *argv[])
     strncpy(output_tga_filename, "approx_nes.tga", 32);
   else if (G_source == SOURCE_APPROX_NES_ROTATED)
     strncpy(output_tga_filename, "approx_nes_rotated.tga", 32);
+  else if (G_source == SOURCE_NTSC_NES)
+    strncpy(output_tga_filename, "ntsc_nes.tga", 32);
   else if (G_source == SOURCE_COMPOSITE_08)
     strncpy(output_tga_filename, "composite_08.tga", 32);
   else if (G_source == SOURCE_COMPOSITE_16)
@@ -1324,103 +1270,89 @@ int main(int argc, char *argv[])
     strncpy(output_tga_filename, "composite_32.tga", 32);
   else
   {
-    printf("Unable to set output filename: Unknown source. Exiting...\n");
+    fprintf(stderr, "Unable to set output filename: Unknown source. Exiting...\n");
     return 0;
   }
 
-  /* set palette size */
-  if ((G_source == SOURCE_APPROX_NES) || 
-      (G_source == SOURCE_APPROX_NES_ROTATED))
-  {
-    G_palette_size = 64;
-  }
-  else if ( (G_source == SOURCE_COMPOSITE_08) || 
-            (G_source == SOURCE_COMPOSITE_16) || 
-            (G_source == SOURCE_COMPOSITE_16_ROTATED))
-  {
-    G_palette_size = 256;
-  }
-  else if (G_source == SOURCE_COMPOSITE_32)
-  {
-    G_palette_size = 1024;
-  }
-  else
-  {
-    printf("Unable to set palette size: Unknown source. Exiting...\n");
-    return 0;
-  }
+  if ((output_filename == NULL) && (output_fd < 0) && (G_num_output_files == 0))
+    output_filename = output_tga_filename;
 
-  /* set voltage table pointers */
-  if (set_voltage_table_pointers())
+  if ((output_filename != NULL) && (output_fd >= 0))
   {
-    printf("Error setting voltage table pointers. Exiting...\n");
+    fprintf(stderr, "Cannot specify both an output filename and a file descriptor. Exiting...\n");
     return 0;
   }
 
-  /* generate palette */
-  if (G_source == SOURCE_APPROX_NES)
-  {
-    if (generate_palette_approx_nes(0))
-    {
-      printf("Error generating texture. Exiting...\n");
-      return 0;
-    }
-  }
-  else if (G_source == SOURCE_APPROX_NES_ROTATED)
-  {
-    if (generate_palette_approx_nes(1))
-    {
-      printf("Error generating texture. Exiting...\n");
-      return 0;
-    }
-  }
-  else if (G_source == SOURCE_COMPOSITE_08)
+  /* generate palette once, and write all requested outputs */
+  if (G_num_output_files > 0)
   {
-    if (generate_palette_256_color(PALETTE_MODE_DOUBLED))
+    if (mapped_flag)
     {
-      printf("Error generating texture. Exiting...\n");
+      fprintf(stderr, "Memory-mapped output cannot be combined with -f. Exiting...\n");
       return 0;
     }
-  }
-  else if (G_source == SOURCE_COMPOSITE_16)
-  {
-    if (generate_palette_256_color(PALETTE_MODE_STANDARD))
+
+    /* the -o / -fd output (if any) is written as a tga file */
+    if ((output_filename != NULL) || (output_fd >= 0))
     {
-      printf("Error generating texture. Exiting...\n");
-      return 0;
+      if (add_output_file(OUTPUT_FORMAT_TGA, output_filename, output_fd))
+        return 0;
     }
-  }
-  else if (G_source == SOURCE_COMPOSITE_16_ROTATED)
-  {
-    if (generate_palette_256_color(PALETTE_MODE_ROTATED))
+
+    if (generate_palette())
     {
-      printf("Error generating texture. Exiting...\n");
+      fprintf(stderr, "Error generating texture. Exiting...\n");
+      clear_palette();
+      free_palette_arena();
       return 0;
     }
+
+    write_output_files();
+
+    clear_palette();
+    free_palette_arena();
+
+    return 0;
   }
-  else if (G_source == SOURCE_COMPOSITE_32)
+
+  /* generate palette directly into the mapped output file */
+  if (mapped_flag)
   {
-    if (generate_palette_1024_color())
+    if ((output_filename != NULL) && (!strcmp(output_filename, "-")))
     {
-      printf("Error generating texture. Exiting...\n");
+      fprintf(stderr, "Memory-mapped output cannot be written to standard output. Exiting...\n");
       return 0;
     }
+
+    if (generate_mapped_tga_file(output_filename, output_fd))
+      fprintf(stderr, "Error writing TGA file.\n");
+
+    clear_palette();
+    free_palette_arena();
+
+    return 0;
   }
-  else
+
+  /* open output stream */
+  fp_out = open_output_stream(output_filename, output_fd);
+
+  if (fp_out == NULL)
   {
-    printf("Unable to generate texture: Invalid source. Exiting...\n");
+    fprintf(stderr, "Unable to open output stream. Exiting...\n");
     return 0;
   }
 
-  /* write output tga file */
-  write_tga_file(output_tga_filename);
+  /* generate palette & write output tga file */
+  if (generate_and_write_tga_file(fp_out))
+    fprintf(stderr, "Error writing TGA file.\n");
+
+  /* close output stream */
+  if (close_output_stream(fp_out))
+    fprintf(stderr, "Error closing output stream.\n");
 
   /* clear palette data */
-  if (G_palette_data != NULL)
-  {
-    free(G_palette_data);
-    G_palette_data = NULL;
-  }
+  clear_palette();
+  free_palette_arena();
 
   return 0;
 }
@@ -0,0 +1,122 @@
+/*******************************************************************************
+** mapped.c (memory-mapped output)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped.h"
+#include "palette.h"
+#include "tga.h"
+
+/*******************************************************************************
+** generate_mapped_tga_file()
+*******************************************************************************/
+short int generate_mapped_tga_file(char* filename, int fd)
+{
+  int   fd_out;
+
+  struct stat file_info;
+
+  size_t  file_size;
+
+  unsigned char* mapping;
+
+  short int status;
+
+  /* open output file (or use the inherited descriptor) */
+  if (fd >= 0)
+    fd_out = fd;
+  else if (filename != NULL)
+    fd_out = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  else
+    fd_out = -1;
+
+  if (fd_out < 0)
+  {
+    fprintf(stderr, "Write TGA file failed: Unable to open output file.\n");
+    return 1;
+  }
+
+  /* only regular files can be resized & mapped */
+  if ((fstat(fd_out, &file_info) < 0) || (!S_ISREG(file_info.st_mode)))
+  {
+    fprintf(stderr, "Write TGA file failed: Memory-mapped output requires a regular file.\n");
+
+    if (fd_out != fd)
+      close(fd_out);
+
+    return 1;
+  }
+
+  /* determine file size */
+  if (set_palette_size())
+  {
+    if (fd_out != fd)
+      close(fd_out);
+
+    return 1;
+  }
+
+  file_size = TGA_HEADER_SIZE + (size_t) 3 * G_palette_size * G_palette_size;
+
+  /* resize & map the file */
+  if (ftruncate(fd_out, (off_t) file_size) < 0)
+  {
+    fprintf(stderr, "Write TGA file failed: Unable to resize output file.\n");
+
+    if (fd_out != fd)
+      close(fd_out);
+
+    return 1;
+  }
+
+  mapping = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_out, 0);
+
+  if (mapping == MAP_FAILED)
+  {
+    fprintf(stderr, "Write TGA file failed: Unable to map output file.\n");
+
+    if (fd_out != fd)
+      close(fd_out);
+
+    return 1;
+  }
+
+  /* write header */
+  status = fill_tga_header(mapping);
+
+  /* generate the palette directly into the mapping, in file byte order */
+  if (!status)
+  {
+    G_palette_channel_order = PALETTE_CHANNEL_ORDER_BGR;
+
+    status = generate_palette_in_place(&mapping[TGA_HEADER_SIZE]);
+
+    G_palette_channel_order = PALETTE_CHANNEL_ORDER_RGB;
+
+    if (status)
+      fprintf(stderr, "Error generating texture.\n");
+  }
+
+  /* the approx nes sources are generated in their own buffer, */
+  /* so they are converted into the mapping afterwards         */
+  if ((!status) && (G_palette_data != &mapping[TGA_HEADER_SIZE]))
+    status = convert_tga_rows(&mapping[TGA_HEADER_SIZE], 0, G_palette_size);
+
+  /* unmapping commits the result to the file */
+  if (munmap(mapping, file_size) < 0)
+    status = 1;
+
+  if (fd_out != fd)
+  {
+    if (close(fd_out) < 0)
+      status = 1;
+  }
+
+  return status;
+}
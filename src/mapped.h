@@ -0,0 +1,11 @@
+/*******************************************************************************
+** mapped.h (memory-mapped output)
+*******************************************************************************/
+
+#ifndef MAPPED_H
+#define MAPPED_H
+
+/* function declarations */
+short int generate_mapped_tga_file(char* filename, int fd);
+
+#endif
@@ -0,0 +1,286 @@
+/*******************************************************************************
+** ntsc.c (ntsc composite signal simulation)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ntsc.h"
+#include "palette.h"
+#include "pool.h"
+
+/* each color is generated the way the nes ppu does it (see the "NTSC  */
+/* video" page on the nesdev wiki): the signal is a square wave, high  */
+/* during the 6 phases of the hue, between the low & high voltages of  */
+/* the luma (from the nes voltage tables: the luma +/- the saturation, */
+/* relative to black & white). hue 0 is always high, and hues 13-15    */
+/* are always low (hues 14 & 15 use the black level). the emphasis     */
+/* bits attenuate the signal during the phases of hues 12 (r), 4 (g)   */
+/* & 8 (b).                                                            */
+/*                                                                     */
+/* the signal is sampled (at the middle of each sample period) over    */
+/* one colorburst cycle, and demodulated: y is the average, and i & q  */
+/* are twice the average of the signal times the reference cosine &    */
+/* sine. the reference phase puts hue 1 at 0 degrees, and each hue is  */
+/* 30 degrees after the previous one (as in the approx nes sources).   */
+/* the samples are processed 4 at a time with sse2 (or with the        */
+/* equivalent scalar code, which sums the same 4 lanes).               */
+
+float S_ntsc_cos[NTSC_SAMPLES_PER_CYCLE];
+float S_ntsc_sin[NTSC_SAMPLES_PER_CYCLE];
+
+/* 1 during the phases of each hue, 0 otherwise */
+float S_ntsc_in_phase[NTSC_NUM_HUES][NTSC_SAMPLES_PER_CYCLE];
+
+/* the emphasis is applied as a scale & an offset */
+float S_ntsc_emphasis_scale[NTSC_NUM_EMPHASIS][NTSC_SAMPLES_PER_CYCLE];
+float S_ntsc_emphasis_offset[NTSC_NUM_EMPHASIS][NTSC_SAMPLES_PER_CYCLE];
+
+unsigned char S_ntsc_colors[NTSC_NUM_EMPHASIS][NTSC_NUM_COLORS][3];
+
+/*******************************************************************************
+** generate_ntsc_tables()
+*******************************************************************************/
+short int generate_ntsc_tables()
+{
+  int   h;
+  int   e;
+  int   j;
+
+  float t;
+  int   attenuated;
+
+  for (j = 0; j < NTSC_SAMPLES_PER_CYCLE; j++)
+  {
+    /* sample time, in phases */
+    t = ((j + 0.5f) * NTSC_NUM_PHASES) / NTSC_SAMPLES_PER_CYCLE;
+
+    /* reference (hue 1 at 0 degrees) */
+    S_ntsc_cos[j] = (float) cos(TWO_PI * (2.0f - t) / NTSC_NUM_PHASES);
+    S_ntsc_sin[j] = (float) sin(TWO_PI * (2.0f - t) / NTSC_NUM_PHASES);
+
+    for (h = 0; h < NTSC_NUM_HUES; h++)
+    {
+      if (fmod(t + h, NTSC_NUM_PHASES) < NTSC_NUM_PHASES / 2)
+        S_ntsc_in_phase[h][j] = 1.0f;
+      else
+        S_ntsc_in_phase[h][j] = 0.0f;
+    }
+
+    for (e = 0; e < NTSC_NUM_EMPHASIS; e++)
+    {
+      attenuated = ((e & 1) && (S_ntsc_in_phase[12][j] != 0.0f)) ||
+                   ((e & 2) && (S_ntsc_in_phase[4][j] != 0.0f)) ||
+                   ((e & 4) && (S_ntsc_in_phase[8][j] != 0.0f));
+
+      if (attenuated)
+      {
+        S_ntsc_emphasis_scale[e][j] = NTSC_ATTENUATION;
+        S_ntsc_emphasis_offset[e][j] = (NTSC_ATTENUATION - 1.0f) * NTSC_BLACK_LEVEL;
+      }
+      else
+      {
+        S_ntsc_emphasis_scale[e][j] = 1.0f;
+        S_ntsc_emphasis_offset[e][j] = 0.0f;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** simulate_ntsc_color()
+*******************************************************************************/
+short int simulate_ntsc_color(int emphasis, int color, unsigned char* rgb)
+{
+  float*  luma_table;
+  float*  saturation_table;
+  int     table_length;
+
+  float*  in_phase;
+  float*  scale;
+  float*  offset;
+
+  float low;
+  float high;
+
+  float sums[3][4];
+
+  float y;
+  float i;
+  float q;
+
+  int   value[3];
+
+  int   luma;
+  int   hue;
+
+  int   j;
+  int   k;
+
+#ifdef __SSE2__
+  __m128  s;
+  __m128  y_sum;
+  __m128  i_sum;
+  __m128  q_sum;
+#else
+  float   s;
+#endif
+
+  if ((emphasis < 0) || (emphasis >= NTSC_NUM_EMPHASIS) ||
+      (color < 0) || (color >= NTSC_NUM_COLORS) || (rgb == NULL))
+  {
+    return 1;
+  }
+
+  if (get_source_voltage_tables(SOURCE_NTSC_NES, &luma_table, &saturation_table, &table_length))
+    return 1;
+
+  luma = color / NTSC_NUM_HUES;
+  hue = color % NTSC_NUM_HUES;
+
+  /* hues 14 & 15 are black */
+  if (hue >= 14)
+    luma = 1;
+
+  low = luma_table[luma] - saturation_table[luma];
+  high = luma_table[luma] + saturation_table[luma];
+
+  if (hue == 0)
+    low = high;
+  else if (hue >= 13)
+    high = low;
+
+  in_phase = S_ntsc_in_phase[hue];
+  scale = S_ntsc_emphasis_scale[emphasis];
+  offset = S_ntsc_emphasis_offset[emphasis];
+
+  /* sample & demodulate (4 samples at a time) */
+#ifdef __SSE2__
+  y_sum = _mm_setzero_ps();
+  i_sum = _mm_setzero_ps();
+  q_sum = _mm_setzero_ps();
+
+  for (j = 0; j < NTSC_SAMPLES_PER_CYCLE; j += 4)
+  {
+    s = _mm_add_ps(_mm_set1_ps(low), _mm_mul_ps(_mm_set1_ps(high - low), _mm_loadu_ps(&in_phase[j])));
+    s = _mm_add_ps(_mm_mul_ps(s, _mm_loadu_ps(&scale[j])), _mm_loadu_ps(&offset[j]));
+
+    y_sum = _mm_add_ps(y_sum, s);
+    i_sum = _mm_add_ps(i_sum, _mm_mul_ps(s, _mm_loadu_ps(&S_ntsc_cos[j])));
+    q_sum = _mm_add_ps(q_sum, _mm_mul_ps(s, _mm_loadu_ps(&S_ntsc_sin[j])));
+  }
+
+  _mm_storeu_ps(sums[0], y_sum);
+  _mm_storeu_ps(sums[1], i_sum);
+  _mm_storeu_ps(sums[2], q_sum);
+#else
+  for (k = 0; k < 4; k++)
+  {
+    sums[0][k] = 0.0f;
+    sums[1][k] = 0.0f;
+    sums[2][k] = 0.0f;
+  }
+
+  for (j = 0; j < NTSC_SAMPLES_PER_CYCLE; j += 4)
+  {
+    for (k = 0; k < 4; k++)
+    {
+      s = low + (high - low) * in_phase[j + k];
+      s = s * scale[j + k] + offset[j + k];
+
+      sums[0][k] += s;
+      sums[1][k] += s * S_ntsc_cos[j + k];
+      sums[2][k] += s * S_ntsc_sin[j + k];
+    }
+  }
+#endif
+
+  y = ((sums[0][0] + sums[0][1]) + (sums[0][2] + sums[0][3])) / NTSC_SAMPLES_PER_CYCLE;
+  i = ((sums[1][0] + sums[1][1]) + (sums[1][2] + sums[1][3])) * 2.0f / NTSC_SAMPLES_PER_CYCLE;
+  q = ((sums[2][0] + sums[2][1]) + (sums[2][2] + sums[2][3])) * 2.0f / NTSC_SAMPLES_PER_CYCLE;
+
+  /* convert to rgb (as in the approx nes sources) */
+  value[0] = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
+  value[1] = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
+  value[2] = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
+
+  for (k = 0; k < 3; k++)
+  {
+    if (value[k] < 0)
+      rgb[k] = 0;
+    else if (value[k] > 255)
+      rgb[k] = 255;
+    else
+      rgb[k] = value[k];
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** ntsc_task()
+*******************************************************************************/
+void ntsc_task(int worker, long index, void* arg)
+{
+  int   e;
+  int   m;
+
+  (void) worker;
+  (void) arg;
+
+  /* each task is one hue, at every luma & emphasis */
+  for (e = 0; e < NTSC_NUM_EMPHASIS; e++)
+  {
+    for (m = 0; m < NTSC_NUM_LUMAS; m++)
+    {
+      simulate_ntsc_color(e, m * NTSC_NUM_HUES + (int) index,
+                          S_ntsc_colors[e][m * NTSC_NUM_HUES + index]);
+    }
+  }
+}
+
+/*******************************************************************************
+** generate_ntsc_colors()
+*******************************************************************************/
+short int generate_ntsc_colors(int num_threads)
+{
+  return run_pool_tasks(num_threads, NTSC_NUM_HUES, ntsc_task, NULL);
+}
+
+/*******************************************************************************
+** get_ntsc_level_color()
+*******************************************************************************/
+int get_ntsc_level_color(int color, int level)
+{
+  int   luma;
+  int   hue;
+
+  /* each lighting level moves the luma up or down by one */
+  hue = color % NTSC_NUM_HUES;
+  luma = color / NTSC_NUM_HUES + level - NTSC_BASE_LEVEL;
+
+  if (hue >= 14)
+    return color;
+  else if (luma < 0)
+    return NTSC_COLOR_BLACK;
+  else if (luma >= NTSC_NUM_LUMAS)
+    return NTSC_COLOR_WHITE;
+  else
+    return luma * NTSC_NUM_HUES + hue;
+}
+
+/*******************************************************************************
+** get_ntsc_color()
+*******************************************************************************/
+unsigned char* get_ntsc_color(int emphasis, int color)
+{
+  return S_ntsc_colors[emphasis][color];
+}
@@ -0,0 +1,45 @@
+/*******************************************************************************
+** ntsc.h (ntsc composite signal simulation)
+*******************************************************************************/
+
+#ifndef NTSC_H
+#define NTSC_H
+
+/* the nes ppu outputs each color as a square wave between two */
+/* voltages, switching on 12 phases of the colorburst cycle    */
+#define NTSC_NUM_PHASES 12
+
+/* the signal is sampled at 4 times that rate */
+#define NTSC_SAMPLES_PER_CYCLE (4 * NTSC_NUM_PHASES)
+
+/* 64 colors (4 lumas of 16 hues), for each of the */
+/* 8 combinations of the emphasis bits (r, g, b)   */
+#define NTSC_NUM_LUMAS    4
+#define NTSC_NUM_HUES     16
+#define NTSC_NUM_COLORS   (NTSC_NUM_LUMAS * NTSC_NUM_HUES)
+#define NTSC_NUM_EMPHASIS 8
+
+/* the texture has one band of 8 lighting levels per emphasis */
+#define NTSC_NUM_LEVELS   8
+#define NTSC_BASE_LEVEL   4
+
+/* colors 0x0F (black) & 0x30 (white) */
+#define NTSC_COLOR_BLACK  0x0F
+#define NTSC_COLOR_WHITE  0x30
+
+/* the emphasis bits attenuate the signal during 6 of the phases:  */
+/* the voltage is scaled, so relative to black & white the signal  */
+/* is scaled and offset by the black level (0.518 v, with white at */
+/* 1.962 v, so the offset is 0.518 / (1.962 - 0.518) of the range) */
+#define NTSC_ATTENUATION  0.746f
+#define NTSC_BLACK_LEVEL  0.358726f
+
+/* function declarations */
+short int generate_ntsc_tables();
+short int simulate_ntsc_color(int emphasis, int color, unsigned char* rgb);
+short int generate_ntsc_colors(int num_threads);
+
+int             get_ntsc_level_color(int color, int level);
+unsigned char*  get_ntsc_color(int emphasis, int color);
+
+#endif
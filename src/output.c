@@ -0,0 +1,390 @@
+/*******************************************************************************
+** output.c (output formats & fan-out writer)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "container.h"
+#include "linear.h"
+#include "output.h"
+#include "packed.h"
+#include "palette.h"
+#include "tga.h"
+#include "ubo.h"
+
+output_file G_output_files[OUTPUT_MAX_FILES];
+int         G_num_output_files;
+
+/*******************************************************************************
+** get_output_format()
+*******************************************************************************/
+int get_output_format(char* name)
+{
+  if (name == NULL)
+    return -1;
+
+  if (!strcmp("tga", name))
+    return OUTPUT_FORMAT_TGA;
+  else if (!strcmp("bin", name))
+    return OUTPUT_FORMAT_BIN;
+  else if (!strcmp("header", name))
+    return OUTPUT_FORMAT_HEADER;
+  else if (!strcmp("indexed", name))
+    return OUTPUT_FORMAT_INDEXED;
+  else if (!strcmp("ktx2", name))
+    return OUTPUT_FORMAT_KTX2;
+  else if (!strcmp("dds", name))
+    return OUTPUT_FORMAT_DDS;
+  else if (!strcmp("rgb565", name))
+    return OUTPUT_FORMAT_RGB565;
+  else if (!strcmp("rgba5551", name))
+    return OUTPUT_FORMAT_RGBA5551;
+  else if (!strcmp("rgba4444", name))
+    return OUTPUT_FORMAT_RGBA4444;
+  else if (!strcmp("rgba16f", name))
+    return OUTPUT_FORMAT_RGBA16F;
+  else if (!strcmp("rgba32f", name))
+    return OUTPUT_FORMAT_RGBA32F;
+  else if (!strcmp("ubo", name))
+    return OUTPUT_FORMAT_UBO;
+  else if (!strcmp("ubo_f32", name))
+    return OUTPUT_FORMAT_UBO_F32;
+  else if (!strcmp("ubo_header", name))
+    return OUTPUT_FORMAT_UBO_HEADER;
+  else
+    return -1;
+}
+
+/*******************************************************************************
+** add_output_file()
+*******************************************************************************/
+short int add_output_file(int format, char* filename, int fd)
+{
+  int k;
+
+  if ((format < 0) || (format >= OUTPUT_NUM_FORMATS))
+    return 1;
+
+  if (G_num_output_files >= OUTPUT_MAX_FILES)
+  {
+    fprintf(stderr, "Cannot add output file; at most %d outputs are allowed.\n", OUTPUT_MAX_FILES);
+    return 1;
+  }
+
+  /* standard output can only be used once */
+  if ((filename != NULL) && (!strcmp(filename, "-")))
+  {
+    for (k = 0; k < G_num_output_files; k++)
+    {
+      if ((G_output_files[k].filename != NULL) &&
+          (!strcmp(G_output_files[k].filename, "-")))
+      {
+        fprintf(stderr, "Cannot add output file; standard output is already in use.\n");
+        return 1;
+      }
+    }
+  }
+
+  G_output_files[G_num_output_files].format = format;
+  G_output_files[G_num_output_files].filename = filename;
+  G_output_files[G_num_output_files].fd = fd;
+  G_output_files[G_num_output_files].status = 0;
+
+  G_num_output_files += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_bin_file()
+*******************************************************************************/
+short int write_bin_file(FILE* fp_out)
+{
+  int bytes_per_row;
+
+  if (fp_out == NULL)
+    return 1;
+
+  /* the raw data is written as generated (rgb, or rgba for approx nes) */
+  bytes_per_row = get_palette_bytes_per_pixel() * G_palette_size;
+
+  if (fwrite(G_palette_data, bytes_per_row, G_palette_size, fp_out) < (size_t) G_palette_size)
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_header_file()
+*******************************************************************************/
+short int write_header_file(FILE* fp_out)
+{
+  char* source_name;
+  char  upper_name[32];
+
+  int   bytes_per_pixel;
+  long  num_bytes;
+
+  char  line[OUTPUT_HEADER_BYTES_PER_LINE * 6 + 4];
+  int   line_length;
+
+  long  k;
+  int   n;
+
+  char  hex_digits[] = "0123456789abcdef";
+
+  if (fp_out == NULL)
+    return 1;
+
+  source_name = get_palette_source_name();
+
+  if (source_name == NULL)
+    return 1;
+
+  for (n = 0; (source_name[n] != '\0') && (n < 31); n++)
+    upper_name[n] = toupper((unsigned char) source_name[n]);
+
+  upper_name[n] = '\0';
+
+  bytes_per_pixel = get_palette_bytes_per_pixel();
+  num_bytes = (long) bytes_per_pixel * G_palette_size * G_palette_size;
+
+  /* write declarations */
+  fprintf(fp_out, "/* %s.h (generated by texture) */\n\n", source_name);
+  fprintf(fp_out, "#ifndef %s_H\n", upper_name);
+  fprintf(fp_out, "#define %s_H\n\n", upper_name);
+  fprintf(fp_out, "#define %s_WIDTH           %d\n", upper_name, G_palette_size);
+  fprintf(fp_out, "#define %s_HEIGHT          %d\n", upper_name, G_palette_size);
+  fprintf(fp_out, "#define %s_BYTES_PER_PIXEL %d\n\n", upper_name, bytes_per_pixel);
+  fprintf(fp_out, "static const unsigned char %s_data[%ld] =\n{\n", source_name, num_bytes);
+
+  /* write data, formatting each line by hand */
+  for (k = 0; k < num_bytes; k += OUTPUT_HEADER_BYTES_PER_LINE)
+  {
+    line_length = 0;
+
+    line[line_length++] = ' ';
+    line[line_length++] = ' ';
+
+    for (n = 0; (n < OUTPUT_HEADER_BYTES_PER_LINE) && (k + n < num_bytes); n++)
+    {
+      line[line_length++] = '0';
+      line[line_length++] = 'x';
+      line[line_length++] = hex_digits[(G_palette_data[k + n] >> 4) & 0x0F];
+      line[line_length++] = hex_digits[G_palette_data[k + n] & 0x0F];
+
+      if (k + n + 1 < num_bytes)
+        line[line_length++] = ',';
+
+      line[line_length++] = ' ';
+    }
+
+    line[line_length - 1] = '\n';
+
+    if (fwrite(line, 1, line_length, fp_out) < (size_t) line_length)
+      return 1;
+  }
+
+  fprintf(fp_out, "};\n\n#endif\n");
+
+  if (ferror(fp_out))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** output_writer_thread()
+*******************************************************************************/
+void* output_writer_thread(void* arg)
+{
+  output_file*  out;
+  FILE*         fp_out;
+
+  out = (output_file*) arg;
+
+  fp_out = open_output_stream(out->filename, out->fd);
+
+  if (fp_out == NULL)
+  {
+    fprintf(stderr, "Unable to open output stream for %s.\n",
+            (out->filename != NULL) ? out->filename : "file descriptor");
+    out->status = 1;
+    return NULL;
+  }
+
+  /* each back-end only reads the palette data */
+  if (out->format == OUTPUT_FORMAT_TGA)
+    out->status = write_tga_file(fp_out);
+  else if (out->format == OUTPUT_FORMAT_BIN)
+    out->status = write_bin_file(fp_out);
+  else if (out->format == OUTPUT_FORMAT_HEADER)
+    out->status = write_header_file(fp_out);
+  else if (out->format == OUTPUT_FORMAT_INDEXED)
+    out->status = write_tga_file_indexed(fp_out);
+  else if (out->format == OUTPUT_FORMAT_KTX2)
+    out->status = write_ktx2_file(fp_out);
+  else if (out->format == OUTPUT_FORMAT_DDS)
+    out->status = write_dds_file(fp_out);
+  else if (out->format == OUTPUT_FORMAT_RGB565)
+    out->status = write_packed_file(fp_out, PACKED_FORMAT_RGB565);
+  else if (out->format == OUTPUT_FORMAT_RGBA5551)
+    out->status = write_packed_file(fp_out, PACKED_FORMAT_RGBA5551);
+  else if (out->format == OUTPUT_FORMAT_RGBA4444)
+    out->status = write_packed_file(fp_out, PACKED_FORMAT_RGBA4444);
+  else if (out->format == OUTPUT_FORMAT_RGBA16F)
+    out->status = write_linear_file(fp_out, LINEAR_FORMAT_F16);
+  else if (out->format == OUTPUT_FORMAT_RGBA32F)
+    out->status = write_linear_file(fp_out, LINEAR_FORMAT_F32);
+  else if (out->format == OUTPUT_FORMAT_UBO)
+    out->status = write_ubo_file(fp_out, UBO_FORMAT_RGBA8);
+  else if (out->format == OUTPUT_FORMAT_UBO_F32)
+    out->status = write_ubo_file(fp_out, UBO_FORMAT_F32);
+  else if (out->format == OUTPUT_FORMAT_UBO_HEADER)
+    out->status = write_ubo_header_file(fp_out);
+  else
+    out->status = 1;
+
+  if (close_output_stream(fp_out))
+    out->status = 1;
+
+  return NULL;
+}
+
+/*******************************************************************************
+** write_output_files()
+*******************************************************************************/
+short int write_output_files()
+{
+  pthread_t threads[OUTPUT_MAX_FILES];
+  int       started[OUTPUT_MAX_FILES];
+
+  int       k;
+  int       linear_flag;
+  int       ubo_flag;
+
+  int       packed_flags[PACKED_NUM_FORMATS];
+  int       format;
+
+  short int status;
+
+  /* the palette data is generated once, and then */
+  /* shared (read only) by all of the back-ends   */
+  if (G_palette_data == NULL)
+    return 1;
+
+  /* the packed outputs share one quantization report per format, */
+  /* printed here so that it is not repeated by the writer threads */
+  for (format = 0; format < PACKED_NUM_FORMATS; format++)
+    packed_flags[format] = 0;
+
+  for (k = 0; k < G_num_output_files; k++)
+  {
+    if (G_output_files[k].format == OUTPUT_FORMAT_RGB565)
+      packed_flags[PACKED_FORMAT_RGB565] = 1;
+    else if (G_output_files[k].format == OUTPUT_FORMAT_RGBA5551)
+      packed_flags[PACKED_FORMAT_RGBA5551] = 1;
+    else if (G_output_files[k].format == OUTPUT_FORMAT_RGBA4444)
+      packed_flags[PACKED_FORMAT_RGBA4444] = 1;
+    else if ( ((G_output_files[k].format == OUTPUT_FORMAT_KTX2) ||
+               (G_output_files[k].format == OUTPUT_FORMAT_DDS)) &&
+              (get_container_packed_format() >= 0))
+    {
+      packed_flags[get_container_packed_format()] = 1;
+    }
+  }
+
+  for (format = 0; format < PACKED_NUM_FORMATS; format++)
+  {
+    if (packed_flags[format] && report_packed_quantization(format))
+    {
+      fprintf(stderr, "Unable to report the packed quantization.\n");
+      return 1;
+    }
+  }
+
+  /* the float outputs share the linear palette */
+  linear_flag = 0;
+
+  for (k = 0; k < G_num_output_files; k++)
+  {
+    if ((G_output_files[k].format == OUTPUT_FORMAT_RGBA16F) ||
+        (G_output_files[k].format == OUTPUT_FORMAT_RGBA32F))
+    {
+      linear_flag = 1;
+    }
+    else if ( ((G_output_files[k].format == OUTPUT_FORMAT_KTX2) ||
+               (G_output_files[k].format == OUTPUT_FORMAT_DDS)) &&
+              (get_container_linear_format() >= 0))
+    {
+      linear_flag = 1;
+    }
+  }
+
+  if (linear_flag && setup_linear_palette())
+  {
+    fprintf(stderr, "Unable to set up the linear palette.\n");
+    return 1;
+  }
+
+  /* the uniform buffer outputs share the selected rows */
+  ubo_flag = 0;
+
+  for (k = 0; k < G_num_output_files; k++)
+  {
+    if ((G_output_files[k].format == OUTPUT_FORMAT_UBO)     ||
+        (G_output_files[k].format == OUTPUT_FORMAT_UBO_F32) ||
+        (G_output_files[k].format == OUTPUT_FORMAT_UBO_HEADER))
+    {
+      ubo_flag = 1;
+    }
+  }
+
+  if (ubo_flag && setup_ubo_rows(G_ubo_selection))
+  {
+    if (linear_flag)
+      clear_linear_palette();
+
+    return 1;
+  }
+
+  for (k = 0; k < G_num_output_files; k++)
+  {
+    G_output_files[k].status = 0;
+
+    if (pthread_create(&threads[k], NULL, output_writer_thread, &G_output_files[k]))
+    {
+      /* if a thread cannot be started, write this output here */
+      output_writer_thread(&G_output_files[k]);
+      started[k] = 0;
+    }
+    else
+      started[k] = 1;
+  }
+
+  status = 0;
+
+  for (k = 0; k < G_num_output_files; k++)
+  {
+    if (started[k])
+      pthread_join(threads[k], NULL);
+
+    if (G_output_files[k].status)
+    {
+      fprintf(stderr, "Error writing output %d.\n", k + 1);
+      status = 1;
+    }
+  }
+
+  if (linear_flag)
+    clear_linear_palette();
+
+  if (ubo_flag)
+    clear_ubo_rows();
+
+  return status;
+}
@@ -0,0 +1,55 @@
+/*******************************************************************************
+** output.h (output formats & fan-out writer)
+*******************************************************************************/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+
+enum
+{
+  OUTPUT_FORMAT_TGA = 0,
+  OUTPUT_FORMAT_BIN,
+  OUTPUT_FORMAT_HEADER,
+  OUTPUT_FORMAT_INDEXED,
+  OUTPUT_FORMAT_KTX2,
+  OUTPUT_FORMAT_DDS,
+  OUTPUT_FORMAT_RGB565,
+  OUTPUT_FORMAT_RGBA5551,
+  OUTPUT_FORMAT_RGBA4444,
+  OUTPUT_FORMAT_RGBA16F,
+  OUTPUT_FORMAT_RGBA32F,
+  OUTPUT_FORMAT_UBO,
+  OUTPUT_FORMAT_UBO_F32,
+  OUTPUT_FORMAT_UBO_HEADER,
+  OUTPUT_NUM_FORMATS
+};
+
+#define OUTPUT_MAX_FILES 16
+
+#define OUTPUT_HEADER_BYTES_PER_LINE 16
+
+typedef struct output_file
+{
+  int       format;
+
+  char*     filename;
+  int       fd;
+
+  short int status;
+} output_file;
+
+extern output_file  G_output_files[OUTPUT_MAX_FILES];
+extern int          G_num_output_files;
+
+/* function declarations */
+int       get_output_format(char* name);
+short int add_output_file(int format, char* filename, int fd);
+
+short int write_bin_file(FILE* fp_out);
+short int write_header_file(FILE* fp_out);
+
+short int write_output_files();
+
+#endif
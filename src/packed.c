@@ -0,0 +1,432 @@
+/*******************************************************************************
+** packed.c (packed 16 bit pixel formats)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "packed.h"
+#include "palette.h"
+
+/* each channel is rounded to the nearest n bit value: (c * max + 127) / 255 */
+/* the sse2 kernel divides by 255 with (t + 1 + (t >> 8)) >> 8, which is    */
+/* exact for the values that occur here, so both versions give the same     */
+/* results. the kernel packs 8 pixels at a time from rgba rows.             */
+
+/*******************************************************************************
+** get_packed_format_name()
+*******************************************************************************/
+char* get_packed_format_name(int format)
+{
+  if (format == PACKED_FORMAT_RGB565)
+    return "rgb565";
+  else if (format == PACKED_FORMAT_RGBA5551)
+    return "rgba5551";
+  else if (format == PACKED_FORMAT_RGBA4444)
+    return "rgba4444";
+  else
+    return NULL;
+}
+
+/*******************************************************************************
+** expand_packed_source_row()
+*******************************************************************************/
+short int expand_packed_source_row( unsigned char* rgba, unsigned char* source,
+                                    int num_pixels)
+{
+  int bytes_per_pixel;
+  int k;
+
+  if ((rgba == NULL) || (source == NULL))
+    return 1;
+
+  /* the palette data is rgb (or bgr), or rgba for approx nes */
+  bytes_per_pixel = get_palette_bytes_per_pixel();
+
+  for (k = 0; k < num_pixels; k++)
+  {
+    if (G_palette_channel_order == PALETTE_CHANNEL_ORDER_BGR)
+    {
+      rgba[4 * k + 0] = source[bytes_per_pixel * k + 2];
+      rgba[4 * k + 1] = source[bytes_per_pixel * k + 1];
+      rgba[4 * k + 2] = source[bytes_per_pixel * k + 0];
+    }
+    else
+    {
+      rgba[4 * k + 0] = source[bytes_per_pixel * k + 0];
+      rgba[4 * k + 1] = source[bytes_per_pixel * k + 1];
+      rgba[4 * k + 2] = source[bytes_per_pixel * k + 2];
+    }
+
+    if (bytes_per_pixel == 4)
+      rgba[4 * k + 3] = source[bytes_per_pixel * k + 3];
+    else
+      rgba[4 * k + 3] = 255;
+  }
+
+  return 0;
+}
+
+#ifdef __SSE2__
+/*******************************************************************************
+** quantize_packed_channels()
+*******************************************************************************/
+__m128i quantize_packed_channels(__m128i c, int max)
+{
+  __m128i t;
+
+  /* the channels are in the low half of each 32 bit lane */
+  t = _mm_add_epi32(_mm_mullo_epi16(c, _mm_set1_epi32(max)), _mm_set1_epi32(127));
+
+  return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(t, _mm_set1_epi32(1)), _mm_srli_epi32(t, 8)), 8);
+}
+
+/*******************************************************************************
+** pack_pixels_4()
+*******************************************************************************/
+__m128i pack_pixels_4(__m128i v, int format)
+{
+  __m128i mask;
+
+  __m128i r;
+  __m128i g;
+  __m128i b;
+  __m128i a;
+
+  __m128i packed;
+
+  mask = _mm_set1_epi32(0xFF);
+
+  r = _mm_and_si128(v, mask);
+  g = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+  b = _mm_and_si128(_mm_srli_epi32(v, 16), mask);
+  a = _mm_srli_epi32(v, 24);
+
+  if (format == PACKED_FORMAT_RGBA5551)
+  {
+    packed = _mm_slli_epi32(quantize_packed_channels(r, 31), 11);
+    packed = _mm_or_si128(packed, _mm_slli_epi32(quantize_packed_channels(g, 31), 6));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(quantize_packed_channels(b, 31), 1));
+    packed = _mm_or_si128(packed, _mm_srli_epi32(a, 7));
+  }
+  else if (format == PACKED_FORMAT_RGBA4444)
+  {
+    packed = _mm_slli_epi32(quantize_packed_channels(r, 15), 12);
+    packed = _mm_or_si128(packed, _mm_slli_epi32(quantize_packed_channels(g, 15), 8));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(quantize_packed_channels(b, 15), 4));
+    packed = _mm_or_si128(packed, quantize_packed_channels(a, 15));
+  }
+  else
+  {
+    packed = _mm_slli_epi32(quantize_packed_channels(r, 31), 11);
+    packed = _mm_or_si128(packed, _mm_slli_epi32(quantize_packed_channels(g, 63), 5));
+    packed = _mm_or_si128(packed, quantize_packed_channels(b, 31));
+  }
+
+  /* sign extend, so the saturating pack keeps all 16 bits */
+  return _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+}
+#endif
+
+/*******************************************************************************
+** pack_pixels()
+*******************************************************************************/
+short int pack_pixels(unsigned char* packed, unsigned char* rgba,
+                      int num_pixels, int format)
+{
+  int k;
+
+  int r;
+  int g;
+  int b;
+  int a;
+
+  unsigned int value;
+
+  if ((packed == NULL) || (rgba == NULL))
+    return 1;
+
+  if ((format < 0) || (format >= PACKED_NUM_FORMATS))
+    return 1;
+
+  k = 0;
+
+#ifdef __SSE2__
+  for (; k + 8 <= num_pixels; k += 8)
+  {
+    _mm_storeu_si128( (__m128i*) &packed[2 * k],
+                      _mm_packs_epi32(pack_pixels_4(_mm_loadu_si128((__m128i*) &rgba[4 * k]), format),
+                                      pack_pixels_4(_mm_loadu_si128((__m128i*) &rgba[4 * k + 16]), format)));
+  }
+#endif
+
+  for (; k < num_pixels; k++)
+  {
+    r = rgba[4 * k + 0];
+    g = rgba[4 * k + 1];
+    b = rgba[4 * k + 2];
+    a = rgba[4 * k + 3];
+
+    if (format == PACKED_FORMAT_RGBA5551)
+    {
+      value = (((r * 31 + 127) / 255) << 11) | (((g * 31 + 127) / 255) << 6) |
+              (((b * 31 + 127) / 255) << 1) | (a >> 7);
+    }
+    else if (format == PACKED_FORMAT_RGBA4444)
+    {
+      value = (((r * 15 + 127) / 255) << 12) | (((g * 15 + 127) / 255) << 8) |
+              (((b * 15 + 127) / 255) << 4) | ((a * 15 + 127) / 255);
+    }
+    else
+    {
+      value = (((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) |
+              ((b * 31 + 127) / 255);
+    }
+
+    packed[2 * k + 0] = value & 0xFF;
+    packed[2 * k + 1] = (value >> 8) & 0xFF;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** unpack_pixel()
+*******************************************************************************/
+short int unpack_pixel(unsigned char* rgba, unsigned char* packed, int format)
+{
+  unsigned int value;
+
+  if ((rgba == NULL) || (packed == NULL))
+    return 1;
+
+  value = packed[0] | (packed[1] << 8);
+
+  if (format == PACKED_FORMAT_RGBA5551)
+  {
+    rgba[0] = (((value >> 11) & 0x1F) * 255 + 15) / 31;
+    rgba[1] = (((value >> 6) & 0x1F) * 255 + 15) / 31;
+    rgba[2] = (((value >> 1) & 0x1F) * 255 + 15) / 31;
+    rgba[3] = (value & 0x01) ? 255 : 0;
+  }
+  else if (format == PACKED_FORMAT_RGBA4444)
+  {
+    rgba[0] = ((value >> 12) & 0x0F) * 17;
+    rgba[1] = ((value >> 8) & 0x0F) * 17;
+    rgba[2] = ((value >> 4) & 0x0F) * 17;
+    rgba[3] = (value & 0x0F) * 17;
+  }
+  else if (format == PACKED_FORMAT_RGB565)
+  {
+    rgba[0] = (((value >> 11) & 0x1F) * 255 + 15) / 31;
+    rgba[1] = (((value >> 5) & 0x3F) * 255 + 31) / 63;
+    rgba[2] = ((value & 0x1F) * 255 + 15) / 31;
+    rgba[3] = 255;
+  }
+  else
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** report_packed_quantization()
+*******************************************************************************/
+short int report_packed_quantization(int format)
+{
+  unsigned char*  colors_in;
+  unsigned char*  colors_out;
+
+  unsigned char*  rgba;
+  unsigned char*  packed;
+  unsigned char   unpacked[4];
+
+  char  line[256];
+
+  long  num_colors_in;
+  long  num_colors_out;
+
+  long  num_transparent;
+  long  num_transparent_kept;
+
+  long  num_opaque;
+  long  error_sum;
+  int   max_errors[3];
+  int   error;
+
+  long  index;
+  int   value;
+
+  int   m;
+  int   n;
+  int   k;
+
+  if (G_palette_data == NULL)
+    return 1;
+
+  /* one bit per 24 bit color, and one bit per packed value */
+  colors_in = calloc(1 << 21, sizeof(unsigned char));
+  colors_out = calloc(1 << 13, sizeof(unsigned char));
+
+  rgba = malloc(sizeof(unsigned char) * 4 * G_palette_size);
+  packed = malloc(sizeof(unsigned char) * 2 * G_palette_size);
+
+  if ((colors_in == NULL) || (colors_out == NULL) || (rgba == NULL) || (packed == NULL))
+  {
+    if (colors_in != NULL)
+      free(colors_in);
+    if (colors_out != NULL)
+      free(colors_out);
+    if (rgba != NULL)
+      free(rgba);
+    if (packed != NULL)
+      free(packed);
+
+    return 1;
+  }
+
+  num_colors_in = 0;
+  num_colors_out = 0;
+
+  num_transparent = 0;
+  num_transparent_kept = 0;
+
+  num_opaque = 0;
+  error_sum = 0;
+
+  for (k = 0; k < 3; k++)
+    max_errors[k] = 0;
+
+  for (m = 0; m < G_palette_size; m++)
+  {
+    expand_packed_source_row( rgba,
+                              &G_palette_data[(long) get_palette_bytes_per_pixel() * m * G_palette_size],
+                              G_palette_size);
+
+    pack_pixels(packed, rgba, G_palette_size, format);
+
+    for (n = 0; n < G_palette_size; n++)
+    {
+      value = packed[2 * n] | (packed[2 * n + 1] << 8);
+
+      if (!(colors_out[value >> 3] & (1 << (value & 7))))
+      {
+        colors_out[value >> 3] |= 1 << (value & 7);
+        num_colors_out += 1;
+      }
+
+      unpack_pixel(unpacked, &packed[2 * n], format);
+
+      /* transparent pixels only need to stay transparent */
+      if (rgba[4 * n + 3] == 0)
+      {
+        num_transparent += 1;
+
+        if (unpacked[3] == 0)
+          num_transparent_kept += 1;
+
+        continue;
+      }
+
+      index = (rgba[4 * n + 0] << 16) | (rgba[4 * n + 1] << 8) | rgba[4 * n + 2];
+
+      if (!(colors_in[index >> 3] & (1 << (index & 7))))
+      {
+        colors_in[index >> 3] |= 1 << (index & 7);
+        num_colors_in += 1;
+      }
+
+      for (k = 0; k < 3; k++)
+      {
+        error = unpacked[k] - rgba[4 * n + k];
+
+        if (error < 0)
+          error = -error;
+
+        if (error > max_errors[k])
+          max_errors[k] = error;
+
+        error_sum += error;
+      }
+
+      num_opaque += 1;
+    }
+  }
+
+  if (num_transparent > 0)
+    num_colors_in += 1;
+
+  /* one line per report, so that reports never interleave */
+  n = sprintf(line, "Packed %s: %ld colors in, %ld values out, "
+                    "max error (r, g, b) %d %d %d, mean error %.2f",
+              get_packed_format_name(format), num_colors_in, num_colors_out,
+              max_errors[0], max_errors[1], max_errors[2],
+              (num_opaque > 0) ? (double) error_sum / (3 * num_opaque) : 0.0);
+
+  if (num_transparent > 0)
+    n += sprintf(&line[n], ", %ld of %ld transparent pixels kept", num_transparent_kept, num_transparent);
+
+  sprintf(&line[n], ".\n");
+  fputs(line, stderr);
+
+  free(colors_in);
+  free(colors_out);
+  free(rgba);
+  free(packed);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_packed_file()
+*******************************************************************************/
+short int write_packed_file(FILE* fp_out, int format)
+{
+  unsigned char*  rgba;
+  unsigned char*  packed;
+
+  int bytes_per_pixel;
+  int m;
+
+  if ((fp_out == NULL) || (G_palette_data == NULL))
+    return 1;
+
+  rgba = malloc(sizeof(unsigned char) * 4 * G_palette_size);
+  packed = malloc(sizeof(unsigned char) * 2 * G_palette_size);
+
+  if ((rgba == NULL) || (packed == NULL))
+  {
+    if (rgba != NULL)
+      free(rgba);
+    if (packed != NULL)
+      free(packed);
+
+    return 1;
+  }
+
+  bytes_per_pixel = get_palette_bytes_per_pixel();
+
+  /* raw packed pixels, top row first */
+  for (m = 0; m < G_palette_size; m++)
+  {
+    expand_packed_source_row(rgba, &G_palette_data[(long) bytes_per_pixel * m * G_palette_size], G_palette_size);
+    pack_pixels(packed, rgba, G_palette_size, format);
+
+    if (fwrite(packed, 2, G_palette_size, fp_out) < (size_t) G_palette_size)
+    {
+      free(rgba);
+      free(packed);
+      return 1;
+    }
+  }
+
+  free(rgba);
+  free(packed);
+
+  return 0;
+}
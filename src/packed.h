@@ -0,0 +1,35 @@
+/*******************************************************************************
+** packed.h (packed 16 bit pixel formats)
+*******************************************************************************/
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdio.h>
+
+/* the pixels are 16 bit little endian values, with red in the */
+/* high bits (the vulkan / opengl "pack16" layouts):           */
+/*   rgb565:   rrrrrggg gggbbbbb                               */
+/*   rgba5551: rrrrrggg ggbbbbba  (alpha set if at least 128)  */
+/*   rgba4444: rrrrgggg bbbbaaaa                               */
+enum
+{
+  PACKED_FORMAT_RGB565 = 0,
+  PACKED_FORMAT_RGBA5551,
+  PACKED_FORMAT_RGBA4444,
+  PACKED_NUM_FORMATS
+};
+
+/* function declarations */
+char*     get_packed_format_name(int format);
+
+short int expand_packed_source_row( unsigned char* rgba, unsigned char* source,
+                                    int num_pixels);
+short int pack_pixels(unsigned char* packed, unsigned char* rgba,
+                      int num_pixels, int format);
+short int unpack_pixel(unsigned char* rgba, unsigned char* packed, int format);
+
+short int report_packed_quantization(int format);
+short int write_packed_file(FILE* fp_out, int format);
+
+#endif
@@ -0,0 +1,1896 @@
+/*******************************************************************************
+** palette.c (palette generation)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ntsc.h"
+#include "palette.h"
+#include "pool.h"
+
+#if 0
+/* the standard table step is 1 / (n + 2),  */
+/* where n is the number of colors per hue  */
+#define COMPOSITE_08_TABLE_STEP 0.1f                /* 1/10 */
+#define COMPOSITE_16_TABLE_STEP 0.055555555555556f  /* 1/18 */
+#define COMPOSITE_32_TABLE_STEP 0.029411764705882f  /* 1/34 */
+#endif
+
+/* the luma is the average of the low and high voltages */
+/* for the 1st half of each table, the low value is 0   */
+/* for the 2nd half of each table, the high value is 1  */
+/* the saturation is half of the peak-to-peak voltage   */
+
+/* for the nes tables, the numbers were obtained    */
+/* from information on the nesdev wiki              */
+/* (see the "NTSC video" and "PPU palettes" pages)  */
+/* (these are used by the ntsc nes source)          */
+float S_nes_p_p[4] = {0.399f,   0.684f, 0.692f, 0.285f};
+float S_nes_lum[4] = {0.1995f,  0.342f, 0.654f, 0.8575f};
+float S_nes_sat[4] = {0.1995f,  0.342f, 0.346f, 0.1425f};
+
+/* note that if we used the "composite 04" table, */
+/* with the table step being 1/(4+2) = 1/6, we    */
+/* would obtain an approximation of these values! */
+float S_approx_nes_p_p[4] = {0.4f, 0.7f,  0.7f,   0.3f};
+float S_approx_nes_lum[4] = {0.2f, 0.35f, 0.65f,  0.85f};
+float S_approx_nes_sat[4] = {0.2f, 0.35f, 0.35f,  0.15f};
+
+float S_composite_08_lum[8];
+float S_composite_08_sat[8];
+
+float S_composite_16_lum[16];
+float S_composite_16_sat[16];
+
+float S_composite_32_lum[32];
+float S_composite_32_sat[32];
+
+int   G_source;
+int   G_palette_size;
+
+unsigned char*  G_palette_data;
+
+palette_params  G_palette_params;
+
+float*  S_luma_table;
+float*  S_saturation_table;
+int     S_table_length;
+
+int   G_palette_channel_order;
+
+/* approx nes mode (0: standard, 1: rotated) */
+int     S_approx_nes_mode;
+
+/* caller-provided storage for the palette data (if any) */
+unsigned char*  S_palette_data_in_place;
+
+/* the palette data is kept in one buffer, which is reused */
+/* by later palettes (it only grows when a larger one is    */
+/* needed), so repeated generation does not reallocate      */
+unsigned char*  S_palette_arena;
+long            S_palette_arena_size;
+
+/* called with each copy & fill of the composite rows (if set) */
+palette_copy_hook G_palette_copy_hook;
+
+/* the color vision deficiency matrices are from Machado, Oliveira */
+/* & Fernandes (2009), at a severity of 1.0. the night transform   */
+/* darkens the luma and shifts it towards blue, and the sepia      */
+/* transform is the common one from the web & image editors.       */
+float S_palette_transform_matrices[PALETTE_NUM_TRANSFORMS][9] =
+  { { 0.152286f,  1.052583f, -0.204868f,
+      0.114503f,  0.786281f,  0.099216f,
+     -0.003882f, -0.048116f,  1.051998f},
+    { 0.367322f,  0.860646f, -0.227968f,
+      0.280085f,  0.672501f,  0.047413f,
+     -0.011820f,  0.042940f,  0.968881f},
+    { 1.255528f, -0.076749f, -0.178779f,
+     -0.078411f,  0.930809f,  0.147602f,
+      0.004733f,  0.691367f,  0.303900f},
+    { 0.105f,     0.205f,     0.040f,
+      0.135f,     0.264f,     0.051f,
+      0.224f,     0.440f,     0.086f},
+    { 0.393f,     0.769f,     0.189f,
+      0.349f,     0.686f,     0.168f,
+      0.272f,     0.534f,     0.131f}
+  };
+
+/*******************************************************************************
+** generate_voltage_tables()
+*******************************************************************************/
+short int generate_voltage_tables()
+{
+  int k;
+
+  /* composite 08 tables */
+  for (k = 0; k < 4; k++)
+  {
+    /* the table should include steps 1, 3, 6, and 8 */
+    if (k < 2)
+      S_composite_08_lum[k] = (2 * k + 1) * PALETTE_256_COLOR_TABLE_STEP;
+    else
+      S_composite_08_lum[k] = (2 * k + 2) * PALETTE_256_COLOR_TABLE_STEP;
+
+    S_composite_08_lum[7 - k] = 1.0f - S_composite_08_lum[k];
+
+    S_composite_08_sat[k] = S_composite_08_lum[k];
+    S_composite_08_sat[7 - k] = S_composite_08_sat[k];
+  }
+
+  /* composite 16 tables */
+  for (k = 0; k < 8; k++)
+  {
+    S_composite_16_lum[k] = (k + 1) * PALETTE_256_COLOR_TABLE_STEP;
+    S_composite_16_lum[15 - k] = 1.0f - S_composite_16_lum[k];
+
+    S_composite_16_sat[k] = S_composite_16_lum[k];
+    S_composite_16_sat[15 - k] = S_composite_16_sat[k];
+  }
+
+  /* composite 32 tables */
+  for (k = 0; k < 16; k++)
+  {
+    S_composite_32_lum[k] = (k + 1) * PALETTE_1024_COLOR_TABLE_STEP;
+    S_composite_32_lum[31 - k] = 1.0f - S_composite_32_lum[k];
+
+    S_composite_32_sat[k] = S_composite_32_lum[k];
+    S_composite_32_sat[31 - k] = S_composite_32_sat[k];
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_uniform_voltage_table()
+*******************************************************************************/
+short int generate_uniform_voltage_table( float* luma_table, float* saturation_table,
+                                          int num_shades, float table_step)
+{
+  int k;
+
+  if ((luma_table == NULL) || (saturation_table == NULL))
+    return 1;
+
+  if ((num_shades < 2) || (num_shades % 2 != 0))
+    return 1;
+
+  /* same construction as the composite 16 & 32 tables */
+  for (k = 0; k < num_shades / 2; k++)
+  {
+    luma_table[k] = (k + 1) * table_step;
+    luma_table[num_shades - 1 - k] = 1.0f - luma_table[k];
+
+    saturation_table[k] = luma_table[k];
+    saturation_table[num_shades - 1 - k] = saturation_table[k];
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_source_voltage_tables()
+*******************************************************************************/
+short int get_source_voltage_tables(int source,
+                                    float** luma_table, float** saturation_table,
+                                    int* table_length)
+{
+  if ((source == SOURCE_APPROX_NES) ||
+      (source == SOURCE_APPROX_NES_ROTATED))
+  {
+    *luma_table = S_approx_nes_lum;
+    *saturation_table = S_approx_nes_sat;
+    *table_length = 4;
+  }
+  else if (source == SOURCE_NTSC_NES)
+  {
+    *luma_table = S_nes_lum;
+    *saturation_table = S_nes_sat;
+    *table_length = 4;
+  }
+  else if (source == SOURCE_COMPOSITE_08)
+  {
+    *luma_table = S_composite_08_lum;
+    *saturation_table = S_composite_08_sat;
+    *table_length = 8;
+  }
+  else if ( (source == SOURCE_COMPOSITE_16) ||
+            (source == SOURCE_COMPOSITE_16_ROTATED))
+  {
+    *luma_table = S_composite_16_lum;
+    *saturation_table = S_composite_16_sat;
+    *table_length = 16;
+  }
+  else if (source == SOURCE_COMPOSITE_32)
+  {
+    *luma_table = S_composite_32_lum;
+    *saturation_table = S_composite_32_sat;
+    *table_length = 32;
+  }
+  else
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_voltage_table_pointers()
+*******************************************************************************/
+short int set_voltage_table_pointers()
+{
+  if (get_source_voltage_tables(G_source, &S_luma_table, &S_saturation_table, &S_table_length))
+  {
+    fprintf(stderr, "Cannot set voltage table pointers; invalid source specified.\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** is_source_composite()
+*******************************************************************************/
+int is_source_composite(int source)
+{
+  /* the composite sources are generated from palette parameters */
+  return  (source == SOURCE_COMPOSITE_08) ||
+          (source == SOURCE_COMPOSITE_16) ||
+          (source == SOURCE_COMPOSITE_16_ROTATED) ||
+          (source == SOURCE_COMPOSITE_32);
+}
+
+/*******************************************************************************
+** get_source_palette_size()
+*******************************************************************************/
+int get_source_palette_size(int source)
+{
+  if ((source == SOURCE_APPROX_NES) ||
+      (source == SOURCE_APPROX_NES_ROTATED) ||
+      (source == SOURCE_NTSC_NES))
+  {
+    return 64;
+  }
+  else if ( (source == SOURCE_COMPOSITE_08) ||
+            (source == SOURCE_COMPOSITE_16) ||
+            (source == SOURCE_COMPOSITE_16_ROTATED))
+  {
+    return 256;
+  }
+  else if (source == SOURCE_COMPOSITE_32)
+    return 1024;
+  else
+    return 0;
+}
+
+/*******************************************************************************
+** set_palette_size()
+*******************************************************************************/
+short int set_palette_size()
+{
+  G_palette_size = get_source_palette_size(G_source);
+
+  if (G_palette_size == 0)
+  {
+    fprintf(stderr, "Cannot set palette size; invalid source specified.\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** allocate_aligned_buffer()
+*******************************************************************************/
+unsigned char* allocate_aligned_buffer(long num_bytes)
+{
+  void* buffer;
+
+  if (num_bytes <= 0)
+    return NULL;
+
+  if (posix_memalign(&buffer, PALETTE_BUFFER_ALIGNMENT, num_bytes))
+    return NULL;
+
+  return (unsigned char*) buffer;
+}
+
+/*******************************************************************************
+** allocate_palette_data()
+*******************************************************************************/
+short int allocate_palette_data(long num_bytes)
+{
+  if (num_bytes <= 0)
+    return 1;
+
+  /* use the caller's storage if it was provided */
+  if (S_palette_data_in_place != NULL)
+  {
+    G_palette_data = S_palette_data_in_place;
+    return 0;
+  }
+
+  /* otherwise, reuse (or grow) the arena */
+  if (num_bytes > S_palette_arena_size)
+  {
+    free_palette_arena();
+
+    S_palette_arena = allocate_aligned_buffer(num_bytes);
+
+    if (S_palette_arena == NULL)
+      return 1;
+
+    S_palette_arena_size = num_bytes;
+  }
+
+  G_palette_data = S_palette_arena;
+
+  return 0;
+}
+
+/*******************************************************************************
+** free_palette_arena()
+*******************************************************************************/
+short int free_palette_arena()
+{
+  if (S_palette_arena != NULL)
+  {
+    if (G_palette_data == S_palette_arena)
+      G_palette_data = NULL;
+
+    free(S_palette_arena);
+    S_palette_arena = NULL;
+  }
+
+  S_palette_arena_size = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_source_name()
+*******************************************************************************/
+char* get_source_name(int source)
+{
+  if (source == SOURCE_APPROX_NES)
+    return "approx_nes";
+  else if (source == SOURCE_APPROX_NES_ROTATED)
+    return "approx_nes_rotated";
+  else if (source == SOURCE_NTSC_NES)
+    return "ntsc_nes";
+  else if (source == SOURCE_COMPOSITE_08)
+    return "composite_08";
+  else if (source == SOURCE_COMPOSITE_16)
+    return "composite_16";
+  else if (source == SOURCE_COMPOSITE_16_ROTATED)
+    return "composite_16_rotated";
+  else if (source == SOURCE_COMPOSITE_32)
+    return "composite_32";
+  else
+    return NULL;
+}
+
+/*******************************************************************************
+** get_palette_source_name()
+*******************************************************************************/
+char* get_palette_source_name()
+{
+  return get_source_name(G_source);
+}
+
+/*******************************************************************************
+** get_palette_source_from_name()
+*******************************************************************************/
+int get_palette_source_from_name(char* name)
+{
+  if (name == NULL)
+    return -1;
+
+  if (!strcmp("approx_nes", name))
+    return SOURCE_APPROX_NES;
+  else if (!strcmp("approx_nes_rotated", name))
+    return SOURCE_APPROX_NES_ROTATED;
+  else if (!strcmp("ntsc_nes", name))
+    return SOURCE_NTSC_NES;
+  else if (!strcmp("composite_08", name))
+    return SOURCE_COMPOSITE_08;
+  else if (!strcmp("composite_16", name))
+    return SOURCE_COMPOSITE_16;
+  else if (!strcmp("composite_16_rotated", name))
+    return SOURCE_COMPOSITE_16_ROTATED;
+  else if (!strcmp("composite_32", name))
+    return SOURCE_COMPOSITE_32;
+  else
+    return -1;
+}
+
+/*******************************************************************************
+** set_palette_transform()
+*******************************************************************************/
+short int set_palette_transform(palette_transform* pt, int transform)
+{
+  int k;
+
+  if ((pt == NULL) || (transform < 0) || (transform >= PALETTE_NUM_TRANSFORMS))
+    return 1;
+
+  for (k = 0; k < 9; k++)
+    pt->matrix[k] = S_palette_transform_matrices[transform][k];
+
+  for (k = 0; k < 3; k++)
+    pt->offset[k] = 0.0f;
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_palette_transform_from_name()
+*******************************************************************************/
+int get_palette_transform_from_name(char* name)
+{
+  if (name == NULL)
+    return -1;
+
+  if (!strcmp("protan", name))
+    return PALETTE_TRANSFORM_PROTAN;
+  else if (!strcmp("deutan", name))
+    return PALETTE_TRANSFORM_DEUTAN;
+  else if (!strcmp("tritan", name))
+    return PALETTE_TRANSFORM_TRITAN;
+  else if (!strcmp("night", name))
+    return PALETTE_TRANSFORM_NIGHT;
+  else if (!strcmp("sepia", name))
+    return PALETTE_TRANSFORM_SEPIA;
+  else
+    return -1;
+}
+
+/*******************************************************************************
+** get_palette_bytes_per_pixel()
+*******************************************************************************/
+int get_palette_bytes_per_pixel()
+{
+  /* the approx nes sources have an alpha channel */
+  if ((G_source == SOURCE_APPROX_NES) ||
+      (G_source == SOURCE_APPROX_NES_ROTATED))
+  {
+    return 4;
+  }
+  else
+    return 3;
+}
+
+/*******************************************************************************
+** setup_palette_approx_nes()
+*******************************************************************************/
+short int setup_palette_approx_nes(int mode)
+{
+  int m;
+
+  S_approx_nes_mode = mode;
+
+  /* allocate palette data */
+  /*G_palette_data = malloc(sizeof(GLubyte) * 4 * G_palette_size * G_palette_size);*/
+  if (allocate_palette_data(4 * G_palette_size * G_palette_size))
+    return 1;
+
+  /* every band writes the first 55 colors of its rows, */
+  /* so only the rest of each row is initialized        */
+  for (m = 0; m < G_palette_size; m++)
+  {
+    memset( &G_palette_data[4 * (m * G_palette_size + PALETTE_APPROX_NES_NUM_COLORS)], 0,
+            4 * (G_palette_size - PALETTE_APPROX_NES_NUM_COLORS));
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_palette_approx_nes_band()
+*******************************************************************************/
+short int generate_palette_approx_nes_band(int band)
+{
+  int   phi;
+
+  int   m;
+  int   n;
+  int   k;
+
+  float y;
+  float i;
+  float q;
+
+  int   r;
+  int   g;
+  int   b;
+
+  int   shift;
+
+  unsigned char*  row;
+  unsigned char*  base_row;
+
+  /* palette 0 */
+  if (band == 0)
+  {
+    /* the colors are written straight into the base level row */
+    row = &G_palette_data[4 * (PALETTE_APPROX_NES_BASE_LEVEL * 64)];
+
+    /* transparency color */
+    row[4 * 0 + 0] = 0;
+    row[4 * 0 + 1] = 0;
+    row[4 * 0 + 2] = 0;
+    row[4 * 0 + 3] = 0;
+
+    /* black */
+    row[4 * 1 + 0] = 0;
+    row[4 * 1 + 1] = 0;
+    row[4 * 1 + 2] = 0;
+    row[4 * 1 + 3] = 255;
+
+    /* greys */
+    for (n = 0; n < 4; n++)
+    {
+      row[4 * (n + 2) + 0] = (int) ((S_approx_nes_lum[n] * 255) + 0.5f);
+      row[4 * (n + 2) + 1] = (int) ((S_approx_nes_lum[n] * 255) + 0.5f);
+      row[4 * (n + 2) + 2] = (int) ((S_approx_nes_lum[n] * 255) + 0.5f);
+      row[4 * (n + 2) + 3] = 255;
+    }
+
+    /* white */
+    row[4 * 6 + 0] = 255;
+    row[4 * 6 + 1] = 255;
+    row[4 * 6 + 2] = 255;
+    row[4 * 6 + 3] = 255;
+
+    /* determine phi    */
+    /* mode 0: standard */
+    /* mode 1: rotated  */
+    if (S_approx_nes_mode == 0)
+      phi = 0;
+    else if (S_approx_nes_mode == 1)
+      phi = 15;
+    else
+      phi = 0;
+
+    /* generate each hue */
+    for (m = 0; m < 12; m++)
+    {
+      for (n = 0; n < 4; n++)
+      {
+        /* compute yiq values */
+        y = S_approx_nes_lum[n];
+        i = S_approx_nes_sat[n] * cos(TWO_PI * ((m * 30) + phi) / 360.0f);
+        q = S_approx_nes_sat[n] * sin(TWO_PI * ((m * 30) + phi) / 360.0f);
+
+        /* convert to rgb */
+        r = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
+        g = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
+        b = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
+
+        /* bound rgb values */
+        if (r < 0)
+          r = 0;
+        else if (r > 255)
+          r = 255;
+
+        if (g < 0)
+          g = 0;
+        else if (g > 255)
+          g = 255;
+
+        if (b < 0)
+          b = 0;
+        else if (b > 255)
+          b = 255;
+
+        row[4 * (7 + 4 * m + n) + 0] = r;
+        row[4 * (7 + 4 * m + n) + 1] = g;
+        row[4 * (7 + 4 * m + n) + 2] = b;
+        row[4 * (7 + 4 * m + n) + 3] = 255;
+      }
+    }
+
+    /* generate lighting levels for palette 0. each level away from */
+    /* the base level shifts the greys & hues by shades / base level */
+    /* (black or white is shifted in at their ends)                  */
+    base_row = &G_palette_data[4 * (PALETTE_APPROX_NES_BASE_LEVEL * 64)];
+
+    for (k = 0; k < PALETTE_APPROX_NES_NUM_LEVELS; k++)
+    {
+      if (k == PALETTE_APPROX_NES_BASE_LEVEL)
+        continue;
+
+      row = &G_palette_data[4 * (k * 64)];
+
+      if (k < PALETTE_APPROX_NES_BASE_LEVEL)
+        shift = ((PALETTE_APPROX_NES_BASE_LEVEL - k) * PALETTE_APPROX_NES_NUM_SHADES) / PALETTE_APPROX_NES_BASE_LEVEL;
+      else
+        shift = ((k - PALETTE_APPROX_NES_BASE_LEVEL) * PALETTE_APPROX_NES_NUM_SHADES) / PALETTE_APPROX_NES_BASE_LEVEL;
+
+      /* copy transparency color */
+      memcpy(&row[4 * 0], &base_row[4 * 0], 4);
+
+      /* shadows */
+      if (k < PALETTE_APPROX_NES_BASE_LEVEL)
+      {
+        /* greys (black, the greys & white) */
+        for (m = 0; m < shift + 1; m++)
+          memcpy(&row[4 * (m + 1)], &base_row[4 * 1], 4);
+
+        memcpy(&row[4 * (shift + 2)], &base_row[4 * 2], 4 * (PALETTE_APPROX_NES_NUM_SHADES + 1 - shift));
+
+        /* hues */
+        for (m = 0; m < 12; m++)
+        {
+          for (n = 0; n < shift; n++)
+            memcpy(&row[4 * (4 * m + 7 + n)], &base_row[4 * 1], 4);
+
+          if (shift < PALETTE_APPROX_NES_NUM_SHADES)
+            memcpy(&row[4 * (4 * m + 7 + shift)], &base_row[4 * (4 * m + 7)], 4 * (PALETTE_APPROX_NES_NUM_SHADES - shift));
+        }
+      }
+      /* highlights */
+      else
+      {
+        /* greys */
+        for (m = 0; m < shift + 1; m++)
+          memcpy(&row[4 * (PALETTE_APPROX_NES_NUM_SHADES + 2 - m)], &base_row[4 * (PALETTE_APPROX_NES_NUM_SHADES + 2)], 4);
+
+        memcpy(&row[4 * 1], &base_row[4 * (shift + 1)], 4 * (PALETTE_APPROX_NES_NUM_SHADES + 1 - shift));
+
+        /* hues */
+        for (m = 0; m < 12; m++)
+        {
+          for (n = 0; n < shift; n++)
+            memcpy(&row[4 * (4 * m + 7 + (PALETTE_APPROX_NES_NUM_SHADES - 1 - n))], &base_row[4 * (PALETTE_APPROX_NES_NUM_SHADES + 2)], 4);
+
+          if (shift < PALETTE_APPROX_NES_NUM_SHADES)
+            memcpy(&row[4 * (4 * m + 7)], &base_row[4 * (4 * m + 7 + shift)], 4 * (PALETTE_APPROX_NES_NUM_SHADES - shift));
+        }
+      }
+    }
+  }
+  /* palettes 1 - 5 (shift by 2 each time) */
+  else if (band < 6)
+  {
+    m = band;
+
+    for (n = 0; n < 8; n++)
+    {
+      /* transparency & greys */
+      memcpy(&G_palette_data[4 * ((8 * m + n) * 64 + 0)], &G_palette_data[4 * ((8 * (m - 1) + n) * 64 + 0)], 4 * 7);
+
+      /* shifted back colors */
+      memcpy(&G_palette_data[4 * ((8 * m + n) * 64 + 7)], &G_palette_data[4 * ((8 * (m - 1) + n) * 64 + 15)], 4 * 4 * 10);
+
+      /* cycled around colors */
+      memcpy(&G_palette_data[4 * ((8 * m + n) * 64 + 47)], &G_palette_data[4 * ((8 * (m - 1) + n) * 64 + 7)], 4 * 4 * 2);
+    }
+  }
+  /* palette 6 (greyscale) */
+  else if (band == 6)
+  {
+    for (m = 0; m < 8; m++)
+    {
+      memcpy(&G_palette_data[4 * ((48 + m) * 64 + 0)], &G_palette_data[4 * (m * 64 + 0)], 4 * 7);
+
+      for (n = 0; n < 12; n++)
+        memcpy(&G_palette_data[4 * ((48 + m) * 64 + 4 * n + 7)], &G_palette_data[4 * (m * 64 + 2)], 4 * 4);
+    }
+  }
+  /* palette 7 (inverted greyscale) */
+  else if (band == 7)
+  {
+    for (m = 0; m < 8; m++)
+    {
+      memcpy(&G_palette_data[4 * ((56 + m) * 64 + 0)], &G_palette_data[4 * (m * 64 + 0)], 4);
+
+      for (n = 1; n < 7; n++)
+      {
+        G_palette_data[4 * ((56 + m) * 64 + n) + 0] = G_palette_data[4 * (m * 64 + (7 - n)) + 0];
+        G_palette_data[4 * ((56 + m) * 64 + n) + 1] = G_palette_data[4 * (m * 64 + (7 - n)) + 1];
+        G_palette_data[4 * ((56 + m) * 64 + n) + 2] = G_palette_data[4 * (m * 64 + (7 - n)) + 2];
+        G_palette_data[4 * ((56 + m) * 64 + n) + 3] = G_palette_data[4 * (m * 64 + (7 - n)) + 3];
+      }
+
+      for (n = 0; n < 12; n++)
+        memcpy(&G_palette_data[4 * ((56 + m) * 64 + 4 * n + 7)], &G_palette_data[4 * ((56 + m) * 64 + 2)], 4 * 4);
+    }
+  }
+  else
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** setup_palette_ntsc_nes()
+*******************************************************************************/
+short int setup_palette_ntsc_nes()
+{
+  /* allocate palette data */
+  if (allocate_palette_data(3 * G_palette_size * G_palette_size))
+    return 1;
+
+  /* simulate the colors (every texel is written by the bands) */
+  return generate_ntsc_colors(get_default_num_threads());
+}
+
+/*******************************************************************************
+** generate_palette_ntsc_nes_band()
+*******************************************************************************/
+short int generate_palette_ntsc_nes_band(int band)
+{
+  unsigned char*  row;
+  unsigned char*  rgb;
+
+  int   k;
+  int   n;
+
+  /* each band is one emphasis setting, and each row is the nes  */
+  /* palette (0x00 - 0x3F), with the lumas shifted by the level  */
+  if ((band < 0) || (band >= NTSC_NUM_EMPHASIS))
+    return 1;
+
+  for (k = 0; k < NTSC_NUM_LEVELS; k++)
+  {
+    row = &G_palette_data[3 * (band * NTSC_NUM_LEVELS + k) * G_palette_size];
+
+    for (n = 0; n < NTSC_NUM_COLORS; n++)
+    {
+      rgb = get_ntsc_color(band, get_ntsc_level_color(n, k));
+
+      if (G_palette_channel_order == PALETTE_CHANNEL_ORDER_BGR)
+      {
+        row[3 * n + 0] = rgb[2];
+        row[3 * n + 1] = rgb[1];
+        row[3 * n + 2] = rgb[0];
+      }
+      else
+        memcpy(&row[3 * n], rgb, 3);
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_palette_params_256_color()
+*******************************************************************************/
+short int set_palette_params_256_color(palette_params* pp, int mode)
+{
+  pp->palette_size = 256;
+  pp->num_levels = 0;
+  pp->num_variants = 0;
+  pp->row_stride = 0;
+
+  /* initialize variables based on mode */
+  if (mode == PALETTE_MODE_STANDARD)
+  {
+    pp->num_hues = 12;
+    pp->num_shades = 16;
+
+    pp->num_rotations = 6;
+    pp->num_tints = 3;
+
+    pp->phi = 0.0f;
+    pp->tint_start_hue = 2;
+
+    pp->fixed_hues_left = 1;
+    pp->fixed_hues_right = 1;
+  }
+  else if (mode == PALETTE_MODE_ROTATED)
+  {
+    pp->num_hues = 12;
+    pp->num_shades = 16;
+
+    pp->num_rotations = 6;
+    pp->num_tints = 3;
+
+    pp->phi = PI / 12.0f; /* 15 degrees */
+    pp->tint_start_hue = 1;
+
+    pp->fixed_hues_left = 1;
+    pp->fixed_hues_right = 1;
+  }
+  else if (mode == PALETTE_MODE_DOUBLED)
+  {
+    pp->num_hues = 24;
+    pp->num_shades = 8;
+
+    pp->num_rotations = 6;
+    pp->num_tints = 3;
+
+    pp->phi = 0.0f;
+    pp->tint_start_hue = 2;
+
+    pp->fixed_hues_left = 1;
+    pp->fixed_hues_right = 2;
+  }
+  else
+  {
+    pp->num_hues = 12;
+    pp->num_shades = 16;
+
+    pp->num_rotations = 6;
+    pp->num_tints = 3;
+
+    pp->phi = 0.0f;
+    pp->tint_start_hue = 2;
+
+    pp->fixed_hues_left = 1;
+    pp->fixed_hues_right = 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_palette_params_1024_color()
+*******************************************************************************/
+short int set_palette_params_1024_color(palette_params* pp)
+{
+  pp->palette_size = 1024;
+  pp->num_levels = 0;
+  pp->num_variants = 0;
+  pp->row_stride = 0;
+
+  /* initialize variables */
+  pp->num_hues = 24;
+  pp->num_shades = 32;
+
+  pp->num_rotations = 6;
+  pp->num_tints = 3;
+
+  pp->phi = 0.0f;
+  pp->tint_start_hue = 2;
+
+  pp->fixed_hues_left = 1;
+  pp->fixed_hues_right = 2;
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_palette_params_for_source()
+*******************************************************************************/
+short int set_palette_params_for_source(palette_params* pp, int source)
+{
+  if (pp == NULL)
+    return 1;
+
+  if (source == SOURCE_COMPOSITE_08)
+    set_palette_params_256_color(pp, PALETTE_MODE_DOUBLED);
+  else if (source == SOURCE_COMPOSITE_16)
+    set_palette_params_256_color(pp, PALETTE_MODE_STANDARD);
+  else if (source == SOURCE_COMPOSITE_16_ROTATED)
+    set_palette_params_256_color(pp, PALETTE_MODE_ROTATED);
+  else if (source == SOURCE_COMPOSITE_32)
+    set_palette_params_1024_color(pp);
+  else
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** derive_palette_params()
+*******************************************************************************/
+short int derive_palette_params(palette_params* pp)
+{
+  if (pp == NULL)
+    return 1;
+
+  if ((pp->palette_size < 2 * PALETTE_NUM_INDICES) ||
+      (pp->palette_size > PALETTE_MAX_SIZE) ||
+      (pp->palette_size % (2 * PALETTE_NUM_INDICES) != 0))
+  {
+    return 1;
+  }
+
+  /* the default is a square texture */
+  if (pp->num_levels == 0)
+    pp->levels_per_palette = pp->palette_size / PALETTE_NUM_INDICES;
+  else if ( (pp->num_levels < PALETTE_MIN_LEVELS) ||
+            (pp->num_levels > PALETTE_MAX_LEVELS) ||
+            (pp->num_levels % 2 != 0))
+  {
+    return 1;
+  }
+  else
+    pp->levels_per_palette = pp->num_levels;
+
+  pp->base_level = pp->levels_per_palette / 2;
+
+  /* the hues and shades must fit in a row */
+  if ((pp->num_hues < 1) || (pp->num_shades < 1))
+    return 1;
+
+  if ((pp->num_hues + 1) * pp->num_shades > pp->palette_size)
+    return 1;
+
+  /* the rotations & tints must divide the hues evenly */
+  if ((pp->num_rotations < 1) || (pp->num_rotations > PALETTE_INDEX_GREYSCALE) ||
+      (pp->num_hues % pp->num_rotations != 0))
+  {
+    return 1;
+  }
+
+  if ((pp->num_tints < 1) || (pp->num_tints > PALETTE_NUM_INDICES - PALETTE_INDEX_TINT_RED) ||
+      (pp->num_hues % pp->num_tints != 0))
+  {
+    return 1;
+  }
+
+  if ((pp->tint_start_hue < 1) ||
+      (pp->tint_start_hue + (pp->num_tints - 1) * (pp->num_hues / pp->num_tints) > pp->num_hues))
+  {
+    return 1;
+  }
+
+  if ((pp->fixed_hues_left < 0) || (pp->fixed_hues_right < 0) ||
+      (pp->fixed_hues_left + pp->fixed_hues_right > pp->num_hues))
+  {
+    return 1;
+  }
+
+  if ((pp->num_variants < 0) || (pp->num_variants > PALETTE_MAX_VARIANTS))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_palette_num_palettes()
+*******************************************************************************/
+int get_palette_num_palettes(palette_params* pp)
+{
+  return PALETTE_NUM_INDICES + pp->num_variants;
+}
+
+/*******************************************************************************
+** get_palette_height()
+*******************************************************************************/
+int get_palette_height(palette_params* pp)
+{
+  return get_palette_num_palettes(pp) * pp->levels_per_palette;
+}
+
+/*******************************************************************************
+** get_palette_level_shift()
+*******************************************************************************/
+int get_palette_level_shift(palette_params* pp, int level)
+{
+  int distance;
+
+  /* each level away from the base level shifts the gradients by  */
+  /* shades / base level, in 1 / 256 of a shade. the shift is a    */
+  /* whole number of shades when the shades divide evenly among    */
+  /* the levels (the built-in sources), and otherwise the two      */
+  /* nearest shades are blended (see blend_palette_level_shift()). */
+  if (level < pp->base_level)
+    distance = pp->base_level - level;
+  else
+    distance = level - pp->base_level;
+
+  return (int) (((long) 2 * distance * pp->num_shades * PALETTE_LEVEL_SHIFT_ONE + pp->base_level) /
+                (2 * pp->base_level));
+}
+
+/*******************************************************************************
+** blend_palette_level_shift()
+*******************************************************************************/
+short int blend_palette_level_shift(unsigned char* gradient, int num_shades,
+                                    int shift, int highlight_flag)
+{
+  int whole;
+  int fraction;
+
+  int j;
+  int c;
+
+  whole = shift >> PALETTE_LEVEL_SHIFT_BITS;
+  fraction = shift & (PALETTE_LEVEL_SHIFT_ONE - 1);
+
+  if (fraction == 0)
+    return 0;
+
+  /* the gradient has already been shifted by the whole shades, */
+  /* so each shade is blended with its neighbour away from the  */
+  /* shift (black or white past the end). the shades are        */
+  /* visited so that each neighbour is read before it changes.  */
+  if (!highlight_flag)
+  {
+    for (j = num_shades - 1; j >= whole; j--)
+    {
+      for (c = 0; c < 3; c++)
+      {
+        gradient[3 * j + c] = ( (PALETTE_LEVEL_SHIFT_ONE - fraction) * gradient[3 * j + c] +
+                                fraction * ((j > whole) ? gradient[3 * (j - 1) + c] : 0) +
+                                PALETTE_LEVEL_SHIFT_ONE / 2) >> PALETTE_LEVEL_SHIFT_BITS;
+      }
+    }
+  }
+  else
+  {
+    for (j = 0; j < num_shades - whole; j++)
+    {
+      for (c = 0; c < 3; c++)
+      {
+        gradient[3 * j + c] = ( (PALETTE_LEVEL_SHIFT_ONE - fraction) * gradient[3 * j + c] +
+                                fraction * ((j + 1 < num_shades - whole) ? gradient[3 * (j + 1) + c] : 255) +
+                                PALETTE_LEVEL_SHIFT_ONE / 2) >> PALETTE_LEVEL_SHIFT_BITS;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** allocate_palette_composite()
+*******************************************************************************/
+short int allocate_palette_composite()
+{
+  palette_params* pp;
+
+  pp = &G_palette_params;
+
+  pp->luma_table = S_luma_table;
+  pp->saturation_table = S_saturation_table;
+
+  pp->channel_order = G_palette_channel_order;
+  pp->base_row = NULL;
+
+  /* initialize derived variables */
+  if (derive_palette_params(pp))
+    return 1;
+
+  /* allocate palette data */
+  /*G_palette_data = malloc(sizeof(GLubyte) * 3 * palette_size * palette_size);*/
+  return allocate_palette_data(3 * (long) pp->palette_size * get_palette_height(pp));
+}
+
+/*******************************************************************************
+** compute_palette_base_color()
+*******************************************************************************/
+short int compute_palette_base_color(palette_params* pp, int gradient, int shade,
+                                     float* rgb)
+{
+  float y;
+  float i;
+  float q;
+
+  /* compute color in yiq (gradient 0 is grey) */
+  y = pp->luma_table[shade];
+
+  if (gradient == 0)
+  {
+    i = 0.0f;
+    q = 0.0f;
+  }
+  else
+  {
+    i = pp->saturation_table[shade] * cos(((TWO_PI * (gradient - 1)) / pp->num_hues) + pp->phi);
+    q = pp->saturation_table[shade] * sin(((TWO_PI * (gradient - 1)) / pp->num_hues) + pp->phi);
+  }
+
+  /* convert from yiq to rgb (not clipped) */
+  rgb[0] = y + (i * 0.956f) + (q * 0.619f);
+  rgb[1] = y - (i * 0.272f) - (q * 0.647f);
+  rgb[2] = y - (i * 1.106f) + (q * 1.703f);
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_palette_base_row()
+*******************************************************************************/
+short int generate_palette_base_row(palette_params* pp, unsigned char* row)
+{
+  int   num_gradients;
+  int   num_shades;
+
+  int   n;
+  int   k;
+
+  float rgb[3];
+
+  int   r;
+  int   g;
+  int   b;
+
+  int   index;
+
+  if ((pp == NULL) || (row == NULL))
+    return 1;
+
+  if ((pp->luma_table == NULL) || (pp->saturation_table == NULL))
+    return 1;
+
+  num_gradients = pp->num_hues + 1;
+  num_shades = pp->num_shades;
+
+  /* generate palette 0 (base level) */
+  for (n = 0; n < num_gradients; n++)
+  {
+    for (k = 0; k < num_shades; k++)
+    {
+      index = n * num_shades + k;
+
+      compute_palette_base_color(pp, n, k, rgb);
+
+      r = (int) ((rgb[0] * 255) + 0.5f);
+      g = (int) ((rgb[1] * 255) + 0.5f);
+      b = (int) ((rgb[2] * 255) + 0.5f);
+
+      /* hard clipping at the bottom */
+      if (r < 0)
+        r = 0;
+      if (g < 0)
+        g = 0;
+      if (b < 0)
+        b = 0;
+
+      /* hard clipping at the top */
+      if (r > 255)
+        r = 255;
+      if (g > 255)
+        g = 255;
+      if (b > 255)
+        b = 255;
+
+      /* insert this color into the row */
+      if (pp->channel_order == PALETTE_CHANNEL_ORDER_BGR)
+      {
+        row[3 * index + 0] = b;
+        row[3 * index + 1] = g;
+        row[3 * index + 2] = r;
+      }
+      else
+      {
+        row[3 * index + 0] = r;
+        row[3 * index + 1] = g;
+        row[3 * index + 2] = b;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_palette_variant_rows()
+*******************************************************************************/
+short int generate_palette_variant_rows(palette_params* pp, unsigned char* base_row,
+                                        unsigned char* data,
+                                        int first_variant, int num_variants)
+{
+  palette_transform*  pt;
+
+  float*  planes;
+  float*  red;
+  float*  green;
+  float*  blue;
+
+  float   matrix[9];
+  float   bias[3];
+
+  int     values[3][4];
+
+  unsigned char*  row;
+
+  int   row_stride;
+  int   num_pixels;
+  int   num_padded;
+
+  int   r_index;
+  int   b_index;
+
+  int   v;
+  int   k;
+  int   j;
+  int   c;
+
+#ifdef __SSE2__
+  __m128  r4;
+  __m128  g4;
+  __m128  b4;
+  __m128  x4;
+#else
+  float   x;
+#endif
+
+  /* the palette 0 base row is split into float planes once, and */
+  /* each transform is applied to 4 colors at a time. the other  */
+  /* levels of each variant are then shifted copies of its base  */
+  /* level row (see generate_palette_composite_row()), as for    */
+  /* palette 0. the sse2 kernel computes each channel in the same */
+  /* order as the scalar version, so the results are the same.   */
+  if ((pp == NULL) || (base_row == NULL) || (data == NULL))
+    return 1;
+
+  if ((first_variant < 0) || (num_variants < 0) ||
+      (first_variant + num_variants > pp->num_variants))
+  {
+    return 1;
+  }
+
+  if (num_variants == 0)
+    return 0;
+
+  if (pp->row_stride > 0)
+    row_stride = pp->row_stride;
+  else
+    row_stride = pp->palette_size;
+
+  num_pixels = (pp->num_hues + 1) * pp->num_shades;
+  num_padded = (num_pixels + 3) & ~3;
+
+  if (pp->channel_order == PALETTE_CHANNEL_ORDER_BGR)
+  {
+    r_index = 2;
+    b_index = 0;
+  }
+  else
+  {
+    r_index = 0;
+    b_index = 2;
+  }
+
+  planes = (float*) allocate_aligned_buffer(sizeof(float) * 3 * num_padded);
+
+  if (planes == NULL)
+    return 1;
+
+  red = &planes[0];
+  green = &planes[num_padded];
+  blue = &planes[2 * num_padded];
+
+  for (k = 0; k < num_padded; k++)
+  {
+    if (k < num_pixels)
+    {
+      red[k] = base_row[3 * k + r_index];
+      green[k] = base_row[3 * k + 1];
+      blue[k] = base_row[3 * k + b_index];
+    }
+    else
+    {
+      red[k] = 0.0f;
+      green[k] = 0.0f;
+      blue[k] = 0.0f;
+    }
+  }
+
+  for (v = first_variant; v < first_variant + num_variants; v++)
+  {
+    pt = &pp->variants[v];
+
+    row = &data[3 * ((PALETTE_NUM_INDICES + v) * pp->levels_per_palette + pp->base_level) * row_stride];
+
+    /* the colors are 0-255 here, and 0.5 is added for the rounding */
+    for (c = 0; c < 9; c++)
+      matrix[c] = pt->matrix[c];
+
+    for (c = 0; c < 3; c++)
+      bias[c] = (255.0f * pt->offset[c]) + 0.5f;
+
+    for (k = 0; k < num_padded; k += 4)
+    {
+#ifdef __SSE2__
+      r4 = _mm_load_ps(&red[k]);
+      g4 = _mm_load_ps(&green[k]);
+      b4 = _mm_load_ps(&blue[k]);
+
+      for (c = 0; c < 3; c++)
+      {
+        x4 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(matrix[3 * c + 0]), r4),
+                        _mm_mul_ps(_mm_set1_ps(matrix[3 * c + 1]), g4));
+        x4 = _mm_add_ps(x4, _mm_mul_ps(_mm_set1_ps(matrix[3 * c + 2]), b4));
+        x4 = _mm_add_ps(x4, _mm_set1_ps(bias[c]));
+
+        /* hard clipping, then truncation (the values are positive) */
+        x4 = _mm_min_ps(_mm_max_ps(x4, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+
+        _mm_storeu_si128((__m128i*) values[c], _mm_cvttps_epi32(x4));
+      }
+#else
+      for (c = 0; c < 3; c++)
+      {
+        for (j = 0; j < 4; j++)
+        {
+          x = (matrix[3 * c + 0] * red[k + j]) + (matrix[3 * c + 1] * green[k + j]);
+          x = x + (matrix[3 * c + 2] * blue[k + j]);
+          x = x + bias[c];
+
+          /* hard clipping, then truncation (the values are positive) */
+          if (x < 0.0f)
+            x = 0.0f;
+          if (x > 255.0f)
+            x = 255.0f;
+
+          values[c][j] = (int) x;
+        }
+      }
+#endif
+
+      /* insert these colors into the row */
+      for (j = 0; (j < 4) && (k + j < num_pixels); j++)
+      {
+        row[3 * (k + j) + r_index] = values[0][j];
+        row[3 * (k + j) + 1] = values[1][j];
+        row[3 * (k + j) + b_index] = values[2][j];
+      }
+    }
+  }
+
+  free(planes);
+
+  return 0;
+}
+
+/*******************************************************************************
+** copy_palette_bytes()
+*******************************************************************************/
+void copy_palette_bytes(unsigned char* dest, unsigned char* src, long num_bytes)
+{
+  if (G_palette_copy_hook != NULL)
+    G_palette_copy_hook(dest, src, 0, num_bytes);
+
+  memcpy(dest, src, num_bytes);
+}
+
+/*******************************************************************************
+** fill_palette_bytes()
+*******************************************************************************/
+void fill_palette_bytes(unsigned char* dest, int value, long num_bytes)
+{
+  if (G_palette_copy_hook != NULL)
+    G_palette_copy_hook(dest, NULL, value, num_bytes);
+
+  memset(dest, value, num_bytes);
+}
+
+/*******************************************************************************
+** init_palette_composite_row()
+*******************************************************************************/
+short int init_palette_composite_row(palette_params* pp, unsigned char* row,
+                                     int palette, int level)
+{
+  int   num_gradients;
+  int   num_shades;
+  int   num_covered;
+
+  int   shift;
+
+  int   n;
+
+  num_gradients = pp->num_hues + 1;
+  num_shades = pp->num_shades;
+
+  /* number of gradients written by generate_palette_composite_row() */
+  if (!is_palette_used(pp, palette))
+    num_covered = 0;
+  else if ((palette >= PALETTE_INDEX_ROTATE_60) && (palette <= PALETTE_INDEX_ROTATE_300))
+    num_covered = 1 + pp->num_rotations * (pp->num_hues / pp->num_rotations);
+  else
+    num_covered = num_gradients;
+
+  /* the rest of the row is black */
+  fill_palette_bytes( &row[3 * num_covered * num_shades], 0,
+                      3 * (pp->palette_size - num_covered * num_shades));
+
+  /* the palette 0 (and variant) gradients are shifted towards  */
+  /* black or white, and the shades shifted in at their ends are */
+  /* black or white                                              */
+  if (((palette == PALETTE_INDEX_STANDARD) || (palette >= PALETTE_NUM_INDICES)) &&
+      (level != pp->base_level))
+  {
+    shift = get_palette_level_shift(pp, level) >> PALETTE_LEVEL_SHIFT_BITS;
+
+    for (n = 0; n < num_gradients; n++)
+    {
+      if (level < pp->base_level)
+        fill_palette_bytes(&row[3 * (num_shades * n)], 0, 3 * shift);
+      else
+        fill_palette_bytes(&row[3 * (num_shades * (n + 1) - shift)], 255, 3 * shift);
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** is_palette_used()
+*******************************************************************************/
+int is_palette_used(palette_params* pp, int palette)
+{
+  /* the rotated & tinted palettes past the number of rotations */
+  /* or tints are left black                                    */
+  if ((palette >= PALETTE_INDEX_ROTATE_60) && (palette <= PALETTE_INDEX_ROTATE_300))
+    return (palette - PALETTE_INDEX_ROTATE_60 + 1 < pp->num_rotations);
+  else if ((palette >= PALETTE_INDEX_ALTERNATE_ROTATE_60) && (palette <= PALETTE_INDEX_ALTERNATE_ROTATE_300))
+    return (palette - PALETTE_INDEX_ALTERNATE_ROTATE_60 + 1 < pp->num_rotations);
+  else if ((palette >= PALETTE_INDEX_TINT_RED) && (palette <= PALETTE_INDEX_TINT_GREEN))
+    return (palette - PALETTE_INDEX_TINT_RED < pp->num_tints);
+  else if (palette >= PALETTE_NUM_INDICES)
+    return (palette - PALETTE_NUM_INDICES < pp->num_variants);
+  else
+    return 1;
+}
+
+/*******************************************************************************
+** generate_palette_composite_row()
+*******************************************************************************/
+short int generate_palette_composite_row( palette_params* pp, unsigned char* row,
+                                          int palette, int level,
+                                          unsigned char* level_row,
+                                          unsigned char* companion_row)
+{
+  int   levels_per_palette;
+  int   base_level;
+
+  int   num_hues;
+  int   num_gradients;
+
+  int   num_shades;
+  int   shift;
+  int   whole;
+
+  int   num_rotations;
+  int   rotation_step;
+
+  int   num_tints;
+  int   tint_step;
+
+  int   tint_start_hue;
+
+  int   fixed_hues_left;
+  int   fixed_hues_right;
+
+  int   n;
+  int   p;
+
+  /* each row of palette 0 (and of the variant palettes) is derived */
+  /* from its base level row, and each row of the other palettes is */
+  /* derived from the palette 0 row at the same level (level_row).  */
+  /* the alternate palettes also copy from the rotated or greyscale */
+  /* row at that level (companion_row). the row must already be     */
+  /* initialized.                                                   */
+  if ((pp == NULL) || (row == NULL) || (level_row == NULL))
+    return 1;
+
+  if (!is_palette_used(pp, palette))
+    return 0;
+
+  /* load parameters */
+  levels_per_palette = pp->levels_per_palette;
+  base_level = pp->base_level;
+
+  num_hues = pp->num_hues;
+  num_shades = pp->num_shades;
+
+  num_rotations = pp->num_rotations;
+  num_tints = pp->num_tints;
+
+  tint_start_hue = pp->tint_start_hue;
+
+  fixed_hues_left = pp->fixed_hues_left;
+  fixed_hues_right = pp->fixed_hues_right;
+
+  /* initialize derived variables */
+  num_gradients = num_hues + 1;
+
+  rotation_step = num_hues / num_rotations;
+  tint_step = num_hues / num_tints;
+
+  /* palette 0 & the variant palettes */
+  if ((palette == PALETTE_INDEX_STANDARD) || (palette >= PALETTE_NUM_INDICES))
+  {
+    /* base level */
+    if (level == base_level)
+    {
+      if (row != level_row)
+        copy_palette_bytes(row, level_row, 3 * num_gradients * num_shades);
+    }
+    /* shadows (shifted towards black) */
+    else if (level < base_level)
+    {
+      shift = get_palette_level_shift(pp, level);
+      whole = shift >> PALETTE_LEVEL_SHIFT_BITS;
+
+      for (n = 0; n < num_gradients; n++)
+      {
+        copy_palette_bytes( &row[3 * (num_shades * n + whole)],
+                            &level_row[3 * (num_shades * n)],
+                            3 * (num_shades - whole));
+
+        blend_palette_level_shift(&row[3 * (num_shades * n)], num_shades, shift, 0);
+      }
+    }
+    /* highlights (shifted towards white) */
+    else if (level < levels_per_palette)
+    {
+      shift = get_palette_level_shift(pp, level);
+      whole = shift >> PALETTE_LEVEL_SHIFT_BITS;
+
+      for (n = 0; n < num_gradients; n++)
+      {
+        copy_palette_bytes( &row[3 * (num_shades * n)],
+                            &level_row[3 * (num_shades * n + whole)],
+                            3 * (num_shades - whole));
+
+        blend_palette_level_shift(&row[3 * (num_shades * n)], num_shades, shift, 1);
+      }
+    }
+  }
+  /* palettes 1-5: rotations */
+  else if ((palette >= PALETTE_INDEX_ROTATE_60) && (palette <= PALETTE_INDEX_ROTATE_300))
+  {
+    p = palette - PALETTE_INDEX_ROTATE_60 + 1;
+
+    /* greys */
+    copy_palette_bytes( &row[0],
+                        &level_row[0],
+                        3 * num_shades);
+
+    /* rotated hues */
+    copy_palette_bytes( &row[3 * (1 * num_shades)],
+                        &level_row[3 * ((1 + p * rotation_step) * num_shades)],
+                        3 * (num_rotations - p) * rotation_step * num_shades);
+
+    copy_palette_bytes( &row[3 * ((1 + (num_rotations - p) * rotation_step) * num_shades)],
+                        &level_row[3 * num_shades],
+                        3 * p * rotation_step * num_shades);
+  }
+  /* palette 6: greyscale */
+  else if (palette == PALETTE_INDEX_GREYSCALE)
+  {
+    for (n = 0; n < num_gradients; n++)
+    {
+      copy_palette_bytes( &row[3 * (n * num_shades)],
+                          &level_row[3 * (0 * num_shades)],
+                          3 * num_shades);
+    }
+  }
+  /* palettes 7-12: alternate rotations & greyscale (preserving flesh tones) */
+  else if ((palette >= PALETTE_INDEX_ALTERNATE_ROTATE_60) && (palette <= PALETTE_INDEX_ALTERNATE_GREYSCALE))
+  {
+    if (companion_row == NULL)
+      return 1;
+
+    /* copying grey and the fixed hues on the left side */
+    copy_palette_bytes( &row[0],
+                        &level_row[0],
+                        3 * num_shades * (1 + fixed_hues_left));
+
+    /* copying the fixed hues on the right side */
+    copy_palette_bytes( &row[3 * ((1 + num_hues - fixed_hues_right) * num_shades)],
+                        &level_row[3 * ((1 + num_hues - fixed_hues_right) * num_shades)],
+                        3 * num_shades * fixed_hues_right);
+
+    /* copy the other hues from the rotated (or greyscale) palette */
+    copy_palette_bytes( &row[3 * ((1 + fixed_hues_left) * num_shades)],
+                        &companion_row[3 * ((1 + fixed_hues_left) * num_shades)],
+                        3 * num_shades * (num_hues - fixed_hues_left - fixed_hues_right));
+  }
+  /* palettes 13-15: tints */
+  else if ((palette >= PALETTE_INDEX_TINT_RED) && (palette <= PALETTE_INDEX_TINT_GREEN))
+  {
+    p = palette - PALETTE_INDEX_TINT_RED;
+
+    for (n = 0; n < num_gradients; n++)
+    {
+      copy_palette_bytes( &row[3 * (n * num_shades)],
+                          &level_row[3 * ((tint_start_hue + p * tint_step) * num_shades)],
+                          3 * num_shades);
+    }
+  }
+  else
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_palette_companion_index()
+*******************************************************************************/
+int get_palette_companion_index(int palette)
+{
+  /* the alternate palettes copy most of their hues from these */
+  if ((palette >= PALETTE_INDEX_ALTERNATE_ROTATE_60) && (palette <= PALETTE_INDEX_ALTERNATE_ROTATE_300))
+    return palette - PALETTE_INDEX_ALTERNATE_ROTATE_60 + PALETTE_INDEX_ROTATE_60;
+  else if (palette == PALETTE_INDEX_ALTERNATE_GREYSCALE)
+    return PALETTE_INDEX_GREYSCALE;
+  else
+    return -1;
+}
+
+/*******************************************************************************
+** generate_palette_composite_group_data()
+*******************************************************************************/
+short int generate_palette_composite_group_data( palette_params* pp, unsigned char* data,
+                                                 int first_palette, int num_palettes)
+{
+  int   row_stride;
+  int   levels_per_palette;
+  int   base_level;
+
+  int   last_palette;
+  int   first_variant;
+  int   companion;
+
+  int   m;
+  int   p;
+
+  unsigned char*  row;
+  unsigned char*  base_row;
+  unsigned char*  level_row;
+  unsigned char*  companion_row;
+
+  /* a group of palettes is generated (and initialized) one       */
+  /* lighting level at a time: the row of the first palette, then */
+  /* the same row of each other palette. every row a level reads  */
+  /* from (the palette 0 & companion rows) is in an earlier group  */
+  /* or was written just before, so it is still in the cache, and */
+  /* the group is only written once. the base level rows of the    */
+  /* variant palettes are transformed up front, since their other  */
+  /* levels are copied from them.                                  */
+  if ((pp == NULL) || (data == NULL))
+    return 1;
+
+  if ((first_palette < 0) || (num_palettes < 1) ||
+      (first_palette + num_palettes > get_palette_num_palettes(pp)))
+  {
+    return 1;
+  }
+
+  if (pp->row_stride > 0)
+    row_stride = pp->row_stride;
+  else
+    row_stride = pp->palette_size;
+
+  levels_per_palette = pp->levels_per_palette;
+  base_level = pp->base_level;
+
+  last_palette = first_palette + num_palettes;
+
+  /* palette 0 (base level) */
+  base_row = &data[3 * base_level * row_stride];
+
+  if (first_palette == PALETTE_INDEX_STANDARD)
+  {
+    init_palette_composite_row(pp, base_row, PALETTE_INDEX_STANDARD, base_level);
+
+    if (pp->base_row != NULL)
+      memcpy(base_row, pp->base_row, 3 * (pp->num_hues + 1) * pp->num_shades);
+    else if (generate_palette_base_row(pp, base_row))
+      return 1;
+  }
+
+  /* variant palettes (base level, transformed from palette 0) */
+  if (last_palette > PALETTE_NUM_INDICES)
+  {
+    if (first_palette > PALETTE_NUM_INDICES)
+      first_variant = first_palette - PALETTE_NUM_INDICES;
+    else
+      first_variant = 0;
+
+    for (p = PALETTE_NUM_INDICES + first_variant; p < last_palette; p++)
+    {
+      init_palette_composite_row( pp, &data[3 * ((p * levels_per_palette) + base_level) * row_stride],
+                                  p, base_level);
+    }
+
+    if (generate_palette_variant_rows(pp, base_row, data, first_variant,
+                                      last_palette - PALETTE_NUM_INDICES - first_variant))
+    {
+      return 1;
+    }
+  }
+
+  for (m = 0; m < levels_per_palette; m++)
+  {
+    for (p = first_palette; p < last_palette; p++)
+    {
+      row = &data[3 * ((p * levels_per_palette) + m) * row_stride];
+
+      if (((p != PALETTE_INDEX_STANDARD) && (p < PALETTE_NUM_INDICES)) || (m != base_level))
+        init_palette_composite_row(pp, row, p, m);
+
+      if (p == PALETTE_INDEX_STANDARD)
+        level_row = base_row;
+      else if (p >= PALETTE_NUM_INDICES)
+        level_row = &data[3 * ((p * levels_per_palette) + base_level) * row_stride];
+      else
+        level_row = &data[3 * m * row_stride];
+
+      companion = get_palette_companion_index(p);
+
+      if (companion >= 0)
+        companion_row = &data[3 * ((companion * levels_per_palette) + m) * row_stride];
+      else
+        companion_row = NULL;
+
+      if (generate_palette_composite_row(pp, row, p, m, level_row, companion_row))
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_palette_composite_data()
+*******************************************************************************/
+short int generate_palette_composite_data(palette_params* pp, unsigned char* data)
+{
+  if (pp == NULL)
+    return 1;
+
+  /* the whole texture is one group */
+  return generate_palette_composite_group_data( pp, data,
+                                                0, get_palette_num_palettes(pp));
+}
+
+/*******************************************************************************
+** generate_palette_composite_bands()
+*******************************************************************************/
+short int generate_palette_composite_bands(int first_band, int num_bands)
+{
+  /* each band is one palette */
+  return generate_palette_composite_group_data( &G_palette_params, G_palette_data,
+                                                first_band, num_bands);
+}
+
+/*******************************************************************************
+** setup_palette()
+*******************************************************************************/
+short int setup_palette()
+{
+  /* set palette size */
+  if (set_palette_size())
+    return 1;
+
+  /* set voltage table pointers */
+  if (set_voltage_table_pointers())
+    return 1;
+
+  /* set parameters & allocate palette data */
+  if (G_source == SOURCE_APPROX_NES)
+    return setup_palette_approx_nes(0);
+  else if (G_source == SOURCE_APPROX_NES_ROTATED)
+    return setup_palette_approx_nes(1);
+  else if (G_source == SOURCE_NTSC_NES)
+    return setup_palette_ntsc_nes();
+  else if (set_palette_params_for_source(&G_palette_params, G_source))
+  {
+    fprintf(stderr, "Cannot setup palette; invalid source specified.\n");
+    return 1;
+  }
+
+  /* the composite rows are initialized as they are generated */
+  return allocate_palette_composite();
+}
+
+/*******************************************************************************
+** get_palette_num_bands()
+*******************************************************************************/
+int get_palette_num_bands()
+{
+  /* each band is one palette, containing all of its lighting levels. */
+  /* the bands are generated in order, and each band only depends on  */
+  /* the bands before it, so a finished band will not change again.   */
+  if ((G_source == SOURCE_APPROX_NES) ||
+      (G_source == SOURCE_APPROX_NES_ROTATED))
+  {
+    return PALETTE_APPROX_NES_NUM_BANDS;
+  }
+  else if (G_source == SOURCE_NTSC_NES)
+    return NTSC_NUM_EMPHASIS;
+  else
+    return PALETTE_NUM_INDICES;
+}
+
+/*******************************************************************************
+** generate_palette_band()
+*******************************************************************************/
+short int generate_palette_band(int band)
+{
+  if (G_palette_data == NULL)
+    return 1;
+
+  if ((G_source == SOURCE_APPROX_NES) ||
+      (G_source == SOURCE_APPROX_NES_ROTATED))
+  {
+    return generate_palette_approx_nes_band(band);
+  }
+  else if (G_source == SOURCE_NTSC_NES)
+    return generate_palette_ntsc_nes_band(band);
+  else
+    return generate_palette_composite_bands(band, 1);
+}
+
+/*******************************************************************************
+** generate_palette_bands()
+*******************************************************************************/
+short int generate_palette_bands(int first_band, int num_bands)
+{
+  int k;
+
+  if (G_palette_data == NULL)
+    return 1;
+
+  /* the composite sources generate the bands together, level by level */
+  if (is_source_composite(G_source))
+    return generate_palette_composite_bands(first_band, num_bands);
+
+  for (k = first_band; k < first_band + num_bands; k++)
+  {
+    if (generate_palette_band(k))
+      return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_palette()
+*******************************************************************************/
+short int generate_palette()
+{
+  if (setup_palette())
+    return 1;
+
+  /* the composite sources are generated level by level, */
+  /* as one group of bands (see generate_palette_bands()) */
+  return generate_palette_bands(0, get_palette_num_bands());
+}
+
+/*******************************************************************************
+** generate_palette_in_place()
+*******************************************************************************/
+short int generate_palette_in_place(unsigned char* data)
+{
+  short int status;
+
+  /* the composite & ntsc nes sources are generated directly into  */
+  /* the caller's storage (3 bytes per pixel, in the current channel */
+  /* order). the approx nes sources need an alpha channel, so they   */
+  /* still use their own buffer.                                     */
+  if ((G_source == SOURCE_APPROX_NES) ||
+      (G_source == SOURCE_APPROX_NES_ROTATED))
+  {
+    return generate_palette();
+  }
+
+  S_palette_data_in_place = data;
+  status = generate_palette();
+
+  if (status)
+  {
+    S_palette_data_in_place = NULL;
+    G_palette_data = NULL;
+  }
+
+  return status;
+}
+
+/*******************************************************************************
+** clear_palette()
+*******************************************************************************/
+short int clear_palette()
+{
+  /* the arena is kept for the next palette (see free_palette_arena()), */
+  /* and storage provided by the caller is not freed                    */
+  G_palette_data = NULL;
+  S_palette_data_in_place = NULL;
+
+  return 0;
+}
@@ -0,0 +1,234 @@
+/*******************************************************************************
+** palette.h (palette generation)
+*******************************************************************************/
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#define PI      3.14159265358979323846f
+#define TWO_PI  6.28318530717958647693f
+
+enum
+{
+  PALETTE_INDEX_STANDARD = 0,
+  PALETTE_INDEX_ROTATE_60,
+  PALETTE_INDEX_ROTATE_120,
+  PALETTE_INDEX_ROTATE_180,
+  PALETTE_INDEX_ROTATE_240,
+  PALETTE_INDEX_ROTATE_300,
+  PALETTE_INDEX_GREYSCALE,
+  PALETTE_INDEX_ALTERNATE_ROTATE_60,
+  PALETTE_INDEX_ALTERNATE_ROTATE_120,
+  PALETTE_INDEX_ALTERNATE_ROTATE_180,
+  PALETTE_INDEX_ALTERNATE_ROTATE_240,
+  PALETTE_INDEX_ALTERNATE_ROTATE_300,
+  PALETTE_INDEX_ALTERNATE_GREYSCALE,
+  PALETTE_INDEX_TINT_RED,
+  PALETTE_INDEX_TINT_BLUE,
+  PALETTE_INDEX_TINT_GREEN,
+  PALETTE_NUM_INDICES
+};
+
+enum
+{
+  PALETTE_MODE_STANDARD = 0,
+  PALETTE_MODE_ROTATED,
+  PALETTE_MODE_DOUBLED,
+  PALETTE_NUM_MODES
+};
+
+enum
+{
+  /* 64 color palettes */
+  SOURCE_APPROX_NES = 0,
+  SOURCE_APPROX_NES_ROTATED,
+  SOURCE_NTSC_NES,
+  /* 256 color palettes */
+  SOURCE_COMPOSITE_08,
+  SOURCE_COMPOSITE_16,
+  SOURCE_COMPOSITE_16_ROTATED,
+  /* 1024 color palettes */
+  SOURCE_COMPOSITE_32,
+  NUM_SOURCES
+};
+
+/* color transforms for the variant palettes (which are added after */
+/* the palettes above, starting at PALETTE_NUM_INDICES)             */
+enum
+{
+  PALETTE_TRANSFORM_PROTAN = 0,
+  PALETTE_TRANSFORM_DEUTAN,
+  PALETTE_TRANSFORM_TRITAN,
+  PALETTE_TRANSFORM_NIGHT,
+  PALETTE_TRANSFORM_SEPIA,
+  PALETTE_NUM_TRANSFORMS
+};
+
+/* byte order of the pixels in the 3 byte per pixel palette data */
+enum
+{
+  PALETTE_CHANNEL_ORDER_RGB = 0,
+  PALETTE_CHANNEL_ORDER_BGR
+};
+
+/* the approx nes texture has 8 palettes of 8 levels each, and each   */
+/* row has 55 colors (transparent, black, 4 greys, white, 12 hues x 4) */
+#define PALETTE_APPROX_NES_NUM_BANDS  8
+#define PALETTE_APPROX_NES_NUM_COLORS 55
+
+#define PALETTE_APPROX_NES_NUM_LEVELS 8
+#define PALETTE_APPROX_NES_BASE_LEVEL (PALETTE_APPROX_NES_NUM_LEVELS / 2)
+#define PALETTE_APPROX_NES_NUM_SHADES 4
+
+/* alignment of the palette buffers (a cache line) */
+#define PALETTE_BUFFER_ALIGNMENT 64
+
+/* largest texture size for the composite generator */
+#define PALETTE_MAX_SIZE 8192
+
+/* the level shifts are in fractions of a shade (1 / 256), and */
+/* a shift between two shades blends them                      */
+#define PALETTE_MIN_LEVELS  2
+#define PALETTE_MAX_LEVELS  (PALETTE_MAX_SIZE / PALETTE_NUM_INDICES)
+
+#define PALETTE_LEVEL_SHIFT_BITS  8
+#define PALETTE_LEVEL_SHIFT_ONE   (1 << PALETTE_LEVEL_SHIFT_BITS)
+
+/* largest number of variant palettes (the watch mode keeps a bit */
+/* for each palette in a long)                                    */
+#define PALETTE_MAX_VARIANTS 8
+
+/* the size of the table step is 1 / (n + 2), */
+/* where n is the number of colors per hue    */
+#define PALETTE_256_COLOR_TABLE_STEP  0.055555555555556f  /* 1/18 (n = 16) */
+#define PALETTE_1024_COLOR_TABLE_STEP 0.029411764705882f  /* 1/34 (n = 32) */
+
+/* a variant palette is palette 0 with each color transformed by */
+/* rgb' = matrix * rgb + offset (rgb in 0-1, the matrix row major) */
+typedef struct palette_transform
+{
+  float matrix[9];
+  float offset[3];
+} palette_transform;
+
+/* parameters for the 256 and 1024 color generators */
+typedef struct palette_params
+{
+  int   palette_size;
+
+  /* lighting levels per palette (0 for the palette size / 16) */
+  int   num_levels;
+
+  int   levels_per_palette;
+  int   base_level;
+
+  int   num_hues;
+  int   num_shades;
+
+  int   num_rotations;
+  int   num_tints;
+
+  float phi;
+
+  int   tint_start_hue;
+
+  int   fixed_hues_left;
+  int   fixed_hues_right;
+
+  float*  luma_table;
+  float*  saturation_table;
+
+  /* variant palettes (after the 16 palettes above) */
+  int               num_variants;
+  palette_transform variants[PALETTE_MAX_VARIANTS];
+
+  int   channel_order;
+
+  /* precomputed palette 0 base level row (or NULL) */
+  unsigned char*  base_row;
+
+  /* distance between rows in pixels (0 for the palette size) */
+  int   row_stride;
+} palette_params;
+
+/* the composite rows are built with copies & fills only (apart from */
+/* the palette 0 base row), which can be recorded with this hook     */
+/* (src is NULL for a fill)                                          */
+typedef void (*palette_copy_hook)(unsigned char* dest, unsigned char* src,
+                                  int value, long num_bytes);
+
+extern int  G_source;
+extern int  G_palette_size;
+
+extern unsigned char* G_palette_data;
+
+extern int  G_palette_channel_order;
+
+extern palette_params G_palette_params;
+
+extern palette_copy_hook  G_palette_copy_hook;
+
+/* function declarations */
+short int generate_voltage_tables();
+short int generate_uniform_voltage_table( float* luma_table, float* saturation_table,
+                                          int num_shades, float table_step);
+short int get_source_voltage_tables(int source,
+                                    float** luma_table, float** saturation_table,
+                                    int* table_length);
+short int set_voltage_table_pointers();
+
+unsigned char*  allocate_aligned_buffer(long num_bytes);
+short int       free_palette_arena();
+
+int       is_source_composite(int source);
+int       get_source_palette_size(int source);
+short int set_palette_size();
+
+char*     get_source_name(int source);
+char*     get_palette_source_name();
+int       get_palette_source_from_name(char* name);
+int       get_palette_bytes_per_pixel();
+
+short int set_palette_params_256_color(palette_params* pp, int mode);
+short int set_palette_params_1024_color(palette_params* pp);
+short int set_palette_params_for_source(palette_params* pp, int source);
+
+short int setup_palette();
+int       get_palette_num_bands();
+short int generate_palette_band(int band);
+short int generate_palette_bands(int first_band, int num_bands);
+
+short int set_palette_transform(palette_transform* pt, int transform);
+int       get_palette_transform_from_name(char* name);
+
+short int derive_palette_params(palette_params* pp);
+int       get_palette_num_palettes(palette_params* pp);
+int       get_palette_height(palette_params* pp);
+int       get_palette_level_shift(palette_params* pp, int level);
+short int blend_palette_level_shift(unsigned char* gradient, int num_shades,
+                                    int shift, int highlight_flag);
+short int compute_palette_base_color(palette_params* pp, int gradient, int shade,
+                                     float* rgb);
+short int generate_palette_base_row(palette_params* pp, unsigned char* row);
+short int generate_palette_variant_rows(palette_params* pp, unsigned char* base_row,
+                                        unsigned char* data,
+                                        int first_variant, int num_variants);
+int       is_palette_used(palette_params* pp, int palette);
+void      copy_palette_bytes(unsigned char* dest, unsigned char* src, long num_bytes);
+void      fill_palette_bytes(unsigned char* dest, int value, long num_bytes);
+short int init_palette_composite_row(palette_params* pp, unsigned char* row,
+                                     int palette, int level);
+short int generate_palette_composite_row( palette_params* pp, unsigned char* row,
+                                          int palette, int level,
+                                          unsigned char* level_row,
+                                          unsigned char* companion_row);
+int       get_palette_companion_index(int palette);
+short int generate_palette_composite_group_data( palette_params* pp, unsigned char* data,
+                                                 int first_palette, int num_palettes);
+short int generate_palette_composite_data(palette_params* pp, unsigned char* data);
+
+short int generate_palette();
+short int generate_palette_in_place(unsigned char* data);
+short int clear_palette();
+
+#endif
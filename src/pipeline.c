@@ -0,0 +1,212 @@
+/*******************************************************************************
+** pipeline.c (pipelined generation & output)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "palette.h"
+#include "pipeline.h"
+#include "tga.h"
+
+/* the generator (main thread) fills G_palette_data one band    */
+/* at a time, while the writer thread converts & flushes the    */
+/* bands that are already finished. since every band is derived */
+/* from the bands before it, a finished band never changes, and */
+/* the writer can read it while the next band is being filled.  */
+/*                                                              */
+/* the composite sources are generated level by level (see      */
+/* generate_palette_composite_group_data()), which finishes all */
+/* of the bands being generated at the last level. they are      */
+/* generated in groups of palettes instead, and each group is    */
+/* handed off once its last level is finished.                   */
+
+pthread_mutex_t S_pipeline_mutex;
+pthread_cond_t  S_pipeline_cond;
+
+int   S_pipeline_bands_done;
+int   S_pipeline_abort;
+int   S_pipeline_writer_failed;
+
+FILE* S_pipeline_fp_out;
+
+/*******************************************************************************
+** pipeline_writer_thread()
+*******************************************************************************/
+void* pipeline_writer_thread(void* arg)
+{
+  int   num_bands;
+  int   rows_per_band;
+
+  int   k;
+
+  unsigned char* band_buffer;
+
+  (void) arg;
+
+  num_bands = get_palette_num_bands();
+  rows_per_band = G_palette_size / num_bands;
+
+  /* allocate band buffer */
+  band_buffer = malloc(sizeof(unsigned char) * 3 * G_palette_size * rows_per_band);
+
+  if (band_buffer == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: Unable to allocate band buffer.\n");
+    goto fail;
+  }
+
+  /* the header can be written while palette 0 is generated */
+  if (write_tga_header(S_pipeline_fp_out))
+    goto fail;
+
+  for (k = 0; k < num_bands; k++)
+  {
+    /* wait for this band to be finished */
+    pthread_mutex_lock(&S_pipeline_mutex);
+
+    while ((S_pipeline_bands_done <= k) && (!S_pipeline_abort))
+      pthread_cond_wait(&S_pipeline_cond, &S_pipeline_mutex);
+
+    if (S_pipeline_bands_done <= k)
+    {
+      pthread_mutex_unlock(&S_pipeline_mutex);
+      goto fail;
+    }
+
+    pthread_mutex_unlock(&S_pipeline_mutex);
+
+    /* convert and write this band */
+    convert_tga_rows(band_buffer, k * rows_per_band, rows_per_band);
+
+    if (fwrite( band_buffer, 3 * G_palette_size, rows_per_band, S_pipeline_fp_out) <
+                (size_t) rows_per_band)
+    {
+      goto fail;
+    }
+  }
+
+  free(band_buffer);
+
+  return NULL;
+
+fail:
+  if (band_buffer != NULL)
+    free(band_buffer);
+
+  pthread_mutex_lock(&S_pipeline_mutex);
+  S_pipeline_writer_failed = 1;
+  pthread_mutex_unlock(&S_pipeline_mutex);
+
+  return NULL;
+}
+
+/*******************************************************************************
+** generate_and_write_tga_file()
+*******************************************************************************/
+short int generate_and_write_tga_file(FILE* fp_out)
+{
+  pthread_t writer;
+
+  int       num_bands;
+  int       group_size;
+  int       k;
+
+  short int status;
+
+  if (fp_out == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: No output stream specified.\n");
+    return 1;
+  }
+
+  /* set parameters & allocate palette data */
+  if (setup_palette())
+  {
+    fprintf(stderr, "Error generating texture.\n");
+    return 1;
+  }
+
+  num_bands = get_palette_num_bands();
+
+  if (is_source_composite(G_source))
+    group_size = PIPELINE_COMPOSITE_GROUP_SIZE;
+  else
+    group_size = 1;
+
+  /* initialize pipeline state */
+  S_pipeline_bands_done = 0;
+  S_pipeline_abort = 0;
+  S_pipeline_writer_failed = 0;
+
+  S_pipeline_fp_out = fp_out;
+
+  pthread_mutex_init(&S_pipeline_mutex, NULL);
+  pthread_cond_init(&S_pipeline_cond, NULL);
+
+  /* start writer thread */
+  if (pthread_create(&writer, NULL, pipeline_writer_thread, NULL))
+  {
+    pthread_cond_destroy(&S_pipeline_cond);
+    pthread_mutex_destroy(&S_pipeline_mutex);
+
+    /* fall back to generating first, then writing */
+    if (generate_palette_bands(0, num_bands))
+    {
+      fprintf(stderr, "Error generating texture.\n");
+      return 1;
+    }
+
+    return write_tga_file(fp_out);
+  }
+
+  /* generate groups of bands, handing each one off to the writer */
+  status = 0;
+
+  for (k = 0; k < num_bands; k += group_size)
+  {
+    if (k + group_size > num_bands)
+      group_size = num_bands - k;
+
+    if (generate_palette_bands(k, group_size))
+    {
+      fprintf(stderr, "Error generating texture.\n");
+      status = 1;
+      break;
+    }
+
+    pthread_mutex_lock(&S_pipeline_mutex);
+
+    S_pipeline_bands_done = k + group_size;
+    pthread_cond_signal(&S_pipeline_cond);
+
+    /* stop early if the output is gone */
+    if (S_pipeline_writer_failed)
+      status = 1;
+
+    pthread_mutex_unlock(&S_pipeline_mutex);
+
+    if (status)
+      break;
+  }
+
+  if (status)
+  {
+    pthread_mutex_lock(&S_pipeline_mutex);
+    S_pipeline_abort = 1;
+    pthread_cond_signal(&S_pipeline_cond);
+    pthread_mutex_unlock(&S_pipeline_mutex);
+  }
+
+  /* wait for writer thread */
+  pthread_join(writer, NULL);
+
+  if (S_pipeline_writer_failed)
+    status = 1;
+
+  pthread_cond_destroy(&S_pipeline_cond);
+  pthread_mutex_destroy(&S_pipeline_mutex);
+
+  return status;
+}
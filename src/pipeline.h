@@ -0,0 +1,17 @@
+/*******************************************************************************
+** pipeline.h (pipelined generation & output)
+*******************************************************************************/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+
+/* the composite sources are generated level by level within groups */
+/* of this many palettes, and each group is written as a whole      */
+#define PIPELINE_COMPOSITE_GROUP_SIZE 4
+
+/* function declarations */
+short int generate_and_write_tga_file(FILE* fp_out);
+
+#endif
@@ -0,0 +1,198 @@
+/*******************************************************************************
+** pool.c (work-stealing thread pool)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/* each worker starts with a contiguous range of task indices. */
+/* it takes tasks from the front of its own range, and when it */
+/* runs out, it steals the back half of another worker's range */
+/* (so that neighbouring tasks tend to stay on the same core). */
+/* a worker exits once it finds every other range empty.       */
+
+typedef struct pool_worker
+{
+  pthread_mutex_t mutex;
+
+  long  begin;
+  long  end;
+
+  int   index;
+} pool_worker;
+
+pool_worker     S_pool_workers[POOL_MAX_THREADS];
+int             S_pool_num_workers;
+
+pool_task_func  S_pool_func;
+void*           S_pool_arg;
+
+/*******************************************************************************
+** get_default_num_threads()
+*******************************************************************************/
+int get_default_num_threads()
+{
+  long num_threads;
+
+  num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (num_threads < 1)
+    num_threads = 1;
+  else if (num_threads > POOL_MAX_THREADS)
+    num_threads = POOL_MAX_THREADS;
+
+  return (int) num_threads;
+}
+
+/*******************************************************************************
+** steal_pool_tasks()
+*******************************************************************************/
+short int steal_pool_tasks(pool_worker* thief)
+{
+  pool_worker*  victim;
+
+  long  begin;
+  long  end;
+
+  int   k;
+
+  for (k = 1; k < S_pool_num_workers; k++)
+  {
+    victim = &S_pool_workers[(thief->index + k) % S_pool_num_workers];
+
+    pthread_mutex_lock(&victim->mutex);
+
+    if (victim->end - victim->begin > 0)
+    {
+      /* take the back half (or the last task) */
+      end = victim->end;
+      begin = victim->begin + (victim->end - victim->begin) / 2;
+
+      victim->end = begin;
+
+      pthread_mutex_unlock(&victim->mutex);
+
+      pthread_mutex_lock(&thief->mutex);
+      thief->begin = begin;
+      thief->end = end;
+      pthread_mutex_unlock(&thief->mutex);
+
+      return 0;
+    }
+
+    pthread_mutex_unlock(&victim->mutex);
+  }
+
+  return 1;
+}
+
+/*******************************************************************************
+** pool_worker_thread()
+*******************************************************************************/
+void* pool_worker_thread(void* arg)
+{
+  pool_worker*  worker;
+
+  long  index;
+
+  worker = (pool_worker*) arg;
+
+  while (1)
+  {
+    /* take the next task from our own range */
+    pthread_mutex_lock(&worker->mutex);
+
+    if (worker->begin < worker->end)
+    {
+      index = worker->begin;
+      worker->begin += 1;
+
+      pthread_mutex_unlock(&worker->mutex);
+
+      S_pool_func(worker->index, index, S_pool_arg);
+      continue;
+    }
+
+    pthread_mutex_unlock(&worker->mutex);
+
+    /* our range is empty, so steal from another worker */
+    if (steal_pool_tasks(worker))
+      break;
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+** run_pool_tasks()
+*******************************************************************************/
+short int run_pool_tasks( int num_threads, long num_tasks,
+                          pool_task_func func, void* arg)
+{
+  pthread_t threads[POOL_MAX_THREADS];
+  int       started[POOL_MAX_THREADS];
+
+  long      index;
+  int       k;
+
+  if ((func == NULL) || (num_tasks < 0))
+    return 1;
+
+  if (num_threads < 1)
+    num_threads = 1;
+  else if (num_threads > POOL_MAX_THREADS)
+    num_threads = POOL_MAX_THREADS;
+
+  if (num_threads > num_tasks)
+    num_threads = (num_tasks > 0) ? (int) num_tasks : 1;
+
+  S_pool_num_workers = num_threads;
+  S_pool_func = func;
+  S_pool_arg = arg;
+
+  /* split the tasks evenly among the workers */
+  for (k = 0; k < num_threads; k++)
+  {
+    pthread_mutex_init(&S_pool_workers[k].mutex, NULL);
+
+    S_pool_workers[k].begin = (num_tasks * k) / num_threads;
+    S_pool_workers[k].end = (num_tasks * (k + 1)) / num_threads;
+    S_pool_workers[k].index = k;
+  }
+
+  /* worker 0 runs on the calling thread */
+  for (k = 1; k < num_threads; k++)
+  {
+    if (pthread_create(&threads[k], NULL, pool_worker_thread, &S_pool_workers[k]))
+      started[k] = 0;
+    else
+      started[k] = 1;
+  }
+
+  pool_worker_thread(&S_pool_workers[0]);
+
+  for (k = 1; k < num_threads; k++)
+  {
+    if (started[k])
+      pthread_join(threads[k], NULL);
+  }
+
+  /* run any tasks left in the ranges of workers that did not start */
+  for (k = 1; k < num_threads; k++)
+  {
+    if (!started[k])
+    {
+      for (index = S_pool_workers[k].begin; index < S_pool_workers[k].end; index++)
+        func(0, index, arg);
+    }
+  }
+
+  for (k = 0; k < num_threads; k++)
+    pthread_mutex_destroy(&S_pool_workers[k].mutex);
+
+  return 0;
+}
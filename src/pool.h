@@ -0,0 +1,20 @@
+/*******************************************************************************
+** pool.h (work-stealing thread pool)
+*******************************************************************************/
+
+#ifndef POOL_H
+#define POOL_H
+
+#define POOL_MAX_THREADS 64
+
+/* a task is identified by its index; the worker index */
+/* can be used to select per-thread reusable buffers   */
+typedef void (*pool_task_func)(int worker, long index, void* arg);
+
+/* function declarations */
+int       get_default_num_threads();
+
+short int run_pool_tasks( int num_threads, long num_tasks,
+                          pool_task_func func, void* arg);
+
+#endif
@@ -0,0 +1,491 @@
+/*******************************************************************************
+** publish.c (palette textures in posix shared memory)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "palette.h"
+#include "publish.h"
+
+/*******************************************************************************
+** get_publish_segment_name()
+*******************************************************************************/
+short int get_publish_segment_name(char* segment_name, char* name, unsigned int generation)
+{
+  if ((name == NULL) || (name[0] == '\0') ||
+      (strlen(name) >= PUBLISH_NAME_LENGTH) || (strchr(name, '/') != NULL))
+  {
+    fprintf(stderr, "Invalid shared memory name %s.\n", (name != NULL) ? name : "");
+    return 1;
+  }
+
+  /* generation 0 is the "/name" segment (the current generation) */
+  if (generation == 0)
+    sprintf(segment_name, "/%s", name);
+  else
+    sprintf(segment_name, "/%s.%u", name, generation);
+
+  return 0;
+}
+
+/*******************************************************************************
+** is_publish_header_valid()
+*******************************************************************************/
+int is_publish_header_valid(publish_header* header)
+{
+  return (header->magic == PUBLISH_MAGIC) &&
+         (header->version == PUBLISH_VERSION) &&
+         (header->header_size == sizeof(publish_header));
+}
+
+/*******************************************************************************
+** fill_publish_header()
+*******************************************************************************/
+short int fill_publish_header(publish_header* header, unsigned int generation)
+{
+  memset(header, 0, sizeof(publish_header));
+
+  header->magic = PUBLISH_MAGIC;
+  header->version = PUBLISH_VERSION;
+  header->header_size = sizeof(publish_header);
+  header->generation = generation;
+
+  header->source = G_source;
+  strncpy(header->source_name, get_palette_source_name(), PUBLISH_SOURCE_NAME_LENGTH - 1);
+
+  header->width = G_palette_size;
+  header->height = G_palette_size;
+  header->bytes_per_pixel = get_palette_bytes_per_pixel();
+  header->channel_order = PALETTE_CHANNEL_ORDER_RGB;
+
+  header->num_palettes = get_palette_num_bands();
+  header->levels_per_palette = G_palette_size / get_palette_num_bands();
+
+  header->data_offset = PUBLISH_DATA_OFFSET;
+  header->data_size = header->bytes_per_pixel * G_palette_size * G_palette_size;
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_publish_segment()
+*******************************************************************************/
+short int write_publish_segment(char* segment_name, unsigned int generation)
+{
+  int   fd;
+
+  publish_header  header;
+
+  unsigned char*  mapping;
+  size_t          mapping_size;
+
+  short int status;
+
+  /* a segment left over from an interrupted run is replaced */
+  fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+  if ((fd < 0) && (errno == EEXIST))
+  {
+    shm_unlink(segment_name);
+    fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  }
+
+  if (fd < 0)
+  {
+    fprintf(stderr, "Unable to create shared memory segment %s.\n", segment_name);
+    return 1;
+  }
+
+  fill_publish_header(&header, generation);
+
+  mapping_size = (size_t) header.data_offset + header.data_size;
+
+  if (ftruncate(fd, (off_t) mapping_size) < 0)
+  {
+    fprintf(stderr, "Unable to resize shared memory segment %s.\n", segment_name);
+    close(fd);
+    shm_unlink(segment_name);
+    return 1;
+  }
+
+  mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    fprintf(stderr, "Unable to map shared memory segment %s.\n", segment_name);
+    shm_unlink(segment_name);
+    return 1;
+  }
+
+  /* generate the texture directly into the segment (the approx */
+  /* nes sources are generated in their own buffer, and copied)  */
+  status = generate_palette_in_place(&mapping[header.data_offset]);
+
+  if ((!status) && (G_palette_data != &mapping[header.data_offset]))
+    memcpy(&mapping[header.data_offset], G_palette_data, header.data_size);
+
+  if (status)
+    fprintf(stderr, "Error generating texture.\n");
+
+  /* the texture is no longer needed in this process */
+  clear_palette();
+
+  memcpy(mapping, &header, sizeof(publish_header));
+
+  if (munmap(mapping, mapping_size) < 0)
+    status = 1;
+
+  if (status)
+    shm_unlink(segment_name);
+
+  return status;
+}
+
+/*******************************************************************************
+** publish_texture()
+*******************************************************************************/
+short int publish_texture(char* name)
+{
+  int   fd;
+
+  char  segment_name[PUBLISH_NAME_LENGTH + 16];
+  char  new_segment_name[PUBLISH_NAME_LENGTH + 16];
+  char  old_segment_name[PUBLISH_NAME_LENGTH + 16];
+
+  struct stat   segment_info;
+  struct flock  lock;
+
+  publish_header* current;
+  publish_header  header;
+
+  unsigned int  generation;
+  unsigned int  old_generation;
+
+  short int status;
+
+  if (get_publish_segment_name(segment_name, name, 0))
+    return 1;
+
+  if (set_palette_size())
+    return 1;
+
+  /* open (or create) the current generation segment */
+  fd = shm_open(segment_name, O_RDWR | O_CREAT, 0644);
+
+  if (fd < 0)
+  {
+    fprintf(stderr, "Unable to open shared memory segment %s.\n", segment_name);
+    return 1;
+  }
+
+  /* one publisher at a time */
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = 0;
+  lock.l_len = 0;
+
+  if (fcntl(fd, F_SETLKW, &lock) < 0)
+  {
+    fprintf(stderr, "Unable to lock shared memory segment %s.\n", segment_name);
+    close(fd);
+    return 1;
+  }
+
+  if ((fstat(fd, &segment_info) < 0) ||
+      ( ((size_t) segment_info.st_size < sizeof(publish_header)) &&
+        (ftruncate(fd, sizeof(publish_header)) < 0)))
+  {
+    fprintf(stderr, "Unable to resize shared memory segment %s.\n", segment_name);
+    close(fd);
+    return 1;
+  }
+
+  current = mmap(NULL, sizeof(publish_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (current == MAP_FAILED)
+  {
+    fprintf(stderr, "Unable to map shared memory segment %s.\n", segment_name);
+    close(fd);
+    return 1;
+  }
+
+  /* the next generation (generations start at 1) */
+  if (is_publish_header_valid(current))
+    old_generation = current->generation;
+  else
+    old_generation = 0;
+
+  generation = old_generation + 1;
+
+  if (generation == 0)
+    generation = 1;
+
+  /* write the new generation */
+  get_publish_segment_name(new_segment_name, name, generation);
+
+  status = write_publish_segment(new_segment_name, generation);
+
+  /* make it current: the header first, and then the generation */
+  if (!status)
+  {
+    fill_publish_header(&header, old_generation);
+
+    if (!is_publish_header_valid(current))
+      current->generation = 0;
+
+    current->magic = header.magic;
+    current->version = header.version;
+    current->header_size = header.header_size;
+    current->source = header.source;
+    memcpy(current->source_name, header.source_name, PUBLISH_SOURCE_NAME_LENGTH);
+    current->width = header.width;
+    current->height = header.height;
+    current->bytes_per_pixel = header.bytes_per_pixel;
+    current->channel_order = header.channel_order;
+    current->num_palettes = header.num_palettes;
+    current->levels_per_palette = header.levels_per_palette;
+    current->data_offset = header.data_offset;
+    current->data_size = header.data_size;
+
+#ifdef __GNUC__
+    __sync_synchronize();
+#endif
+
+    current->generation = generation;
+
+#ifdef __GNUC__
+    __sync_synchronize();
+#endif
+
+    /* the consumers of the previous generation keep their mappings */
+    if (old_generation != 0)
+    {
+      get_publish_segment_name(old_segment_name, name, old_generation);
+      shm_unlink(old_segment_name);
+    }
+
+    printf("published %s generation %u (%s, %ux%u)\n",
+           segment_name, generation, header.source_name, header.width, header.height);
+  }
+
+  munmap(current, sizeof(publish_header));
+
+  /* closing the descriptor releases the lock */
+  if (close(fd) < 0)
+    status = 1;
+
+  return status;
+}
+
+/*******************************************************************************
+** unpublish_texture()
+*******************************************************************************/
+short int unpublish_texture(char* name)
+{
+  char  segment_name[PUBLISH_NAME_LENGTH + 16];
+
+  unsigned int  generation;
+
+  if (get_publish_segment_name(segment_name, name, 0))
+    return 1;
+
+  generation = get_published_generation(name);
+
+  if (shm_unlink(segment_name) < 0)
+  {
+    fprintf(stderr, "Unable to remove shared memory segment %s.\n", segment_name);
+    return 1;
+  }
+
+  if (generation != 0)
+  {
+    get_publish_segment_name(segment_name, name, generation);
+    shm_unlink(segment_name);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_published_generation()
+*******************************************************************************/
+unsigned int get_published_generation(char* name)
+{
+  int   fd;
+
+  char  segment_name[PUBLISH_NAME_LENGTH + 16];
+
+  struct stat segment_info;
+
+  publish_header* current;
+  unsigned int    generation;
+
+  if (get_publish_segment_name(segment_name, name, 0))
+    return 0;
+
+  fd = shm_open(segment_name, O_RDONLY, 0);
+
+  if (fd < 0)
+    return 0;
+
+  if ((fstat(fd, &segment_info) < 0) ||
+      ((size_t) segment_info.st_size < sizeof(publish_header)))
+  {
+    close(fd);
+    return 0;
+  }
+
+  current = mmap(NULL, sizeof(publish_header), PROT_READ, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (current == MAP_FAILED)
+    return 0;
+
+  if (is_publish_header_valid(current))
+    generation = current->generation;
+  else
+    generation = 0;
+
+  munmap(current, sizeof(publish_header));
+
+  return generation;
+}
+
+/*******************************************************************************
+** map_published_texture()
+*******************************************************************************/
+short int map_published_texture(char* name, publish_view* view)
+{
+  int   fd;
+
+  char  segment_name[PUBLISH_NAME_LENGTH + 16];
+
+  struct stat segment_info;
+
+  unsigned int  generation;
+  int           attempt;
+
+  if (view == NULL)
+    return 1;
+
+  view->header = NULL;
+  view->mapping = NULL;
+  view->mapping_size = 0;
+  view->data = NULL;
+
+  /* the generation can be replaced (and its segment unlinked) */
+  /* between reading it and opening it, so try again if it is  */
+  for (attempt = 0; attempt < 3; attempt++)
+  {
+    generation = get_published_generation(name);
+
+    if (generation == 0)
+      return 1;
+
+    get_publish_segment_name(segment_name, name, generation);
+
+    fd = shm_open(segment_name, O_RDONLY, 0);
+
+    if (fd >= 0)
+      break;
+  }
+
+  if (fd < 0)
+    return 1;
+
+  if ((fstat(fd, &segment_info) < 0) ||
+      ((size_t) segment_info.st_size < PUBLISH_DATA_OFFSET))
+  {
+    close(fd);
+    return 1;
+  }
+
+  view->mapping_size = segment_info.st_size;
+  view->mapping = mmap(NULL, view->mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (view->mapping == MAP_FAILED)
+  {
+    view->mapping = NULL;
+    return 1;
+  }
+
+  view->header = (publish_header*) view->mapping;
+
+  if ((!is_publish_header_valid(view->header)) ||
+      (view->header->generation != generation) ||
+      ((size_t) view->header->data_offset + view->header->data_size > view->mapping_size))
+  {
+    unmap_published_texture(view);
+    return 1;
+  }
+
+  view->data = &view->mapping[view->header->data_offset];
+
+  return 0;
+}
+
+/*******************************************************************************
+** unmap_published_texture()
+*******************************************************************************/
+short int unmap_published_texture(publish_view* view)
+{
+  if (view == NULL)
+    return 1;
+
+  if (view->mapping != NULL)
+  {
+    munmap(view->mapping, view->mapping_size);
+    view->mapping = NULL;
+  }
+
+  view->header = NULL;
+  view->mapping_size = 0;
+  view->data = NULL;
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_published_info()
+*******************************************************************************/
+short int write_published_info(FILE* fp_out, char* name)
+{
+  publish_view  view;
+  publish_header* header;
+
+  if (fp_out == NULL)
+    return 1;
+
+  if (map_published_texture(name, &view))
+  {
+    fprintf(stderr, "Unable to map the published texture %s.\n", name);
+    return 1;
+  }
+
+  header = view.header;
+
+  fprintf(fp_out, "name: %s\n", name);
+  fprintf(fp_out, "generation: %u\n", header->generation);
+  fprintf(fp_out, "source: %s\n", header->source_name);
+  fprintf(fp_out, "size: %ux%u\n", header->width, header->height);
+  fprintf(fp_out, "bytes per pixel: %u\n", header->bytes_per_pixel);
+  fprintf(fp_out, "palettes: %u of %u levels\n",
+          header->num_palettes, header->levels_per_palette);
+  fprintf(fp_out, "data: %u bytes at offset %u\n", header->data_size, header->data_offset);
+
+  unmap_published_texture(&view);
+
+  return 0;
+}
@@ -0,0 +1,76 @@
+/*******************************************************************************
+** publish.h (palette textures in posix shared memory)
+*******************************************************************************/
+
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <stdio.h>
+
+/* "TXSH" (little endian), and the version of the header layout */
+#define PUBLISH_MAGIC   0x48535854UL
+#define PUBLISH_VERSION 1
+
+/* the texture data starts on its own page */
+#define PUBLISH_DATA_OFFSET 4096
+
+#define PUBLISH_NAME_LENGTH         64
+#define PUBLISH_SOURCE_NAME_LENGTH  32
+
+/* a texture named "name" is published in two segments: "/name" only    */
+/* has the header of the current generation, and "/name.<generation>"   */
+/* has the header followed by the texture (at the data offset). a new   */
+/* generation is written to its own segment, and then made current by  */
+/* storing its number in the "/name" header (the other fields are      */
+/* written first). consumers map "/name" read-only, open the segment of */
+/* the generation they find there (and check that its header has the   */
+/* same generation), and can compare the generation later to see if    */
+/* the texture was regenerated. the previous segment is unlinked, but   */
+/* stays valid for the consumers that still have it mapped.             */
+typedef struct publish_header
+{
+  unsigned int  magic;
+  unsigned int  version;
+  unsigned int  header_size;
+
+  volatile unsigned int generation;
+
+  /* source (palette.h enum & name) */
+  unsigned int  source;
+  char          source_name[PUBLISH_SOURCE_NAME_LENGTH];
+
+  /* texture layout: rows of pixels, one band of levels per palette */
+  unsigned int  width;
+  unsigned int  height;
+  unsigned int  bytes_per_pixel;
+  unsigned int  channel_order;
+
+  unsigned int  num_palettes;
+  unsigned int  levels_per_palette;
+
+  unsigned int  data_offset;
+  unsigned int  data_size;
+} publish_header;
+
+/* a consumer's read-only view of one generation */
+typedef struct publish_view
+{
+  publish_header* header;
+
+  unsigned char*  mapping;
+  size_t          mapping_size;
+
+  unsigned char*  data;
+} publish_view;
+
+/* function declarations */
+short int publish_texture(char* name);
+short int unpublish_texture(char* name);
+
+unsigned int  get_published_generation(char* name);
+short int     map_published_texture(char* name, publish_view* view);
+short int     unmap_published_texture(publish_view* view);
+
+short int write_published_info(FILE* fp_out, char* name);
+
+#endif
@@ -0,0 +1,223 @@
+/*******************************************************************************
+** query.c (lazy palette row queries)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "palette.h"
+#include "query.h"
+#include "tga.h"
+
+/* rows are generated only when they are asked for, and then kept.   */
+/* each row needs the palette 0 row at its level (and the rotated or  */
+/* greyscale row for the alternate palettes), which need the base    */
+/* row, so a query costs at most three row copies after the first.   */
+/* queries are not thread safe (the rows are filled in on demand).   */
+
+palette_params  S_query_params;
+
+unsigned char*  S_query_base_row;
+unsigned char** S_query_rows;
+
+/*******************************************************************************
+** setup_palette_query()
+*******************************************************************************/
+short int setup_palette_query(palette_params* pp)
+{
+  int num_rows;
+
+  if (pp == NULL)
+    return 1;
+
+  clear_palette_query();
+
+  S_query_params = *pp;
+
+  if (derive_palette_params(&S_query_params))
+    return 1;
+
+  num_rows = PALETTE_NUM_INDICES * S_query_params.levels_per_palette;
+
+  S_query_rows = calloc(num_rows, sizeof(unsigned char*));
+  S_query_base_row = malloc(sizeof(unsigned char) * 3 * S_query_params.palette_size);
+
+  if ((S_query_rows == NULL) || (S_query_base_row == NULL))
+  {
+    clear_palette_query();
+    return 1;
+  }
+
+  /* palette 0 base level (or the shared base row) */
+  if (pp->base_row != NULL)
+  {
+    memcpy( S_query_base_row, pp->base_row,
+            3 * (S_query_params.num_hues + 1) * S_query_params.num_shades);
+  }
+  else if (generate_palette_base_row(&S_query_params, S_query_base_row))
+  {
+    clear_palette_query();
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** setup_palette_query_source()
+*******************************************************************************/
+short int setup_palette_query_source(int source, int num_levels)
+{
+  palette_params  params;
+
+  int table_length;
+
+  /* the approx nes texture is built differently (and is only 64x64) */
+  if (set_palette_params_for_source(&params, source))
+  {
+    fprintf(stderr, "Row queries are only available for the composite sources.\n");
+    return 1;
+  }
+
+  if (get_source_voltage_tables(source, &params.luma_table, &params.saturation_table, &table_length))
+    return 1;
+
+  params.channel_order = PALETTE_CHANNEL_ORDER_RGB;
+  params.base_row = NULL;
+  params.num_levels = num_levels;
+
+  return setup_palette_query(&params);
+}
+
+/*******************************************************************************
+** get_palette_query_row()
+*******************************************************************************/
+unsigned char* get_palette_query_row(int palette, int level)
+{
+  palette_params* pp;
+
+  unsigned char*  row;
+  unsigned char*  level_row;
+  unsigned char*  companion_row;
+
+  int index;
+  int companion;
+
+  pp = &S_query_params;
+
+  if (S_query_rows == NULL)
+    return NULL;
+
+  if ((palette < 0) || (palette >= PALETTE_NUM_INDICES) ||
+      (level < 0) || (level >= pp->levels_per_palette))
+  {
+    return NULL;
+  }
+
+  index = palette * pp->levels_per_palette + level;
+
+  if (S_query_rows[index] != NULL)
+    return S_query_rows[index];
+
+  /* find the rows this one is derived from */
+  if (palette == PALETTE_INDEX_STANDARD)
+    level_row = S_query_base_row;
+  else
+    level_row = get_palette_query_row(PALETTE_INDEX_STANDARD, level);
+
+  companion = get_palette_companion_index(palette);
+
+  if (companion >= 0)
+    companion_row = get_palette_query_row(companion, level);
+  else
+    companion_row = NULL;
+
+  if ((level_row == NULL) || ((companion >= 0) && (companion_row == NULL)))
+    return NULL;
+
+  /* generate this row */
+  row = malloc(sizeof(unsigned char) * 3 * pp->palette_size);
+
+  if (row == NULL)
+    return NULL;
+
+  init_palette_composite_row(pp, row, palette, level);
+
+  if (generate_palette_composite_row(pp, row, palette, level, level_row, companion_row))
+  {
+    free(row);
+    return NULL;
+  }
+
+  S_query_rows[index] = row;
+
+  return row;
+}
+
+/*******************************************************************************
+** get_palette_query_color()
+*******************************************************************************/
+short int get_palette_query_color(int palette, int level, int index,
+                                  unsigned char* rgb)
+{
+  unsigned char* row;
+
+  if ((rgb == NULL) || (index < 0) || (index >= S_query_params.palette_size))
+    return 1;
+
+  row = get_palette_query_row(palette, level);
+
+  if (row == NULL)
+    return 1;
+
+  rgb[0] = row[3 * index + 0];
+  rgb[1] = row[3 * index + 1];
+  rgb[2] = row[3 * index + 2];
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_palette_query_row()
+*******************************************************************************/
+short int write_palette_query_row(FILE* fp_out, int palette, int level)
+{
+  unsigned char* row;
+
+  row = get_palette_query_row(palette, level);
+
+  if (row == NULL)
+    return 1;
+
+  /* a single row tga */
+  return write_tga_image(fp_out, row, S_query_params.palette_size, 1, 3);
+}
+
+/*******************************************************************************
+** clear_palette_query()
+*******************************************************************************/
+short int clear_palette_query()
+{
+  int k;
+
+  if (S_query_rows != NULL)
+  {
+    for (k = 0; k < PALETTE_NUM_INDICES * S_query_params.levels_per_palette; k++)
+    {
+      if (S_query_rows[k] != NULL)
+        free(S_query_rows[k]);
+    }
+
+    free(S_query_rows);
+    S_query_rows = NULL;
+  }
+
+  if (S_query_base_row != NULL)
+  {
+    free(S_query_base_row);
+    S_query_base_row = NULL;
+  }
+
+  return 0;
+}
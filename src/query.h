@@ -0,0 +1,24 @@
+/*******************************************************************************
+** query.h (lazy palette row queries)
+*******************************************************************************/
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdio.h>
+
+#include "palette.h"
+
+/* function declarations */
+short int setup_palette_query(palette_params* pp);
+short int setup_palette_query_source(int source, int num_levels);
+
+unsigned char*  get_palette_query_row(int palette, int level);
+short int       get_palette_query_color(int palette, int level, int index,
+                                        unsigned char* rgb);
+
+short int write_palette_query_row(FILE* fp_out, int palette, int level);
+
+short int clear_palette_query();
+
+#endif
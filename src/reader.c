@@ -0,0 +1,415 @@
+/*******************************************************************************
+** reader.c (tga file input)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+#include "tga.h"
+
+/* the file is mapped, and uncompressed 24 bit images are used in */
+/* place. the other images are decoded into a bgr buffer: each    */
+/* run of pixels is converted with one loop per pixel format, and */
+/* repeated pixels are filled by doubling the copied part. the    */
+/* color-mapped images can also be decoded to their indices.      */
+
+typedef struct tga_decoder
+{
+  int   bytes_per_pixel;
+
+  /* bytes per decoded pixel (3 for bgr, 2 for indices) */
+  int   dest_bytes;
+  int   index_flag;
+
+  /* color map, converted to bgr (color-mapped images only) */
+  unsigned char*  color_map;
+  int             map_first;
+  int             map_length;
+} tga_decoder;
+
+/*******************************************************************************
+** decode_tga_run()
+*******************************************************************************/
+short int decode_tga_run( tga_decoder* dc, unsigned char* dest,
+                          unsigned char* src, long count)
+{
+  long  k;
+  int   index;
+
+  /* true color */
+  if (dc->color_map == NULL)
+  {
+    if (dc->bytes_per_pixel == 3)
+      memcpy(dest, src, 3 * count);
+    else
+    {
+      for (k = 0; k < count; k++)
+      {
+        dest[3 * k + 0] = src[4 * k + 0];
+        dest[3 * k + 1] = src[4 * k + 1];
+        dest[3 * k + 2] = src[4 * k + 2];
+      }
+    }
+
+    return 0;
+  }
+
+  /* color-mapped (8 or 16 bit indices) */
+  for (k = 0; k < count; k++)
+  {
+    if (dc->bytes_per_pixel == 1)
+      index = src[k];
+    else
+      index = src[2 * k] | (src[2 * k + 1] << 8);
+
+    index -= dc->map_first;
+
+    if ((index < 0) || (index >= dc->map_length))
+      return 1;
+
+    if (dc->index_flag)
+      ((unsigned short*) dest)[k] = (unsigned short) index;
+    else
+      memcpy(&dest[3 * k], &dc->color_map[3 * index], 3);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** decode_tga_rle()
+*******************************************************************************/
+short int decode_tga_rle( tga_decoder* dc, unsigned char* dest, long num_pixels,
+                          unsigned char* src, unsigned char* src_end)
+{
+  long  count;
+  long  filled;
+  long  done;
+
+  /* packets may run across rows, so the image is decoded as a whole */
+  done = 0;
+
+  while (done < num_pixels)
+  {
+    if (src >= src_end)
+      return 1;
+
+    count = (*src & 0x7F) + 1;
+
+    if (done + count > num_pixels)
+      return 1;
+
+    /* run-length packet (one pixel, repeated) */
+    if (*src & 0x80)
+    {
+      if (src + 1 + dc->bytes_per_pixel > src_end)
+        return 1;
+
+      if (decode_tga_run(dc, &dest[dc->dest_bytes * done], src + 1, 1))
+        return 1;
+
+      for (filled = 1; filled < count; filled *= 2)
+      {
+        memcpy( &dest[dc->dest_bytes * (done + filled)], &dest[dc->dest_bytes * done],
+                dc->dest_bytes * ((filled < count - filled) ? filled : count - filled));
+      }
+
+      src += 1 + dc->bytes_per_pixel;
+    }
+    /* raw packet */
+    else
+    {
+      if (src + 1 + count * dc->bytes_per_pixel > src_end)
+        return 1;
+
+      if (decode_tga_run(dc, &dest[dc->dest_bytes * done], src + 1, count))
+        return 1;
+
+      src += 1 + count * dc->bytes_per_pixel;
+    }
+
+    done += count;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** read_tga_image()
+*******************************************************************************/
+short int read_tga_image(char* filename, tga_image* image)
+{
+  return read_tga_image_data(filename, image, 0);
+}
+
+/*******************************************************************************
+** read_tga_image_indices()
+*******************************************************************************/
+short int read_tga_image_indices(char* filename, tga_image* image)
+{
+  return read_tga_image_data(filename, image, 1);
+}
+
+/*******************************************************************************
+** read_tga_image_data()
+*******************************************************************************/
+short int read_tga_image_data(char* filename, tga_image* image, int index_flag)
+{
+  int   fd;
+
+  struct stat file_info;
+
+  unsigned char*  header;
+  unsigned char*  src;
+  unsigned char*  src_end;
+  unsigned char*  map_src;
+
+  tga_decoder dc;
+
+  int   map_type;
+  int   map_entry_bytes;
+  int   descriptor;
+
+  long  num_pixels;
+  int   k;
+
+  if ((filename == NULL) || (image == NULL))
+    return 1;
+
+  image->pixels = NULL;
+  image->mapping = NULL;
+  image->mapping_size = 0;
+  image->decoded = NULL;
+
+  dc.color_map = NULL;
+
+  dc.index_flag = index_flag;
+  dc.dest_bytes = index_flag ? 2 : 3;
+
+  /* map the file */
+  fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+  {
+    fprintf(stderr, "Read TGA file failed: Unable to open %s.\n", filename);
+    return 1;
+  }
+
+  if ((fstat(fd, &file_info) < 0) || (!S_ISREG(file_info.st_mode)) ||
+      (file_info.st_size < TGA_HEADER_SIZE))
+  {
+    fprintf(stderr, "Read TGA file failed: %s is not a tga file.\n", filename);
+    close(fd);
+    return 1;
+  }
+
+  image->mapping_size = file_info.st_size;
+  image->mapping = mmap(NULL, image->mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  close(fd);
+
+  if (image->mapping == MAP_FAILED)
+  {
+    fprintf(stderr, "Read TGA file failed: Unable to map %s.\n", filename);
+    image->mapping = NULL;
+    return 1;
+  }
+
+  /* the file is read once, front to back */
+  posix_madvise(image->mapping, image->mapping_size, POSIX_MADV_SEQUENTIAL);
+
+  /* read header */
+  header = image->mapping;
+  src_end = image->mapping + image->mapping_size;
+
+  map_type = header[1];
+  image->type = header[2];
+
+  dc.map_first = header[3] | (header[4] << 8);
+  dc.map_length = header[5] | (header[6] << 8);
+  map_entry_bytes = (header[7] + 7) / 8;
+
+  image->width = header[12] | (header[13] << 8);
+  image->height = header[14] | (header[15] << 8);
+
+  dc.bytes_per_pixel = (header[16] + 7) / 8;
+  descriptor = header[17];
+
+  if ((image->width == 0) || (image->height == 0) ||
+      (descriptor & TGA_DESCRIPTOR_RIGHT_TO_LEFT))
+  {
+    fprintf(stderr, "Read TGA file failed: Unsupported image layout in %s.\n", filename);
+    clear_tga_image(image);
+    return 1;
+  }
+
+  /* skip the image id, and find the color map */
+  src = header + TGA_HEADER_SIZE + header[0];
+  map_src = src;
+
+  if (map_type == 1)
+    src += (long) dc.map_length * map_entry_bytes;
+
+  if (src > src_end)
+  {
+    fprintf(stderr, "Read TGA file failed: %s is truncated.\n", filename);
+    clear_tga_image(image);
+    return 1;
+  }
+
+  /* check pixel format */
+  if ((image->type == TGA_TYPE_TRUE_COLOR) || (image->type == TGA_TYPE_RLE_TRUE_COLOR))
+  {
+    if (index_flag)
+    {
+      fprintf(stderr, "Read TGA file failed: %s is not color-mapped.\n", filename);
+      clear_tga_image(image);
+      return 1;
+    }
+
+    if ((header[16] != 24) && (header[16] != 32))
+    {
+      fprintf(stderr, "Read TGA file failed: Unsupported pixel depth in %s.\n", filename);
+      clear_tga_image(image);
+      return 1;
+    }
+  }
+  else if ((image->type == TGA_TYPE_COLOR_MAPPED) || (image->type == TGA_TYPE_RLE_COLOR_MAPPED))
+  {
+    if ((map_type != 1) ||
+        ((header[16] != 8) && (header[16] != 16)) ||
+        ((header[7] != 24) && (header[7] != 32)))
+    {
+      fprintf(stderr, "Read TGA file failed: Unsupported color map in %s.\n", filename);
+      clear_tga_image(image);
+      return 1;
+    }
+
+    /* convert the color map to bgr */
+    dc.color_map = malloc(sizeof(unsigned char) * 3 * (dc.map_length + 1));
+
+    if (dc.color_map == NULL)
+    {
+      clear_tga_image(image);
+      return 1;
+    }
+
+    for (k = 0; k < dc.map_length; k++)
+      memcpy(&dc.color_map[3 * k], &map_src[k * map_entry_bytes], 3);
+  }
+  else
+  {
+    fprintf(stderr, "Read TGA file failed: Unsupported image type %d in %s.\n",
+            image->type, filename);
+    clear_tga_image(image);
+    return 1;
+  }
+
+  num_pixels = (long) image->width * image->height;
+
+  /* uncompressed 24 bit images are used in place */
+  if ((image->type == TGA_TYPE_TRUE_COLOR) && (dc.bytes_per_pixel == 3))
+  {
+    if (src + 3 * num_pixels > src_end)
+    {
+      fprintf(stderr, "Read TGA file failed: %s is truncated.\n", filename);
+      clear_tga_image(image);
+      return 1;
+    }
+
+    image->pixels = src;
+  }
+  /* decode the other images */
+  else
+  {
+    image->decoded = malloc(sizeof(unsigned char) * dc.dest_bytes * num_pixels);
+
+    if (image->decoded == NULL)
+    {
+      fprintf(stderr, "Read TGA file failed: Unable to allocate image buffer.\n");
+      free(dc.color_map);
+      clear_tga_image(image);
+      return 1;
+    }
+
+    if ((image->type == TGA_TYPE_TRUE_COLOR) || (image->type == TGA_TYPE_COLOR_MAPPED))
+    {
+      if ((src + num_pixels * dc.bytes_per_pixel > src_end) ||
+          (decode_tga_run(&dc, image->decoded, src, num_pixels)))
+      {
+        fprintf(stderr, "Read TGA file failed: %s is truncated or invalid.\n", filename);
+        free(dc.color_map);
+        clear_tga_image(image);
+        return 1;
+      }
+    }
+    else if (decode_tga_rle(&dc, image->decoded, num_pixels, src, src_end))
+    {
+      fprintf(stderr, "Read TGA file failed: %s is truncated or invalid.\n", filename);
+      free(dc.color_map);
+      clear_tga_image(image);
+      return 1;
+    }
+
+    image->pixels = image->decoded;
+  }
+
+  free(dc.color_map);
+
+  /* bottom-up images are read with a negative row stride */
+  image->row_stride = dc.dest_bytes * (long) image->width;
+
+  if (!(descriptor & TGA_DESCRIPTOR_TOP_TO_BOTTOM))
+  {
+    image->pixels += (image->height - 1) * image->row_stride;
+    image->row_stride = -image->row_stride;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_tga_image_row()
+*******************************************************************************/
+unsigned char* get_tga_image_row(tga_image* image, int row)
+{
+  if ((image == NULL) || (image->pixels == NULL))
+    return NULL;
+
+  if ((row < 0) || (row >= image->height))
+    return NULL;
+
+  return image->pixels + row * image->row_stride;
+}
+
+/*******************************************************************************
+** clear_tga_image()
+*******************************************************************************/
+short int clear_tga_image(tga_image* image)
+{
+  if (image == NULL)
+    return 1;
+
+  if (image->decoded != NULL)
+  {
+    free(image->decoded);
+    image->decoded = NULL;
+  }
+
+  if (image->mapping != NULL)
+  {
+    munmap(image->mapping, image->mapping_size);
+    image->mapping = NULL;
+  }
+
+  image->pixels = NULL;
+  image->mapping_size = 0;
+
+  return 0;
+}
@@ -0,0 +1,49 @@
+/*******************************************************************************
+** reader.h (tga file input)
+*******************************************************************************/
+
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+
+/* image types (uncompressed & run-length encoded) */
+#define TGA_TYPE_COLOR_MAPPED     1
+#define TGA_TYPE_TRUE_COLOR       2
+#define TGA_TYPE_RLE_COLOR_MAPPED 9
+#define TGA_TYPE_RLE_TRUE_COLOR   10
+
+/* image descriptor bits */
+#define TGA_DESCRIPTOR_RIGHT_TO_LEFT  0x10
+#define TGA_DESCRIPTOR_TOP_TO_BOTTOM  0x20
+
+/* a decoded image has 3 bytes per pixel, in bgr order (as in the file). */
+/* uncompressed 24 bit images are not copied: their rows point into the */
+/* mapped file. the rows are accessed with get_tga_image_row(), which   */
+/* takes care of the origin (the first row is always the top row, and  */
+/* bottom-up images have a negative row stride). color-mapped images    */
+/* read with read_tga_image_indices() have an unsigned short per pixel  */
+/* instead (the index into the color map).                              */
+typedef struct tga_image
+{
+  int   type;
+  int   width;
+  int   height;
+
+  unsigned char*  pixels;
+  long            row_stride;
+
+  unsigned char*  mapping;
+  size_t          mapping_size;
+
+  unsigned char*  decoded;
+} tga_image;
+
+/* function declarations */
+short int read_tga_image(char* filename, tga_image* image);
+short int read_tga_image_indices(char* filename, tga_image* image);
+short int read_tga_image_data(char* filename, tga_image* image, int index_flag);
+unsigned char* get_tga_image_row(tga_image* image, int row);
+short int clear_tga_image(tga_image* image);
+
+#endif
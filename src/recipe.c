@@ -0,0 +1,566 @@
+/*******************************************************************************
+** recipe.c (compact texture recipes)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "palette.h"
+#include "recipe.h"
+
+/* apart from the palette 0 base gradients, a composite texture is   */
+/* built entirely from copies & fills (the level shifts, rotations,  */
+/* greyscale, alternate & tint palettes, and the black or white      */
+/* padding). a recipe is a recording of those copies & fills (taken  */
+/* with the palette copy hook while the texture is generated), where */
+/* runs of the same operation at a constant stride (e.g. one shifted */
+/* copy per gradient) are merged into one repeated operation.        */
+/*                                                                   */
+/* expanding a recipe puts the base gradients in place, and replays  */
+/* the operations in order. the copies & fills that are a multiple  */
+/* of 16 bytes (every gradient for the 256 & 1024 color sources) use */
+/* sse2 loads & stores, and the rest use memcpy & memset.            */
+
+recipe*         S_recipe_recording;
+unsigned char*  S_recipe_data;
+short int       S_recipe_record_failed;
+
+/*******************************************************************************
+** set_recipe_u16() / set_recipe_u32()
+*******************************************************************************/
+short int set_recipe_u16(unsigned char* data, unsigned long value)
+{
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+
+  return 0;
+}
+
+short int set_recipe_u32(unsigned char* data, unsigned long value)
+{
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = (value >> 16) & 0xFF;
+  data[3] = (value >> 24) & 0xFF;
+
+  return 0;
+}
+
+/*******************************************************************************
+** get_recipe_u16() / get_recipe_u32()
+*******************************************************************************/
+unsigned long get_recipe_u16(unsigned char* data)
+{
+  return (unsigned long) data[0] | ((unsigned long) data[1] << 8);
+}
+
+unsigned long get_recipe_u32(unsigned char* data)
+{
+  return (unsigned long) data[0] | ((unsigned long) data[1] << 8) |
+         ((unsigned long) data[2] << 16) | ((unsigned long) data[3] << 24);
+}
+
+/*******************************************************************************
+** add_recipe_op()
+*******************************************************************************/
+short int add_recipe_op(recipe* rc, int type, int value, long dest, long src, long length)
+{
+  recipe_op*  op;
+  recipe_op*  ops;
+
+  long  dest_stride;
+  long  src_stride;
+
+  if (length <= 0)
+    return 0;
+
+  /* extend the last operation if this is the next one in its run */
+  if (rc->num_ops > 0)
+  {
+    op = &rc->ops[rc->num_ops - 1];
+
+    dest_stride = dest - (op->dest + (op->count - 1) * op->dest_stride);
+    src_stride = src - (op->src + (op->count - 1) * op->src_stride);
+
+    if ((op->type == type) && (op->value == value) && (op->length == length) &&
+        (op->count < 65535) && (dest_stride > 0) && (src_stride >= 0))
+    {
+      if (op->count == 1)
+      {
+        op->dest_stride = dest_stride;
+        op->src_stride = src_stride;
+        op->count = 2;
+
+        return 0;
+      }
+      else if ((op->dest_stride == dest_stride) && (op->src_stride == src_stride))
+      {
+        op->count += 1;
+
+        return 0;
+      }
+    }
+  }
+
+  /* otherwise, start a new one */
+  if (rc->num_ops >= rc->max_ops)
+  {
+    ops = realloc(rc->ops, sizeof(recipe_op) * 2 * (rc->max_ops + 64));
+
+    if (ops == NULL)
+      return 1;
+
+    rc->ops = ops;
+    rc->max_ops = 2 * (rc->max_ops + 64);
+  }
+
+  op = &rc->ops[rc->num_ops];
+
+  op->type = type;
+  op->value = value;
+  op->count = 1;
+  op->dest = dest;
+  op->src = src;
+  op->length = length;
+  op->dest_stride = 0;
+  op->src_stride = 0;
+
+  rc->num_ops += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** record_recipe_op()
+*******************************************************************************/
+void record_recipe_op(unsigned char* dest, unsigned char* src, int value, long num_bytes)
+{
+  short int status;
+
+  if (src == NULL)
+  {
+    status = add_recipe_op( S_recipe_recording, RECIPE_OP_FILL, value,
+                            dest - S_recipe_data, 0, num_bytes);
+  }
+  else
+  {
+    status = add_recipe_op( S_recipe_recording, RECIPE_OP_COPY, 0,
+                            dest - S_recipe_data, src - S_recipe_data, num_bytes);
+  }
+
+  if (status)
+    S_recipe_record_failed = 1;
+}
+
+/*******************************************************************************
+** build_recipe()
+*******************************************************************************/
+short int build_recipe(recipe* rc, int source)
+{
+  palette_params  params;
+
+  unsigned char*  data;
+  unsigned char*  check;
+  long            texture_size;
+
+  int   table_length;
+
+  short int status;
+
+  if (rc == NULL)
+    return 1;
+
+  rc->base = NULL;
+  rc->ops = NULL;
+  rc->num_ops = 0;
+  rc->max_ops = 0;
+
+  /* the approx nes & ntsc nes textures are not built from copies */
+  if (set_palette_params_for_source(&params, source))
+  {
+    fprintf(stderr, "Recipes are only available for the composite sources.\n");
+    return 1;
+  }
+
+  if (get_source_voltage_tables(source, &params.luma_table, &params.saturation_table, &table_length))
+    return 1;
+
+  params.channel_order = PALETTE_CHANNEL_ORDER_RGB;
+  params.base_row = NULL;
+
+  if (derive_palette_params(&params))
+    return 1;
+
+  rc->source = source;
+  rc->palette_size = params.palette_size;
+
+  texture_size = 3 * (long) params.palette_size * params.palette_size;
+
+  rc->base_offset = 3 * (long) params.base_level * params.palette_size;
+  rc->base_size = 3 * (params.num_hues + 1) * params.num_shades;
+
+  data = allocate_aligned_buffer(texture_size);
+  check = allocate_aligned_buffer(texture_size);
+  rc->base = malloc(sizeof(unsigned char) * rc->base_size);
+
+  if ((data == NULL) || (check == NULL) || (rc->base == NULL))
+  {
+    fprintf(stderr, "Unable to allocate recipe buffers.\n");
+    status = 1;
+    goto cleanup;
+  }
+
+  /* generate the texture, recording the copies & fills */
+  S_recipe_recording = rc;
+  S_recipe_data = data;
+  S_recipe_record_failed = 0;
+
+  G_palette_copy_hook = record_recipe_op;
+
+  status = generate_palette_composite_data(&params, data);
+
+  G_palette_copy_hook = NULL;
+  S_recipe_recording = NULL;
+
+  if (S_recipe_record_failed)
+    status = 1;
+
+  if (status)
+  {
+    fprintf(stderr, "Error recording recipe.\n");
+    goto cleanup;
+  }
+
+  memcpy(rc->base, &data[rc->base_offset], rc->base_size);
+
+  /* make sure the recipe reproduces the texture */
+  if ((expand_recipe(rc, check)) || (memcmp(data, check, texture_size)))
+  {
+    fprintf(stderr, "Recipe does not reproduce the texture.\n");
+    status = 1;
+  }
+
+cleanup:
+  if (data != NULL)
+    free(data);
+  if (check != NULL)
+    free(check);
+
+  if (status)
+    clear_recipe(rc);
+
+  return status;
+}
+
+/*******************************************************************************
+** write_recipe_file()
+*******************************************************************************/
+short int write_recipe_file(FILE* fp_out, recipe* rc)
+{
+  unsigned char header[RECIPE_HEADER_SIZE];
+  unsigned char record[RECIPE_OP_SIZE];
+
+  recipe_op*  op;
+
+  long  k;
+
+  if ((fp_out == NULL) || (rc == NULL) || (rc->base == NULL))
+    return 1;
+
+  set_recipe_u32(&header[0], RECIPE_MAGIC);
+  set_recipe_u16(&header[4], RECIPE_VERSION);
+  set_recipe_u16(&header[6], rc->source);
+  set_recipe_u32(&header[8], rc->palette_size);
+  set_recipe_u32(&header[12], rc->base_offset);
+  set_recipe_u32(&header[16], rc->base_size);
+  set_recipe_u32(&header[20], rc->num_ops);
+
+  if (fwrite(header, 1, RECIPE_HEADER_SIZE, fp_out) < RECIPE_HEADER_SIZE)
+    return 1;
+
+  if (fwrite(rc->base, 1, rc->base_size, fp_out) < (size_t) rc->base_size)
+    return 1;
+
+  for (k = 0; k < rc->num_ops; k++)
+  {
+    op = &rc->ops[k];
+
+    record[0] = op->type;
+    record[1] = op->value;
+    set_recipe_u16(&record[2], op->count);
+    set_recipe_u32(&record[4], op->dest);
+    set_recipe_u32(&record[8], op->src);
+    set_recipe_u32(&record[12], op->length);
+    set_recipe_u32(&record[16], op->dest_stride);
+    set_recipe_u32(&record[20], op->src_stride);
+
+    if (fwrite(record, 1, RECIPE_OP_SIZE, fp_out) < RECIPE_OP_SIZE)
+      return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** is_recipe_run_valid()
+*******************************************************************************/
+int is_recipe_run_valid(long start, long stride, long count, long length, long size)
+{
+  /* the last repetition must end inside the texture */
+  if ((start < 0) || (length < 0) || (start > size) || (length > size - start))
+    return 0;
+
+  if ((count > 1) && (stride > 0) && ((count - 1) > (size - start - length) / stride))
+    return 0;
+
+  return 1;
+}
+
+/*******************************************************************************
+** read_recipe_file()
+*******************************************************************************/
+short int read_recipe_file(char* filename, recipe* rc)
+{
+  FILE* fp_in;
+
+  struct stat file_info;
+
+  unsigned char*  contents;
+  unsigned char*  record;
+  recipe_op*      op;
+
+  long  texture_size;
+  long  k;
+
+  short int status;
+
+  if ((filename == NULL) || (rc == NULL))
+    return 1;
+
+  rc->base = NULL;
+  rc->ops = NULL;
+  rc->num_ops = 0;
+  rc->max_ops = 0;
+
+  /* read the whole file */
+  if ((stat(filename, &file_info) < 0) || (file_info.st_size < RECIPE_HEADER_SIZE))
+  {
+    fprintf(stderr, "Read recipe failed: %s is not a recipe file.\n", filename);
+    return 1;
+  }
+
+  fp_in = fopen(filename, "rb");
+
+  if (fp_in == NULL)
+  {
+    fprintf(stderr, "Read recipe failed: Unable to open %s.\n", filename);
+    return 1;
+  }
+
+  contents = malloc(file_info.st_size);
+
+  if ((contents == NULL) ||
+      (fread(contents, 1, file_info.st_size, fp_in) < (size_t) file_info.st_size))
+  {
+    fprintf(stderr, "Read recipe failed: Unable to read %s.\n", filename);
+    fclose(fp_in);
+
+    if (contents != NULL)
+      free(contents);
+
+    return 1;
+  }
+
+  fclose(fp_in);
+
+  status = 0;
+
+  /* header */
+  rc->source = get_recipe_u16(&contents[6]);
+  rc->palette_size = get_recipe_u32(&contents[8]);
+  rc->base_offset = get_recipe_u32(&contents[12]);
+  rc->base_size = get_recipe_u32(&contents[16]);
+  rc->num_ops = get_recipe_u32(&contents[20]);
+
+  if ((get_recipe_u32(&contents[0]) != RECIPE_MAGIC) ||
+      (get_recipe_u16(&contents[4]) != RECIPE_VERSION) ||
+      (!is_source_composite(rc->source)) ||
+      (rc->palette_size <= 0) || (rc->palette_size > PALETTE_MAX_SIZE) ||
+      (rc->num_ops > (file_info.st_size - RECIPE_HEADER_SIZE) / RECIPE_OP_SIZE) ||
+      (RECIPE_HEADER_SIZE + rc->base_size + rc->num_ops * RECIPE_OP_SIZE != file_info.st_size))
+  {
+    fprintf(stderr, "Read recipe failed: %s is not a valid recipe file.\n", filename);
+    status = 1;
+    goto cleanup;
+  }
+
+  texture_size = 3 * (long) rc->palette_size * rc->palette_size;
+
+  if (!is_recipe_run_valid(rc->base_offset, 0, 1, rc->base_size, texture_size))
+  {
+    fprintf(stderr, "Read recipe failed: %s is not a valid recipe file.\n", filename);
+    status = 1;
+    goto cleanup;
+  }
+
+  /* base gradients & operations */
+  rc->base = malloc(sizeof(unsigned char) * (rc->base_size + 1));
+  rc->ops = malloc(sizeof(recipe_op) * (rc->num_ops + 1));
+  rc->max_ops = rc->num_ops;
+
+  if ((rc->base == NULL) || (rc->ops == NULL))
+  {
+    fprintf(stderr, "Read recipe failed: Unable to allocate recipe.\n");
+    status = 1;
+    goto cleanup;
+  }
+
+  memcpy(rc->base, &contents[RECIPE_HEADER_SIZE], rc->base_size);
+
+  for (k = 0; k < rc->num_ops; k++)
+  {
+    record = &contents[RECIPE_HEADER_SIZE + rc->base_size + k * RECIPE_OP_SIZE];
+    op = &rc->ops[k];
+
+    op->type = record[0];
+    op->value = record[1];
+    op->count = get_recipe_u16(&record[2]);
+    op->dest = get_recipe_u32(&record[4]);
+    op->src = get_recipe_u32(&record[8]);
+    op->length = get_recipe_u32(&record[12]);
+    op->dest_stride = get_recipe_u32(&record[16]);
+    op->src_stride = get_recipe_u32(&record[20]);
+
+    /* every operation must stay inside the texture */
+    if ((op->type >= RECIPE_NUM_OPS) || (op->count < 1) ||
+        (!is_recipe_run_valid(op->dest, op->dest_stride, op->count, op->length, texture_size)) ||
+        ((op->type == RECIPE_OP_COPY) &&
+         (!is_recipe_run_valid(op->src, op->src_stride, op->count, op->length, texture_size))))
+    {
+      fprintf(stderr, "Read recipe failed: Invalid operation %ld in %s.\n", k, filename);
+      status = 1;
+      goto cleanup;
+    }
+  }
+
+cleanup:
+  free(contents);
+
+  if (status)
+    clear_recipe(rc);
+
+  return status;
+}
+
+/*******************************************************************************
+** expand_recipe()
+*******************************************************************************/
+short int expand_recipe(recipe* rc, unsigned char* data)
+{
+  recipe_op*  op;
+
+  unsigned char*  dest;
+  unsigned char*  src;
+
+  long  num_blocks;
+
+  long  k;
+  long  n;
+
+#ifdef __SSE2__
+  __m128i fill;
+  long    j;
+#endif
+
+  if ((rc == NULL) || (rc->base == NULL) || (data == NULL))
+    return 1;
+
+  memcpy(&data[rc->base_offset], rc->base, rc->base_size);
+
+  for (k = 0; k < rc->num_ops; k++)
+  {
+    op = &rc->ops[k];
+
+    dest = &data[op->dest];
+    src = &data[op->src];
+
+#ifdef __SSE2__
+    num_blocks = op->length / 16;
+#else
+    num_blocks = 0;
+#endif
+
+    /* copies */
+    if (op->type == RECIPE_OP_COPY)
+    {
+      for (n = 0; n < op->count; n++)
+      {
+#ifdef __SSE2__
+        for (j = 0; j < num_blocks; j++)
+        {
+          _mm_storeu_si128( (__m128i*) &dest[16 * j],
+                            _mm_loadu_si128((__m128i*) &src[16 * j]));
+        }
+#endif
+        if (16 * num_blocks < op->length)
+          memcpy(&dest[16 * num_blocks], &src[16 * num_blocks], op->length - 16 * num_blocks);
+
+        dest += op->dest_stride;
+        src += op->src_stride;
+      }
+    }
+    /* fills */
+    else
+    {
+#ifdef __SSE2__
+      fill = _mm_set1_epi8((char) op->value);
+#endif
+
+      for (n = 0; n < op->count; n++)
+      {
+#ifdef __SSE2__
+        for (j = 0; j < num_blocks; j++)
+          _mm_storeu_si128((__m128i*) &dest[16 * j], fill);
+#endif
+        if (16 * num_blocks < op->length)
+          memset(&dest[16 * num_blocks], op->value, op->length - 16 * num_blocks);
+
+        dest += op->dest_stride;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_recipe()
+*******************************************************************************/
+short int clear_recipe(recipe* rc)
+{
+  if (rc == NULL)
+    return 1;
+
+  if (rc->base != NULL)
+  {
+    free(rc->base);
+    rc->base = NULL;
+  }
+
+  if (rc->ops != NULL)
+  {
+    free(rc->ops);
+    rc->ops = NULL;
+  }
+
+  rc->num_ops = 0;
+  rc->max_ops = 0;
+
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*******************************************************************************
+** recipe.h (compact texture recipes)
+*******************************************************************************/
+
+#ifndef RECIPE_H
+#define RECIPE_H
+
+#include <stdio.h>
+
+/* "TXRC" (little endian), and the version of the file layout */
+#define RECIPE_MAGIC    0x43525854UL
+#define RECIPE_VERSION  1
+
+/* the file has a header, the palette 0 base gradients (rgb), and */
+/* the list of operations that derive the rest of the texture     */
+#define RECIPE_HEADER_SIZE  24
+#define RECIPE_OP_SIZE      24
+
+enum
+{
+  RECIPE_OP_COPY = 0,
+  RECIPE_OP_FILL,
+  RECIPE_NUM_OPS
+};
+
+/* an operation is repeated count times, moving the destination & */
+/* source by their strides (all offsets are bytes in the texture) */
+typedef struct recipe_op
+{
+  int   type;
+  int   value;
+
+  long  count;
+
+  long  dest;
+  long  src;
+  long  length;
+
+  long  dest_stride;
+  long  src_stride;
+} recipe_op;
+
+typedef struct recipe
+{
+  int   source;
+  int   palette_size;
+
+  /* palette 0 base gradients, and where they go in the texture */
+  unsigned char*  base;
+  long            base_offset;
+  long            base_size;
+
+  recipe_op*  ops;
+  long        num_ops;
+  long        max_ops;
+} recipe;
+
+/* function declarations */
+short int build_recipe(recipe* rc, int source);
+short int write_recipe_file(FILE* fp_out, recipe* rc);
+
+short int read_recipe_file(char* filename, recipe* rc);
+short int expand_recipe(recipe* rc, unsigned char* data);
+
+short int clear_recipe(recipe* rc);
+
+#endif
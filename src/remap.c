@@ -0,0 +1,854 @@
+/*******************************************************************************
+** remap.c (batch remapping of images onto a palette)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "encode.h"
+#include "palette.h"
+#include "pool.h"
+#include "reader.h"
+#include "remap.h"
+#include "tga.h"
+
+/* each image is mapped onto one row of the texture (a palette at one */
+/* lighting level), and written as a color-mapped tga file with the   */
+/* row as its color map. the texture is generated once, and the row's */
+/* colors are shared (read only) by all of the threads.               */
+/*                                                                    */
+/* the images go through a pipeline: the main thread reads them (and  */
+/* faults in their pages), the compute threads map them, and the      */
+/* writer thread writes them out, in order. the reader stops when     */
+/* REMAP_MAX_IN_FLIGHT images have not been written yet, so the       */
+/* memory use does not depend on the number of files.                 */
+
+float*          S_remap_colors;
+int             S_remap_row_length;
+
+unsigned char*  S_remap_color_map;
+int             S_remap_num_colors;
+
+int             S_remap_mode;
+
+/* exact mapping (colors to their first index) */
+unsigned long*  S_remap_hash_colors;
+unsigned short* S_remap_hash_indices;
+
+remap_job*      S_remap_jobs;
+int             S_remap_num_jobs;
+int             S_remap_max_jobs;
+
+pthread_mutex_t S_remap_mutex;
+pthread_cond_t  S_remap_cond;
+
+int   S_remap_num_read;
+int   S_remap_next_compute;
+int   S_remap_num_written;
+int   S_remap_abort;
+
+long  S_remap_bytes_written;
+int   S_remap_num_failed;
+
+/*******************************************************************************
+** get_remap_hash()
+*******************************************************************************/
+unsigned long get_remap_hash(unsigned long color, unsigned long size)
+{
+  return ((color * 2654435761UL) >> 8) & (size - 1);
+}
+
+/*******************************************************************************
+** setup_remap_palette()
+*******************************************************************************/
+short int setup_remap_palette(int palette, int level, int mode)
+{
+  unsigned char*  row;
+
+  int   levels_per_palette;
+
+  unsigned long color;
+  unsigned long hash;
+
+  int   m;
+  int   k;
+
+  clear_remap();
+
+  S_remap_mode = mode;
+
+  /* generate the texture, and find the row */
+  if (generate_palette())
+    return 1;
+
+  levels_per_palette = G_palette_size / get_palette_num_bands();
+
+  if (palette < 0)
+    palette = 0;
+
+  if (level < 0)
+    level = levels_per_palette / 2;
+
+  if ((palette >= get_palette_num_bands()) || (level >= levels_per_palette))
+  {
+    fprintf(stderr, "The %s texture has %d palettes of %d levels.\n",
+            get_palette_source_name(), get_palette_num_bands(), levels_per_palette);
+    return 1;
+  }
+
+  S_remap_num_colors = G_palette_size;
+  S_remap_row_length = (G_palette_size + ENCODE_NUM_LANES - 1) & ~(ENCODE_NUM_LANES - 1);
+
+  S_remap_color_map = malloc(sizeof(unsigned char) * 3 * S_remap_num_colors);
+  S_remap_colors = (float*) allocate_aligned_buffer(sizeof(float) * 3 * S_remap_row_length);
+  S_remap_hash_colors = malloc(sizeof(unsigned long) * TGA_INDEXED_HASH_SIZE);
+  S_remap_hash_indices = malloc(sizeof(unsigned short) * TGA_INDEXED_HASH_SIZE);
+
+  if ((S_remap_color_map == NULL) || (S_remap_colors == NULL) ||
+      (S_remap_hash_colors == NULL) || (S_remap_hash_indices == NULL))
+  {
+    fprintf(stderr, "Unable to allocate remap palette.\n");
+    return 1;
+  }
+
+  /* the color map is the row as it appears in the tga file */
+  /* (bgr, with transparent texels written as magenta)      */
+  convert_tga_rows(S_remap_color_map, palette * levels_per_palette + level, 1);
+
+  for (m = 0; m < S_remap_row_length; m++)
+  {
+    for (k = 0; k < 3; k++)
+    {
+      if (m < S_remap_num_colors)
+        S_remap_colors[k * S_remap_row_length + m] = S_remap_color_map[3 * m + 2 - k];
+      else
+        S_remap_colors[k * S_remap_row_length + m] = ENCODE_PADDING_VALUE;
+    }
+  }
+
+  /* exact mapping table (the first index of each color) */
+  for (m = 0; m < TGA_INDEXED_HASH_SIZE; m++)
+    S_remap_hash_colors[m] = 0xFFFFFFFFUL;
+
+  for (m = 0; m < S_remap_num_colors; m++)
+  {
+    row = &S_remap_color_map[3 * m];
+
+    color = ((unsigned long) row[2] << 16) | ((unsigned long) row[1] << 8) | row[0];
+    hash = get_remap_hash(color, TGA_INDEXED_HASH_SIZE);
+
+    while ((S_remap_hash_colors[hash] != 0xFFFFFFFFUL) && (S_remap_hash_colors[hash] != color))
+      hash = (hash + 1) & (TGA_INDEXED_HASH_SIZE - 1);
+
+    if (S_remap_hash_colors[hash] == 0xFFFFFFFFUL)
+    {
+      S_remap_hash_colors[hash] = color;
+      S_remap_hash_indices[hash] = m;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** add_remap_job()
+*******************************************************************************/
+short int add_remap_job(char* input_filename, char* output_dir)
+{
+  remap_job*  job;
+  remap_job*  jobs;
+
+  char* name;
+
+  struct stat file_info;
+  struct stat output_info;
+
+  if ((stat(input_filename, &file_info) < 0) || (!S_ISREG(file_info.st_mode)))
+  {
+    fprintf(stderr, "Remap input %s is not a file.\n", input_filename);
+    return 1;
+  }
+
+  name = strrchr(input_filename, '/');
+
+  if (name == NULL)
+    name = input_filename;
+  else
+    name += 1;
+
+  if ((strlen(input_filename) >= REMAP_FILENAME_LENGTH) ||
+      (strlen(output_dir) + strlen(name) + 1 >= REMAP_FILENAME_LENGTH))
+  {
+    fprintf(stderr, "Remap filename %s is too long.\n", input_filename);
+    return 1;
+  }
+
+  /* grow the job list */
+  if (S_remap_num_jobs >= S_remap_max_jobs)
+  {
+    jobs = realloc(S_remap_jobs, sizeof(remap_job) * 2 * (S_remap_max_jobs + 8));
+
+    if (jobs == NULL)
+      return 1;
+
+    S_remap_jobs = jobs;
+    S_remap_max_jobs = 2 * (S_remap_max_jobs + 8);
+  }
+
+  job = &S_remap_jobs[S_remap_num_jobs];
+
+  strcpy(job->input_filename, input_filename);
+  sprintf(job->output_filename, "%s/%s", output_dir, name);
+
+  /* the inputs are mapped while the outputs are written, */
+  /* so an output cannot replace an input                 */
+  if ((stat(job->output_filename, &output_info) == 0) &&
+      (output_info.st_dev == file_info.st_dev) && (output_info.st_ino == file_info.st_ino))
+  {
+    fprintf(stderr, "Remap output %s is the same file as its input.\n", job->output_filename);
+    return 1;
+  }
+
+  job->image.pixels = NULL;
+  job->image.mapping = NULL;
+  job->image.mapping_size = 0;
+  job->image.decoded = NULL;
+
+  job->indices = NULL;
+  job->num_bytes = 0;
+  job->state = REMAP_STATE_QUEUED;
+  job->status = 0;
+
+  S_remap_num_jobs += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** compare_remap_names()
+*******************************************************************************/
+int compare_remap_names(const void* a, const void* b)
+{
+  return strcmp(*((char**) a), *((char**) b));
+}
+
+/*******************************************************************************
+** add_remap_inputs()
+*******************************************************************************/
+short int add_remap_inputs(char* path, char* output_dir)
+{
+  DIR*            dir;
+  struct dirent*  entry;
+
+  FILE* fp_in;
+
+  char  filename[2 * REMAP_FILENAME_LENGTH];
+  char  line[REMAP_FILENAME_LENGTH];
+
+  char**  names;
+  int     num_names;
+  int     max_names;
+  char**  new_names;
+
+  struct stat file_info;
+
+  size_t  length;
+  int     k;
+
+  short int status;
+
+  if ((path == NULL) || (output_dir == NULL))
+    return 1;
+
+  if ((stat(output_dir, &file_info) < 0) || (!S_ISDIR(file_info.st_mode)))
+  {
+    fprintf(stderr, "Remap output %s is not a directory.\n", output_dir);
+    return 1;
+  }
+
+  if (stat(path, &file_info) < 0)
+  {
+    fprintf(stderr, "Unable to open remap input %s.\n", path);
+    return 1;
+  }
+
+  /* a list of files (one per line) */
+  if (!S_ISDIR(file_info.st_mode))
+  {
+    fp_in = fopen(path, "r");
+
+    if (fp_in == NULL)
+    {
+      fprintf(stderr, "Unable to open remap input %s.\n", path);
+      return 1;
+    }
+
+    status = 0;
+
+    while ((status == 0) && (fgets(line, REMAP_FILENAME_LENGTH, fp_in) != NULL))
+    {
+      length = strlen(line);
+
+      while ((length > 0) && ((line[length - 1] == '\n') || (line[length - 1] == '\r') ||
+                              (line[length - 1] == ' ')))
+      {
+        line[--length] = '\0';
+      }
+
+      if (length > 0)
+        status = add_remap_job(line, output_dir);
+    }
+
+    fclose(fp_in);
+
+    return status;
+  }
+
+  /* a directory (all of its tga files, in name order) */
+  dir = opendir(path);
+
+  if (dir == NULL)
+  {
+    fprintf(stderr, "Unable to open remap input %s.\n", path);
+    return 1;
+  }
+
+  names = NULL;
+  num_names = 0;
+  max_names = 0;
+
+  status = 0;
+
+  while ((status == 0) && ((entry = readdir(dir)) != NULL))
+  {
+    length = strlen(entry->d_name);
+
+    if ((length < 5) ||
+        ((strcmp(&entry->d_name[length - 4], ".tga")) &&
+         (strcmp(&entry->d_name[length - 4], ".TGA"))))
+    {
+      continue;
+    }
+
+    if (num_names >= max_names)
+    {
+      new_names = realloc(names, sizeof(char*) * 2 * (max_names + 8));
+
+      if (new_names == NULL)
+      {
+        status = 1;
+        break;
+      }
+
+      names = new_names;
+      max_names = 2 * (max_names + 8);
+    }
+
+    names[num_names] = malloc(length + 1);
+
+    if (names[num_names] == NULL)
+    {
+      status = 1;
+      break;
+    }
+
+    strcpy(names[num_names], entry->d_name);
+    num_names += 1;
+  }
+
+  closedir(dir);
+
+  if (num_names > 0)
+    qsort(names, num_names, sizeof(char*), compare_remap_names);
+
+  for (k = 0; k < num_names; k++)
+  {
+    if (status == 0)
+    {
+      if (strlen(path) + strlen(names[k]) + 1 >= REMAP_FILENAME_LENGTH)
+      {
+        fprintf(stderr, "Remap filename %s is too long.\n", names[k]);
+        status = 1;
+      }
+      else
+      {
+        sprintf(filename, "%s/%s", path, names[k]);
+        status = add_remap_job(filename, output_dir);
+      }
+    }
+
+    free(names[k]);
+  }
+
+  if (names != NULL)
+    free(names);
+
+  return status;
+}
+
+/*******************************************************************************
+** map_remap_job()
+*******************************************************************************/
+short int map_remap_job(remap_job* job, unsigned long* cache_colors,
+                        unsigned short* cache_indices, long* cache_count)
+{
+  unsigned char*  src;
+  unsigned short* dest;
+
+  unsigned long color;
+  unsigned long hash;
+
+  float rgb[3];
+  int   index;
+
+  long  n;
+  int   m;
+
+  job->indices = malloc(sizeof(unsigned short) * (long) job->image.width * job->image.height);
+
+  if (job->indices == NULL)
+  {
+    fprintf(stderr, "Remap failed: Unable to allocate indices for %s.\n", job->input_filename);
+    return 1;
+  }
+
+  for (n = 0; n < job->image.height; n++)
+  {
+    src = get_tga_image_row(&job->image, (int) n);
+    dest = &job->indices[n * job->image.width];
+
+    for (m = 0; m < job->image.width; m++)
+    {
+      color = ((unsigned long) src[3 * m + 2] << 16) |
+              ((unsigned long) src[3 * m + 1] << 8) |
+              ((unsigned long) src[3 * m + 0]);
+
+      /* exact: look the color up in the palette */
+      if (S_remap_mode == REMAP_MODE_EXACT)
+      {
+        hash = get_remap_hash(color, TGA_INDEXED_HASH_SIZE);
+
+        while ((S_remap_hash_colors[hash] != 0xFFFFFFFFUL) && (S_remap_hash_colors[hash] != color))
+          hash = (hash + 1) & (TGA_INDEXED_HASH_SIZE - 1);
+
+        if (S_remap_hash_colors[hash] == 0xFFFFFFFFUL)
+        {
+          fprintf(stderr, "Remap failed: %s has colors that are not in the palette.\n",
+                  job->input_filename);
+          return 1;
+        }
+
+        dest[m] = S_remap_hash_indices[hash];
+        continue;
+      }
+
+      /* nearest: look the color up in the cache, or search the row */
+      hash = get_remap_hash(color, REMAP_CACHE_SIZE);
+
+      while ((cache_colors[hash] != 0xFFFFFFFFUL) && (cache_colors[hash] != color))
+        hash = (hash + 1) & (REMAP_CACHE_SIZE - 1);
+
+      if (cache_colors[hash] == 0xFFFFFFFFUL)
+      {
+        if (*cache_count >= REMAP_CACHE_SIZE / 2)
+        {
+          for (index = 0; index < REMAP_CACHE_SIZE; index++)
+            cache_colors[index] = 0xFFFFFFFFUL;
+
+          *cache_count = 0;
+
+          hash = get_remap_hash(color, REMAP_CACHE_SIZE);
+        }
+
+        rgb[0] = src[3 * m + 2];
+        rgb[1] = src[3 * m + 1];
+        rgb[2] = src[3 * m + 0];
+
+        find_encode_nearest_color(S_remap_colors, S_remap_row_length, rgb, &index);
+
+        cache_colors[hash] = color;
+        cache_indices[hash] = (unsigned short) index;
+        *cache_count += 1;
+      }
+
+      dest[m] = cache_indices[hash];
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** remap_compute_thread()
+*******************************************************************************/
+void* remap_compute_thread(void* arg)
+{
+  remap_job*  job;
+
+  unsigned long*  cache_colors;
+  unsigned short* cache_indices;
+  long            cache_count;
+
+  int   k;
+
+  (void) arg;
+
+  cache_colors = malloc(sizeof(unsigned long) * REMAP_CACHE_SIZE);
+  cache_indices = malloc(sizeof(unsigned short) * REMAP_CACHE_SIZE);
+  cache_count = 0;
+
+  if (cache_colors != NULL)
+  {
+    for (k = 0; k < REMAP_CACHE_SIZE; k++)
+      cache_colors[k] = 0xFFFFFFFFUL;
+  }
+
+  while (1)
+  {
+    /* wait for the next image to be read */
+    pthread_mutex_lock(&S_remap_mutex);
+
+    while ( (S_remap_next_compute >= S_remap_num_read) &&
+            (S_remap_next_compute < S_remap_num_jobs) && (!S_remap_abort))
+    {
+      pthread_cond_wait(&S_remap_cond, &S_remap_mutex);
+    }
+
+    if ((S_remap_next_compute >= S_remap_num_jobs) || (S_remap_abort))
+    {
+      pthread_mutex_unlock(&S_remap_mutex);
+      break;
+    }
+
+    job = &S_remap_jobs[S_remap_next_compute];
+    job->state = REMAP_STATE_MAPPING;
+
+    S_remap_next_compute += 1;
+
+    pthread_mutex_unlock(&S_remap_mutex);
+
+    /* map it */
+    if (job->status == 0)
+    {
+      if ((cache_colors == NULL) || (cache_indices == NULL))
+        job->status = 1;
+      else
+        job->status = map_remap_job(job, cache_colors, cache_indices, &cache_count);
+    }
+
+    pthread_mutex_lock(&S_remap_mutex);
+    job->state = REMAP_STATE_MAPPED;
+    pthread_cond_broadcast(&S_remap_cond);
+    pthread_mutex_unlock(&S_remap_mutex);
+  }
+
+  if (cache_colors != NULL)
+    free(cache_colors);
+  if (cache_indices != NULL)
+    free(cache_indices);
+
+  return NULL;
+}
+
+/*******************************************************************************
+** remap_writer_thread()
+*******************************************************************************/
+void* remap_writer_thread(void* arg)
+{
+  remap_job*  job;
+
+  FILE* fp_out;
+
+  int   k;
+
+  (void) arg;
+
+  for (k = 0; k < S_remap_num_jobs; k++)
+  {
+    job = &S_remap_jobs[k];
+
+    /* wait for this image to be mapped */
+    pthread_mutex_lock(&S_remap_mutex);
+
+    while ((job->state != REMAP_STATE_MAPPED) && (!S_remap_abort))
+      pthread_cond_wait(&S_remap_cond, &S_remap_mutex);
+
+    if (job->state != REMAP_STATE_MAPPED)
+    {
+      pthread_mutex_unlock(&S_remap_mutex);
+      break;
+    }
+
+    pthread_mutex_unlock(&S_remap_mutex);
+
+    /* write it */
+    if (job->status == 0)
+    {
+      fp_out = open_output_stream(job->output_filename, -1);
+
+      if (fp_out == NULL)
+        job->status = 1;
+      else
+      {
+        if (write_tga_image_indexed(fp_out, job->indices,
+                                    job->image.width, job->image.height,
+                                    S_remap_color_map, S_remap_num_colors))
+        {
+          job->status = 1;
+        }
+
+        if (close_output_stream(fp_out))
+          job->status = 1;
+      }
+
+      if (job->status == 0)
+      {
+        S_remap_bytes_written += TGA_HEADER_SIZE + 3 * S_remap_num_colors +
+                                 (long) job->image.width * job->image.height *
+                                 ((S_remap_num_colors <= 256) ? 1 : 2);
+      }
+      else
+        fprintf(stderr, "Remap failed: Unable to write %s.\n", job->output_filename);
+    }
+
+    if (job->status != 0)
+      S_remap_num_failed += 1;
+
+    /* release it */
+    clear_tga_image(&job->image);
+
+    if (job->indices != NULL)
+    {
+      free(job->indices);
+      job->indices = NULL;
+    }
+
+    pthread_mutex_lock(&S_remap_mutex);
+    S_remap_num_written += 1;
+    pthread_cond_broadcast(&S_remap_cond);
+    pthread_mutex_unlock(&S_remap_mutex);
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+** read_remap_job()
+*******************************************************************************/
+short int read_remap_job(remap_job* job, long page_size)
+{
+  volatile unsigned char  sum;
+
+  size_t  offset;
+
+  if (read_tga_image(job->input_filename, &job->image))
+  {
+    fprintf(stderr, "Remap failed: Unable to read %s.\n", job->input_filename);
+    return 1;
+  }
+
+  job->num_bytes = (long) job->image.mapping_size;
+
+  /* fault in the mapped pages here, so that the */
+  /* compute threads do not wait on the disk     */
+  sum = 0;
+
+  for (offset = 0; offset < job->image.mapping_size; offset += page_size)
+    sum += job->image.mapping[offset];
+
+  (void) sum;
+
+  return 0;
+}
+
+/*******************************************************************************
+** run_remap()
+*******************************************************************************/
+short int run_remap(int num_threads)
+{
+  pthread_t compute_threads[POOL_MAX_THREADS];
+  pthread_t writer_thread;
+
+  int   num_started;
+  int   writer_started;
+
+  struct timespec start;
+  struct timespec end;
+
+  double  seconds;
+  double  megabytes_read;
+  long    num_bytes_read;
+  long    page_size;
+
+  remap_job*  job;
+
+  int   k;
+
+  if ((S_remap_colors == NULL) || (S_remap_num_jobs == 0))
+    return 1;
+
+  if ((num_threads < 1) || (num_threads > POOL_MAX_THREADS))
+    return 1;
+
+  page_size = sysconf(_SC_PAGESIZE);
+
+  if (page_size <= 0)
+    page_size = 4096;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  S_remap_num_read = 0;
+  S_remap_next_compute = 0;
+  S_remap_num_written = 0;
+  S_remap_abort = 0;
+  S_remap_bytes_written = 0;
+  S_remap_num_failed = 0;
+
+  pthread_mutex_init(&S_remap_mutex, NULL);
+  pthread_cond_init(&S_remap_cond, NULL);
+
+  /* start the compute & writer threads */
+  for (num_started = 0; num_started < num_threads; num_started++)
+  {
+    if (pthread_create(&compute_threads[num_started], NULL, remap_compute_thread, NULL))
+    {
+      S_remap_abort = 1;
+      break;
+    }
+  }
+
+  writer_started = 0;
+
+  if (!S_remap_abort)
+  {
+    if (pthread_create(&writer_thread, NULL, remap_writer_thread, NULL))
+      S_remap_abort = 1;
+    else
+      writer_started = 1;
+  }
+
+  /* read the images (this is the reader thread) */
+  for (k = 0; (k < S_remap_num_jobs) && (!S_remap_abort); k++)
+  {
+    job = &S_remap_jobs[k];
+
+    pthread_mutex_lock(&S_remap_mutex);
+
+    while ((S_remap_num_read - S_remap_num_written >= REMAP_MAX_IN_FLIGHT) && (!S_remap_abort))
+      pthread_cond_wait(&S_remap_cond, &S_remap_mutex);
+
+    pthread_mutex_unlock(&S_remap_mutex);
+
+    job->status = read_remap_job(job, page_size);
+
+    pthread_mutex_lock(&S_remap_mutex);
+    job->state = REMAP_STATE_READ;
+    S_remap_num_read += 1;
+    pthread_cond_broadcast(&S_remap_cond);
+    pthread_mutex_unlock(&S_remap_mutex);
+  }
+
+  /* stop the threads if one of them could not be started */
+  if (S_remap_abort)
+  {
+    fprintf(stderr, "Unable to start remap threads.\n");
+
+    pthread_mutex_lock(&S_remap_mutex);
+    pthread_cond_broadcast(&S_remap_cond);
+    pthread_mutex_unlock(&S_remap_mutex);
+  }
+
+  for (k = 0; k < num_started; k++)
+    pthread_join(compute_threads[k], NULL);
+
+  if (writer_started)
+    pthread_join(writer_thread, NULL);
+
+  pthread_cond_destroy(&S_remap_cond);
+  pthread_mutex_destroy(&S_remap_mutex);
+
+  if (S_remap_abort)
+    return 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  /* throughput (of the files that were remapped & written) */
+  num_bytes_read = 0;
+
+  for (k = 0; k < S_remap_num_jobs; k++)
+  {
+    if (S_remap_jobs[k].status == 0)
+      num_bytes_read += S_remap_jobs[k].num_bytes;
+  }
+
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+  megabytes_read = num_bytes_read / 1048576.0;
+
+  printf("remapped %d of %d files (%.2f MB read, %.2f MB written) in %.3f s, %.1f MB/s\n",
+         S_remap_num_jobs - S_remap_num_failed, S_remap_num_jobs,
+         megabytes_read, S_remap_bytes_written / 1048576.0, seconds,
+         (seconds > 0.0) ? megabytes_read / seconds : 0.0);
+
+  if (S_remap_num_failed > 0)
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_remap()
+*******************************************************************************/
+short int clear_remap()
+{
+  int k;
+
+  if (S_remap_colors != NULL)
+  {
+    free(S_remap_colors);
+    S_remap_colors = NULL;
+  }
+
+  if (S_remap_color_map != NULL)
+  {
+    free(S_remap_color_map);
+    S_remap_color_map = NULL;
+  }
+
+  if (S_remap_hash_colors != NULL)
+  {
+    free(S_remap_hash_colors);
+    S_remap_hash_colors = NULL;
+  }
+
+  if (S_remap_hash_indices != NULL)
+  {
+    free(S_remap_hash_indices);
+    S_remap_hash_indices = NULL;
+  }
+
+  if (S_remap_jobs != NULL)
+  {
+    /* (only if the pipeline was stopped early) */
+    for (k = 0; k < S_remap_num_jobs; k++)
+    {
+      clear_tga_image(&S_remap_jobs[k].image);
+
+      if (S_remap_jobs[k].indices != NULL)
+        free(S_remap_jobs[k].indices);
+    }
+
+    free(S_remap_jobs);
+    S_remap_jobs = NULL;
+  }
+
+  S_remap_num_jobs = 0;
+  S_remap_max_jobs = 0;
+
+  return 0;
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************
+** remap.h (batch remapping of images onto a palette)
+*******************************************************************************/
+
+#ifndef REMAP_H
+#define REMAP_H
+
+#include "reader.h"
+
+#define REMAP_FILENAME_LENGTH 512
+
+/* at most this many images are in memory at once (read, */
+/* mapped, or waiting to be written)                     */
+#define REMAP_MAX_IN_FLIGHT 8
+
+/* each compute thread caches the nearest colors it has found */
+/* (the cache is cleared when it gets half full)              */
+#define REMAP_CACHE_SIZE  65536
+
+enum
+{
+  REMAP_MODE_NEAREST = 0,
+  REMAP_MODE_EXACT
+};
+
+enum
+{
+  REMAP_STATE_QUEUED = 0,
+  REMAP_STATE_READ,
+  REMAP_STATE_MAPPING,
+  REMAP_STATE_MAPPED
+};
+
+typedef struct remap_job
+{
+  char  input_filename[REMAP_FILENAME_LENGTH];
+  char  output_filename[REMAP_FILENAME_LENGTH];
+
+  tga_image       image;
+  unsigned short* indices;
+
+  long  num_bytes;
+
+  int   state;
+  short int status;
+} remap_job;
+
+/* function declarations */
+short int setup_remap_palette(int palette, int level, int mode);
+short int add_remap_inputs(char* path, char* output_dir);
+
+short int run_remap(int num_threads);
+
+short int clear_remap();
+
+#endif
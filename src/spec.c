@@ -0,0 +1,834 @@
+/*******************************************************************************
+** spec.c (palette spec files)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "palette.h"
+#include "pool.h"
+#include "spec.h"
+#include "tga.h"
+
+/* a spec file is a list of sections, each defining one palette:    */
+/*                                                                    */
+/*   # comment                                                        */
+/*   [name]                                                           */
+/*   source = composite_16_rotated  (first key, if given)             */
+/*   size = 256                                                       */
+/*   levels = 64                    (default is size / 16)            */
+/*   hues = 12                                                        */
+/*   shades = 16                                                      */
+/*   rotations = 6                                                    */
+/*   tints = 3                                                        */
+/*   phi = 15                       (degrees)                         */
+/*   tint_start_hue = 1                                               */
+/*   fixed_hues_left = 1                                              */
+/*   fixed_hues_right = 1                                             */
+/*   table = uniform                (or a built-in source name)       */
+/*   table_step = 1/18              (default is 1 / (shades + 2))     */
+/*   variant = protan               (adds a palette, see below)       */
+/*   output = name.tga              (default is the section name)     */
+/*                                                                    */
+/* each variant line adds a palette after the 16 built-in ones: a     */
+/* color transform of palette 0 (protan, deutan, tritan, night or     */
+/* sepia), or a custom 3x3 matrix (9 numbers, row major, for rgb in   */
+/* 0-1) optionally followed by an offset (3 more numbers).            */
+/*                                                                    */
+/* unspecified values default to the composite 16 source. specs that  */
+/* share a voltage table, or a table & hues & shades & phi, share the */
+/* computed table or base row.                                        */
+
+typedef struct spec_voltage_table
+{
+  int     table_source;
+  float   table_step;
+  int     num_shades;
+
+  float*  luma_table;
+  float*  saturation_table;
+} spec_voltage_table;
+
+typedef struct spec_base_row
+{
+  int     voltage_index;
+
+  int     num_hues;
+  int     num_shades;
+  float   phi;
+
+  unsigned char* row;
+} spec_base_row;
+
+palette_spec* G_specs;
+int           G_num_specs;
+
+spec_voltage_table* S_spec_voltage_tables;
+int                 S_spec_num_voltage_tables;
+
+spec_base_row*      S_spec_base_rows;
+int                 S_spec_num_base_rows;
+
+unsigned char*      S_spec_buffers[POOL_MAX_THREADS];
+long                S_spec_max_pixels;
+
+/*******************************************************************************
+** trim_spec_string()
+*******************************************************************************/
+char* trim_spec_string(char* str)
+{
+  char* end;
+
+  while (isspace((unsigned char) *str))
+    str++;
+
+  end = str + strlen(str);
+
+  while ((end > str) && isspace((unsigned char) *(end - 1)))
+    end--;
+
+  *end = '\0';
+
+  return str;
+}
+
+/*******************************************************************************
+** parse_spec_int()
+*******************************************************************************/
+short int parse_spec_int(char* value, int* result)
+{
+  char* endptr;
+  long  number;
+
+  number = strtol(value, &endptr, 10);
+
+  if ((endptr == value) || (*endptr != '\0') || (number < 0) || (number > 65535))
+    return 1;
+
+  *result = (int) number;
+
+  return 0;
+}
+
+/*******************************************************************************
+** parse_spec_float()
+*******************************************************************************/
+short int parse_spec_float(char* value, float* result)
+{
+  char*   endptr;
+  double  numerator;
+  double  denominator;
+
+  numerator = strtod(value, &endptr);
+
+  if (endptr == value)
+    return 1;
+
+  /* fractions (such as 1/18) are allowed */
+  if (*endptr == '/')
+  {
+    value = endptr + 1;
+    denominator = strtod(value, &endptr);
+
+    if ((endptr == value) || (denominator == 0.0))
+      return 1;
+
+    numerator /= denominator;
+  }
+
+  if (*endptr != '\0')
+    return 1;
+
+  *result = (float) numerator;
+
+  return 0;
+}
+
+/*******************************************************************************
+** parse_spec_variant()
+*******************************************************************************/
+short int parse_spec_variant(char* value, palette_params* pp)
+{
+  palette_transform*  pt;
+
+  char*   endptr;
+  double  number;
+
+  float   numbers[12];
+  int     num_numbers;
+
+  int   transform;
+  int   k;
+
+  if (pp->num_variants >= PALETTE_MAX_VARIANTS)
+    return 1;
+
+  pt = &pp->variants[pp->num_variants];
+
+  /* built-in transform */
+  transform = get_palette_transform_from_name(value);
+
+  if (transform >= 0)
+  {
+    set_palette_transform(pt, transform);
+    pp->num_variants += 1;
+
+    return 0;
+  }
+
+  /* custom matrix (and offset) */
+  num_numbers = 0;
+
+  while (*value != '\0')
+  {
+    number = strtod(value, &endptr);
+
+    if ((endptr == value) || (num_numbers >= 12))
+      return 1;
+
+    if ((*endptr != '\0') && (!isspace((unsigned char) *endptr)))
+      return 1;
+
+    numbers[num_numbers] = (float) number;
+    num_numbers += 1;
+
+    value = endptr;
+
+    while (isspace((unsigned char) *value))
+      value++;
+  }
+
+  if ((num_numbers != 9) && (num_numbers != 12))
+    return 1;
+
+  for (k = 0; k < 9; k++)
+    pt->matrix[k] = numbers[k];
+
+  for (k = 0; k < 3; k++)
+    pt->offset[k] = (num_numbers == 12) ? numbers[9 + k] : 0.0f;
+
+  pp->num_variants += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** init_palette_spec()
+*******************************************************************************/
+short int init_palette_spec(palette_spec* spec, char* name)
+{
+  memset(spec, 0, sizeof(palette_spec));
+
+  strncpy(spec->name, name, SPEC_NAME_LENGTH - 1);
+  spec->name[SPEC_NAME_LENGTH - 1] = '\0';
+
+  spec->output_filename[0] = '\0';
+
+  /* defaults are the composite 16 parameters, with a uniform table */
+  set_palette_params_for_source(&spec->params, SOURCE_COMPOSITE_16);
+
+  spec->table_source = -1;
+  spec->table_step = 0.0f;
+
+  spec->num_keys = 0;
+
+  spec->voltage_index = -1;
+  spec->base_row_index = -1;
+
+  spec->status = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_palette_spec_value()
+*******************************************************************************/
+short int set_palette_spec_value(palette_spec* spec, char* key, char* value)
+{
+  palette_params* pp;
+
+  int   source;
+  float degrees;
+
+  pp = &spec->params;
+
+  if (!strcmp(key, "source"))
+  {
+    source = get_palette_source_from_name(value);
+
+    if (set_palette_params_for_source(pp, source))
+      return 1;
+
+    spec->table_source = source;
+  }
+  else if (!strcmp(key, "size"))
+    return parse_spec_int(value, &pp->palette_size);
+  else if (!strcmp(key, "levels"))
+    return parse_spec_int(value, &pp->num_levels);
+  else if (!strcmp(key, "hues"))
+    return parse_spec_int(value, &pp->num_hues);
+  else if (!strcmp(key, "shades"))
+    return parse_spec_int(value, &pp->num_shades);
+  else if (!strcmp(key, "rotations"))
+    return parse_spec_int(value, &pp->num_rotations);
+  else if (!strcmp(key, "tints"))
+    return parse_spec_int(value, &pp->num_tints);
+  else if (!strcmp(key, "tint_start_hue"))
+    return parse_spec_int(value, &pp->tint_start_hue);
+  else if (!strcmp(key, "fixed_hues_left"))
+    return parse_spec_int(value, &pp->fixed_hues_left);
+  else if (!strcmp(key, "fixed_hues_right"))
+    return parse_spec_int(value, &pp->fixed_hues_right);
+  else if (!strcmp(key, "phi"))
+  {
+    if (parse_spec_float(value, &degrees))
+      return 1;
+
+    pp->phi = (degrees * PI) / 180.0f;
+  }
+  else if (!strcmp(key, "table"))
+  {
+    if (!strcmp(value, "uniform"))
+      spec->table_source = -1;
+    else
+    {
+      spec->table_source = get_palette_source_from_name(value);
+
+      if (spec->table_source < 0)
+        return 1;
+    }
+  }
+  else if (!strcmp(key, "table_step"))
+  {
+    if (parse_spec_float(value, &spec->table_step))
+      return 1;
+
+    if ((spec->table_step <= 0.0f) || (spec->table_step >= 1.0f))
+      return 1;
+
+    spec->table_source = -1;
+  }
+  else if (!strcmp(key, "variant"))
+    return parse_spec_variant(value, pp);
+  else if (!strcmp(key, "output"))
+  {
+    /* several specs are written at once, so stdout is not allowed */
+    if ((value[0] == '\0') || (!strcmp(value, "-")))
+      return 1;
+
+    if (strlen(value) >= SPEC_FILENAME_LENGTH)
+      return 1;
+
+    strcpy(spec->output_filename, value);
+  }
+  else
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** finish_palette_spec()
+*******************************************************************************/
+short int finish_palette_spec(palette_spec* spec)
+{
+  float*  luma_table;
+  float*  saturation_table;
+  int     table_length;
+
+  /* check parameters */
+  if (derive_palette_params(&spec->params))
+  {
+    fprintf(stderr, "Spec %s: Invalid palette parameters.\n", spec->name);
+    return 1;
+  }
+
+  if (spec->params.num_shades > SPEC_MAX_VOLTAGE_SHADES)
+  {
+    fprintf(stderr, "Spec %s: Too many shades.\n", spec->name);
+    return 1;
+  }
+
+  /* check voltage table */
+  if (spec->table_source >= 0)
+  {
+    get_source_voltage_tables(spec->table_source, &luma_table, &saturation_table, &table_length);
+
+    if (table_length != spec->params.num_shades)
+    {
+      fprintf(stderr, "Spec %s: The voltage table has %d shades, not %d.\n",
+              spec->name, table_length, spec->params.num_shades);
+      return 1;
+    }
+  }
+  else if (spec->params.num_shades % 2 != 0)
+  {
+    fprintf(stderr, "Spec %s: A uniform table needs an even number of shades.\n", spec->name);
+    return 1;
+  }
+  else if (spec->table_step == 0.0f)
+    spec->table_step = 1.0f / (spec->params.num_shades + 2);
+
+  /* default output filename */
+  if (spec->output_filename[0] == '\0')
+  {
+    if (strlen(spec->name) + 4 >= SPEC_FILENAME_LENGTH)
+      return 1;
+
+    strcpy(spec->output_filename, spec->name);
+    strcat(spec->output_filename, ".tga");
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** load_palette_specs()
+*******************************************************************************/
+short int load_palette_specs(char* filename)
+{
+  FILE* fp_in;
+
+  char  line[SPEC_LINE_LENGTH];
+  int   line_number;
+
+  char* str;
+  char* key;
+  char* value;
+  char* separator;
+
+  int   k;
+
+  palette_spec* specs;
+  int           capacity;
+
+  palette_spec* current;
+
+  G_specs = NULL;
+  G_num_specs = 0;
+
+  capacity = 0;
+  current = NULL;
+
+  /* open file */
+  fp_in = fopen(filename, "r");
+
+  if (fp_in == NULL)
+  {
+    fprintf(stderr, "Unable to open spec file %s.\n", filename);
+    return 1;
+  }
+
+  /* read lines */
+  line_number = 0;
+
+  while (fgets(line, SPEC_LINE_LENGTH, fp_in) != NULL)
+  {
+    line_number += 1;
+
+    if ((strchr(line, '\n') == NULL) && (!feof(fp_in)))
+    {
+      fprintf(stderr, "Spec file %s, line %d: Line is too long.\n", filename, line_number);
+      goto fail;
+    }
+
+    /* remove comments */
+    if ((str = strchr(line, '#')) != NULL)
+      *str = '\0';
+
+    str = trim_spec_string(line);
+
+    if (str[0] == '\0')
+      continue;
+
+    /* start of a new section */
+    if (str[0] == '[')
+    {
+      separator = strchr(str, ']');
+
+      if ((separator == NULL) || (separator[1] != '\0'))
+      {
+        fprintf(stderr, "Spec file %s, line %d: Invalid section name.\n", filename, line_number);
+        goto fail;
+      }
+
+      *separator = '\0';
+      str = trim_spec_string(str + 1);
+
+      if ((str[0] == '\0') || (strlen(str) >= SPEC_NAME_LENGTH))
+      {
+        fprintf(stderr, "Spec file %s, line %d: Invalid section name.\n", filename, line_number);
+        goto fail;
+      }
+
+      for (k = 0; k < G_num_specs; k++)
+      {
+        if (!strcmp(G_specs[k].name, str))
+        {
+          fprintf(stderr, "Spec file %s, line %d: Duplicate section %s.\n", filename, line_number, str);
+          goto fail;
+        }
+      }
+
+      /* finish the previous section */
+      if ((current != NULL) && finish_palette_spec(current))
+        goto fail;
+
+      /* grow the spec array as needed */
+      if (G_num_specs >= capacity)
+      {
+        capacity = (capacity == 0) ? 16 : 2 * capacity;
+        specs = realloc(G_specs, sizeof(palette_spec) * capacity);
+
+        if (specs == NULL)
+        {
+          fprintf(stderr, "Unable to allocate specs.\n");
+          goto fail;
+        }
+
+        G_specs = specs;
+      }
+
+      current = &G_specs[G_num_specs];
+      G_num_specs += 1;
+
+      init_palette_spec(current, str);
+
+      continue;
+    }
+
+    /* key = value */
+    separator = strchr(str, '=');
+
+    if ((separator == NULL) || (current == NULL))
+    {
+      fprintf(stderr, "Spec file %s, line %d: Expected [section] or key = value.\n", filename, line_number);
+      goto fail;
+    }
+
+    *separator = '\0';
+
+    key = trim_spec_string(str);
+    value = trim_spec_string(separator + 1);
+
+    /* the source sets all of the params, which would */
+    /* silently undo any keys given before it         */
+    if ((!strcmp(key, "source")) && (current->num_keys > 0))
+    {
+      fprintf(stderr, "Spec file %s, line %d: The source must be the first key of a section.\n", filename, line_number);
+      goto fail;
+    }
+
+    current->num_keys += 1;
+
+    if (set_palette_spec_value(current, key, value))
+    {
+      fprintf(stderr, "Spec file %s, line %d: Invalid value for %s.\n", filename, line_number, key);
+      goto fail;
+    }
+  }
+
+  /* finish the last section */
+  if ((current != NULL) && finish_palette_spec(current))
+    goto fail;
+
+  fclose(fp_in);
+
+  if (G_num_specs == 0)
+  {
+    fprintf(stderr, "Spec file %s has no palettes.\n", filename);
+    clear_palette_specs();
+    return 1;
+  }
+
+  return 0;
+
+fail:
+  fclose(fp_in);
+  clear_palette_specs();
+
+  return 1;
+}
+
+/*******************************************************************************
+** share_palette_spec_tables()
+*******************************************************************************/
+short int share_palette_spec_tables()
+{
+  palette_spec*       spec;
+  spec_voltage_table* vt;
+  spec_base_row*      br;
+
+  int   table_length;
+
+  int   k;
+  int   n;
+
+  vt = NULL;
+  br = NULL;
+
+  S_spec_voltage_tables = malloc(sizeof(spec_voltage_table) * G_num_specs);
+  S_spec_base_rows = malloc(sizeof(spec_base_row) * G_num_specs);
+
+  S_spec_num_voltage_tables = 0;
+  S_spec_num_base_rows = 0;
+
+  if ((S_spec_voltage_tables == NULL) || (S_spec_base_rows == NULL))
+    return 1;
+
+  for (k = 0; k < G_num_specs; k++)
+  {
+    spec = &G_specs[k];
+
+    /* find or add the voltage table */
+    for (n = 0; n < S_spec_num_voltage_tables; n++)
+    {
+      vt = &S_spec_voltage_tables[n];
+
+      if ((vt->table_source == spec->table_source) &&
+          (vt->num_shades == spec->params.num_shades) &&
+          ((spec->table_source >= 0) || (vt->table_step == spec->table_step)))
+      {
+        break;
+      }
+    }
+
+    if (n == S_spec_num_voltage_tables)
+    {
+      vt = &S_spec_voltage_tables[n];
+
+      vt->table_source = spec->table_source;
+      vt->table_step = spec->table_step;
+      vt->num_shades = spec->params.num_shades;
+
+      vt->luma_table = NULL;
+      vt->saturation_table = NULL;
+
+      S_spec_num_voltage_tables += 1;
+
+      /* the built-in tables are used as they are */
+      if (spec->table_source >= 0)
+      {
+        get_source_voltage_tables(spec->table_source,
+                                  &vt->luma_table, &vt->saturation_table,
+                                  &table_length);
+      }
+      else
+      {
+        vt->luma_table = malloc(sizeof(float) * 2 * vt->num_shades);
+
+        if (vt->luma_table == NULL)
+          return 1;
+
+        vt->saturation_table = &vt->luma_table[vt->num_shades];
+
+        generate_uniform_voltage_table( vt->luma_table, vt->saturation_table,
+                                        vt->num_shades, vt->table_step);
+      }
+    }
+
+    vt = &S_spec_voltage_tables[n];
+    spec->voltage_index = n;
+
+    spec->params.luma_table = vt->luma_table;
+    spec->params.saturation_table = vt->saturation_table;
+    spec->params.channel_order = PALETTE_CHANNEL_ORDER_RGB;
+
+    /* find or add the base row */
+    for (n = 0; n < S_spec_num_base_rows; n++)
+    {
+      br = &S_spec_base_rows[n];
+
+      if ((br->voltage_index == spec->voltage_index) &&
+          (br->num_hues == spec->params.num_hues) &&
+          (br->num_shades == spec->params.num_shades) &&
+          (br->phi == spec->params.phi))
+      {
+        break;
+      }
+    }
+
+    if (n == S_spec_num_base_rows)
+    {
+      br = &S_spec_base_rows[n];
+
+      br->voltage_index = spec->voltage_index;
+      br->num_hues = spec->params.num_hues;
+      br->num_shades = spec->params.num_shades;
+      br->phi = spec->params.phi;
+
+      br->row = malloc(sizeof(unsigned char) * 3 * (br->num_hues + 1) * br->num_shades);
+
+      S_spec_num_base_rows += 1;
+
+      if (br->row == NULL)
+        return 1;
+
+      spec->params.base_row = NULL;
+      generate_palette_base_row(&spec->params, br->row);
+    }
+
+    br = &S_spec_base_rows[n];
+    spec->base_row_index = n;
+    spec->params.base_row = br->row;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** spec_task()
+*******************************************************************************/
+void spec_task(int worker, long index, void* arg)
+{
+  palette_spec*   spec;
+  unsigned char*  data;
+
+  FILE* fp_out;
+
+  (void) arg;
+
+  spec = &G_specs[index];
+
+  /* each worker reuses one buffer, large enough for any spec */
+  if (S_spec_buffers[worker] == NULL)
+    S_spec_buffers[worker] = allocate_aligned_buffer(3 * S_spec_max_pixels);
+
+  data = S_spec_buffers[worker];
+
+  if (data == NULL)
+  {
+    spec->status = 1;
+    return;
+  }
+
+  /* generate palette */
+  spec->status = generate_palette_composite_data(&spec->params, data);
+
+  if (spec->status)
+    return;
+
+  /* write output file */
+  fp_out = open_output_stream(spec->output_filename, -1);
+
+  if (fp_out == NULL)
+  {
+    spec->status = 1;
+    return;
+  }
+
+  spec->status = write_tga_image( fp_out, data,
+                                  spec->params.palette_size,
+                                  get_palette_height(&spec->params), 3);
+
+  if (close_output_stream(fp_out))
+    spec->status = 1;
+}
+
+/*******************************************************************************
+** run_palette_specs()
+*******************************************************************************/
+short int run_palette_specs(int num_threads)
+{
+  int       k;
+  long      pixels;
+
+  short int status;
+
+  if (G_num_specs == 0)
+    return 1;
+
+  /* compute the shared voltage tables & base rows once */
+  if (share_palette_spec_tables())
+  {
+    fprintf(stderr, "Unable to allocate shared spec tables.\n");
+    return 1;
+  }
+
+  S_spec_max_pixels = 0;
+
+  for (k = 0; k < G_num_specs; k++)
+  {
+    pixels = (long) G_specs[k].params.palette_size * get_palette_height(&G_specs[k].params);
+
+    if (pixels > S_spec_max_pixels)
+      S_spec_max_pixels = pixels;
+  }
+
+  /* generate all specs across the worker threads */
+  for (k = 0; k < POOL_MAX_THREADS; k++)
+    S_spec_buffers[k] = NULL;
+
+  run_pool_tasks(num_threads, G_num_specs, spec_task, NULL);
+
+  for (k = 0; k < POOL_MAX_THREADS; k++)
+  {
+    if (S_spec_buffers[k] != NULL)
+    {
+      free(S_spec_buffers[k]);
+      S_spec_buffers[k] = NULL;
+    }
+  }
+
+  /* report failures */
+  status = 0;
+
+  for (k = 0; k < G_num_specs; k++)
+  {
+    if (G_specs[k].status)
+    {
+      fprintf(stderr, "Error generating spec %s (%s).\n",
+              G_specs[k].name, G_specs[k].output_filename);
+      status = 1;
+    }
+  }
+
+  return status;
+}
+
+/*******************************************************************************
+** clear_palette_specs()
+*******************************************************************************/
+short int clear_palette_specs()
+{
+  int k;
+
+  if (S_spec_voltage_tables != NULL)
+  {
+    for (k = 0; k < S_spec_num_voltage_tables; k++)
+    {
+      if (S_spec_voltage_tables[k].table_source < 0)
+        free(S_spec_voltage_tables[k].luma_table);
+    }
+
+    free(S_spec_voltage_tables);
+    S_spec_voltage_tables = NULL;
+  }
+
+  if (S_spec_base_rows != NULL)
+  {
+    for (k = 0; k < S_spec_num_base_rows; k++)
+    {
+      if (S_spec_base_rows[k].row != NULL)
+        free(S_spec_base_rows[k].row);
+    }
+
+    free(S_spec_base_rows);
+    S_spec_base_rows = NULL;
+  }
+
+  S_spec_num_voltage_tables = 0;
+  S_spec_num_base_rows = 0;
+
+  if (G_specs != NULL)
+  {
+    free(G_specs);
+    G_specs = NULL;
+  }
+
+  G_num_specs = 0;
+
+  return 0;
+}
@@ -0,0 +1,52 @@
+/*******************************************************************************
+** spec.h (palette spec files)
+*******************************************************************************/
+
+#ifndef SPEC_H
+#define SPEC_H
+
+#include "palette.h"
+
+#define SPEC_NAME_LENGTH      64
+#define SPEC_LINE_LENGTH      256
+#define SPEC_FILENAME_LENGTH  256
+
+#define SPEC_MAX_VOLTAGE_SHADES 256
+
+typedef struct palette_spec
+{
+  char  name[SPEC_NAME_LENGTH];
+  char  output_filename[SPEC_FILENAME_LENGTH];
+
+  /* the voltage table is either uniform (with the given */
+  /* step), or the table of one of the built-in sources  */
+  int   table_source;
+  float table_step;
+
+  palette_params  params;
+
+  /* keys set so far (source resets the params, so it must be first) */
+  int   num_keys;
+
+  /* indices into the shared voltage tables & base rows */
+  int   voltage_index;
+  int   base_row_index;
+
+  short int status;
+} palette_spec;
+
+extern palette_spec*  G_specs;
+extern int            G_num_specs;
+
+/* function declarations */
+char*     trim_spec_string(char* str);
+short int parse_spec_int(char* value, int* result);
+short int parse_spec_float(char* value, float* result);
+short int parse_spec_variant(char* value, palette_params* pp);
+
+short int load_palette_specs(char* filename);
+short int share_palette_spec_tables();
+short int run_palette_specs(int num_threads);
+short int clear_palette_specs();
+
+#endif
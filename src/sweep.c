@@ -0,0 +1,766 @@
+/*******************************************************************************
+** sweep.c (parameter sweeps)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "analysis.h"
+#include "palette.h"
+#include "pool.h"
+#include "spec.h"
+#include "sweep.h"
+#include "tga.h"
+
+/* a sweep file lists the values to try for each parameter,   */
+/* and every combination is generated (in any order). values  */
+/* are comma separated numbers or inclusive start:stop:step   */
+/* ranges (phi is in degrees, and a table step of 0 is the    */
+/* default of 1 / (shades + 2)):                              */
+/*                                                            */
+/*   size = 1024                                              */
+/*   hues = 12, 24                                            */
+/*   shades = 32                                              */
+/*   phi = 0:30:0.5                                           */
+/*   table_step = 0, 1/40:1/30:0.0005                         */
+/*   fixed_hues_left = 0:2                                    */
+/*   top = 10                      (write the 10 best as tga) */
+/*   top_prefix = sweep_                                      */
+/*   score = delta_e               (distance, delta_e, clip)  */
+/*                                                            */
+/* the summary has one line per valid combination, with its   */
+/* base row metrics, the clipping & delta e analysis, and a   */
+/* hash of the full texture. the scores for the top outputs   */
+/* are the smallest rgb distance between any two colors of    */
+/* the base row, the smallest delta e between adjacent shades */
+/* or hues (larger is better), or the total clipping amount   */
+/* (smaller is better).                                       */
+
+char* S_sweep_param_names[SWEEP_NUM_PARAMS] =
+  { "size", "hues", "shades", "rotations", "tints",
+    "phi", "table_step", "tint_start_hue",
+    "fixed_hues_left", "fixed_hues_right" };
+
+float*  S_sweep_values[SWEEP_NUM_PARAMS];
+int     S_sweep_num_values[SWEEP_NUM_PARAMS];
+
+long    S_sweep_num_combinations;
+int     S_sweep_max_size;
+
+int     S_sweep_top;
+int     S_sweep_score;
+char    S_sweep_top_prefix[SWEEP_PREFIX_LENGTH];
+
+sweep_result*   S_sweep_results;
+
+unsigned char*  S_sweep_buffers[POOL_MAX_THREADS];
+analysis_row*   S_sweep_analysis_rows[POOL_MAX_THREADS];
+
+/*******************************************************************************
+** add_sweep_values()
+*******************************************************************************/
+short int add_sweep_values(int param, char* str)
+{
+  char* item;
+  char* next;
+  char* colon;
+
+  float start;
+  float stop;
+  float step;
+
+  float value;
+  long  k;
+
+  int   num_values;
+
+  num_values = 0;
+
+  for (item = str; item != NULL; item = next)
+  {
+    next = strchr(item, ',');
+
+    if (next != NULL)
+      *next++ = '\0';
+
+    item = trim_spec_string(item);
+
+    /* range (start:stop or start:stop:step) */
+    if ((colon = strchr(item, ':')) != NULL)
+    {
+      *colon = '\0';
+
+      if (parse_spec_float(trim_spec_string(item), &start))
+        return 1;
+
+      item = colon + 1;
+      step = 1.0f;
+
+      if ((colon = strchr(item, ':')) != NULL)
+      {
+        *colon = '\0';
+
+        if (parse_spec_float(trim_spec_string(colon + 1), &step))
+          return 1;
+      }
+
+      if (parse_spec_float(trim_spec_string(item), &stop))
+        return 1;
+
+      if ((step <= 0.0f) || (stop < start))
+        return 1;
+
+      /* computing each value from the start avoids accumulating error */
+      for (k = 0; ; k++)
+      {
+        value = start + k * step;
+
+        if (value > stop + step * 0.001f)
+          break;
+
+        if (num_values >= SWEEP_MAX_VALUES)
+          return 1;
+
+        S_sweep_values[param][num_values++] = value;
+      }
+    }
+    /* single value */
+    else
+    {
+      if (parse_spec_float(item, &value))
+        return 1;
+
+      if (num_values >= SWEEP_MAX_VALUES)
+        return 1;
+
+      S_sweep_values[param][num_values++] = value;
+    }
+  }
+
+  if (num_values == 0)
+    return 1;
+
+  S_sweep_num_values[param] = num_values;
+
+  return 0;
+}
+
+/*******************************************************************************
+** load_sweep()
+*******************************************************************************/
+short int load_sweep(char* filename)
+{
+  FILE* fp_in;
+
+  char  line[SPEC_LINE_LENGTH];
+  int   line_number;
+
+  char* str;
+  char* key;
+  char* value;
+  char* separator;
+
+  palette_params defaults;
+
+  int   k;
+
+  /* defaults are the composite 16 parameters */
+  set_palette_params_for_source(&defaults, SOURCE_COMPOSITE_16);
+
+  for (k = 0; k < SWEEP_NUM_PARAMS; k++)
+  {
+    S_sweep_values[k] = malloc(sizeof(float) * SWEEP_MAX_VALUES);
+    S_sweep_num_values[k] = 1;
+
+    if (S_sweep_values[k] == NULL)
+    {
+      clear_sweep();
+      return 1;
+    }
+  }
+
+  S_sweep_values[SWEEP_PARAM_SIZE][0] = defaults.palette_size;
+  S_sweep_values[SWEEP_PARAM_HUES][0] = defaults.num_hues;
+  S_sweep_values[SWEEP_PARAM_SHADES][0] = defaults.num_shades;
+  S_sweep_values[SWEEP_PARAM_ROTATIONS][0] = defaults.num_rotations;
+  S_sweep_values[SWEEP_PARAM_TINTS][0] = defaults.num_tints;
+  S_sweep_values[SWEEP_PARAM_PHI][0] = 0.0f;
+  S_sweep_values[SWEEP_PARAM_TABLE_STEP][0] = 0.0f;
+  S_sweep_values[SWEEP_PARAM_TINT_START_HUE][0] = defaults.tint_start_hue;
+  S_sweep_values[SWEEP_PARAM_FIXED_HUES_LEFT][0] = defaults.fixed_hues_left;
+  S_sweep_values[SWEEP_PARAM_FIXED_HUES_RIGHT][0] = defaults.fixed_hues_right;
+
+  S_sweep_top = 0;
+  S_sweep_score = SWEEP_SCORE_DISTANCE;
+  strcpy(S_sweep_top_prefix, "sweep_");
+
+  /* open file */
+  fp_in = fopen(filename, "r");
+
+  if (fp_in == NULL)
+  {
+    fprintf(stderr, "Unable to open sweep file %s.\n", filename);
+    clear_sweep();
+    return 1;
+  }
+
+  /* read lines */
+  line_number = 0;
+
+  while (fgets(line, SPEC_LINE_LENGTH, fp_in) != NULL)
+  {
+    line_number += 1;
+
+    if ((str = strchr(line, '#')) != NULL)
+      *str = '\0';
+
+    str = trim_spec_string(line);
+
+    if (str[0] == '\0')
+      continue;
+
+    separator = strchr(str, '=');
+
+    if (separator == NULL)
+    {
+      fprintf(stderr, "Sweep file %s, line %d: Expected key = values.\n", filename, line_number);
+      goto fail;
+    }
+
+    *separator = '\0';
+
+    key = trim_spec_string(str);
+    value = trim_spec_string(separator + 1);
+
+    if (!strcmp(key, "top"))
+    {
+      if (parse_spec_int(value, &S_sweep_top))
+        goto invalid;
+
+      continue;
+    }
+    else if (!strcmp(key, "top_prefix"))
+    {
+      if ((value[0] == '\0') || (strlen(value) >= SWEEP_PREFIX_LENGTH))
+        goto invalid;
+
+      strcpy(S_sweep_top_prefix, value);
+      continue;
+    }
+    else if (!strcmp(key, "score"))
+    {
+      if (!strcmp(value, "distance"))
+        S_sweep_score = SWEEP_SCORE_DISTANCE;
+      else if (!strcmp(value, "delta_e"))
+        S_sweep_score = SWEEP_SCORE_DELTA_E;
+      else if (!strcmp(value, "clip"))
+        S_sweep_score = SWEEP_SCORE_CLIPPING;
+      else
+        goto invalid;
+
+      continue;
+    }
+
+    for (k = 0; k < SWEEP_NUM_PARAMS; k++)
+    {
+      if (!strcmp(key, S_sweep_param_names[k]))
+        break;
+    }
+
+    if ((k == SWEEP_NUM_PARAMS) || add_sweep_values(k, value))
+      goto invalid;
+  }
+
+  fclose(fp_in);
+
+  /* count combinations */
+  S_sweep_num_combinations = 1;
+  S_sweep_max_size = 0;
+
+  for (k = 0; k < SWEEP_NUM_PARAMS; k++)
+  {
+    if (S_sweep_num_combinations * S_sweep_num_values[k] > SWEEP_MAX_COMBINATIONS)
+    {
+      fprintf(stderr, "Sweep file %s: Too many combinations (the limit is %d).\n",
+              filename, SWEEP_MAX_COMBINATIONS);
+      clear_sweep();
+      return 1;
+    }
+
+    S_sweep_num_combinations *= S_sweep_num_values[k];
+  }
+
+  for (k = 0; k < S_sweep_num_values[SWEEP_PARAM_SIZE]; k++)
+  {
+    if ((S_sweep_values[SWEEP_PARAM_SIZE][k] < 1) ||
+        (S_sweep_values[SWEEP_PARAM_SIZE][k] > PALETTE_MAX_SIZE))
+    {
+      fprintf(stderr, "Sweep file %s: Invalid size.\n", filename);
+      clear_sweep();
+      return 1;
+    }
+
+    if (S_sweep_values[SWEEP_PARAM_SIZE][k] > S_sweep_max_size)
+      S_sweep_max_size = (int) S_sweep_values[SWEEP_PARAM_SIZE][k];
+  }
+
+  return 0;
+
+invalid:
+  fprintf(stderr, "Sweep file %s, line %d: Invalid value for %s.\n", filename, line_number, key);
+
+fail:
+  fclose(fp_in);
+  clear_sweep();
+
+  return 1;
+}
+
+/*******************************************************************************
+** get_sweep_values()
+*******************************************************************************/
+short int get_sweep_values(long index, float* values)
+{
+  int k;
+
+  /* the combination index is a mixed radix number */
+  for (k = 0; k < SWEEP_NUM_PARAMS; k++)
+  {
+    values[k] = S_sweep_values[k][index % S_sweep_num_values[k]];
+    index /= S_sweep_num_values[k];
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** set_sweep_params()
+*******************************************************************************/
+short int set_sweep_params(palette_params* pp, float* values,
+                           float* luma_table, float* saturation_table)
+{
+  float table_step;
+
+  pp->palette_size = (int) (values[SWEEP_PARAM_SIZE] + 0.5f);
+  pp->num_levels = 0;
+  pp->num_variants = 0;
+  pp->num_hues = (int) (values[SWEEP_PARAM_HUES] + 0.5f);
+  pp->num_shades = (int) (values[SWEEP_PARAM_SHADES] + 0.5f);
+  pp->num_rotations = (int) (values[SWEEP_PARAM_ROTATIONS] + 0.5f);
+  pp->num_tints = (int) (values[SWEEP_PARAM_TINTS] + 0.5f);
+  pp->phi = (values[SWEEP_PARAM_PHI] * PI) / 180.0f;
+  pp->tint_start_hue = (int) (values[SWEEP_PARAM_TINT_START_HUE] + 0.5f);
+  pp->fixed_hues_left = (int) (values[SWEEP_PARAM_FIXED_HUES_LEFT] + 0.5f);
+  pp->fixed_hues_right = (int) (values[SWEEP_PARAM_FIXED_HUES_RIGHT] + 0.5f);
+
+  pp->luma_table = luma_table;
+  pp->saturation_table = saturation_table;
+
+  pp->channel_order = PALETTE_CHANNEL_ORDER_RGB;
+  pp->base_row = NULL;
+  pp->row_stride = 0;
+
+  if (derive_palette_params(pp))
+    return 1;
+
+  if (pp->num_shades > SPEC_MAX_VOLTAGE_SHADES)
+    return 1;
+
+  /* voltage table */
+  table_step = values[SWEEP_PARAM_TABLE_STEP];
+
+  if (table_step == 0.0f)
+    table_step = 1.0f / (pp->num_shades + 2);
+
+  if ((table_step < 0.0f) || (table_step * (pp->num_shades / 2) >= 0.5f))
+    return 1;
+
+  return generate_uniform_voltage_table(luma_table, saturation_table,
+                                        pp->num_shades, table_step);
+}
+
+/*******************************************************************************
+** generate_sweep_palette()
+*******************************************************************************/
+short int generate_sweep_palette(long index, unsigned char* data, palette_params* pp,
+                                 float* luma_table, float* saturation_table)
+{
+  float values[SWEEP_NUM_PARAMS];
+
+  get_sweep_values(index, values);
+
+  if (set_sweep_params(pp, values, luma_table, saturation_table))
+    return 1;
+
+  return generate_palette_composite_data(pp, data);
+}
+
+/*******************************************************************************
+** sweep_task()
+*******************************************************************************/
+void sweep_task(int worker, long index, void* arg)
+{
+  palette_params    params;
+  palette_analysis  analysis;
+
+  float luma_table[SPEC_MAX_VOLTAGE_SHADES];
+  float saturation_table[SPEC_MAX_VOLTAGE_SHADES];
+
+  unsigned char*  data;
+  unsigned char*  row;
+
+  sweep_result*   result;
+
+  long  num_bytes;
+  long  k;
+
+  int   num_colors;
+  int   m;
+  int   n;
+
+  long  dr;
+  long  dg;
+  long  db;
+  long  distance;
+
+  unsigned long hash;
+
+  (void) arg;
+
+  result = &S_sweep_results[index];
+  result->valid = 0;
+
+  /* each worker reuses one buffer, large enough for any combination */
+  if (S_sweep_buffers[worker] == NULL)
+    S_sweep_buffers[worker] = allocate_aligned_buffer(3 * (long) S_sweep_max_size * S_sweep_max_size);
+
+  data = S_sweep_buffers[worker];
+
+  if (data == NULL)
+    return;
+
+  /* and one set of analysis rows */
+  if (S_sweep_analysis_rows[worker] == NULL)
+    S_sweep_analysis_rows[worker] = malloc(sizeof(analysis_row) * ANALYSIS_NUM_ROWS);
+
+  if (S_sweep_analysis_rows[worker] == NULL)
+    return;
+
+  if (generate_sweep_palette(index, data, &params, luma_table, saturation_table))
+    return;
+
+  /* hash of the full texture (fnv-1a) */
+  num_bytes = 3L * params.palette_size * params.palette_size;
+  hash = 2166136261UL;
+
+  for (k = 0; k < num_bytes; k++)
+    hash = ((hash ^ data[k]) * 16777619UL) & 0xFFFFFFFFUL;
+
+  /* base row metrics */
+  row = &data[3 * params.base_level * params.palette_size];
+  num_colors = (params.num_hues + 1) * params.num_shades;
+
+  result->min_distance = 3 * 255 * 255;
+  result->num_distinct = 0;
+
+  for (m = 0; m < num_colors; m++)
+  {
+    for (n = 0; n < m; n++)
+    {
+      dr = (long) row[3 * m + 0] - row[3 * n + 0];
+      dg = (long) row[3 * m + 1] - row[3 * n + 1];
+      db = (long) row[3 * m + 2] - row[3 * n + 2];
+
+      distance = dr * dr + dg * dg + db * db;
+
+      if (distance < result->min_distance)
+        result->min_distance = distance;
+
+      if (distance == 0)
+        break;
+    }
+
+    /* count this color if it did not appear earlier */
+    if (n == m)
+      result->num_distinct += 1;
+  }
+
+  /* clipping & perceptual spacing */
+  if (analyze_palette_rows(&params, &analysis, S_sweep_analysis_rows[worker]))
+    return;
+
+  result->clip_count = analysis.clip_count;
+  result->clip_magnitude = analysis.clip_magnitude;
+
+  result->min_shade_delta_e = analysis.min_shade_delta_e;
+  result->min_hue_delta_e = analysis.min_hue_delta_e;
+
+  result->hash = hash;
+  result->valid = 1;
+}
+
+/*******************************************************************************
+** compare_sweep_results()
+*******************************************************************************/
+int compare_sweep_results(const void* a, const void* b)
+{
+  long index_a;
+  long index_b;
+
+  sweep_result* result_a;
+  sweep_result* result_b;
+
+  float delta_e_a;
+  float delta_e_b;
+
+  index_a = *((const long*) a);
+  index_b = *((const long*) b);
+
+  result_a = &S_sweep_results[index_a];
+  result_b = &S_sweep_results[index_b];
+
+  /* larger minimum delta e first (or less clipping) */
+  if (S_sweep_score == SWEEP_SCORE_DELTA_E)
+  {
+    delta_e_a = result_a->min_shade_delta_e;
+    delta_e_b = result_b->min_shade_delta_e;
+
+    if (result_a->min_hue_delta_e < delta_e_a)
+      delta_e_a = result_a->min_hue_delta_e;
+
+    if (result_b->min_hue_delta_e < delta_e_b)
+      delta_e_b = result_b->min_hue_delta_e;
+
+    if (delta_e_a != delta_e_b)
+      return (delta_e_a > delta_e_b) ? -1 : 1;
+  }
+  else if (S_sweep_score == SWEEP_SCORE_CLIPPING)
+  {
+    if (result_a->clip_magnitude != result_b->clip_magnitude)
+      return (result_a->clip_magnitude < result_b->clip_magnitude) ? -1 : 1;
+  }
+
+  /* larger minimum distance first, then more distinct colors */
+  if (result_a->min_distance != result_b->min_distance)
+    return (result_a->min_distance > result_b->min_distance) ? -1 : 1;
+
+  if (result_a->num_distinct != result_b->num_distinct)
+    return (result_a->num_distinct > result_b->num_distinct) ? -1 : 1;
+
+  return (index_a < index_b) ? -1 : 1;
+}
+
+/*******************************************************************************
+** write_sweep_top()
+*******************************************************************************/
+short int write_sweep_top(int num_valid)
+{
+  long*   order;
+  long    k;
+  int     n;
+
+  palette_params  params;
+
+  float luma_table[SPEC_MAX_VOLTAGE_SHADES];
+  float saturation_table[SPEC_MAX_VOLTAGE_SHADES];
+
+  char  filename[SWEEP_PREFIX_LENGTH + 32];
+
+  FILE* fp_out;
+
+  short int status;
+
+  if ((S_sweep_top <= 0) || (num_valid == 0))
+    return 0;
+
+  order = malloc(sizeof(long) * num_valid);
+
+  if ((order == NULL) || (S_sweep_buffers[0] == NULL))
+  {
+    if (order != NULL)
+      free(order);
+
+    return 1;
+  }
+
+  n = 0;
+
+  for (k = 0; k < S_sweep_num_combinations; k++)
+  {
+    if (S_sweep_results[k].valid)
+      order[n++] = k;
+  }
+
+  qsort(order, num_valid, sizeof(long), compare_sweep_results);
+
+  /* regenerate & write the best combinations */
+  status = 0;
+
+  for (n = 0; (n < S_sweep_top) && (n < num_valid); n++)
+  {
+    generate_sweep_palette(order[n], S_sweep_buffers[0], &params, luma_table, saturation_table);
+
+    sprintf(filename, "%s%ld.tga", S_sweep_top_prefix, order[n]);
+
+    fp_out = open_output_stream(filename, -1);
+
+    if (fp_out == NULL)
+    {
+      status = 1;
+      continue;
+    }
+
+    if (write_tga_image(fp_out, S_sweep_buffers[0], params.palette_size, params.palette_size, 3))
+      status = 1;
+
+    if (close_output_stream(fp_out))
+      status = 1;
+  }
+
+  free(order);
+
+  return status;
+}
+
+/*******************************************************************************
+** run_sweep()
+*******************************************************************************/
+short int run_sweep(FILE* fp_out, int num_threads)
+{
+  float   values[SWEEP_NUM_PARAMS];
+
+  long    k;
+  int     n;
+
+  int     num_valid;
+
+  struct timespec start;
+  struct timespec end;
+
+  short int status;
+
+  if (fp_out == NULL)
+    return 1;
+
+  S_sweep_results = malloc(sizeof(sweep_result) * S_sweep_num_combinations);
+
+  if (S_sweep_results == NULL)
+  {
+    fprintf(stderr, "Unable to allocate sweep results.\n");
+    return 1;
+  }
+
+  for (n = 0; n < POOL_MAX_THREADS; n++)
+  {
+    S_sweep_buffers[n] = NULL;
+    S_sweep_analysis_rows[n] = NULL;
+  }
+
+  /* generate every combination (no i/o happens here) */
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  run_pool_tasks(num_threads, S_sweep_num_combinations, sweep_task, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  for (n = 0; n < POOL_MAX_THREADS; n++)
+  {
+    if (S_sweep_analysis_rows[n] != NULL)
+    {
+      free(S_sweep_analysis_rows[n]);
+      S_sweep_analysis_rows[n] = NULL;
+    }
+  }
+
+  /* write summary */
+  fprintf(fp_out, "index,size,hues,shades,rotations,tints,phi,table_step,");
+  fprintf(fp_out, "tint_start_hue,fixed_hues_left,fixed_hues_right,");
+  fprintf(fp_out, "distinct_colors,min_distance,clipped,clip_total,");
+  fprintf(fp_out, "min_shade_delta_e,min_hue_delta_e,hash\n");
+
+  num_valid = 0;
+
+  for (k = 0; k < S_sweep_num_combinations; k++)
+  {
+    if (!S_sweep_results[k].valid)
+      continue;
+
+    num_valid += 1;
+
+    get_sweep_values(k, values);
+
+    fprintf(fp_out, "%ld,%d,%d,%d,%d,%d,%g,%g,%d,%d,%d,%d,%ld,%d,%.2f,%.2f,%.2f,%08lx\n",
+            k,
+            (int) (values[SWEEP_PARAM_SIZE] + 0.5f),
+            (int) (values[SWEEP_PARAM_HUES] + 0.5f),
+            (int) (values[SWEEP_PARAM_SHADES] + 0.5f),
+            (int) (values[SWEEP_PARAM_ROTATIONS] + 0.5f),
+            (int) (values[SWEEP_PARAM_TINTS] + 0.5f),
+            values[SWEEP_PARAM_PHI],
+            values[SWEEP_PARAM_TABLE_STEP],
+            (int) (values[SWEEP_PARAM_TINT_START_HUE] + 0.5f),
+            (int) (values[SWEEP_PARAM_FIXED_HUES_LEFT] + 0.5f),
+            (int) (values[SWEEP_PARAM_FIXED_HUES_RIGHT] + 0.5f),
+            S_sweep_results[k].num_distinct,
+            S_sweep_results[k].min_distance,
+            S_sweep_results[k].clip_count,
+            S_sweep_results[k].clip_magnitude,
+            S_sweep_results[k].min_shade_delta_e,
+            S_sweep_results[k].min_hue_delta_e,
+            S_sweep_results[k].hash);
+  }
+
+  fprintf(stderr, "Sweep: %ld combinations, %d valid, %.3f s.\n",
+          S_sweep_num_combinations, num_valid,
+          (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0);
+
+  /* write the top outputs */
+  if (S_sweep_buffers[0] == NULL)
+    S_sweep_buffers[0] = allocate_aligned_buffer(3 * (long) S_sweep_max_size * S_sweep_max_size);
+
+  status = write_sweep_top(num_valid);
+
+  if (status)
+    fprintf(stderr, "Error writing sweep outputs.\n");
+
+  if (ferror(fp_out))
+    status = 1;
+
+  return status;
+}
+
+/*******************************************************************************
+** clear_sweep()
+*******************************************************************************/
+short int clear_sweep()
+{
+  int k;
+
+  for (k = 0; k < SWEEP_NUM_PARAMS; k++)
+  {
+    if (S_sweep_values[k] != NULL)
+    {
+      free(S_sweep_values[k]);
+      S_sweep_values[k] = NULL;
+    }
+  }
+
+  for (k = 0; k < POOL_MAX_THREADS; k++)
+  {
+    if (S_sweep_buffers[k] != NULL)
+    {
+      free(S_sweep_buffers[k]);
+      S_sweep_buffers[k] = NULL;
+    }
+  }
+
+  if (S_sweep_results != NULL)
+  {
+    free(S_sweep_results);
+    S_sweep_results = NULL;
+  }
+
+  return 0;
+}
@@ -0,0 +1,58 @@
+/*******************************************************************************
+** sweep.h (parameter sweeps)
+*******************************************************************************/
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+
+enum
+{
+  SWEEP_PARAM_SIZE = 0,
+  SWEEP_PARAM_HUES,
+  SWEEP_PARAM_SHADES,
+  SWEEP_PARAM_ROTATIONS,
+  SWEEP_PARAM_TINTS,
+  SWEEP_PARAM_PHI,
+  SWEEP_PARAM_TABLE_STEP,
+  SWEEP_PARAM_TINT_START_HUE,
+  SWEEP_PARAM_FIXED_HUES_LEFT,
+  SWEEP_PARAM_FIXED_HUES_RIGHT,
+  SWEEP_NUM_PARAMS
+};
+
+#define SWEEP_MAX_VALUES        4096
+#define SWEEP_MAX_COMBINATIONS  4194304
+#define SWEEP_PREFIX_LENGTH     192
+
+/* scores used to pick the top combinations */
+enum
+{
+  SWEEP_SCORE_DISTANCE = 0,
+  SWEEP_SCORE_DELTA_E,
+  SWEEP_SCORE_CLIPPING
+};
+
+typedef struct sweep_result
+{
+  unsigned long hash;
+
+  long  min_distance;
+  int   num_distinct;
+
+  int   clip_count;
+  float clip_magnitude;
+
+  float min_shade_delta_e;
+  float min_hue_delta_e;
+
+  short int valid;
+} sweep_result;
+
+/* function declarations */
+short int load_sweep(char* filename);
+short int run_sweep(FILE* fp_out, int num_threads);
+short int clear_sweep();
+
+#endif
@@ -0,0 +1,476 @@
+/*******************************************************************************
+** tga.c (tga file output)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "palette.h"
+#include "tga.h"
+
+/*******************************************************************************
+** open_output_stream()
+*******************************************************************************/
+FILE* open_output_stream(char* filename, int fd)
+{
+  FILE* fp_out;
+
+  /* inherited file descriptor */
+  if (fd >= 0)
+    fp_out = fdopen(fd, "wb");
+  /* standard output */
+  else if ((filename != NULL) && (!strcmp(filename, "-")))
+    fp_out = stdout;
+  /* regular file */
+  else if (filename != NULL)
+    fp_out = fopen(filename, "wb");
+  else
+    fp_out = NULL;
+
+  if (fp_out == NULL)
+    return NULL;
+
+  /* use a buffer matching the pipe capacity, so that each */
+  /* write to a pipe can be consumed by the reader at once */
+  if (setvbuf(fp_out, NULL, _IOFBF, OUTPUT_STREAM_BUFFER_SIZE))
+  {
+    if (fp_out != stdout)
+      fclose(fp_out);
+
+    return NULL;
+  }
+
+  return fp_out;
+}
+
+/*******************************************************************************
+** close_output_stream()
+*******************************************************************************/
+short int close_output_stream(FILE* fp_out)
+{
+  if (fp_out == NULL)
+    return 1;
+
+  /* standard output is flushed but left open */
+  if (fp_out == stdout)
+  {
+    if (fflush(fp_out))
+      return 1;
+  }
+  else if (fclose(fp_out))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** fill_tga_header_image()
+*******************************************************************************/
+short int fill_tga_header_image(unsigned char* header, int width, int height)
+{
+  if (header == NULL)
+    return 1;
+
+  if ((width <= 0) || (width > 65535) || (height <= 0) || (height > 65535))
+  {
+    fprintf(stderr, "Write TGA file failed: Invalid image size.\n");
+    return 1;
+  }
+
+  /* image id field length, colormap type, image type */
+  header[0] = 0;
+  header[1] = 0;
+  header[2] = 2;
+
+  /* colormap specification */
+  header[3] = 0;
+  header[4] = 0;
+  header[5] = 0;
+  header[6] = 0;
+  header[7] = 0;
+
+  /* x origin, y origin (little endian) */
+  header[8] = 0;
+  header[9] = 0;
+  header[10] = 0;
+  header[11] = 0;
+
+  /* image width, image height (little endian) */
+  header[12] = width & 0xFF;
+  header[13] = (width >> 8) & 0xFF;
+  header[14] = height & 0xFF;
+  header[15] = (height >> 8) & 0xFF;
+
+  /* pixel bpp, image descriptor (top-left origin) */
+  header[16] = 24;
+  header[17] = 0x20;
+
+  return 0;
+}
+
+/*******************************************************************************
+** fill_tga_header()
+*******************************************************************************/
+short int fill_tga_header(unsigned char* header)
+{
+  return fill_tga_header_image(header, G_palette_size, G_palette_size);
+}
+
+/*******************************************************************************
+** write_tga_header()
+*******************************************************************************/
+short int write_tga_header(FILE* fp_out)
+{
+  unsigned char header[TGA_HEADER_SIZE];
+
+  /* make sure output stream is valid */
+  if (fp_out == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: No output stream specified.\n");
+    return 1;
+  }
+
+  if (fill_tga_header(header))
+    return 1;
+
+  if (fwrite(header, 1, TGA_HEADER_SIZE, fp_out) < TGA_HEADER_SIZE)
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_tga_rows_image()
+*******************************************************************************/
+short int convert_tga_rows_image( unsigned char* buffer, unsigned char* data,
+                                  int width, int bytes_per_pixel,
+                                  int start_row, int num_rows)
+{
+  int   m;
+  int   n;
+
+  int   index;
+
+  if ((buffer == NULL) || (data == NULL))
+    return 1;
+
+  if ((start_row < 0) || (num_rows < 0))
+    return 1;
+
+  /* convert palette data to bgr, one row at a time */
+  for (n = 0; n < num_rows; n++)
+  {
+    if (bytes_per_pixel == 4)
+    {
+      for (m = 0; m < width; m++)
+      {
+        index = ((start_row + n) * width) + m;
+
+        /* if this is a transparency color, just write out magenta */
+        if (data[4 * index + 3] == 0)
+        {
+          buffer[3 * (n * width + m) + 2] = 255;
+          buffer[3 * (n * width + m) + 1] = 0;
+          buffer[3 * (n * width + m) + 0] = 255;
+        }
+        /* otherwise, write out this color */
+        else
+        {
+          buffer[3 * (n * width + m) + 2] = data[4 * index + 0];
+          buffer[3 * (n * width + m) + 1] = data[4 * index + 1];
+          buffer[3 * (n * width + m) + 0] = data[4 * index + 2];
+        }
+      }
+    }
+    else
+    {
+      for (m = 0; m < width; m++)
+      {
+        index = ((start_row + n) * width) + m;
+
+        buffer[3 * (n * width + m) + 2] = data[3 * index + 0];
+        buffer[3 * (n * width + m) + 1] = data[3 * index + 1];
+        buffer[3 * (n * width + m) + 0] = data[3 * index + 2];
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_tga_rows()
+*******************************************************************************/
+short int convert_tga_rows(unsigned char* buffer, int start_row, int num_rows)
+{
+  if (start_row + num_rows > G_palette_size)
+    return 1;
+
+  return convert_tga_rows_image(buffer, G_palette_data,
+                                G_palette_size, get_palette_bytes_per_pixel(),
+                                start_row, num_rows);
+}
+
+/*******************************************************************************
+** write_tga_image()
+*******************************************************************************/
+short int write_tga_image(FILE* fp_out, unsigned char* data,
+                          int width, int height, int bytes_per_pixel)
+{
+  int   n;
+
+  unsigned char header[TGA_HEADER_SIZE];
+
+  unsigned char* output_buffer;
+
+  /* make sure output stream is valid */
+  if (fp_out == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: No output stream specified.\n");
+    return 1;
+  }
+
+  /* write header */
+  if (fill_tga_header_image(header, width, height))
+    return 1;
+
+  if (fwrite(header, 1, TGA_HEADER_SIZE, fp_out) < TGA_HEADER_SIZE)
+    return 1;
+
+  /* allocate row buffer */
+  output_buffer = malloc(sizeof(unsigned char) * 3 * width);
+
+  if (output_buffer == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: Unable to allocate row buffer.\n");
+    return 1;
+  }
+
+  /* write image data, one row at a time */
+  for (n = 0; n < height; n++)
+  {
+    convert_tga_rows_image(output_buffer, data, width, bytes_per_pixel, n, 1);
+
+    if (fwrite(output_buffer, 3, width, fp_out) < (size_t) width)
+    {
+      free(output_buffer);
+      return 1;
+    }
+  }
+
+  free(output_buffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_tga_file()
+*******************************************************************************/
+short int write_tga_file(FILE* fp_out)
+{
+  return write_tga_image( fp_out, G_palette_data,
+                          G_palette_size, G_palette_size,
+                          get_palette_bytes_per_pixel());
+}
+
+/*******************************************************************************
+** write_tga_image_indexed()
+*******************************************************************************/
+short int write_tga_image_indexed(FILE* fp_out, unsigned short* indices,
+                                  int width, int height,
+                                  unsigned char* color_map, int num_colors)
+{
+  int   n;
+  int   m;
+
+  unsigned char header[TGA_HEADER_SIZE];
+
+  unsigned char* output_buffer;
+
+  int   index_bytes;
+
+  /* make sure output stream is valid */
+  if (fp_out == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: No output stream specified.\n");
+    return 1;
+  }
+
+  if ((num_colors <= 0) || (num_colors > TGA_INDEXED_MAX_COLORS))
+  {
+    fprintf(stderr, "Write TGA file failed: Invalid number of colors.\n");
+    return 1;
+  }
+
+  if (fill_tga_header_image(header, width, height))
+    return 1;
+
+  /* use 8 bit indices if possible */
+  if (num_colors <= 256)
+    index_bytes = 1;
+  else
+    index_bytes = 2;
+
+  /* colormap type, image type (uncompressed color-mapped) */
+  header[1] = 1;
+  header[2] = 1;
+
+  /* colormap specification: first entry, length, entry size */
+  header[3] = 0;
+  header[4] = 0;
+  header[5] = num_colors & 0xFF;
+  header[6] = (num_colors >> 8) & 0xFF;
+  header[7] = 24;
+
+  /* pixel bpp */
+  header[16] = 8 * index_bytes;
+
+  /* write header & color map */
+  if (fwrite(header, 1, TGA_HEADER_SIZE, fp_out) < TGA_HEADER_SIZE)
+    return 1;
+
+  if (fwrite(color_map, 3, num_colors, fp_out) < (size_t) num_colors)
+    return 1;
+
+  /* allocate row buffer */
+  output_buffer = malloc(sizeof(unsigned char) * 2 * width);
+
+  if (output_buffer == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: Unable to allocate row buffer.\n");
+    return 1;
+  }
+
+  /* write indices, one row at a time */
+  for (n = 0; n < height; n++)
+  {
+    for (m = 0; m < width; m++)
+    {
+      if (index_bytes == 1)
+        output_buffer[m] = indices[(long) n * width + m] & 0xFF;
+      else
+      {
+        output_buffer[2 * m + 0] = indices[(long) n * width + m] & 0xFF;
+        output_buffer[2 * m + 1] = (indices[(long) n * width + m] >> 8) & 0xFF;
+      }
+    }
+
+    if (fwrite(output_buffer, index_bytes, width, fp_out) < (size_t) width)
+    {
+      free(output_buffer);
+      return 1;
+    }
+  }
+
+  free(output_buffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_tga_file_indexed()
+*******************************************************************************/
+short int write_tga_file_indexed(FILE* fp_out)
+{
+  int   m;
+  int   n;
+
+  unsigned long color;
+  unsigned long hash;
+
+  unsigned long*  hash_colors;
+  unsigned short* hash_indices;
+
+  unsigned char*  color_map;
+  int             num_colors;
+
+  unsigned short* indices;
+
+  unsigned char*  row_buffer;
+
+  short int status;
+
+  /* make sure output stream is valid */
+  if (fp_out == NULL)
+  {
+    fprintf(stderr, "Write TGA file failed: No output stream specified.\n");
+    return 1;
+  }
+
+  /* allocate buffers */
+  hash_colors = malloc(sizeof(unsigned long) * TGA_INDEXED_HASH_SIZE);
+  hash_indices = malloc(sizeof(unsigned short) * TGA_INDEXED_HASH_SIZE);
+  color_map = malloc(sizeof(unsigned char) * 3 * TGA_INDEXED_MAX_COLORS);
+  indices = malloc(sizeof(unsigned short) * G_palette_size * G_palette_size);
+  row_buffer = malloc(sizeof(unsigned char) * 3 * G_palette_size);
+
+  status = 0;
+
+  if ((hash_colors == NULL) || (hash_indices == NULL) || (color_map == NULL) ||
+      (indices == NULL) || (row_buffer == NULL))
+  {
+    fprintf(stderr, "Write TGA file failed: Unable to allocate index buffers.\n");
+    status = 1;
+    goto cleanup;
+  }
+
+  /* empty slots are marked with a value that is not a 24 bit color */
+  for (m = 0; m < TGA_INDEXED_HASH_SIZE; m++)
+    hash_colors[m] = 0xFFFFFFFFUL;
+
+  /* build the color map (colors are stored in bgr order) */
+  num_colors = 0;
+
+  for (n = 0; n < G_palette_size; n++)
+  {
+    convert_tga_rows(row_buffer, n, 1);
+
+    for (m = 0; m < G_palette_size; m++)
+    {
+      color = ((unsigned long) row_buffer[3 * m + 0] << 16) |
+              ((unsigned long) row_buffer[3 * m + 1] << 8) |
+              ((unsigned long) row_buffer[3 * m + 2]);
+
+      hash = ((color * 2654435761UL) >> 8) & (TGA_INDEXED_HASH_SIZE - 1);
+
+      while ((hash_colors[hash] != 0xFFFFFFFFUL) && (hash_colors[hash] != color))
+        hash = (hash + 1) & (TGA_INDEXED_HASH_SIZE - 1);
+
+      if (hash_colors[hash] == 0xFFFFFFFFUL)
+      {
+        if (num_colors >= TGA_INDEXED_MAX_COLORS)
+        {
+          fprintf(stderr, "Write TGA file failed: Too many colors for an indexed image.\n");
+          status = 1;
+          goto cleanup;
+        }
+
+        hash_colors[hash] = color;
+        hash_indices[hash] = num_colors;
+
+        memcpy(&color_map[3 * num_colors], &row_buffer[3 * m], 3);
+        num_colors += 1;
+      }
+
+      indices[n * G_palette_size + m] = hash_indices[hash];
+    }
+  }
+
+  status = write_tga_image_indexed(fp_out, indices, G_palette_size, G_palette_size,
+                                   color_map, num_colors);
+
+cleanup:
+  if (hash_colors != NULL)
+    free(hash_colors);
+  if (hash_indices != NULL)
+    free(hash_indices);
+  if (color_map != NULL)
+    free(color_map);
+  if (indices != NULL)
+    free(indices);
+  if (row_buffer != NULL)
+    free(row_buffer);
+
+  return status;
+}
@@ -0,0 +1,43 @@
+/*******************************************************************************
+** tga.h (tga file output)
+*******************************************************************************/
+
+#ifndef TGA_H
+#define TGA_H
+
+#include <stdio.h>
+
+/* the output stream buffer matches the default */
+/* pipe capacity on linux (16 pages of 4096)    */
+#define OUTPUT_STREAM_BUFFER_SIZE 65536
+
+/* the header is 18 bytes (no image id field and no colormap) */
+#define TGA_HEADER_SIZE 18
+
+/* indexed images use 8 bit indices when there are at most 256 */
+/* colors, and 16 bit indices otherwise (up to 65535 colors)    */
+#define TGA_INDEXED_MAX_COLORS  65535
+#define TGA_INDEXED_HASH_SIZE   131072
+
+/* function declarations */
+FILE*     open_output_stream(char* filename, int fd);
+short int close_output_stream(FILE* fp_out);
+
+short int fill_tga_header_image(unsigned char* header, int width, int height);
+short int fill_tga_header(unsigned char* header);
+short int write_tga_header(FILE* fp_out);
+
+short int convert_tga_rows_image( unsigned char* buffer, unsigned char* data,
+                                  int width, int bytes_per_pixel,
+                                  int start_row, int num_rows);
+short int convert_tga_rows(unsigned char* buffer, int start_row, int num_rows);
+
+short int write_tga_image(FILE* fp_out, unsigned char* data,
+                          int width, int height, int bytes_per_pixel);
+short int write_tga_image_indexed(FILE* fp_out, unsigned short* indices,
+                                  int width, int height,
+                                  unsigned char* color_map, int num_colors);
+short int write_tga_file(FILE* fp_out);
+short int write_tga_file_indexed(FILE* fp_out);
+
+#endif
@@ -0,0 +1,806 @@
+/*******************************************************************************
+** trim.c (usage-driven texture trimming)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "encode.h"
+#include "palette.h"
+#include "pool.h"
+#include "reader.h"
+#include "tga.h"
+#include "trim.h"
+
+/* the assets are listed in a text file, one per line:               */
+/*                                                                    */
+/*   # comment                                                        */
+/*   sprite_indices.tga sprite_tiles.csv   (index image & tile map)   */
+/*   font_indices.tga 3 4                  (index image, palette 3 at */
+/*                                          level 4)                  */
+/*                                                                    */
+/* each asset is read by one of the worker threads, which counts the  */
+/* texels that use each (row, column) of the texture in its own       */
+/* histogram. the histograms are then added up (one row of the        */
+/* texture per task). the trimmed texture only keeps the rows and the */
+/* columns that are used (in their original order), so an index is   */
+/* remapped with the column table, and a palette & level with the row */
+/* table (both are written as one csv file).                          */
+
+trim_asset*     S_trim_assets;
+int             S_trim_num_assets;
+int             S_trim_max_assets;
+
+int             S_trim_num_rows;
+int             S_trim_num_columns;
+int             S_trim_levels_per_palette;
+
+/* per-worker histograms, and their sum */
+unsigned int*   S_trim_histograms[POOL_MAX_THREADS];
+unsigned long*  S_trim_counts;
+
+/* old row / column to new (-1 if unused) */
+int*  S_trim_row_map;
+int*  S_trim_column_map;
+
+int   S_trim_num_used_rows;
+int   S_trim_num_used_columns;
+
+/*******************************************************************************
+** add_trim_asset()
+*******************************************************************************/
+short int add_trim_asset(char* index_filename, char* tile_map_filename,
+                         int palette, int level)
+{
+  trim_asset* assets;
+  trim_asset* asset;
+
+  if ((strlen(index_filename) >= TRIM_FILENAME_LENGTH) ||
+      ((tile_map_filename != NULL) && (strlen(tile_map_filename) >= TRIM_FILENAME_LENGTH)))
+  {
+    fprintf(stderr, "Asset filename %s is too long.\n", index_filename);
+    return 1;
+  }
+
+  /* grow the asset array as needed */
+  if (S_trim_num_assets >= S_trim_max_assets)
+  {
+    assets = realloc(S_trim_assets, sizeof(trim_asset) * 2 * (S_trim_max_assets + 8));
+
+    if (assets == NULL)
+    {
+      fprintf(stderr, "Unable to allocate assets.\n");
+      return 1;
+    }
+
+    S_trim_assets = assets;
+    S_trim_max_assets = 2 * (S_trim_max_assets + 8);
+  }
+
+  asset = &S_trim_assets[S_trim_num_assets];
+
+  strcpy(asset->index_filename, index_filename);
+
+  if (tile_map_filename != NULL)
+    strcpy(asset->tile_map_filename, tile_map_filename);
+  else
+    asset->tile_map_filename[0] = '\0';
+
+  asset->palette = palette;
+  asset->level = level;
+
+  asset->num_texels = 0;
+  asset->status = 0;
+
+  S_trim_num_assets += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** load_trim_assets()
+*******************************************************************************/
+short int load_trim_assets(char* filename)
+{
+  FILE* fp_in;
+
+  char  line[TRIM_LINE_LENGTH];
+  int   line_number;
+
+  char* tokens[4];
+  int   num_tokens;
+
+  char* str;
+  char* endptr;
+  long  palette;
+  long  level;
+
+  clear_trim();
+
+  fp_in = fopen(filename, "r");
+
+  if (fp_in == NULL)
+  {
+    fprintf(stderr, "Unable to open asset list %s.\n", filename);
+    return 1;
+  }
+
+  line_number = 0;
+
+  while (fgets(line, TRIM_LINE_LENGTH, fp_in) != NULL)
+  {
+    line_number += 1;
+
+    if ((strchr(line, '\n') == NULL) && (!feof(fp_in)))
+    {
+      fprintf(stderr, "Asset list %s, line %d: Line is too long.\n", filename, line_number);
+      goto fail;
+    }
+
+    /* remove comments */
+    if ((str = strchr(line, '#')) != NULL)
+      *str = '\0';
+
+    num_tokens = 0;
+
+    for (str = strtok(line, " \t\r\n"); str != NULL; str = strtok(NULL, " \t\r\n"))
+    {
+      if (num_tokens >= 4)
+        break;
+
+      tokens[num_tokens] = str;
+      num_tokens += 1;
+    }
+
+    if (num_tokens == 0)
+      continue;
+
+    /* index image & tile map */
+    if (num_tokens == 2)
+    {
+      if (add_trim_asset(tokens[0], tokens[1], -1, -1))
+        goto fail;
+    }
+    /* index image, palette & level */
+    else if (num_tokens == 3)
+    {
+      palette = strtol(tokens[1], &endptr, 10);
+
+      if ((endptr == tokens[1]) || (*endptr != '\0') || (palette < 0) || (palette > 65535))
+      {
+        fprintf(stderr, "Asset list %s, line %d: Invalid palette %s.\n", filename, line_number, tokens[1]);
+        goto fail;
+      }
+
+      level = strtol(tokens[2], &endptr, 10);
+
+      if ((endptr == tokens[2]) || (*endptr != '\0') || (level < 0) || (level > 65535))
+      {
+        fprintf(stderr, "Asset list %s, line %d: Invalid level %s.\n", filename, line_number, tokens[2]);
+        goto fail;
+      }
+
+      if (add_trim_asset(tokens[0], NULL, (int) palette, (int) level))
+        goto fail;
+    }
+    else
+    {
+      fprintf(stderr, "Asset list %s, line %d: Expected an index image, and a tile map ", filename, line_number);
+      fprintf(stderr, "or a palette & level.\n");
+      goto fail;
+    }
+  }
+
+  fclose(fp_in);
+
+  if (S_trim_num_assets == 0)
+  {
+    fprintf(stderr, "Asset list %s has no assets.\n", filename);
+    clear_trim();
+    return 1;
+  }
+
+  return 0;
+
+fail:
+  fclose(fp_in);
+  clear_trim();
+
+  return 1;
+}
+
+/*******************************************************************************
+** get_trim_row()
+*******************************************************************************/
+int get_trim_row(int palette, int level)
+{
+  /* the texture row of a palette & level (or -1 if out of range) */
+  if ((palette < 0) || (palette >= get_palette_num_bands()) ||
+      (level < 0) || (level >= S_trim_levels_per_palette))
+  {
+    return -1;
+  }
+
+  return palette * S_trim_levels_per_palette + level;
+}
+
+/*******************************************************************************
+** read_trim_tile_map()
+*******************************************************************************/
+short int read_trim_tile_map( trim_asset* asset, int width, int height,
+                              int** tile_rows, int* tile_size, int* tiles_across)
+{
+  FILE* fp_in;
+
+  char  line[256];
+
+  int*  entries;
+  int*  grid;
+  int   num_entries;
+  int   max_entries;
+
+  int   tile_x;
+  int   tile_y;
+  int   palette;
+  int   level;
+  int   row;
+  long  error;
+
+  int   across;
+  int   down;
+  int   size;
+
+  int   k;
+
+  *tile_rows = NULL;
+
+  fp_in = fopen(asset->tile_map_filename, "r");
+
+  if (fp_in == NULL)
+  {
+    fprintf(stderr, "Unable to open tile map %s.\n", asset->tile_map_filename);
+    return 1;
+  }
+
+  /* header (see write_encode_tile_map()) */
+  if ((fgets(line, sizeof(line), fp_in) == NULL) || (strncmp(line, "tile_x,", 7)))
+  {
+    fprintf(stderr, "Tile map %s has no header.\n", asset->tile_map_filename);
+    fclose(fp_in);
+    return 1;
+  }
+
+  /* tiles (x, y & texture row) */
+  entries = NULL;
+  num_entries = 0;
+  max_entries = 0;
+
+  across = 0;
+  down = 0;
+
+  while (fgets(line, sizeof(line), fp_in) != NULL)
+  {
+    if (sscanf(line, "%d,%d,%d,%d,%d,%ld", &tile_x, &tile_y, &palette, &level, &row, &error) != 6)
+      goto invalid;
+
+    row = get_trim_row(palette, level);
+
+    if ((tile_x < 0) || (tile_x > 65535) || (tile_y < 0) || (tile_y > 65535) || (row < 0))
+      goto invalid;
+
+    if (num_entries >= max_entries)
+    {
+      grid = realloc(entries, sizeof(int) * 3 * 2 * (max_entries + 64));
+
+      if (grid == NULL)
+        goto invalid;
+
+      entries = grid;
+      max_entries = 2 * (max_entries + 64);
+    }
+
+    entries[3 * num_entries + 0] = tile_x;
+    entries[3 * num_entries + 1] = tile_y;
+    entries[3 * num_entries + 2] = row;
+
+    num_entries += 1;
+
+    if (tile_x + 1 > across)
+      across = tile_x + 1;
+    if (tile_y + 1 > down)
+      down = tile_y + 1;
+  }
+
+  fclose(fp_in);
+  fp_in = NULL;
+
+  /* the tile size is the one that gives the same number of tiles */
+  for (size = ENCODE_MIN_TILE_SIZE; size <= ENCODE_MAX_TILE_SIZE; size *= 2)
+  {
+    if (((width + size - 1) / size == across) && ((height + size - 1) / size == down))
+      break;
+  }
+
+  if ((size > ENCODE_MAX_TILE_SIZE) || (num_entries != across * down))
+    goto invalid;
+
+  grid = malloc(sizeof(int) * num_entries);
+
+  if (grid == NULL)
+    goto invalid;
+
+  for (k = 0; k < num_entries; k++)
+    grid[k] = -1;
+
+  for (k = 0; k < num_entries; k++)
+  {
+    tile_x = entries[3 * k + 0];
+    tile_y = entries[3 * k + 1];
+
+    /* each tile must be listed once */
+    if (grid[tile_y * across + tile_x] >= 0)
+    {
+      free(grid);
+      goto invalid;
+    }
+
+    grid[tile_y * across + tile_x] = entries[3 * k + 2];
+  }
+
+  free(entries);
+
+  *tile_rows = grid;
+  *tile_size = size;
+  *tiles_across = across;
+
+  return 0;
+
+invalid:
+  fprintf(stderr, "Tile map %s does not match %s (or the %s texture).\n",
+          asset->tile_map_filename, asset->index_filename, get_palette_source_name());
+
+  if (fp_in != NULL)
+    fclose(fp_in);
+
+  if (entries != NULL)
+    free(entries);
+
+  return 1;
+}
+
+/*******************************************************************************
+** trim_asset_task()
+*******************************************************************************/
+void trim_asset_task(int worker, long index, void* arg)
+{
+  trim_asset*     asset;
+  tga_image       image;
+
+  unsigned int*   histogram;
+  unsigned int*   counts;
+  unsigned short* indices;
+
+  int*  tile_rows;
+  int   tile_size;
+  int   tiles_across;
+
+  int   num_columns;
+  int   end;
+
+  int   m;
+  int   n;
+  int   t;
+
+  (void) arg;
+
+  asset = &S_trim_assets[index];
+
+  asset->status = 0;
+  asset->num_texels = 0;
+
+  num_columns = S_trim_num_columns;
+
+  /* each worker counts into its own histogram */
+  if (S_trim_histograms[worker] == NULL)
+  {
+    S_trim_histograms[worker] = calloc((long) S_trim_num_rows * num_columns, sizeof(unsigned int));
+
+    if (S_trim_histograms[worker] == NULL)
+    {
+      asset->status = 1;
+      return;
+    }
+  }
+
+  histogram = S_trim_histograms[worker];
+
+  if (read_tga_image_indices(asset->index_filename, &image))
+  {
+    asset->status = 1;
+    return;
+  }
+
+  /* the texture row of each tile (a single tile covers the */
+  /* image if it has one palette & level)                   */
+  if (asset->tile_map_filename[0] != '\0')
+  {
+    if (read_trim_tile_map(asset, image.width, image.height, &tile_rows, &tile_size, &tiles_across))
+    {
+      asset->status = 1;
+      clear_tga_image(&image);
+      return;
+    }
+  }
+  else
+  {
+    tile_rows = malloc(sizeof(int));
+
+    if (tile_rows == NULL)
+    {
+      asset->status = 1;
+      clear_tga_image(&image);
+      return;
+    }
+
+    tile_rows[0] = get_trim_row(asset->palette, asset->level);
+    tile_size = (image.width > image.height) ? image.width : image.height;
+    tiles_across = 1;
+
+    if (tile_rows[0] < 0)
+    {
+      fprintf(stderr, "Asset %s: The %s texture has %d palettes of %d levels.\n",
+              asset->index_filename, get_palette_source_name(),
+              get_palette_num_bands(), S_trim_levels_per_palette);
+      asset->status = 1;
+    }
+  }
+
+  /* count the texels, one tile span at a time */
+  for (n = 0; (!asset->status) && (n < image.height); n++)
+  {
+    indices = (unsigned short*) get_tga_image_row(&image, n);
+
+    for (t = 0; t < tiles_across; t++)
+    {
+      counts = &histogram[(long) tile_rows[(n / tile_size) * tiles_across + t] * num_columns];
+
+      end = (t + 1) * tile_size;
+
+      if (end > image.width)
+        end = image.width;
+
+      for (m = t * tile_size; m < end; m++)
+      {
+        if (indices[m] >= num_columns)
+          break;
+
+        counts[indices[m]] += 1;
+      }
+
+      if (m < end)
+      {
+        fprintf(stderr, "Asset %s: Index %d is past the %s texture.\n",
+                asset->index_filename, indices[m], get_palette_source_name());
+        asset->status = 1;
+        break;
+      }
+    }
+  }
+
+  if (!asset->status)
+    asset->num_texels = (long) image.width * image.height;
+
+  free(tile_rows);
+  clear_tga_image(&image);
+}
+
+/*******************************************************************************
+** trim_reduce_task()
+*******************************************************************************/
+void trim_reduce_task(int worker, long index, void* arg)
+{
+  unsigned long*  counts;
+  unsigned int*   histogram;
+
+  int   num_columns;
+
+  int   k;
+  int   m;
+
+  (void) worker;
+  (void) arg;
+
+  /* one texture row per task */
+  num_columns = S_trim_num_columns;
+
+  counts = &S_trim_counts[index * num_columns];
+
+  for (m = 0; m < num_columns; m++)
+    counts[m] = 0;
+
+  for (k = 0; k < POOL_MAX_THREADS; k++)
+  {
+    if (S_trim_histograms[k] == NULL)
+      continue;
+
+    histogram = &S_trim_histograms[k][index * num_columns];
+
+    for (m = 0; m < num_columns; m++)
+      counts[m] += histogram[m];
+  }
+}
+
+/*******************************************************************************
+** run_trim()
+*******************************************************************************/
+short int run_trim(int num_threads)
+{
+  struct timespec start;
+  struct timespec end;
+
+  long  num_texels;
+  int   num_failed;
+
+  int   k;
+  int   n;
+  int   m;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  /* generate the texture */
+  if (generate_palette())
+    return 1;
+
+  S_trim_num_rows = G_palette_size;
+  S_trim_num_columns = G_palette_size;
+  S_trim_levels_per_palette = G_palette_size / get_palette_num_bands();
+
+  S_trim_counts = malloc(sizeof(unsigned long) * S_trim_num_rows * S_trim_num_columns);
+  S_trim_row_map = malloc(sizeof(int) * S_trim_num_rows);
+  S_trim_column_map = malloc(sizeof(int) * S_trim_num_columns);
+
+  if ((S_trim_counts == NULL) || (S_trim_row_map == NULL) || (S_trim_column_map == NULL))
+  {
+    fprintf(stderr, "Unable to allocate trim tables.\n");
+    return 1;
+  }
+
+  /* count the texels of the assets, then add up the histograms */
+  for (k = 0; k < POOL_MAX_THREADS; k++)
+    S_trim_histograms[k] = NULL;
+
+  run_pool_tasks(num_threads, S_trim_num_assets, trim_asset_task, NULL);
+
+  num_texels = 0;
+  num_failed = 0;
+
+  for (k = 0; k < S_trim_num_assets; k++)
+  {
+    if (S_trim_assets[k].status)
+    {
+      fprintf(stderr, "Error reading asset %s.\n", S_trim_assets[k].index_filename);
+      num_failed += 1;
+    }
+
+    num_texels += S_trim_assets[k].num_texels;
+  }
+
+  if (num_failed == 0)
+    run_pool_tasks(num_threads, S_trim_num_rows, trim_reduce_task, NULL);
+
+  for (k = 0; k < POOL_MAX_THREADS; k++)
+  {
+    if (S_trim_histograms[k] != NULL)
+    {
+      free(S_trim_histograms[k]);
+      S_trim_histograms[k] = NULL;
+    }
+  }
+
+  /* the texture is only trimmed if every asset was counted */
+  if (num_failed > 0)
+    return 1;
+
+  /* keep the used rows & columns, in order */
+  for (m = 0; m < S_trim_num_columns; m++)
+    S_trim_column_map[m] = -1;
+
+  S_trim_num_used_rows = 0;
+
+  for (n = 0; n < S_trim_num_rows; n++)
+  {
+    S_trim_row_map[n] = -1;
+
+    for (m = 0; m < S_trim_num_columns; m++)
+    {
+      if (S_trim_counts[(long) n * S_trim_num_columns + m] == 0)
+        continue;
+
+      S_trim_row_map[n] = S_trim_num_used_rows;
+      S_trim_column_map[m] = 0;
+    }
+
+    if (S_trim_row_map[n] >= 0)
+      S_trim_num_used_rows += 1;
+  }
+
+  S_trim_num_used_columns = 0;
+
+  for (m = 0; m < S_trim_num_columns; m++)
+  {
+    if (S_trim_column_map[m] >= 0)
+    {
+      S_trim_column_map[m] = S_trim_num_used_columns;
+      S_trim_num_used_columns += 1;
+    }
+  }
+
+  if (S_trim_num_used_rows == 0)
+  {
+    fprintf(stderr, "The assets do not use any texels.\n");
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("trimmed %s from %dx%d to %dx%d (%.1f%% of the texels), %ld texels in %d assets, in %.2f ms\n",
+         get_palette_source_name(), S_trim_num_columns, S_trim_num_rows,
+         S_trim_num_used_columns, S_trim_num_used_rows,
+         (100.0 * S_trim_num_used_columns * S_trim_num_used_rows) /
+         ((double) S_trim_num_columns * S_trim_num_rows),
+         num_texels, S_trim_num_assets,
+         ((end.tv_sec - start.tv_sec) * 1000.0) + ((end.tv_nsec - start.tv_nsec) / 1000000.0));
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_trim_texture()
+*******************************************************************************/
+short int write_trim_texture(FILE* fp_out)
+{
+  unsigned char*  data;
+  unsigned char*  row_buffer;
+  unsigned char*  dest;
+
+  int   n;
+  int   m;
+
+  short int status;
+
+  if ((S_trim_row_map == NULL) || (S_trim_num_used_rows == 0))
+    return 1;
+
+  data = malloc(sizeof(unsigned char) * 3 * S_trim_num_used_columns * S_trim_num_used_rows);
+  row_buffer = malloc(sizeof(unsigned char) * 3 * S_trim_num_columns);
+
+  if ((data == NULL) || (row_buffer == NULL))
+  {
+    fprintf(stderr, "Unable to allocate trimmed texture.\n");
+    status = 1;
+    goto cleanup;
+  }
+
+  /* the rows are taken as they appear in the tga file (bgr, with */
+  /* transparent texels as magenta), and put back in rgb order    */
+  for (n = 0; n < S_trim_num_rows; n++)
+  {
+    if (S_trim_row_map[n] < 0)
+      continue;
+
+    convert_tga_rows(row_buffer, n, 1);
+
+    for (m = 0; m < S_trim_num_columns; m++)
+    {
+      if (S_trim_column_map[m] < 0)
+        continue;
+
+      dest = &data[3 * ((long) S_trim_row_map[n] * S_trim_num_used_columns + S_trim_column_map[m])];
+
+      dest[0] = row_buffer[3 * m + 2];
+      dest[1] = row_buffer[3 * m + 1];
+      dest[2] = row_buffer[3 * m + 0];
+    }
+  }
+
+  status = write_tga_image(fp_out, data, S_trim_num_used_columns, S_trim_num_used_rows, 3);
+
+cleanup:
+  if (data != NULL)
+    free(data);
+  if (row_buffer != NULL)
+    free(row_buffer);
+
+  return status;
+}
+
+/*******************************************************************************
+** write_trim_tables()
+*******************************************************************************/
+short int write_trim_tables(FILE* fp_out)
+{
+  unsigned long num_texels;
+
+  int   n;
+  int   m;
+
+  if ((fp_out == NULL) || (S_trim_row_map == NULL) || (S_trim_num_used_rows == 0))
+    return 1;
+
+  /* one line per kept row (with its palette & level) or column, */
+  /* and the number of texels of the assets that use it          */
+  fprintf(fp_out, "table,palette,level,old,new,texels\n");
+
+  for (n = 0; n < S_trim_num_rows; n++)
+  {
+    if (S_trim_row_map[n] < 0)
+      continue;
+
+    num_texels = 0;
+
+    for (m = 0; m < S_trim_num_columns; m++)
+      num_texels += S_trim_counts[(long) n * S_trim_num_columns + m];
+
+    fprintf(fp_out, "row,%d,%d,%d,%d,%lu\n",
+            n / S_trim_levels_per_palette, n % S_trim_levels_per_palette,
+            n, S_trim_row_map[n], num_texels);
+  }
+
+  for (m = 0; m < S_trim_num_columns; m++)
+  {
+    if (S_trim_column_map[m] < 0)
+      continue;
+
+    num_texels = 0;
+
+    for (n = 0; n < S_trim_num_rows; n++)
+      num_texels += S_trim_counts[(long) n * S_trim_num_columns + m];
+
+    fprintf(fp_out, "column,,,%d,%d,%lu\n", m, S_trim_column_map[m], num_texels);
+  }
+
+  if (ferror(fp_out))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_trim()
+*******************************************************************************/
+short int clear_trim()
+{
+  if (S_trim_assets != NULL)
+  {
+    free(S_trim_assets);
+    S_trim_assets = NULL;
+  }
+
+  S_trim_num_assets = 0;
+  S_trim_max_assets = 0;
+
+  if (S_trim_counts != NULL)
+  {
+    free(S_trim_counts);
+    S_trim_counts = NULL;
+  }
+
+  if (S_trim_row_map != NULL)
+  {
+    free(S_trim_row_map);
+    S_trim_row_map = NULL;
+  }
+
+  if (S_trim_column_map != NULL)
+  {
+    free(S_trim_column_map);
+    S_trim_column_map = NULL;
+  }
+
+  S_trim_num_used_rows = 0;
+  S_trim_num_used_columns = 0;
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+/*******************************************************************************
+** trim.h (usage-driven texture trimming)
+*******************************************************************************/
+
+#ifndef TRIM_H
+#define TRIM_H
+
+#include <stdio.h>
+
+#define TRIM_FILENAME_LENGTH  512
+#define TRIM_LINE_LENGTH      (2 * TRIM_FILENAME_LENGTH + 64)
+
+/* an asset is an index image (a color-mapped tga file, where each  */
+/* index is a column of the texture), along with the palette & level */
+/* of each of its tiles (a tile map, as written by -encode), or one  */
+/* palette & level for the whole image (as written by -remap)        */
+typedef struct trim_asset
+{
+  char  index_filename[TRIM_FILENAME_LENGTH];
+  char  tile_map_filename[TRIM_FILENAME_LENGTH];
+
+  int   palette;
+  int   level;
+
+  long  num_texels;
+
+  short int status;
+} trim_asset;
+
+/* function declarations */
+short int load_trim_assets(char* filename);
+short int run_trim(int num_threads);
+
+short int write_trim_texture(FILE* fp_out);
+short int write_trim_tables(FILE* fp_out);
+
+short int clear_trim();
+
+#endif
@@ -0,0 +1,504 @@
+/*******************************************************************************
+** ubo.c (std140 uniform buffer outputs)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "packed.h"
+#include "palette.h"
+#include "ubo.h"
+
+/* the selected rows (palettes at lighting levels) are packed one */
+/* after the other, with every color of each row, so the color at */
+/* (row, column) is color i = row * width + column of the block:  */
+/*                                                                */
+/*   rgba8:  colors[i / 4][i % 4], 4 bytes (r, g, b, a)           */
+/*   f32:    colors[i], 4 little endian floats (r, g, b, a)       */
+/*                                                                */
+/* before writing, test_ubo_layout() packs a known palette and     */
+/* checks it against hand computed std140 offsets & sizes. the     */
+/* header has the matching structs, with compile time size checks. */
+
+char* G_ubo_selection;
+
+int*  S_ubo_palettes;
+int*  S_ubo_levels;
+int   S_ubo_num_rows;
+
+/*******************************************************************************
+** add_ubo_rows()
+*******************************************************************************/
+short int add_ubo_rows(int palette, int first_level, int last_level)
+{
+  int   levels_per_palette;
+  int   m;
+
+  levels_per_palette = G_palette_size / get_palette_num_bands();
+
+  if ((palette < 0) || (palette >= get_palette_num_bands()) ||
+      (first_level < 0) || (last_level >= levels_per_palette) || (first_level > last_level))
+  {
+    fprintf(stderr, "The %s texture has %d palettes of %d levels.\n",
+            get_palette_source_name(), get_palette_num_bands(), levels_per_palette);
+    return 1;
+  }
+
+  for (m = first_level; m <= last_level; m++)
+  {
+    if (S_ubo_num_rows >= G_palette_size)
+    {
+      fprintf(stderr, "Too many uniform buffer rows (at most %d).\n", G_palette_size);
+      return 1;
+    }
+
+    S_ubo_palettes[S_ubo_num_rows] = palette;
+    S_ubo_levels[S_ubo_num_rows] = m;
+
+    S_ubo_num_rows += 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** setup_ubo_rows()
+*******************************************************************************/
+short int setup_ubo_rows(char* selection)
+{
+  char* str;
+  char* endptr;
+
+  long  palette;
+  long  first_level;
+  long  last_level;
+
+  int   levels_per_palette;
+
+  clear_ubo_rows();
+
+  S_ubo_palettes = malloc(sizeof(int) * G_palette_size);
+  S_ubo_levels = malloc(sizeof(int) * G_palette_size);
+
+  if ((S_ubo_palettes == NULL) || (S_ubo_levels == NULL))
+  {
+    clear_ubo_rows();
+    return 1;
+  }
+
+  levels_per_palette = G_palette_size / get_palette_num_bands();
+
+  /* the whole texture */
+  if (selection == NULL)
+  {
+    for (palette = 0; palette < get_palette_num_bands(); palette++)
+      add_ubo_rows((int) palette, 0, levels_per_palette - 1);
+
+    return 0;
+  }
+
+  /* palette[:level[-level]], ... */
+  str = selection;
+
+  while (1)
+  {
+    palette = strtol(str, &endptr, 10);
+
+    if ((endptr == str) || (palette < 0) || (palette > 65535))
+      goto invalid;
+
+    first_level = 0;
+    last_level = levels_per_palette - 1;
+
+    if (*endptr == ':')
+    {
+      str = endptr + 1;
+      first_level = strtol(str, &endptr, 10);
+
+      if ((endptr == str) || (first_level < 0) || (first_level > 65535))
+        goto invalid;
+
+      last_level = first_level;
+
+      if (*endptr == '-')
+      {
+        str = endptr + 1;
+        last_level = strtol(str, &endptr, 10);
+
+        if ((endptr == str) || (last_level < 0) || (last_level > 65535))
+          goto invalid;
+      }
+    }
+
+    if (add_ubo_rows((int) palette, (int) first_level, (int) last_level))
+    {
+      clear_ubo_rows();
+      return 1;
+    }
+
+    if (*endptr == '\0')
+      break;
+    else if (*endptr != ',')
+      goto invalid;
+
+    str = endptr + 1;
+  }
+
+  return 0;
+
+invalid:
+  fprintf(stderr, "Invalid uniform buffer rows %s.\n", selection);
+  clear_ubo_rows();
+
+  return 1;
+}
+
+/*******************************************************************************
+** get_ubo_block_size()
+*******************************************************************************/
+long get_ubo_block_size(long num_colors, int format)
+{
+  /* the last uvec4 is padded (and the block size is always */
+  /* a multiple of 16 bytes, as the array stride)            */
+  if (format == UBO_FORMAT_RGBA8)
+    return UBO_ARRAY_STRIDE * ((num_colors + UBO_COLORS_PER_UVEC4 - 1) / UBO_COLORS_PER_UVEC4);
+  else
+    return UBO_ARRAY_STRIDE * num_colors;
+}
+
+/*******************************************************************************
+** get_ubo_size()
+*******************************************************************************/
+long get_ubo_size(int format)
+{
+  return get_ubo_block_size((long) S_ubo_num_rows * G_palette_size, format);
+}
+
+/*******************************************************************************
+** set_ubo_float()
+*******************************************************************************/
+short int set_ubo_float(unsigned char* dest, float value)
+{
+  unsigned int  bits;
+
+  memcpy(&bits, &value, 4);
+
+  dest[0] = bits & 0xFF;
+  dest[1] = (bits >> 8) & 0xFF;
+  dest[2] = (bits >> 16) & 0xFF;
+  dest[3] = (bits >> 24) & 0xFF;
+
+  return 0;
+}
+
+/*******************************************************************************
+** pack_ubo_colors()
+*******************************************************************************/
+short int pack_ubo_colors(unsigned char* blob, unsigned char* rgba,
+                          long first_color, int num_colors, int format)
+{
+  unsigned char*  dest;
+  int             m;
+
+  if ((blob == NULL) || (rgba == NULL))
+    return 1;
+
+  /* the colors are consecutive in both layouts */
+  if (format == UBO_FORMAT_RGBA8)
+    memcpy(&blob[4 * first_color], rgba, 4 * num_colors);
+  else
+  {
+    dest = &blob[UBO_ARRAY_STRIDE * first_color];
+
+    for (m = 0; m < 4 * num_colors; m++)
+    {
+      set_ubo_float(dest, rgba[m] / 255.0f);
+      dest += 4;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** build_ubo_blob()
+*******************************************************************************/
+short int build_ubo_blob(unsigned char* blob, int format)
+{
+  unsigned char*  rgba;
+
+  int   bytes_per_pixel;
+  int   row;
+
+  int   k;
+
+  if ((blob == NULL) || (S_ubo_num_rows == 0) || (G_palette_data == NULL))
+    return 1;
+
+  rgba = malloc(sizeof(unsigned char) * 4 * G_palette_size);
+
+  if (rgba == NULL)
+    return 1;
+
+  bytes_per_pixel = get_palette_bytes_per_pixel();
+
+  memset(blob, 0, get_ubo_size(format));
+
+  for (k = 0; k < S_ubo_num_rows; k++)
+  {
+    row = S_ubo_palettes[k] * (G_palette_size / get_palette_num_bands()) + S_ubo_levels[k];
+
+    expand_packed_source_row(rgba, &G_palette_data[(long) bytes_per_pixel * row * G_palette_size], G_palette_size);
+
+    pack_ubo_colors(blob, rgba, (long) k * G_palette_size, G_palette_size, format);
+  }
+
+  free(rgba);
+
+  return 0;
+}
+
+/*******************************************************************************
+** test_ubo_layout()
+*******************************************************************************/
+short int test_ubo_layout()
+{
+  unsigned char rgba[4 * UBO_TEST_NUM_COLORS];
+  unsigned char blob[UBO_TEST_BLOB_SIZE];
+  unsigned char expected[16];
+
+  int   k;
+
+  /* a known palette: color k is (10k + 1, 10k + 2, 10k + 3, 10k + 4), */
+  /* packed as 2 rows of 3 colors                                      */
+  for (k = 0; k < 4 * UBO_TEST_NUM_COLORS; k++)
+    rgba[k] = 10 * (k / 4) + (k % 4) + 1;
+
+  /* rgba8: 6 colors take 2 uvec4s (32 bytes, the last one padded). */
+  /* color 4 starts the 2nd element (the 16 byte array stride), and */
+  /* color 5 is its 2nd component (y), at byte 20                  */
+  if ((get_ubo_block_size(1, UBO_FORMAT_RGBA8) != 16) ||
+      (get_ubo_block_size(4, UBO_FORMAT_RGBA8) != 16) ||
+      (get_ubo_block_size(UBO_TEST_NUM_COLORS, UBO_FORMAT_RGBA8) != 32))
+  {
+    return 1;
+  }
+
+  memset(blob, 0, UBO_TEST_BLOB_SIZE);
+  pack_ubo_colors(blob, rgba, 0, 3, UBO_FORMAT_RGBA8);
+  pack_ubo_colors(blob, &rgba[4 * 3], 3, UBO_TEST_NUM_COLORS - 3, UBO_FORMAT_RGBA8);
+
+  expected[0] = 41; expected[1] = 42; expected[2] = 43; expected[3] = 44;
+  expected[4] = 51; expected[5] = 52; expected[6] = 53; expected[7] = 54;
+
+  if (memcmp(&blob[16], expected, 8))
+    return 1;
+
+  /* the padding & anything past the block are untouched */
+  for (k = 24; k < UBO_TEST_BLOB_SIZE; k++)
+  {
+    if (blob[k] != 0)
+      return 1;
+  }
+
+  /* f32: one vec4 per color (96 bytes). color 1 is at the 16 byte */
+  /* array stride, and color 5 is at byte 80 (51 / 255 = 0.2, with */
+  /* the float bits 0x3E4CCCCD, little endian)                      */
+  if ((get_ubo_block_size(1, UBO_FORMAT_F32) != 16) ||
+      (get_ubo_block_size(UBO_TEST_NUM_COLORS, UBO_FORMAT_F32) != 96))
+  {
+    return 1;
+  }
+
+  memset(blob, 0, UBO_TEST_BLOB_SIZE);
+  pack_ubo_colors(blob, rgba, 0, 3, UBO_FORMAT_F32);
+  pack_ubo_colors(blob, &rgba[4 * 3], 3, UBO_TEST_NUM_COLORS - 3, UBO_FORMAT_F32);
+
+  set_ubo_float(&expected[0], 11 / 255.0f);
+  set_ubo_float(&expected[4], 12 / 255.0f);
+  set_ubo_float(&expected[8], 13 / 255.0f);
+  set_ubo_float(&expected[12], 14 / 255.0f);
+
+  if (memcmp(&blob[16], expected, 16))
+    return 1;
+
+  if ((blob[80] != 0xCD) || (blob[81] != 0xCC) || (blob[82] != 0x4C) || (blob[83] != 0x3E))
+    return 1;
+
+  for (k = 96; k < UBO_TEST_BLOB_SIZE; k++)
+  {
+    if (blob[k] != 0)
+      return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_ubo_file()
+*******************************************************************************/
+short int write_ubo_file(FILE* fp_out, int format)
+{
+  unsigned char*  blob;
+  long            size;
+
+  if ((fp_out == NULL) || (G_palette_data == NULL) || (S_ubo_num_rows == 0))
+    return 1;
+
+  if ((format < 0) || (format >= UBO_NUM_FORMATS))
+    return 1;
+
+  size = get_ubo_size(format);
+
+  blob = malloc(sizeof(unsigned char) * size);
+
+  if (blob == NULL)
+    return 1;
+
+  if (test_ubo_layout() || build_ubo_blob(blob, format))
+  {
+    fprintf(stderr, "Uniform buffer layout check failed.\n");
+    free(blob);
+    return 1;
+  }
+
+  if (size > UBO_GUARANTEED_SIZE)
+  {
+    fprintf(stderr, "Warning: The uniform buffer is %ld bytes (only %d bytes are always supported).\n",
+            size, UBO_GUARANTEED_SIZE);
+  }
+
+  if (fwrite(blob, 1, size, fp_out) < (size_t) size)
+  {
+    free(blob);
+    return 1;
+  }
+
+  free(blob);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_ubo_header_file()
+*******************************************************************************/
+short int write_ubo_header_file(FILE* fp_out)
+{
+  char* source_name;
+  char  upper_name[32];
+
+  long  num_colors;
+  long  rgba8_size;
+  long  f32_size;
+
+  int   k;
+  int   n;
+
+  if ((fp_out == NULL) || (S_ubo_num_rows == 0))
+    return 1;
+
+  source_name = get_palette_source_name();
+
+  if (source_name == NULL)
+    return 1;
+
+  for (n = 0; (source_name[n] != '\0') && (n < 31); n++)
+    upper_name[n] = toupper((unsigned char) source_name[n]);
+
+  upper_name[n] = '\0';
+
+  num_colors = (long) S_ubo_num_rows * G_palette_size;
+
+  rgba8_size = get_ubo_size(UBO_FORMAT_RGBA8);
+  f32_size = get_ubo_size(UBO_FORMAT_F32);
+
+  /* layout (as a comment) */
+  fprintf(fp_out, "/* %s_ubo.h (generated by texture) */\n\n", source_name);
+  fprintf(fp_out, "#ifndef %s_UBO_H\n", upper_name);
+  fprintf(fp_out, "#define %s_UBO_H\n\n", upper_name);
+
+  fprintf(fp_out, "/* std140 uniform blocks (color i = row * %s_UBO_WIDTH + column):\n", upper_name);
+  fprintf(fp_out, "**\n");
+  fprintf(fp_out, "**   layout(std140) uniform %s_rgba8\n", source_name);
+  fprintf(fp_out, "**   {\n");
+  fprintf(fp_out, "**     uvec4 colors[%ld];  (unpackUnorm4x8(colors[i / 4][i %% 4]))\n",
+          rgba8_size / UBO_ARRAY_STRIDE);
+  fprintf(fp_out, "**   };\n");
+  fprintf(fp_out, "**\n");
+  fprintf(fp_out, "**   layout(std140) uniform %s_f32\n", source_name);
+  fprintf(fp_out, "**   {\n");
+  fprintf(fp_out, "**     vec4 colors[%ld];   (colors[i])\n", num_colors);
+  fprintf(fp_out, "**   };\n");
+  fprintf(fp_out, "*/\n\n");
+
+  /* sizes & structs */
+  fprintf(fp_out, "#define %s_UBO_WIDTH       %d\n", upper_name, G_palette_size);
+  fprintf(fp_out, "#define %s_UBO_NUM_ROWS    %d\n", upper_name, S_ubo_num_rows);
+  fprintf(fp_out, "#define %s_UBO_RGBA8_SIZE  %ld\n", upper_name, rgba8_size);
+  fprintf(fp_out, "#define %s_UBO_F32_SIZE    %ld\n\n", upper_name, f32_size);
+
+  fprintf(fp_out, "typedef struct %s_ubo_rgba8\n{\n", source_name);
+  fprintf(fp_out, "  unsigned int  colors[%ld][4];\n", rgba8_size / UBO_ARRAY_STRIDE);
+  fprintf(fp_out, "} %s_ubo_rgba8;\n\n", source_name);
+
+  fprintf(fp_out, "typedef struct %s_ubo_f32\n{\n", source_name);
+  fprintf(fp_out, "  float         colors[%ld][4];\n", num_colors);
+  fprintf(fp_out, "} %s_ubo_f32;\n\n", source_name);
+
+  fprintf(fp_out, "/* the structs must have the std140 sizes */\n");
+  fprintf(fp_out, "typedef char %s_ubo_rgba8_size_check[(sizeof(%s_ubo_rgba8) == %ld) ? 1 : -1];\n",
+          source_name, source_name, rgba8_size);
+  fprintf(fp_out, "typedef char %s_ubo_f32_size_check[(sizeof(%s_ubo_f32) == %ld) ? 1 : -1];\n\n",
+          source_name, source_name, f32_size);
+
+  /* the palette & level of each row */
+  fprintf(fp_out, "/* palette & level of each row */\n");
+  fprintf(fp_out, "static const unsigned short %s_ubo_rows[%d][2] =\n{\n", source_name, S_ubo_num_rows);
+
+  for (k = 0; k < S_ubo_num_rows; k++)
+  {
+    if (k % UBO_HEADER_ROWS_PER_LINE == 0)
+      fprintf(fp_out, "  ");
+
+    fprintf(fp_out, "{%d, %d}", S_ubo_palettes[k], S_ubo_levels[k]);
+
+    if (k + 1 < S_ubo_num_rows)
+      fprintf(fp_out, ",");
+
+    if ((k % UBO_HEADER_ROWS_PER_LINE == UBO_HEADER_ROWS_PER_LINE - 1) || (k + 1 == S_ubo_num_rows))
+      fprintf(fp_out, "\n");
+    else
+      fprintf(fp_out, " ");
+  }
+
+  fprintf(fp_out, "};\n\n#endif\n");
+
+  if (ferror(fp_out))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** clear_ubo_rows()
+*******************************************************************************/
+short int clear_ubo_rows()
+{
+  if (S_ubo_palettes != NULL)
+  {
+    free(S_ubo_palettes);
+    S_ubo_palettes = NULL;
+  }
+
+  if (S_ubo_levels != NULL)
+  {
+    free(S_ubo_levels);
+    S_ubo_levels = NULL;
+  }
+
+  S_ubo_num_rows = 0;
+
+  return 0;
+}
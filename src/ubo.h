@@ -0,0 +1,52 @@
+/*******************************************************************************
+** ubo.h (std140 uniform buffer outputs)
+*******************************************************************************/
+
+#ifndef UBO_H
+#define UBO_H
+
+#include <stdio.h>
+
+/* the block has one array member. in std140, each array element takes */
+/* 16 bytes: a uvec4 of 4 rgba8 colors (each read with unpackUnorm4x8) */
+/* or a vec4 of one color (0-1, as in the 8 bit texture)               */
+enum
+{
+  UBO_FORMAT_RGBA8 = 0,
+  UBO_FORMAT_F32,
+  UBO_NUM_FORMATS
+};
+
+#define UBO_ARRAY_STRIDE      16
+#define UBO_COLORS_PER_UVEC4  4
+
+/* the largest block that every opengl & vulkan implementation supports */
+#define UBO_GUARANTEED_SIZE 16384
+
+#define UBO_HEADER_ROWS_PER_LINE 8
+
+/* the layout test packs a few colors into a larger buffer */
+#define UBO_TEST_NUM_COLORS 6
+#define UBO_TEST_BLOB_SIZE  112
+
+/* rows to export ("palette", "palette:level" or "palette:first-last", */
+/* separated by commas), or NULL for the whole texture                 */
+extern char*  G_ubo_selection;
+
+/* function declarations */
+short int setup_ubo_rows(char* selection);
+
+long      get_ubo_block_size(long num_colors, int format);
+long      get_ubo_size(int format);
+
+short int pack_ubo_colors(unsigned char* blob, unsigned char* rgba,
+                          long first_color, int num_colors, int format);
+short int build_ubo_blob(unsigned char* blob, int format);
+short int test_ubo_layout();
+
+short int write_ubo_file(FILE* fp_out, int format);
+short int write_ubo_header_file(FILE* fp_out);
+
+short int clear_ubo_rows();
+
+#endif
@@ -0,0 +1,592 @@
+/*******************************************************************************
+** watch.c (spec file watch mode)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "palette.h"
+#include "pool.h"
+#include "spec.h"
+#include "tga.h"
+#include "watch.h"
+
+/* the spec file is watched with inotify (on its directory, so that */
+/* editors that save by renaming are seen as well). on each save,   */
+/* the specs are reloaded and compared with the ones the kept       */
+/* textures were generated from:                                    */
+/*                                                                  */
+/*   rotations                   palettes 1-5 & 7-11                */
+/*   fixed_hues_left / right     palettes 7-12                      */
+/*   tints / tint_start_hue      palettes 13-15                     */
+/*   a variant's transform       that variant palette               */
+/*   anything else               the whole texture                  */
+/*                                                                  */
+/* the other palettes only read the palette 0 row at the same level */
+/* (palettes 7-11 also the rotated row, and the variants only their */
+/* own base level row, transformed from palette 0), so only the     */
+/* rows of the changed palettes are regenerated, and they are       */
+/* written over the existing output file in place.                  */
+
+watch_texture*  S_watch_textures;
+int             S_watch_num_textures;
+
+/*******************************************************************************
+** get_palette_range_mask()
+*******************************************************************************/
+long get_palette_range_mask(int first, int last)
+{
+  long  mask;
+  int   p;
+
+  mask = 0;
+
+  for (p = first; p <= last; p++)
+    mask |= WATCH_PALETTE_BIT(p);
+
+  return mask;
+}
+
+/*******************************************************************************
+** get_spec_invalid_palettes()
+*******************************************************************************/
+long get_spec_invalid_palettes(palette_spec* old_spec, palette_spec* new_spec)
+{
+  palette_params* op;
+  palette_params* np;
+
+  long  invalid;
+  int   v;
+
+  op = &old_spec->params;
+  np = &new_spec->params;
+
+  /* these change palette 0 (or the file itself) */
+  if ((strcmp(old_spec->output_filename, new_spec->output_filename)) ||
+      (old_spec->table_source != new_spec->table_source) ||
+      (old_spec->table_step != new_spec->table_step) ||
+      (op->palette_size != np->palette_size) ||
+      (op->levels_per_palette != np->levels_per_palette) ||
+      (op->num_hues != np->num_hues) ||
+      (op->num_shades != np->num_shades) ||
+      (op->num_variants != np->num_variants) ||
+      (op->phi != np->phi))
+  {
+    return WATCH_ALL_PALETTES;
+  }
+
+  invalid = 0;
+
+  if (op->num_rotations != np->num_rotations)
+  {
+    invalid |= get_palette_range_mask(PALETTE_INDEX_ROTATE_60, PALETTE_INDEX_ROTATE_300);
+    invalid |= get_palette_range_mask(PALETTE_INDEX_ALTERNATE_ROTATE_60, PALETTE_INDEX_ALTERNATE_ROTATE_300);
+  }
+
+  if ((op->fixed_hues_left != np->fixed_hues_left) ||
+      (op->fixed_hues_right != np->fixed_hues_right))
+  {
+    invalid |= get_palette_range_mask(PALETTE_INDEX_ALTERNATE_ROTATE_60, PALETTE_INDEX_ALTERNATE_GREYSCALE);
+  }
+
+  if ((op->num_tints != np->num_tints) ||
+      (op->tint_start_hue != np->tint_start_hue))
+  {
+    invalid |= get_palette_range_mask(PALETTE_INDEX_TINT_RED, PALETTE_INDEX_TINT_GREEN);
+  }
+
+  for (v = 0; v < np->num_variants; v++)
+  {
+    if (memcmp(&op->variants[v], &np->variants[v], sizeof(palette_transform)))
+      invalid |= WATCH_PALETTE_BIT(PALETTE_NUM_INDICES + v);
+  }
+
+  return invalid;
+}
+
+/*******************************************************************************
+** write_watch_texture()
+*******************************************************************************/
+short int write_watch_texture(watch_texture* wt)
+{
+  FILE* fp_out;
+
+  short int status;
+
+  fp_out = open_output_stream(wt->spec.output_filename, -1);
+
+  if (fp_out == NULL)
+    return 1;
+
+  status = write_tga_image( fp_out, wt->data,
+                            wt->spec.params.palette_size,
+                            get_palette_height(&wt->spec.params), 3);
+
+  if (close_output_stream(fp_out))
+    status = 1;
+
+  return status;
+}
+
+/*******************************************************************************
+** write_watch_palettes()
+*******************************************************************************/
+short int write_watch_palettes(watch_texture* wt)
+{
+  palette_params* pp;
+
+  unsigned char*  buffer;
+
+  struct stat file_info;
+
+  long  row_bytes;
+  long  block_bytes;
+
+  int   fd;
+  int   p;
+
+  short int status;
+
+  pp = &wt->spec.params;
+
+  row_bytes = 3 * (long) pp->palette_size;
+  block_bytes = row_bytes * pp->levels_per_palette;
+
+  /* the file must still hold a texture of the same size */
+  fd = open(wt->spec.output_filename, O_WRONLY);
+
+  if (fd < 0)
+    return write_watch_texture(wt);
+
+  if ((fstat(fd, &file_info) < 0) || (!S_ISREG(file_info.st_mode)) ||
+      (file_info.st_size != TGA_HEADER_SIZE + row_bytes * get_palette_height(pp)))
+  {
+    close(fd);
+    return write_watch_texture(wt);
+  }
+
+  buffer = malloc(sizeof(unsigned char) * block_bytes);
+
+  if (buffer == NULL)
+  {
+    close(fd);
+    return 1;
+  }
+
+  /* the rows of each palette are contiguous in the file */
+  status = 0;
+
+  for (p = 0; p < get_palette_num_palettes(pp); p++)
+  {
+    if (!(wt->invalid & WATCH_PALETTE_BIT(p)))
+      continue;
+
+    convert_tga_rows_image( buffer, wt->data, pp->palette_size, 3,
+                            p * pp->levels_per_palette, pp->levels_per_palette);
+
+    if (pwrite(fd, buffer, block_bytes, TGA_HEADER_SIZE + p * block_bytes) != block_bytes)
+    {
+      status = 1;
+      break;
+    }
+  }
+
+  free(buffer);
+
+  if (close(fd) < 0)
+    status = 1;
+
+  return status;
+}
+
+/*******************************************************************************
+** watch_task()
+*******************************************************************************/
+void watch_task(int worker, long index, void* arg)
+{
+  watch_texture*  wt;
+  palette_params* pp;
+
+  unsigned char*  row;
+  unsigned char*  level_row;
+  unsigned char*  companion_row;
+
+  int   levels_per_palette;
+  int   num_palettes;
+  int   companion;
+
+  int   m;
+  int   p;
+
+  (void) worker;
+  (void) arg;
+
+  wt = &S_watch_textures[index];
+  pp = &wt->spec.params;
+
+  wt->status = 0;
+  wt->num_rows = 0;
+
+  if (wt->invalid == 0)
+    return;
+
+  levels_per_palette = pp->levels_per_palette;
+
+  /* new (or changed) palette 0: generate & write the whole texture */
+  if (wt->invalid == WATCH_ALL_PALETTES)
+  {
+    if (wt->data == NULL)
+      wt->data = allocate_aligned_buffer(3 * (long) pp->palette_size * get_palette_height(pp));
+
+    if ((wt->data == NULL) || (generate_palette_composite_data(pp, wt->data)))
+    {
+      wt->status = 1;
+      return;
+    }
+
+    wt->num_rows = get_palette_height(pp);
+    wt->status = write_watch_texture(wt);
+
+    return;
+  }
+
+  num_palettes = get_palette_num_palettes(pp);
+
+  /* the changed variants need their base level rows first */
+  for (p = PALETTE_NUM_INDICES; p < num_palettes; p++)
+  {
+    if (!(wt->invalid & WATCH_PALETTE_BIT(p)))
+      continue;
+
+    row = &wt->data[3 * ((p * levels_per_palette) + pp->base_level) * pp->palette_size];
+
+    init_palette_composite_row(pp, row, p, pp->base_level);
+
+    if (generate_palette_variant_rows(pp, &wt->data[3 * pp->base_level * pp->palette_size],
+                                      wt->data, p - PALETTE_NUM_INDICES, 1))
+    {
+      wt->status = 1;
+      return;
+    }
+  }
+
+  /* otherwise, regenerate the rows of the changed palettes (in order, */
+  /* so the rotated rows are updated before the alternate palettes)    */
+  for (m = 0; m < levels_per_palette; m++)
+  {
+    for (p = 1; p < num_palettes; p++)
+    {
+      if (!(wt->invalid & WATCH_PALETTE_BIT(p)))
+        continue;
+
+      row = &wt->data[3 * ((p * levels_per_palette) + m) * pp->palette_size];
+
+      if (p >= PALETTE_NUM_INDICES)
+        level_row = &wt->data[3 * ((p * levels_per_palette) + pp->base_level) * pp->palette_size];
+      else
+        level_row = &wt->data[3 * m * pp->palette_size];
+
+      companion = get_palette_companion_index(p);
+
+      if (companion >= 0)
+        companion_row = &wt->data[3 * ((companion * levels_per_palette) + m) * pp->palette_size];
+      else
+        companion_row = NULL;
+
+      if ((p < PALETTE_NUM_INDICES) || (m != pp->base_level))
+        init_palette_composite_row(pp, row, p, m);
+
+      if (generate_palette_composite_row(pp, row, p, m, level_row, companion_row))
+      {
+        wt->status = 1;
+        return;
+      }
+
+      wt->num_rows += 1;
+    }
+  }
+
+  wt->status = write_watch_palettes(wt);
+}
+
+/*******************************************************************************
+** update_watch_textures()
+*******************************************************************************/
+short int update_watch_textures(int num_threads)
+{
+  watch_texture*  textures;
+  watch_texture*  wt;
+
+  int   k;
+  int   n;
+  int   p;
+
+  short int status;
+
+  /* match the loaded specs with the kept textures (by name) */
+  textures = malloc(sizeof(watch_texture) * G_num_specs);
+
+  if (textures == NULL)
+    return 1;
+
+  for (k = 0; k < G_num_specs; k++)
+  {
+    wt = &textures[k];
+
+    wt->spec = G_specs[k];
+    wt->data = NULL;
+    wt->invalid = WATCH_ALL_PALETTES;
+    wt->num_rows = 0;
+    wt->status = 0;
+
+    for (n = 0; n < S_watch_num_textures; n++)
+    {
+      if ((S_watch_textures[n].data != NULL) &&
+          (!strcmp(S_watch_textures[n].spec.name, wt->spec.name)))
+      {
+        wt->invalid = get_spec_invalid_palettes(&S_watch_textures[n].spec, &wt->spec);
+
+        /* the texture is kept if it has the same size */
+        if (wt->invalid != WATCH_ALL_PALETTES)
+        {
+          wt->data = S_watch_textures[n].data;
+          S_watch_textures[n].data = NULL;
+        }
+
+        break;
+      }
+    }
+  }
+
+  clear_watch_textures();
+
+  S_watch_textures = textures;
+  S_watch_num_textures = G_num_specs;
+
+  /* regenerate across the worker threads */
+  run_pool_tasks(num_threads, S_watch_num_textures, watch_task, NULL);
+
+  /* report */
+  status = 0;
+
+  for (k = 0; k < S_watch_num_textures; k++)
+  {
+    wt = &S_watch_textures[k];
+
+    /* the shared tables & base row are freed with the specs */
+    wt->spec.params.luma_table = NULL;
+    wt->spec.params.saturation_table = NULL;
+    wt->spec.params.base_row = NULL;
+
+    if (wt->status)
+    {
+      fprintf(stderr, "Error generating spec %s (%s).\n",
+              wt->spec.name, wt->spec.output_filename);
+
+      /* regenerate it in full next time */
+      if (wt->data != NULL)
+      {
+        free(wt->data);
+        wt->data = NULL;
+      }
+
+      status = 1;
+      continue;
+    }
+
+    if (wt->invalid == 0)
+      continue;
+
+    if (wt->invalid == WATCH_ALL_PALETTES)
+      printf("%s: all palettes", wt->spec.name);
+    else
+    {
+      printf("%s: palettes", wt->spec.name);
+
+      for (p = 0; p < get_palette_num_palettes(&wt->spec.params); p++)
+      {
+        if (wt->invalid & WATCH_PALETTE_BIT(p))
+          printf(" %d", p);
+      }
+    }
+
+    printf(" (%ld rows)\n", wt->num_rows);
+  }
+
+  return status;
+}
+
+/*******************************************************************************
+** reload_watch_specs()
+*******************************************************************************/
+short int reload_watch_specs(char* filename, int num_threads)
+{
+  struct timespec start;
+  struct timespec end;
+
+  short int status;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (load_palette_specs(filename))
+  {
+    fprintf(stderr, "Error loading spec file. Keeping the previous textures.\n");
+    return 1;
+  }
+
+  if (share_palette_spec_tables())
+  {
+    fprintf(stderr, "Unable to allocate shared spec tables.\n");
+    clear_palette_specs();
+    return 1;
+  }
+
+  status = update_watch_textures(num_threads);
+
+  clear_palette_specs();
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("updated in %.2f ms\n",
+         (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+
+  fflush(stdout);
+
+  return status;
+}
+
+/*******************************************************************************
+** run_spec_watch()
+*******************************************************************************/
+short int run_spec_watch(char* filename, int num_threads)
+{
+  char  directory[SPEC_FILENAME_LENGTH];
+  char* basename;
+  char* separator;
+
+  long  buffer[WATCH_EVENT_BUFFER_SIZE / sizeof(long)];
+  char* event_data;
+  long  length;
+  long  offset;
+
+  struct inotify_event* event;
+  struct pollfd         pfd;
+
+  int   fd;
+  int   changed;
+
+  if ((filename == NULL) || (strlen(filename) >= SPEC_FILENAME_LENGTH))
+    return 1;
+
+  /* watch the directory (for saves that replace the file) */
+  strcpy(directory, filename);
+  separator = strrchr(directory, '/');
+
+  if (separator == NULL)
+  {
+    strcpy(directory, ".");
+    basename = filename;
+  }
+  else
+  {
+    if (separator == directory)
+      separator[1] = '\0';
+    else
+      separator[0] = '\0';
+
+    basename = strrchr(filename, '/') + 1;
+  }
+
+  fd = inotify_init();
+
+  if (fd < 0)
+  {
+    fprintf(stderr, "Unable to initialize inotify.\n");
+    return 1;
+  }
+
+  if (inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+  {
+    fprintf(stderr, "Unable to watch %s.\n", directory);
+    close(fd);
+    return 1;
+  }
+
+  /* generate everything once */
+  reload_watch_specs(filename, num_threads);
+
+  printf("watching %s\n", filename);
+  fflush(stdout);
+
+  event_data = (char*) buffer;
+
+  for (;;)
+  {
+    length = read(fd, event_data, sizeof(buffer));
+
+    if (length <= 0)
+      break;
+
+    /* look for the spec file in the events */
+    changed = 0;
+
+    for (offset = 0; offset < length; offset += sizeof(struct inotify_event) + event->len)
+    {
+      event = (struct inotify_event*) &event_data[offset];
+
+      if ((event->len > 0) && (!strcmp(event->name, basename)))
+        changed = 1;
+    }
+
+    if (!changed)
+      continue;
+
+    /* collect the rest of the events of this save */
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while (poll(&pfd, 1, WATCH_SETTLE_MS) > 0)
+    {
+      if (read(fd, event_data, sizeof(buffer)) <= 0)
+        break;
+    }
+
+    reload_watch_specs(filename, num_threads);
+  }
+
+  close(fd);
+  clear_watch_textures();
+
+  return 1;
+}
+
+/*******************************************************************************
+** clear_watch_textures()
+*******************************************************************************/
+short int clear_watch_textures()
+{
+  int k;
+
+  if (S_watch_textures != NULL)
+  {
+    for (k = 0; k < S_watch_num_textures; k++)
+    {
+      if (S_watch_textures[k].data != NULL)
+        free(S_watch_textures[k].data);
+    }
+
+    free(S_watch_textures);
+    S_watch_textures = NULL;
+  }
+
+  S_watch_num_textures = 0;
+
+  return 0;
+}
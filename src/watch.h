@@ -0,0 +1,39 @@
+/*******************************************************************************
+** watch.h (spec file watch mode)
+*******************************************************************************/
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "spec.h"
+
+/* the events of one save are collected for this long */
+#define WATCH_SETTLE_MS 20
+
+#define WATCH_EVENT_BUFFER_SIZE 4096
+
+/* the palettes to regenerate are kept as a bit mask */
+#define WATCH_PALETTE_BIT(p)  (1L << (p))
+#define WATCH_ALL_PALETTES    ((1L << (PALETTE_NUM_INDICES + PALETTE_MAX_VARIANTS)) - 1)
+
+/* each spec's texture is kept in memory, along with the */
+/* spec it was generated from (to find what changed)     */
+typedef struct watch_texture
+{
+  palette_spec    spec;
+  unsigned char*  data;
+
+  long      invalid;
+  long      num_rows;
+
+  short int status;
+} watch_texture;
+
+/* function declarations */
+long      get_spec_invalid_palettes(palette_spec* old_spec, palette_spec* new_spec);
+
+short int reload_watch_specs(char* filename, int num_threads);
+short int run_spec_watch(char* filename, int num_threads);
+short int clear_watch_textures();
+
+#endif